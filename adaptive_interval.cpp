@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "adaptive_interval.h"
+
+#include <atomic>
+#include <string>
+#include "gstnvdsmeta.h"
+#include "nvds_analytics_meta.h"
+
+#define PGIE_CLASS_ID_PERSON 0
+
+struct _AdaptiveInterval
+{
+  GstElement *pgie;
+  guint max_interval;
+  gint64 idle_us;
+  guint timer_id;
+
+  /* Written by the streaming thread, read by the main loop */
+  std::atomic<gint64> last_activity_us;
+  std::atomic<bool> reset_pending;
+
+  /* Written by the main loop, read by the streaming thread */
+  std::atomic<bool> raised;
+
+  /* Main loop only */
+  guint interval;
+  gint64 last_step_us;
+};
+
+static void
+set_interval (AdaptiveInterval * adaptive, guint interval)
+{
+  if (interval == adaptive->interval)
+    return;
+  g_print ("Inference interval %u -> %u\n", adaptive->interval, interval);
+  adaptive->interval = interval;
+  adaptive->raised = interval > 0;
+  g_object_set (G_OBJECT (adaptive->pgie), "interval", interval, NULL);
+}
+
+static gboolean
+reset_cb (gpointer data)
+{
+  AdaptiveInterval *adaptive = (AdaptiveInterval *) data;
+
+  adaptive->reset_pending = false;
+  set_interval (adaptive, 0);
+  adaptive->last_step_us = g_get_monotonic_time ();
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+check_cb (gpointer data)
+{
+  AdaptiveInterval *adaptive = (AdaptiveInterval *) data;
+  gint64 now = g_get_monotonic_time ();
+
+  if (now - adaptive->last_activity_us.load () < adaptive->idle_us ||
+      now - adaptive->last_step_us < adaptive->idle_us)
+    return G_SOURCE_CONTINUE;
+
+  set_interval (adaptive,
+      MIN (adaptive->interval * 2 + 1, adaptive->max_interval));
+  adaptive->last_step_us = now;
+  return G_SOURCE_CONTINUE;
+}
+
+static GstPadProbeReturn
+activity_probe (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  AdaptiveInterval *adaptive = (AdaptiveInterval *) u_data;
+  NvDsBatchMeta *batch_meta =
+      gst_buffer_get_nvds_batch_meta ((GstBuffer *) info->data);
+  gboolean active = FALSE;
+
+  if (!batch_meta)
+    return GST_PAD_PROBE_OK;
+
+  for (NvDsMetaList * l_frame = batch_meta->frame_meta_list;
+      l_frame != NULL && !active; l_frame = l_frame->next) {
+    NvDsFrameMeta *frame_meta = (NvDsFrameMeta *) (l_frame->data);
+    gboolean has_roi = FALSE;
+    for (NvDsMetaList * l_user = frame_meta->frame_user_meta_list;
+        l_user != NULL && !active; l_user = l_user->next) {
+      NvDsUserMeta *user_meta = (NvDsUserMeta *) l_user->data;
+      if (user_meta->base_meta.meta_type != NVDS_USER_FRAME_META_NVDSANALYTICS)
+        continue;
+      NvDsAnalyticsFrameMeta *meta =
+          (NvDsAnalyticsFrameMeta *) user_meta->user_meta_data;
+      for (const std::pair<const std::string, uint32_t> & count :
+          meta->objInROIcnt) {
+        has_roi = TRUE;
+        if (count.second > 0) {
+          active = TRUE;
+          break;
+        }
+      }
+    }
+    /* Persons outside every ROI are no activity, a stream without ROIs
+     * counts every person */
+    if (has_roi)
+      continue;
+    for (NvDsMetaList * l_obj = frame_meta->obj_meta_list; l_obj != NULL;
+        l_obj = l_obj->next) {
+      if (((NvDsObjectMeta *) l_obj->data)->class_id == PGIE_CLASS_ID_PERSON) {
+        active = TRUE;
+        break;
+      }
+    }
+  }
+
+  if (!active)
+    return GST_PAD_PROBE_OK;
+
+  adaptive->last_activity_us = g_get_monotonic_time ();
+  /* Back to every frame right away, not on the next check. Only a raised
+   * interval needs the main loop, once per raise */
+  if (adaptive->raised && !adaptive->reset_pending.exchange (true))
+    g_main_context_invoke (NULL, reset_cb, adaptive);
+  return GST_PAD_PROBE_OK;
+}
+
+AdaptiveInterval *
+adaptive_interval_new (GstElement * pgie, guint max_interval, guint idle_sec)
+{
+  AdaptiveInterval *adaptive = new AdaptiveInterval ();
+
+  adaptive->pgie = (GstElement *) gst_object_ref (pgie);
+  adaptive->max_interval = max_interval;
+  adaptive->idle_us = (gint64) idle_sec * G_USEC_PER_SEC;
+  adaptive->last_activity_us = g_get_monotonic_time ();
+  adaptive->reset_pending = false;
+  adaptive->last_step_us = adaptive->last_activity_us;
+  g_object_get (G_OBJECT (pgie), "interval", &adaptive->interval, NULL);
+  adaptive->raised = adaptive->interval > 0;
+
+  adaptive->timer_id = g_timeout_add_seconds (ADAPTIVE_INTERVAL_CHECK_SEC,
+      check_cb, adaptive);
+  return adaptive;
+}
+
+void
+adaptive_interval_attach (AdaptiveInterval * adaptive, GstPad * pad)
+{
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, activity_probe, adaptive,
+      NULL);
+}
+
+void
+adaptive_interval_free (AdaptiveInterval * adaptive)
+{
+  if (!adaptive)
+    return;
+
+  g_source_remove (adaptive->timer_id);
+  /* A reset queued by the last buffers would run after the free */
+  while (adaptive->reset_pending)
+    g_main_context_iteration (NULL, FALSE);
+  gst_object_unref (adaptive->pgie);
+  delete adaptive;
+}
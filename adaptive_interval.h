@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __ADAPTIVE_INTERVAL_H__
+#define __ADAPTIVE_INTERVAL_H__
+
+#include <gst/gst.h>
+
+/* How often the idle time is checked and the interval raised one step */
+#define ADAPTIVE_INTERVAL_CHECK_SEC 1
+
+typedef struct _AdaptiveInterval AdaptiveInterval;
+
+/* Raises the nvinfer "interval" property step by step (0, 1, 3, 7, ... up
+ * to max_interval) once no stream has had an object in one of its
+ * nvdsanalytics ROIs (or, without ROIs, a person detected or tracked) for
+ * idle_sec, and drops it back to 0 on the first one. nvinfer only has one
+ * interval for the whole batch, so every stream has to be idle. */
+AdaptiveInterval *adaptive_interval_new (GstElement * pgie,
+    guint max_interval, guint idle_sec);
+
+/* Watches the ROI counts and object meta of the batches crossing pad,
+ * which has to be downstream of nvdsanalytics. */
+void adaptive_interval_attach (AdaptiveInterval * adaptive, GstPad * pad);
+
+void adaptive_interval_free (AdaptiveInterval * adaptive);
+
+#endif
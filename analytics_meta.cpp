@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "analytics_meta.h"
+
+#include <string.h>
+#include <string>
+#include <vector>
+#include "gstnvdsmeta.h"
+#include "nvds_analytics_meta.h"
+
+struct _AnalyticsMeta
+{
+  MetricsSink *metrics;
+  gint person_class_id;
+  gboolean print_roi;
+};
+
+/* One per probed pad, only touched by its streaming thread */
+typedef struct
+{
+  AnalyticsMeta *meta;
+  guint producer;
+  guint stream_offset;
+  guint stream_stride;
+
+  /* Reused from batch to batch, grows to the largest batch once */
+  std::vector<MetricsRecord> records;
+  std::string line;
+} AnalyticsMetaPad;
+
+static GstPadProbeReturn
+analytics_meta_probe (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  AnalyticsMetaPad *meta_pad = (AnalyticsMetaPad *) u_data;
+  AnalyticsMeta *meta = meta_pad->meta;
+  NvDsBatchMeta *batch_meta =
+      gst_buffer_get_nvds_batch_meta ((GstBuffer *) info->data);
+  guint64 timestamp_us = g_get_real_time ();
+
+  if (!batch_meta)
+    return GST_PAD_PROBE_OK;
+
+  meta_pad->records.clear ();
+  for (NvDsMetaList * l_frame = batch_meta->frame_meta_list; l_frame != NULL;
+      l_frame = l_frame->next) {
+    NvDsFrameMeta *frame_meta = (NvDsFrameMeta *) (l_frame->data);
+    MetricsRecord record;
+    size_t first = meta_pad->records.size ();
+
+    memset (&record, 0, sizeof (record));
+    record.timestamp_us = timestamp_us;
+    record.frame_num = frame_meta->frame_num;
+    record.stream_id = frame_meta->pad_index * meta_pad->stream_stride +
+        meta_pad->stream_offset;
+
+    /* The counts are only needed for the records, printing reads the
+     * frame user meta alone */
+    if (meta->metrics) {
+      for (NvDsMetaList * l_obj = frame_meta->obj_meta_list; l_obj != NULL;
+          l_obj = l_obj->next) {
+        NvDsObjectMeta *obj_meta = (NvDsObjectMeta *) (l_obj->data);
+        record.num_objects++;
+        if (obj_meta->class_id == meta->person_class_id)
+          record.person_count++;
+      }
+    }
+
+    if (meta->print_roi)
+      meta_pad->line.clear ();
+    /* Iterate user metadata in frames to search analytics metadata */
+    for (NvDsMetaList * l_user = frame_meta->frame_user_meta_list;
+        l_user != NULL; l_user = l_user->next) {
+      NvDsUserMeta *user_meta = (NvDsUserMeta *) l_user->data;
+      if (user_meta->base_meta.meta_type != NVDS_USER_FRAME_META_NVDSANALYTICS)
+        continue;
+
+      NvDsAnalyticsFrameMeta *analytics =
+          (NvDsAnalyticsFrameMeta *) user_meta->user_meta_data;
+      /* Get the labels from nvdsanalytics config file */
+      for (const std::pair<const std::string, uint32_t> & status :
+          analytics->objInROIcnt) {
+        if (meta->metrics) {
+          g_strlcpy (record.roi_name, status.first.c_str (),
+              sizeof (record.roi_name));
+          record.roi_count = status.second;
+          meta_pad->records.push_back (record);
+        }
+        if (meta->print_roi) {
+          meta_pad->line += " Objs in ROI ";
+          meta_pad->line += status.first;
+          meta_pad->line += " = ";
+          meta_pad->line += std::to_string (status.second);
+        }
+      }
+    }
+
+    if (meta->metrics && meta_pad->records.size () == first)
+      meta_pad->records.push_back (record);
+    if (meta->print_roi && !meta_pad->line.empty ())
+      g_print ("Frame Number = %d of Stream = %u,  %s\n",
+          frame_meta->frame_num, record.stream_id, meta_pad->line.c_str ());
+  }
+
+  if (!meta_pad->records.empty ())
+    metrics_sink_push_batch (meta->metrics, meta_pad->producer,
+        meta_pad->records.data (), meta_pad->records.size ());
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+free_meta_pad (gpointer data)
+{
+  delete (AnalyticsMetaPad *) data;
+}
+
+AnalyticsMeta *
+analytics_meta_new (MetricsSink * metrics, gint person_class_id,
+    gboolean print_roi)
+{
+  AnalyticsMeta *meta = g_new0 (AnalyticsMeta, 1);
+
+  meta->metrics = metrics;
+  meta->person_class_id = person_class_id;
+  meta->print_roi = print_roi;
+  return meta;
+}
+
+void
+analytics_meta_attach (AnalyticsMeta * meta, GstPad * pad, guint producer,
+    guint stream_offset, guint stream_stride)
+{
+  if (!meta || (!meta->metrics && !meta->print_roi))
+    return;
+
+  AnalyticsMetaPad *meta_pad = new AnalyticsMetaPad ();
+  meta_pad->meta = meta;
+  meta_pad->producer = producer;
+  meta_pad->stream_offset = stream_offset;
+  meta_pad->stream_stride = MAX (stream_stride, 1);
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, analytics_meta_probe,
+      meta_pad, free_meta_pad);
+}
+
+void
+analytics_meta_free (AnalyticsMeta * meta)
+{
+  g_free (meta);
+}
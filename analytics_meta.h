@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __ANALYTICS_META_H__
+#define __ANALYTICS_META_H__
+
+#include <gst/gst.h>
+
+#include "metrics_sink.h"
+
+typedef struct _AnalyticsMeta AnalyticsMeta;
+
+/* Single pass over the frame meta of the batches downstream of
+ * nvdsanalytics, shared by track-person-detect and the deepstream-app
+ * build. Every frame becomes one MetricsRecord per ROI, or one without a
+ * ROI, pushed to metrics together once per batch; NULL metrics skips the
+ * records and the object walk they need. With print_roi the ROI counts of
+ * every frame are printed, which only reads the frame user meta. Objects of
+ * person_class_id are counted as persons. */
+AnalyticsMeta *analytics_meta_new (MetricsSink * metrics,
+    gint person_class_id, gboolean print_roi);
+
+/* Adds the probe to pad, no probe at all when nothing consumes the results.
+ * producer is the metrics ring the streaming thread of pad pushes to,
+ * streams are identified as pad_index * stream_stride + stream_offset. */
+void analytics_meta_attach (AnalyticsMeta * meta, GstPad * pad,
+    guint producer, guint stream_offset, guint stream_stride);
+
+/* Once no more buffers flow, before freeing the metrics sink. */
+void analytics_meta_free (AnalyticsMeta * meta);
+
+#endif
@@ -0,0 +1,592 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "benchmark.h"
+
+#include <dlfcn.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <cuda_runtime_api.h>
+#include <nvml.h>
+#include "gstnvdsmeta.h"
+#include "source_manager.h"
+
+/* NVML is only needed for the benchmark, it is resolved at runtime so the
+ * app still starts on machines without the driver library */
+#define BENCHMARK_NVML_LIB "libnvidia-ml.so.1"
+
+/* Decoded buffers waiting to be seen at the end of the pipeline, anything
+ * older is a buffer that was dropped on the way. */
+#define BENCHMARK_MAX_IN_FLIGHT 4096
+
+typedef struct
+{
+  void *lib;
+  nvmlDevice_t device;
+  decltype (&nvmlShutdown) shutdown;
+  decltype (&nvmlDeviceGetUtilizationRates) get_utilization;
+  decltype (&nvmlDeviceGetMemoryInfo) get_memory_info;
+} Nvml;
+
+typedef struct
+{
+  gint64 decoded_us;
+  guint remaining;
+} InFlight;
+
+struct _Benchmark
+{
+  GMainLoop *loop;
+  guint num_streams;
+  guint duration_sec;
+
+  /* Looping the file: the EOS is swallowed, the source seeks back to 0 and
+   * the timestamps continue from where the previous pass ended */
+  GstPad *source_pad;
+  gboolean loop_file;
+  gboolean looped;
+  GstClockTime pts_offset;
+  GstClockTime pts_end;
+
+  std::atomic<gboolean> started;
+  std::atomic<gboolean> measuring;
+  gint64 start_us;
+  gint64 end_us;
+
+  std::mutex lock;
+  std::unordered_map<GstClockTime, InFlight> in_flight;
+  std::map<guint, guint64> frames;
+  std::vector<gint64> latency;
+
+  Nvml nvml;
+  guint nvml_samples;
+  guint64 gpu_util_sum;
+  guint64 mem_util_sum;
+  guint64 mem_used_max;
+  guint64 mem_total;
+};
+
+static void
+nvml_open (Nvml * nvml)
+{
+  char pci_bus_id[32];
+  int device = 0;
+
+  memset (nvml, 0, sizeof (Nvml));
+  nvml->lib = dlopen (BENCHMARK_NVML_LIB, RTLD_LAZY);
+  if (!nvml->lib) {
+    g_printerr ("%s not found, GPU utilization is not reported\n",
+        BENCHMARK_NVML_LIB);
+    return;
+  }
+
+  auto init = (decltype (&nvmlInit_v2)) dlsym (nvml->lib, "nvmlInit_v2");
+  auto get_handle = (decltype (&nvmlDeviceGetHandleByPciBusId_v2))
+      dlsym (nvml->lib, "nvmlDeviceGetHandleByPciBusId_v2");
+  nvml->shutdown = (decltype (&nvmlShutdown)) dlsym (nvml->lib,
+      "nvmlShutdown");
+  nvml->get_utilization = (decltype (&nvmlDeviceGetUtilizationRates))
+      dlsym (nvml->lib, "nvmlDeviceGetUtilizationRates");
+  nvml->get_memory_info = (decltype (&nvmlDeviceGetMemoryInfo))
+      dlsym (nvml->lib, "nvmlDeviceGetMemoryInfo");
+
+  /* NVML and CUDA do not number the GPUs the same way, the PCI bus id is the
+   * common ground */
+  if (!init || !get_handle || !nvml->shutdown || !nvml->get_utilization ||
+      !nvml->get_memory_info || init () != NVML_SUCCESS) {
+    dlclose (nvml->lib);
+    nvml->lib = NULL;
+    return;
+  }
+  if (cudaGetDevice (&device) != cudaSuccess ||
+      cudaDeviceGetPCIBusId (pci_bus_id, sizeof (pci_bus_id),
+          device) != cudaSuccess ||
+      get_handle (pci_bus_id, &nvml->device) != NVML_SUCCESS) {
+    nvml->shutdown ();
+    dlclose (nvml->lib);
+    nvml->lib = NULL;
+  }
+}
+
+static void
+nvml_close (Nvml * nvml)
+{
+  if (!nvml->lib)
+    return;
+  nvml->shutdown ();
+  dlclose (nvml->lib);
+  nvml->lib = NULL;
+}
+
+static gboolean
+seek_cb (gpointer data)
+{
+  Benchmark *bench = (Benchmark *) data;
+  GstEvent *seek = gst_event_new_seek (1.0, GST_FORMAT_TIME,
+      (GstSeekFlags) (GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT),
+      GST_SEEK_TYPE_SET, 0, GST_SEEK_TYPE_NONE, GST_CLOCK_TIME_NONE);
+
+  /* Upstream through the ghost pad, the decoder and demuxer handle it */
+  if (!gst_pad_send_event (bench->source_pad, seek)) {
+    g_printerr ("Benchmark source could not seek back, stopping\n");
+    g_main_loop_quit (bench->loop);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+static GstPadProbeReturn
+source_probe (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  Benchmark *bench = (Benchmark *) u_data;
+
+  if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+    if (!bench->loop_file)
+      return GST_PAD_PROBE_OK;
+    switch (GST_EVENT_TYPE (event)) {
+      case GST_EVENT_EOS:
+        bench->looped = TRUE;
+        bench->pts_offset = bench->pts_end;
+        g_idle_add (seek_cb, bench);
+        return GST_PAD_PROBE_DROP;
+      /* streammux must not see the flush or the new segment of the seek */
+      case GST_EVENT_FLUSH_START:
+      case GST_EVENT_FLUSH_STOP:
+      case GST_EVENT_SEGMENT:
+        return bench->looped ? GST_PAD_PROBE_DROP : GST_PAD_PROBE_OK;
+      default:
+        return GST_PAD_PROBE_OK;
+    }
+  }
+
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+  if (bench->looped && GST_BUFFER_PTS_IS_VALID (buf)) {
+    buf = gst_buffer_make_writable (buf);
+    GST_BUFFER_PTS (buf) += bench->pts_offset;
+    GST_PAD_PROBE_INFO_DATA (info) = buf;
+  }
+  if (GST_BUFFER_PTS_IS_VALID (buf)) {
+    GstClockTime end = GST_BUFFER_PTS (buf);
+    if (GST_BUFFER_DURATION_IS_VALID (buf))
+      end += GST_BUFFER_DURATION (buf);
+    bench->pts_end = MAX (bench->pts_end, end);
+  }
+
+  /* Every stream gets the same buffer, so one PTS stands for num_streams
+   * frames at the end of the pipeline */
+  std::lock_guard<std::mutex> lock (bench->lock);
+  if (bench->in_flight.size () >= BENCHMARK_MAX_IN_FLIGHT)
+    bench->in_flight.clear ();
+  bench->in_flight[GST_BUFFER_PTS (buf)] =
+      { g_get_monotonic_time (), bench->num_streams };
+  return GST_PAD_PROBE_OK;
+}
+
+static gboolean
+sample_cb (gpointer data)
+{
+  Benchmark *bench = (Benchmark *) data;
+  nvmlUtilization_t util;
+  nvmlMemory_t memory;
+
+  if (!bench->measuring)
+    return G_SOURCE_REMOVE;
+  if (bench->nvml.lib &&
+      bench->nvml.get_utilization (bench->nvml.device, &util) == NVML_SUCCESS &&
+      bench->nvml.get_memory_info (bench->nvml.device, &memory) ==
+      NVML_SUCCESS) {
+    bench->gpu_util_sum += util.gpu;
+    bench->mem_util_sum += util.memory;
+    bench->mem_used_max = MAX (bench->mem_used_max, memory.used);
+    bench->mem_total = memory.total;
+    bench->nvml_samples++;
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+stop_cb (gpointer data)
+{
+  Benchmark *bench = (Benchmark *) data;
+
+  bench->end_us = g_get_monotonic_time ();
+  bench->measuring = FALSE;
+  g_main_loop_quit (bench->loop);
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+warmup_done_cb (gpointer data)
+{
+  Benchmark *bench = (Benchmark *) data;
+
+  {
+    std::lock_guard<std::mutex> lock (bench->lock);
+    bench->frames.clear ();
+    bench->latency.clear ();
+  }
+  bench->start_us = g_get_monotonic_time ();
+  bench->measuring = TRUE;
+  g_print ("Benchmark warm-up done, measuring %u streams for %u s\n",
+      bench->num_streams, bench->duration_sec);
+  sample_cb (bench);
+  g_timeout_add_seconds (1, sample_cb, bench);
+  g_timeout_add_seconds (bench->duration_sec, stop_cb, bench);
+  return G_SOURCE_REMOVE;
+}
+
+static GstPadProbeReturn
+sink_probe (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  Benchmark *bench = (Benchmark *) u_data;
+  NvDsBatchMeta *batch_meta =
+      gst_buffer_get_nvds_batch_meta ((GstBuffer *) info->data);
+  gint64 now = g_get_monotonic_time ();
+
+  if (!batch_meta)
+    return GST_PAD_PROBE_OK;
+
+  /* The warm-up starts with the first frame, not with PLAYING, so an engine
+   * build never eats into it */
+  gboolean expected = FALSE;
+  if (bench->started.compare_exchange_strong (expected, TRUE))
+    g_timeout_add_seconds (BENCHMARK_WARMUP_SEC, warmup_done_cb, bench);
+
+  std::lock_guard<std::mutex> lock (bench->lock);
+  for (NvDsMetaList * l_frame = batch_meta->frame_meta_list; l_frame != NULL;
+      l_frame = l_frame->next) {
+    NvDsFrameMeta *frame_meta = (NvDsFrameMeta *) (l_frame->data);
+    auto it = bench->in_flight.find (frame_meta->buf_pts);
+    gint64 latency = -1;
+    if (it != bench->in_flight.end ()) {
+      latency = now - it->second.decoded_us;
+      if (--it->second.remaining == 0)
+        bench->in_flight.erase (it);
+    }
+    if (!bench->measuring)
+      continue;
+    bench->frames[frame_meta->pad_index]++;
+    if (latency >= 0 && bench->latency.size () < BENCHMARK_MAX_SAMPLES)
+      bench->latency.push_back (latency);
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+/* videotestsrc converted to NVMM NV12, the format the decoder hands out */
+static GstElement *
+create_test_source_bin (void)
+{
+  GstElement *bin = gst_bin_new ("source-bin-test");
+  GstElement *src = gst_element_factory_make ("videotestsrc", NULL);
+  GstElement *raw_caps = gst_element_factory_make ("capsfilter", NULL);
+  GstElement *conv = gst_element_factory_make ("nvvideoconvert", NULL);
+  GstElement *nvmm_caps = gst_element_factory_make ("capsfilter", NULL);
+  GstCaps *caps;
+  GstPad *pad;
+
+  if (!bin || !src || !raw_caps || !conv || !nvmm_caps) {
+    g_printerr ("One element in the test source bin could not be created.\n");
+    return NULL;
+  }
+
+  caps = gst_caps_from_string ("video/x-raw, width=1920, height=1080, "
+      "framerate=30/1");
+  g_object_set (G_OBJECT (raw_caps), "caps", caps, NULL);
+  gst_caps_unref (caps);
+  caps = gst_caps_from_string ("video/x-raw(memory:NVMM), format=NV12");
+  g_object_set (G_OBJECT (nvmm_caps), "caps", caps, NULL);
+  gst_caps_unref (caps);
+
+  gst_bin_add_many (GST_BIN (bin), src, raw_caps, conv, nvmm_caps, NULL);
+  if (!gst_element_link_many (src, raw_caps, conv, nvmm_caps, NULL)) {
+    g_printerr ("Test source bin could not be linked.\n");
+    return NULL;
+  }
+
+  pad = gst_element_get_static_pad (nvmm_caps, "src");
+  gst_element_add_pad (bin, gst_ghost_pad_new ("src", pad));
+  gst_object_unref (pad);
+  return bin;
+}
+
+Benchmark *
+benchmark_new (GstElement * pipeline, GstElement * streammux,
+    const gchar * uri, guint num_streams, guint duration_sec, GMainLoop * loop)
+{
+  Benchmark *bench;
+  GstElement *source_bin, *tee;
+  gchar *default_uri = NULL;
+  GstPad *sinkpad;
+  guint i;
+
+  if (!uri) {
+    gchar *path = g_canonicalize_filename (BENCHMARK_DEFAULT_FILE, NULL);
+    default_uri = gst_filename_to_uri (path, NULL);
+    g_free (path);
+    uri = default_uri;
+  }
+
+  if (g_strcmp0 (uri, BENCHMARK_TEST_SOURCE) == 0)
+    source_bin = create_test_source_bin ();
+  else
+    source_bin = source_manager_create_bin (0, uri, -1);
+  tee = gst_element_factory_make ("tee", "benchmark-tee");
+  if (!source_bin || !tee) {
+    /* Neither is in the pipeline yet, nothing else holds them */
+    if (source_bin)
+      gst_object_unref (source_bin);
+    if (tee)
+      gst_object_unref (tee);
+    g_free (default_uri);
+    return NULL;
+  }
+
+  bench = new Benchmark ();
+  bench->loop = loop;
+  bench->num_streams = num_streams;
+  bench->duration_sec = duration_sec;
+  bench->loop_file = g_str_has_prefix (uri, "file:");
+  bench->started = FALSE;
+  bench->measuring = FALSE;
+  g_free (default_uri);
+
+  gst_bin_add_many (GST_BIN (pipeline), source_bin, tee, NULL);
+  bench->source_pad = gst_element_get_static_pad (source_bin, "src");
+  sinkpad = gst_element_get_static_pad (tee, "sink");
+  if (gst_pad_link (bench->source_pad, sinkpad) != GST_PAD_LINK_OK) {
+    g_printerr ("Benchmark source could not be linked to the tee\n");
+    gst_object_unref (sinkpad);
+    benchmark_free (bench);
+    return NULL;
+  }
+  gst_pad_add_probe (sinkpad, (GstPadProbeType) (GST_PAD_PROBE_TYPE_BUFFER |
+          GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM), source_probe, bench, NULL);
+  gst_object_unref (sinkpad);
+
+  /* Decode once, one queue per stream so streammux can collect the batch
+   * from separate threads */
+  for (i = 0; i < num_streams; i++) {
+    gchar name[32];
+    GstElement *queue;
+    GstPad *srcpad;
+
+    g_snprintf (name, sizeof (name), "benchmark-queue-%u", i);
+    queue = gst_element_factory_make ("queue", name);
+    gst_bin_add (GST_BIN (pipeline), queue);
+    g_snprintf (name, sizeof (name), "sink_%u", i);
+    sinkpad = gst_element_get_request_pad (streammux, name);
+    srcpad = gst_element_get_static_pad (queue, "src");
+    if (!gst_element_link (tee, queue) || !sinkpad ||
+        gst_pad_link (srcpad, sinkpad) != GST_PAD_LINK_OK) {
+      g_printerr ("Benchmark stream %u could not be linked\n", i);
+      if (sinkpad)
+        gst_object_unref (sinkpad);
+      gst_object_unref (srcpad);
+      benchmark_free (bench);
+      return NULL;
+    }
+    gst_object_unref (sinkpad);
+    gst_object_unref (srcpad);
+  }
+
+  nvml_open (&bench->nvml);
+  return bench;
+}
+
+void
+benchmark_attach (Benchmark * bench, GstPad * pad)
+{
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, sink_probe, bench, NULL);
+}
+
+static gdouble
+percentile_ms (std::vector<gint64> & samples, gdouble q)
+{
+  if (samples.empty ())
+    return 0;
+  size_t idx = std::min (samples.size () - 1, (size_t) (q * samples.size ()));
+  std::nth_element (samples.begin (), samples.begin () + idx, samples.end ());
+  return samples[idx] / 1000.0;
+}
+
+void
+benchmark_report (Benchmark * bench, const gchar * infer_config)
+{
+  std::map<guint, guint64> frames;
+  std::vector<gint64> latency;
+  gdouble elapsed, total_fps = 0, min_fps = 0;
+  guint i;
+
+  if (!bench->start_us) {
+    g_printerr ("Benchmark ended before the warm-up was over\n");
+    return;
+  }
+  if (!bench->end_us)
+    bench->end_us = g_get_monotonic_time ();
+  bench->measuring = FALSE;
+  elapsed = MAX (bench->end_us - bench->start_us, 1) / 1e6;
+
+  {
+    std::lock_guard<std::mutex> lock (bench->lock);
+    frames = bench->frames;
+    latency.swap (bench->latency);
+  }
+
+  /* A stream that never produced a frame counts as 0 FPS */
+  g_print ("\nstream      fps\n");
+  for (i = 0; i < bench->num_streams; i++) {
+    gdouble fps = frames[i] / elapsed;
+    g_print ("%6u %8.2f\n", i, fps);
+    total_fps += fps;
+    min_fps = i == 0 ? fps : MIN (min_fps, fps);
+  }
+
+  gdouble gpu_util = bench->nvml_samples ?
+      (gdouble) bench->gpu_util_sum / bench->nvml_samples : -1;
+  gdouble mem_util = bench->nvml_samples ?
+      (gdouble) bench->mem_util_sum / bench->nvml_samples : -1;
+  gdouble p50 = percentile_ms (latency, 0.50);
+  gdouble p99 = percentile_ms (latency, 0.99);
+
+  g_print ("\naggregate %.2f fps, per stream min %.2f avg %.2f, "
+      "latency p50 %.2f ms p99 %.2f ms\n", total_fps, min_fps,
+      total_fps / bench->num_streams, p50, p99);
+  if (bench->nvml_samples)
+    g_print ("gpu %.1f %%, memory controller %.1f %%, memory %.0f / %.0f MiB\n",
+        gpu_util, mem_util, bench->mem_used_max / 1048576.0,
+        bench->mem_total / 1048576.0);
+
+  g_print (BENCHMARK_RESULT_PREFIX "streams=%u duration=%.1f config=%s "
+      "aggregate_fps=%.2f min_fps=%.2f avg_fps=%.2f latency_p50_ms=%.2f "
+      "latency_p99_ms=%.2f gpu_util=%.1f mem_util=%.1f gpu_mem_mb=%.0f\n",
+      bench->num_streams, elapsed, infer_config, total_fps, min_fps,
+      total_fps / bench->num_streams, p50, p99, gpu_util, mem_util,
+      bench->mem_used_max / 1048576.0);
+}
+
+void
+benchmark_free (Benchmark * bench)
+{
+  if (!bench)
+    return;
+  bench->measuring = FALSE;
+  /* Warm-up, sampling, stop and seek callbacks that have not run yet */
+  while (g_source_remove_by_user_data (bench));
+  nvml_close (&bench->nvml);
+  if (bench->source_pad)
+    gst_object_unref (bench->source_pad);
+  delete bench;
+}
+
+/* One child run, the min_fps of its result line or a negative value when it
+ * failed or printed none */
+static gdouble
+run_streams (gchar ** argv, guint num_streams)
+{
+  GPtrArray *child_argv = g_ptr_array_new_with_free_func (g_free);
+  gchar *output = NULL;
+  gint status = 0;
+  GError *error = NULL;
+  gdouble min_fps = -1;
+  guint i;
+
+  for (i = 0; argv[i]; i++) {
+    if (g_strcmp0 (argv[i], "--benchmark-sweep") == 0 ||
+        g_str_has_prefix (argv[i], "--benchmark-streams="))
+      continue;
+    if (g_strcmp0 (argv[i], "--benchmark-streams") == 0) {
+      if (argv[i + 1])
+        i++;
+      continue;
+    }
+    g_ptr_array_add (child_argv, g_strdup (argv[i]));
+  }
+  g_ptr_array_add (child_argv,
+      g_strdup_printf ("--benchmark-streams=%u", num_streams));
+  g_ptr_array_add (child_argv, NULL);
+
+  g_print ("Sweep: running %u streams\n", num_streams);
+  if (!g_spawn_sync (NULL, (gchar **) child_argv->pdata, NULL,
+          G_SPAWN_SEARCH_PATH, NULL, NULL, &output, NULL, &status, &error)) {
+    g_printerr ("Sweep: could not run %s: %s\n", argv[0], error->message);
+    g_error_free (error);
+    g_ptr_array_free (child_argv, TRUE);
+    return -1;
+  }
+  g_ptr_array_free (child_argv, TRUE);
+
+  gchar **lines = g_strsplit (output, "\n", -1);
+  for (i = 0; lines[i]; i++) {
+    if (!g_str_has_prefix (lines[i], BENCHMARK_RESULT_PREFIX))
+      continue;
+    g_print ("%s\n", lines[i]);
+    const gchar *field = strstr (lines[i], " min_fps=");
+    if (field)
+      min_fps = g_ascii_strtod (field + strlen (" min_fps="), NULL);
+  }
+  g_strfreev (lines);
+  g_free (output);
+
+  if (!g_spawn_check_exit_status (status, NULL))
+    return -1;
+  return min_fps;
+}
+
+gint
+benchmark_sweep (gchar ** argv, gdouble target_fps, guint max_streams)
+{
+  guint good = 0, bad = max_streams + 1, n = 1;
+  gdouble fps;
+
+  /* Doubling finds the bracket, bisecting narrows it down */
+  while (n <= max_streams) {
+    fps = run_streams (argv, n);
+    if (fps < 0)
+      return -1;
+    if (fps < target_fps) {
+      bad = n;
+      break;
+    }
+    good = n;
+    n = n == max_streams ? max_streams + 1 : MIN (n * 2, max_streams);
+  }
+  while (good > 0 && bad - good > 1) {
+    n = good + (bad - good) / 2;
+    fps = run_streams (argv, n);
+    if (fps < 0)
+      return -1;
+    if (fps < target_fps)
+      bad = n;
+    else
+      good = n;
+  }
+
+  g_print ("Sweep: %u streams sustain %.2f fps%s\n", good, target_fps,
+      good == max_streams ? " (the sweep limit)" : "");
+  return good;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__
+
+#include <gst/gst.h>
+
+/* Seconds after the first frame before counting starts, so engine
+ * deserialization and the first batches do not count. */
+#define BENCHMARK_WARMUP_SEC 5
+
+/* Latency samples kept over the whole measurement. */
+#define BENCHMARK_MAX_SAMPLES (1 << 20)
+
+/* The result line printed at the end of a run, parsed back by the sweep. */
+#define BENCHMARK_RESULT_PREFIX "BENCHMARK "
+
+/* uri used when none is given on the command line, relative to the working
+ * directory. "videotestsrc" selects a generated 1080p test pattern. */
+#define BENCHMARK_DEFAULT_FILE "video.mp4"
+#define BENCHMARK_TEST_SOURCE "videotestsrc"
+
+typedef struct _Benchmark Benchmark;
+
+/* Decodes uri once and fans it out to streammux sink_0 .. sink_<n-1>
+ * through a tee. Files loop until the run ends. duration_sec counts from
+ * the end of the warm-up, then the loop is quit. */
+Benchmark *benchmark_new (GstElement * pipeline, GstElement * streammux,
+    const gchar * uri, guint num_streams, guint duration_sec, GMainLoop * loop);
+
+/* Counts frames per stream and the latency from decode to this pad. */
+void benchmark_attach (Benchmark * bench, GstPad * pad);
+
+/* Per stream table, then one BENCHMARK_RESULT_PREFIX line of key=value. */
+void benchmark_report (Benchmark * bench, const gchar * infer_config);
+
+void benchmark_free (Benchmark * bench);
+
+/* Runs argv[0] with argv plus --benchmark-streams=N, doubling N while every
+ * stream keeps target_fps and bisecting between the last passing and the
+ * first failing count. Returns the largest passing N, 0 if even one stream
+ * is too slow and -1 if a run failed. */
+gint benchmark_sweep (gchar ** argv, gdouble target_fps, guint max_streams);
+
+#endif
@@ -23,6 +23,7 @@
 #include "deepstream_app.h"
 #include "deepstream_config_file_parser.h"
 #include "nvds_version.h"
+#include "analytics_meta.h"
 #include <string.h>
 #include <unistd.h>
 #include <termios.h>
@@ -60,8 +61,8 @@ static GMutex disp_lock;
 static guint rrow, rcol, rcfg;
 static gboolean rrowsel = FALSE, selecting = FALSE;
 
-extern "C" void
-parse_nvdsanalytics_meta_data (NvDsBatchMeta *batch_meta);
+/* Prints the ROI counts of every frame, same probe as track-person-detect */
+static AnalyticsMeta *analytics = NULL;
 
 GST_DEBUG_CATEGORY (NVDS_APP);
 
@@ -85,20 +86,6 @@ GOptionEntry entries[] = {
   ,
 };
 
-/* nvdsanalytics_src_pad_buffer_probe  will extract metadata received on nvdsanalytics
- * src pad and extract nvanalytics metadata etc. */
-static GstPadProbeReturn
-nvdsanalytics_src_pad_buffer_probe (GstPad * pad, GstPadProbeInfo * info,
-    gpointer u_data)
-{
-    GstBuffer *buf = (GstBuffer *) info->data;
-    NvDsBatchMeta *batch_meta = gst_buffer_get_nvds_batch_meta (buf);
-
-    parse_nvdsanalytics_meta_data (batch_meta);
-
-    return GST_PAD_PROBE_OK;
-}
-
 /**
  * Callback function to be called once all inferences (Primary + Secondary)
  * are done. This is opportunity to modify content of the metadata.
@@ -661,8 +648,9 @@ main (int argc, char *argv[])
             g_print ("Unable to get nvdsanalytics src pad\n");
         else
         {
-            gst_pad_add_probe (src_pad, GST_PAD_PROBE_TYPE_BUFFER,
-                    nvdsanalytics_src_pad_buffer_probe, NULL, NULL);
+            if (!analytics)
+                analytics = analytics_meta_new (NULL, -1, TRUE);
+            analytics_meta_attach (analytics, src_pad, 0, 0, 1);
             gst_object_unref (src_pad);
         }
     }
@@ -810,6 +798,7 @@ done:
 
     g_free (appCtx[i]);
   }
+  analytics_meta_free (analytics);
 
   g_mutex_lock (&disp_lock);
   if (display)
@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "metrics_sink.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/* Records popped per wakeup of the writer thread, formatted into one
+ * buffer and handed to a single fwrite. */
+#define METRICS_WRITE_BATCH 256
+
+/* How long the writer sleeps when the ring is empty. */
+#define METRICS_IDLE_USEC 10000
+
+#define METRICS_BINARY_MAGIC "TPDMETR1"
+
+typedef struct
+{
+  gchar magic[8];
+  guint32 version;
+  guint32 record_size;
+} MetricsBinaryHeader;
+
+/* Single producer, single consumer: one per streaming thread that pushes */
+typedef struct
+{
+  std::vector<MetricsRecord> ring;
+  guint mask;
+
+  /* head is only written by the producer, tail only by the writer thread.
+   * Kept on separate cache lines so the two threads do not bounce them. */
+  alignas(64) std::atomic<guint64> head;
+  alignas(64) std::atomic<guint64> tail;
+  alignas(64) std::atomic<guint64> dropped;
+} MetricsRing;
+
+struct _MetricsSink
+{
+  MetricsFormat format;
+  FILE *file;
+  gboolean owns_file;
+
+  std::vector<std::unique_ptr<MetricsRing>> rings;
+  std::atomic<bool> running;
+
+  std::thread writer;
+};
+
+gboolean
+metrics_format_from_string (const gchar * str, MetricsFormat * format)
+{
+  if (!g_strcmp0 (str, "json"))
+    *format = METRICS_FORMAT_JSON;
+  else if (!g_strcmp0 (str, "csv"))
+    *format = METRICS_FORMAT_CSV;
+  else if (!g_strcmp0 (str, "binary"))
+    *format = METRICS_FORMAT_BINARY;
+  else if (!g_strcmp0 (str, "none"))
+    *format = METRICS_FORMAT_NONE;
+  else
+    return FALSE;
+  return TRUE;
+}
+
+gchar *
+metrics_json_escape (const gchar * str, gchar * out, gsize size)
+{
+  gsize len = 0;
+
+  for (const guchar * p = (const guchar *) str; *p; p++) {
+    gchar escaped[7];
+    gint n;
+
+    if (*p == '"' || *p == '\\')
+      n = g_snprintf (escaped, sizeof (escaped), "\\%c", *p);
+    else if (*p < 0x20)
+      n = g_snprintf (escaped, sizeof (escaped), "\\u%04x", *p);
+    else
+      n = g_snprintf (escaped, sizeof (escaped), "%c", *p);
+    if (len + n >= size)
+      break;
+    memcpy (out + len, escaped, n);
+    len += n;
+  }
+  if (size)
+    out[len] = '\0';
+  return out;
+}
+
+static gsize
+format_record (MetricsFormat format, const MetricsRecord * r, gchar * out,
+    gsize size)
+{
+  gchar roi_name[METRICS_ROI_NAME_LEN * 6];
+  gint len = 0;
+
+  switch (format) {
+    case METRICS_FORMAT_JSON:
+      metrics_json_escape (r->roi_name, roi_name, sizeof (roi_name));
+      len = g_snprintf (out, size,
+          "{\"ts_us\":%" G_GUINT64_FORMAT ",\"stream\":%u,\"frame\":%"
+          G_GUINT64_FORMAT ",\"objects\":%u,\"persons\":%u,\"roi\":\"%s\","
+          "\"roi_count\":%u}\n", r->timestamp_us, r->stream_id, r->frame_num,
+          r->num_objects, r->person_count, roi_name, r->roi_count);
+      break;
+    case METRICS_FORMAT_CSV:
+      len = g_snprintf (out, size,
+          "%" G_GUINT64_FORMAT ",%u,%" G_GUINT64_FORMAT ",%u,%u,%s,%u\n",
+          r->timestamp_us, r->stream_id, r->frame_num, r->num_objects,
+          r->person_count, r->roi_name, r->roi_count);
+      break;
+    case METRICS_FORMAT_BINARY:
+      memcpy (out, r, sizeof (MetricsRecord));
+      len = sizeof (MetricsRecord);
+      break;
+    default:
+      break;
+  }
+  return MIN ((gsize) len, size - 1);
+}
+
+static void
+write_header (MetricsSink * sink)
+{
+  if (sink->format == METRICS_FORMAT_CSV) {
+    fputs ("ts_us,stream,frame,objects,persons,roi,roi_count\n", sink->file);
+  } else if (sink->format == METRICS_FORMAT_BINARY) {
+    MetricsBinaryHeader header;
+    memcpy (header.magic, METRICS_BINARY_MAGIC, sizeof (header.magic));
+    header.version = 1;
+    header.record_size = sizeof (MetricsRecord);
+    fwrite (&header, sizeof (header), 1, sink->file);
+  }
+}
+
+/* Pops up to METRICS_WRITE_BATCH records of one ring and writes them,
+ * returns how many were written so the caller knows whether to sleep. */
+static guint
+drain_ring (MetricsSink * sink, MetricsRing * ring, std::vector<gchar> & buffer)
+{
+  guint64 tail = ring->tail.load (std::memory_order_relaxed);
+  guint64 head = ring->head.load (std::memory_order_acquire);
+  guint count = MIN (head - tail, (guint64) METRICS_WRITE_BATCH);
+  gsize used = 0;
+
+  for (guint i = 0; i < count; i++) {
+    const MetricsRecord *r = &ring->ring[(tail + i) & ring->mask];
+    used += format_record (sink->format, r, buffer.data () + used,
+        buffer.size () - used);
+  }
+  /* The slots can be reused as soon as they are formatted */
+  ring->tail.store (tail + count, std::memory_order_release);
+
+  if (used)
+    fwrite (buffer.data (), 1, used, sink->file);
+  return count;
+}
+
+/* One batch from every ring in turn, so a busy producer cannot starve the
+ * others */
+static guint
+drain_batch (MetricsSink * sink, std::vector<gchar> & buffer)
+{
+  guint count = 0;
+
+  for (auto & ring : sink->rings)
+    count += drain_ring (sink, ring.get (), buffer);
+  return count;
+}
+
+static void
+writer_thread (MetricsSink * sink)
+{
+  /* Worst case line is well under 256 bytes */
+  /* Room for a JSON record with a fully escaped ROI name */
+  std::vector<gchar> buffer (METRICS_WRITE_BATCH * 512);
+
+  while (sink->running.load (std::memory_order_acquire)) {
+    if (!drain_batch (sink, buffer)) {
+      fflush (sink->file);
+      g_usleep (METRICS_IDLE_USEC);
+    }
+  }
+  while (drain_batch (sink, buffer));
+  fflush (sink->file);
+}
+
+MetricsSink *
+metrics_sink_new (MetricsFormat format, const gchar * path, guint capacity,
+    guint num_producers)
+{
+  MetricsSink *sink;
+  FILE *file;
+  gboolean owns_file = FALSE;
+
+  if (format == METRICS_FORMAT_NONE)
+    return NULL;
+
+  if (!path || !g_strcmp0 (path, "-")) {
+    file = stdout;
+  } else {
+    file = fopen (path, format == METRICS_FORMAT_BINARY ? "wb" : "w");
+    if (!file) {
+      g_printerr ("Failed to open metrics file %s\n", path);
+      return NULL;
+    }
+    owns_file = TRUE;
+  }
+
+  if (capacity == 0 || (capacity & (capacity - 1)))
+    capacity = METRICS_RING_CAPACITY;
+
+  sink = new MetricsSink ();
+  sink->format = format;
+  sink->file = file;
+  sink->owns_file = owns_file;
+  for (guint i = 0; i < MAX (num_producers, 1u); i++) {
+    std::unique_ptr<MetricsRing> ring (new MetricsRing ());
+    ring->ring.resize (capacity);
+    ring->mask = capacity - 1;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->dropped = 0;
+    sink->rings.push_back (std::move (ring));
+  }
+  sink->running = true;
+
+  write_header (sink);
+  sink->writer = std::thread (writer_thread, sink);
+  return sink;
+}
+
+gboolean
+metrics_sink_push (MetricsSink * sink, guint producer,
+    const MetricsRecord * record)
+{
+  MetricsRing *ring = sink->rings[producer].get ();
+  guint64 head = ring->head.load (std::memory_order_relaxed);
+  guint64 tail = ring->tail.load (std::memory_order_acquire);
+
+  if (head - tail > ring->mask) {
+    ring->dropped.fetch_add (1, std::memory_order_relaxed);
+    return FALSE;
+  }
+
+  ring->ring[head & ring->mask] = *record;
+  ring->head.store (head + 1, std::memory_order_release);
+  return TRUE;
+}
+
+guint
+metrics_sink_push_batch (MetricsSink * sink, guint producer,
+    const MetricsRecord * records, guint count)
+{
+  MetricsRing *ring = sink->rings[producer].get ();
+  guint64 head = ring->head.load (std::memory_order_relaxed);
+  guint64 tail = ring->tail.load (std::memory_order_acquire);
+  guint64 space = ring->mask + 1 - (head - tail);
+  guint queued = MIN ((guint64) count, space);
+
+  for (guint i = 0; i < queued; i++)
+    ring->ring[(head + i) & ring->mask] = records[i];
+  if (queued)
+    ring->head.store (head + queued, std::memory_order_release);
+  if (queued < count)
+    ring->dropped.fetch_add (count - queued, std::memory_order_relaxed);
+  return queued;
+}
+
+void
+metrics_sink_free (MetricsSink * sink)
+{
+  if (!sink)
+    return;
+
+  sink->running.store (false, std::memory_order_release);
+  sink->writer.join ();
+
+  guint64 dropped = 0;
+  for (auto & ring : sink->rings)
+    dropped += ring->dropped.load ();
+  if (dropped)
+    g_printerr ("Metrics sink dropped %" G_GUINT64_FORMAT " records\n",
+        dropped);
+
+  if (sink->owns_file)
+    fclose (sink->file);
+  delete sink;
+}
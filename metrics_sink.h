@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __METRICS_SINK_H__
+#define __METRICS_SINK_H__
+
+#include <glib.h>
+
+#define METRICS_ROI_NAME_LEN 16
+
+/* Default number of records the ring can hold before the probe starts
+ * dropping, must be a power of two. */
+#define METRICS_RING_CAPACITY 8192
+
+typedef enum
+{
+  METRICS_FORMAT_NONE,
+  METRICS_FORMAT_JSON,
+  METRICS_FORMAT_CSV,
+  METRICS_FORMAT_BINARY
+} MetricsFormat;
+
+/* One record per frame and ROI, frames without analytics meta get a single
+ * record with an empty roi_name. Plain data so a push is a memcpy. */
+typedef struct
+{
+  guint64 timestamp_us;
+  guint64 frame_num;
+  guint32 stream_id;
+  guint32 num_objects;
+  guint32 person_count;
+  guint32 roi_count;
+  gchar roi_name[METRICS_ROI_NAME_LEN];
+} MetricsRecord;
+
+typedef struct _MetricsSink MetricsSink;
+
+gboolean metrics_format_from_string (const gchar * str, MetricsFormat * format);
+
+/* Writes str to out escaped for the inside of a JSON string, ROI names come
+ * from the nvdsanalytics config as they are. Stops before an escape that
+ * does not fit in size with the terminator; returns out. At most 6 bytes
+ * per byte of str. */
+gchar *metrics_json_escape (const gchar * str, gchar * out, gsize size);
+
+/* Opens path ("-" for stdout) and starts the writer thread. Every producer
+ * gets its own ring of capacity records, all merged into the one output. */
+MetricsSink *metrics_sink_new (MetricsFormat format, const gchar * path,
+    guint capacity, guint num_producers);
+
+/* Never blocks: returns FALSE and counts a drop when the ring is full. Only
+ * one thread may push to a given producer index. */
+gboolean metrics_sink_push (MetricsSink * sink, guint producer,
+    const MetricsRecord * record);
+
+/* Pushes count records with a single publish of the ring head, as many as
+ * fit. Returns how many were queued, the rest are counted as drops. */
+guint metrics_sink_push_batch (MetricsSink * sink, guint producer,
+    const MetricsRecord * records, guint count);
+
+/* Drains the ring, stops the writer thread and closes the output. */
+void metrics_sink_free (MetricsSink * sink);
+
+#endif
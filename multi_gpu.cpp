@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "multi_gpu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <cuda_runtime_api.h>
+
+#define STREAM_GROUP_INFIX "-stream-"
+
+guint
+multi_gpu_count (guint requested)
+{
+  int devices = 0;
+
+  if (cudaGetDeviceCount (&devices) != cudaSuccess || devices < 1)
+    devices = 1;
+  if (requested > (guint) devices) {
+    g_printerr ("WARNING: %u GPUs requested, using the %d visible\n",
+        requested, devices);
+    requested = devices;
+  }
+  return MAX (requested, 1);
+}
+
+gchar *
+multi_gpu_engine_path (const gchar * infer_config, guint gpu_id)
+{
+  GKeyFile *infer = g_key_file_new ();
+  gchar *engine = NULL;
+  gchar *path = NULL;
+  gchar *dir, *base, *tag, *ext;
+  GString *name;
+
+  if (!g_key_file_load_from_file (infer, infer_config, G_KEY_FILE_NONE, NULL))
+    goto done;
+  engine = g_key_file_get_string (infer, "property", "model-engine-file",
+      NULL);
+  if (!engine)
+    goto done;
+
+  /* Relative to the nvinfer config, the way nvinfer resolves it */
+  if (g_path_is_absolute (engine)) {
+    dir = g_path_get_dirname (engine);
+  } else {
+    gchar *config_dir = g_path_get_dirname (infer_config);
+    gchar *engine_dir = g_path_get_dirname (engine);
+    dir = g_build_filename (config_dir, engine_dir, NULL);
+    g_free (config_dir);
+    g_free (engine_dir);
+  }
+  base = g_path_get_basename (engine);
+  name = g_string_new (NULL);
+
+  /* model_b1_gpu0_fp32.engine, the name nvinfer gives the engines it builds */
+  tag = strstr (base, "gpu");
+  if (tag && g_ascii_isdigit (tag[3])) {
+    gchar *end = tag + 3;
+    while (g_ascii_isdigit (*end))
+      end++;
+    g_string_append_len (name, base, tag - base);
+    g_string_append_printf (name, "gpu%u%s", gpu_id, end);
+  } else {
+    ext = strrchr (base, '.');
+    g_string_append_len (name, base, ext ? ext - base : (gssize) strlen (base));
+    g_string_append_printf (name, "_gpu%u%s", gpu_id, ext ? ext : "");
+  }
+  path = g_build_filename (dir, name->str, NULL);
+
+  g_string_free (name, TRUE);
+  g_free (base);
+  g_free (dir);
+
+done:
+  g_free (engine);
+  g_key_file_free (infer);
+  return path;
+}
+
+gchar *
+multi_gpu_write_analytics_config (const gchar * analytics_config,
+    guint gpu_index, guint num_gpus)
+{
+  GKeyFile *in = g_key_file_new ();
+  GKeyFile *out = g_key_file_new ();
+  GError *error = NULL;
+  gchar **groups = NULL;
+  gchar *data = NULL;
+  gchar *path = NULL;
+  gsize length;
+  gint fd;
+
+  if (!g_key_file_load_from_file (in, analytics_config, G_KEY_FILE_NONE,
+          &error)) {
+    g_printerr ("Failed to read %s: %s\n", analytics_config, error->message);
+    g_error_free (error);
+    goto done;
+  }
+
+  /* Values are copied raw, the ';' lists need no parsing */
+  groups = g_key_file_get_groups (in, NULL);
+  for (gchar ** group = groups; *group; group++) {
+    const gchar *infix = g_strrstr (*group, STREAM_GROUP_INFIX);
+    gchar *target = NULL;
+    gchar **keys;
+
+    if (infix) {
+      const gchar *digits = infix + strlen (STREAM_GROUP_INFIX);
+      gchar *end = NULL;
+      guint64 id = g_ascii_strtoull (digits, &end, 10);
+
+      if (end != digits && *end == '\0') {
+        /* Another GPU's stream */
+        if (id % num_gpus != gpu_index)
+          continue;
+        target = g_strdup_printf ("%.*s" STREAM_GROUP_INFIX "%u",
+            (int) (infix - *group), *group, (guint) (id / num_gpus));
+      }
+    }
+    if (!target)
+      target = g_strdup (*group);
+
+    keys = g_key_file_get_keys (in, *group, NULL, NULL);
+    for (gchar ** key = keys; key && *key; key++) {
+      gchar *value = g_key_file_get_value (in, *group, *key, NULL);
+      g_key_file_set_value (out, target, *key, value);
+      g_free (value);
+    }
+    g_strfreev (keys);
+    g_free (target);
+  }
+
+  data = g_key_file_to_data (out, &length, NULL);
+  fd = g_file_open_tmp ("tpd-analytics-XXXXXX.txt", &path, &error);
+  if (fd < 0) {
+    g_printerr ("Failed to create the analytics config: %s\n",
+        error->message);
+    g_error_free (error);
+    goto done;
+  }
+  if (write (fd, data, length) != (gssize) length) {
+    g_printerr ("Failed to write %s\n", path);
+    unlink (path);
+    g_free (path);
+    path = NULL;
+  }
+  close (fd);
+
+done:
+  g_free (data);
+  g_strfreev (groups);
+  g_key_file_free (in);
+  g_key_file_free (out);
+  return path;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __MULTI_GPU_H__
+#define __MULTI_GPU_H__
+
+#include <glib.h>
+
+/* Streams are dealt round robin over the GPUs: stream id s runs on GPU
+ * s % num_gpus, as batch pad_index s / num_gpus of that GPU's streammux. */
+
+/* requested clamped to the visible devices, at least 1. */
+guint multi_gpu_count (guint requested);
+
+/* model-engine-file of infer_config for gpu_id: a "gpu<N>" in the file name
+ * becomes gpu<gpu_id>, otherwise _gpu<gpu_id> goes before the extension.
+ * Relative paths are resolved against the config directory. NULL when the
+ * config has no engine file, nvinfer then names the one it builds after
+ * the GPU itself. */
+gchar *multi_gpu_engine_path (const gchar * infer_config, guint gpu_id);
+
+/* Copy of analytics_config with only the per stream groups ("...-stream-<id>")
+ * of the streams on gpu_index, renumbered to their pad_index there. Returns
+ * the path of the file, to be freed and unlinked by the caller. */
+gchar *multi_gpu_write_analytics_config (const gchar * analytics_config,
+    guint gpu_index, guint num_gpus);
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * Created by Marcos Luciano
+ * https://www.github.com/marcoslucianops
+ */
+
+#include <stdint.h>
+#include <cuda_fp16.h>
+#include <cuda_runtime_api.h>
+
+#include "yoloNetwork.h"
+
+namespace {
+    __device__ __forceinline__ float silu(const float x)
+    {
+        return x / (1.f + __expf(-x));
+    }
+
+    // x * tanh(softplus(x)) with tanh(log(1 + e^x)) = ((1 + e^x)^2 - 1) / ((1 + e^x)^2 + 1), one exp instead of
+    // exp, log and tanh. Past 20 the ratio is 1 in float
+    __device__ __forceinline__ float mish(const float x)
+    {
+        if (x > 20.f)
+            return x;
+        const float e = __expf(x);
+        const float n = e * (e + 2.f);
+        return x * __fdividef(n, n + 2.f);
+    }
+
+    template <bool Silu>
+    __global__ void activationFloat(const float* __restrict__ input, float* __restrict__ output, const uint64_t count)
+    {
+        for (uint64_t i = blockIdx.x * blockDim.x + threadIdx.x; i < count; i += gridDim.x * blockDim.x)
+            output[i] = Silu ? silu(input[i]) : mish(input[i]);
+    }
+
+    // Two values per thread, the tensors are linear and TensorRT allocations are aligned
+    template <bool Silu>
+    __global__ void activationHalf(const __half2* __restrict__ input, __half2* __restrict__ output, const uint64_t pairs)
+    {
+        for (uint64_t i = blockIdx.x * blockDim.x + threadIdx.x; i < pairs; i += gridDim.x * blockDim.x)
+        {
+            float2 v = __half22float2(input[i]);
+            v.x = Silu ? silu(v.x) : mish(v.x);
+            v.y = Silu ? silu(v.y) : mish(v.y);
+            output[i] = __float22half2_rn(v);
+        }
+    }
+
+    template <bool Silu>
+    __global__ void activationHalfTail(const __half* __restrict__ input, __half* __restrict__ output, const uint64_t i)
+    {
+        float v = __half2float(input[i]);
+        output[i] = __float2half(Silu ? silu(v) : mish(v));
+    }
+
+    uint gridSize(const uint64_t& count, const uint& threads)
+    {
+        // Grid-stride loops, a few waves are enough to fill the GPU
+        uint64_t blocks = (count + threads - 1) / threads;
+        return static_cast<uint>(blocks < 4096 ? (blocks > 0 ? blocks : 1) : 4096);
+    }
+
+    template <bool Silu>
+    void launch(const void* input, void* output, const uint64_t& count, const bool& half, cudaStream_t stream)
+    {
+        const uint threads = 256;
+        if (!half)
+        {
+            activationFloat<Silu><<<gridSize(count, threads), threads, 0, stream>>>(
+                reinterpret_cast<const float*>(input), reinterpret_cast<float*>(output), count);
+            return;
+        }
+
+        const uint64_t pairs = count / 2;
+        if (pairs > 0)
+            activationHalf<Silu><<<gridSize(pairs, threads), threads, 0, stream>>>(
+                reinterpret_cast<const __half2*>(input), reinterpret_cast<__half2*>(output), pairs);
+        if (count % 2)
+            activationHalfTail<Silu><<<1, 1, 0, stream>>>(
+                reinterpret_cast<const __half*>(input), reinterpret_cast<__half*>(output), count - 1);
+    }
+}
+
+cudaError_t cudaActivation(
+    const void* input, void* output, const uint64_t& count, const ActivationType& activation, const bool& half,
+    cudaStream_t stream);
+
+cudaError_t cudaActivation(
+    const void* input, void* output, const uint64_t& count, const ActivationType& activation, const bool& half,
+    cudaStream_t stream)
+{
+    if (activation == ActivationType::kSilu)
+        launch<true>(input, output, count, half, stream);
+    else
+        launch<false>(input, output, count, half, stream);
+    return cudaGetLastError();
+}
@@ -0,0 +1,92 @@
+/*
+ * Created by Marcos Luciano
+ * https://www.github.com/marcoslucianops
+ */
+
+#include <stdint.h>
+#include <cuda_runtime_api.h>
+
+// One thread per network input pixel: bilinear sample of the crop, BGR -> RGB, 1/255 and HWC -> CHW in one pass
+__global__ void calibPreprocess(
+    const uint8_t* src, const int srcW, const int srcH, const int srcStep, const float cropX, const float cropY,
+    const float scaleX, const float scaleY, float* dst, const int dstW, const int dstH, const int channels)
+{
+    const int x = blockIdx.x * blockDim.x + threadIdx.x;
+    const int y = blockIdx.y * blockDim.y + threadIdx.y;
+    if (x >= dstW || y >= dstH)
+        return;
+
+    // Pixel centers line up the same way as cv::resize
+    float sx = fminf(fmaxf(cropX + (x + 0.5f) * scaleX - 0.5f, 0.f), srcW - 1.f);
+    float sy = fminf(fmaxf(cropY + (y + 0.5f) * scaleY - 0.5f, 0.f), srcH - 1.f);
+    const int x0 = static_cast<int>(sx);
+    const int y0 = static_cast<int>(sy);
+    const int x1 = min(x0 + 1, srcW - 1);
+    const int y1 = min(y0 + 1, srcH - 1);
+    const float ax = sx - x0;
+    const float ay = sy - y0;
+
+    const uint8_t* p00 = src + y0 * srcStep + x0 * 3;
+    const uint8_t* p01 = src + y0 * srcStep + x1 * 3;
+    const uint8_t* p10 = src + y1 * srcStep + x0 * 3;
+    const uint8_t* p11 = src + y1 * srcStep + x1 * 3;
+
+    float bgr[3];
+#pragma unroll
+    for (int c = 0; c < 3; ++c)
+    {
+        float top = p00[c] + (p01[c] - p00[c]) * ax;
+        float bottom = p10[c] + (p11[c] - p10[c]) * ax;
+        bgr[c] = (top + (bottom - top) * ay) * (1.f / 255.f);
+    }
+
+    const int plane = dstW * dstH;
+    const int idx = y * dstW + x;
+    if (channels == 3)
+    {
+        dst[idx] = bgr[2];
+        dst[plane + idx] = bgr[1];
+        dst[2 * plane + idx] = bgr[0];
+    }
+    else
+    {
+        dst[idx] = 0.299f * bgr[2] + 0.587f * bgr[1] + 0.114f * bgr[0];
+    }
+}
+
+cudaError_t cudaCalibPreprocess(
+    const void* src, const int& srcW, const int& srcH, const int& srcStep, const int& letterBox, void* dst,
+    const int& dstW, const int& dstH, const int& channels, cudaStream_t stream);
+
+cudaError_t cudaCalibPreprocess(
+    const void* src, const int& srcW, const int& srcH, const int& srcStep, const int& letterBox, void* dst,
+    const int& dstW, const int& dstH, const int& channels, cudaStream_t stream)
+{
+    // letter-box keeps the network aspect ratio by cropping the centre of the image, as the CPU path did
+    float cropX = 0, cropY = 0, cropW = srcW, cropH = srcH;
+    if (letterBox == 1)
+    {
+        float ratioW = static_cast<float>(srcW) / dstW;
+        float ratioH = static_cast<float>(srcH) / dstH;
+        if (ratioW > ratioH)
+        {
+            cropW = static_cast<int>(dstW * ratioH);
+            cropX = (srcW - static_cast<int>(cropW)) / 2;
+        }
+        else if (ratioW < ratioH)
+        {
+            cropH = static_cast<int>(dstH * ratioW);
+            cropY = (srcH - static_cast<int>(cropH)) / 2;
+        }
+    }
+
+    dim3 threads_per_block(32, 8);
+    dim3 number_of_blocks((dstW + threads_per_block.x - 1) / threads_per_block.x,
+        (dstH + threads_per_block.y - 1) / threads_per_block.y);
+
+    calibPreprocess<<<number_of_blocks, threads_per_block, 0, stream>>>(
+        reinterpret_cast<const uint8_t*>(src), srcW, srcH, srcStep, cropX, cropY, cropW / dstW, cropH / dstH,
+        reinterpret_cast<float*>(dst), dstW, dstH, channels);
+
+    return cudaGetLastError();
+}
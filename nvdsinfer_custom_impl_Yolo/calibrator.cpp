@@ -4,13 +4,169 @@
  */
 
 #include "calibrator.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iterator>
 
+cudaError_t cudaCalibPreprocess(
+    const void* src, const int& srcW, const int& srcH, const int& srcStep, const int& letterBox, void* dst,
+    const int& dstW, const int& dstH, const int& channels, cudaStream_t stream);
+
+CalibBatchLoader::CalibBatchLoader(
+    const std::vector<std::string>& imgPaths, const int& batchSize, const int& channels, const int& height,
+    const int& width, const int& letterBox) :
+    imgPaths(imgPaths), batchSize(batchSize), inputC(channels), inputH(height), inputW(width), letterBox(letterBox)
+{
+    numBatches = imgPaths.size() / batchSize;
+    for (Slot& slot : slots)
+        slot.images.resize(batchSize);
+    CUDA_CHECK(cudaStreamCreateWithFlags(&stream, cudaStreamNonBlocking));
+
+    uint numThreads = std::thread::hardware_concurrency();
+    if (getenv(INT8_CALIB_THREADS_ENV))
+        numThreads = std::atoi(getenv(INT8_CALIB_THREADS_ENV));
+    numThreads = std::max(numThreads, 1u);
+    for (uint i = 0; i < numThreads; ++i)
+        workers.emplace_back(&CalibBatchLoader::worker, this);
+
+    // Both slots start decoding right away
+    for (size_t batch = 0; batch < std::min<size_t>(numBatches, 2); ++batch)
+        submit(batch);
+}
+
+CalibBatchLoader::~CalibBatchLoader()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+        jobs.clear();
+    }
+    jobReady.notify_all();
+    for (std::thread& t : workers)
+        t.join();
+
+    for (Slot& slot : slots)
+        for (Image& image : slot.images)
+            if (image.host)
+                CUDA_CHECK(cudaFreeHost(image.host));
+    if (deviceImages)
+        CUDA_CHECK(cudaFree(deviceImages));
+    CUDA_CHECK(cudaStreamDestroy(stream));
+}
+
+void CalibBatchLoader::worker()
+{
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            jobReady.wait(guard, [this] { return stopping || !jobs.empty(); });
+            if (stopping)
+                return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
+
+void CalibBatchLoader::submit(size_t batch)
+{
+    Slot& slot = slots[batch % 2];
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        slot.pending = batchSize;
+        for (int i = 0; i < batchSize; ++i) {
+            size_t index = batch * batchSize + i;
+            jobs.emplace_back([this, &slot, i, index] { decode(slot, i, imgPaths[index]); });
+        }
+    }
+    jobReady.notify_all();
+}
+
+void CalibBatchLoader::decode(Slot& slot, size_t index, const std::string& path)
+{
+    Image& image = slot.images[index];
+    cv::Mat img = cv::imread(path, cv::IMREAD_COLOR);
+
+    if (img.empty()) {
+        // A missing image calibrates as black rather than aborting a long build
+        std::cerr << "Could not read calibration image " << path << std::endl;
+        img = cv::Mat::zeros(inputH, inputW, CV_8UC3);
+    }
+
+    size_t bytes = img.total() * img.elemSize();
+    if (bytes > image.capacity) {
+        if (image.host)
+            CUDA_CHECK(cudaFreeHost(image.host));
+        // Portable: the worker threads are not bound to the build device
+        CUDA_CHECK(cudaHostAlloc(&image.host, bytes, cudaHostAllocPortable));
+        image.capacity = bytes;
+    }
+    for (int row = 0; row < img.rows; ++row)
+        memcpy(image.host + row * img.cols * 3, img.ptr(row), img.cols * 3);
+    image.width = img.cols;
+    image.height = img.rows;
+
+    bool done;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        done = --slot.pending == 0;
+    }
+    if (done)
+        slotReady.notify_all();
+}
+
+bool CalibBatchLoader::next(float* deviceInput)
+{
+    if (nextBatch >= numBatches)
+        return false;
+
+    size_t batch = nextBatch++;
+    Slot& slot = slots[batch % 2];
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        slotReady.wait(guard, [&slot] { return slot.pending == 0; });
+    }
+
+    size_t bytes = 0;
+    for (const Image& image : slot.images)
+        bytes += (static_cast<size_t>(image.width) * image.height * 3 + 255) & ~static_cast<size_t>(255);
+    if (bytes > deviceCapacity) {
+        if (deviceImages)
+            CUDA_CHECK(cudaFree(deviceImages));
+        CUDA_CHECK(cudaMalloc(&deviceImages, bytes));
+        deviceCapacity = bytes;
+    }
+
+    // Raw images go up as they are, the GPU does the per pixel work
+    unsigned char* src = deviceImages;
+    float* dst = deviceInput;
+    for (const Image& image : slot.images) {
+        size_t imageBytes = static_cast<size_t>(image.width) * image.height * 3;
+        CUDA_CHECK(cudaMemcpyAsync(src, image.host, imageBytes, cudaMemcpyHostToDevice, stream));
+        CUDA_CHECK(cudaCalibPreprocess(
+            src, image.width, image.height, image.width * 3, letterBox, dst, inputW, inputH, inputC, stream));
+        src += (imageBytes + 255) & ~static_cast<size_t>(255);
+        dst += inputC * inputH * inputW;
+    }
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+
+    // The pinned buffers of this slot are free again
+    if (batch + 2 < numBatches)
+        submit(batch + 2);
+
+    std::cout << "Calibration batch " << batch + 1 << "/" << numBatches << ", progress: "
+              << (batch + 1) * 100. / numBatches << "%" << std::endl;
+    return true;
+}
+
 namespace nvinfer1
 {
     Int8EntropyCalibrator2::Int8EntropyCalibrator2(const int &batchsize, const int &channels, const int &height, const int &width, const int &letterbox, const std::string &imgPath,
-        const std::string &calibTablePath):batchSize(batchsize), inputC(channels), inputH(height), inputW(width), letterBox(letterbox), calibTablePath(calibTablePath), imageIndex(0)
+        const std::string &calibTablePath):batchSize(batchsize), inputC(channels), inputH(height), inputW(width), letterBox(letterbox), calibTablePath(calibTablePath)
     {
         inputCount = batchsize * channels * height * width;
         std::fstream f(imgPath);
@@ -19,15 +175,13 @@ namespace nvinfer1
             std::string temp;
             while (std::getline(f, temp)) imgPaths.push_back(temp);
         }
-        batchData = new float[inputCount];
-        CUDA_CHECK(cudaMalloc(&deviceInput, inputCount * sizeof(float)));
     }
 
     Int8EntropyCalibrator2::~Int8EntropyCalibrator2()
     {
-        CUDA_CHECK(cudaFree(deviceInput));
-        if (batchData)
-            delete[] batchData;
+        loader.reset();
+        if (deviceInput)
+            CUDA_CHECK(cudaFree(deviceInput));
     }
 
     int Int8EntropyCalibrator2::getBatchSize() const noexcept
@@ -37,24 +191,13 @@ namespace nvinfer1
 
     bool Int8EntropyCalibrator2::getBatch(void **bindings, const char **names, int nbBindings) noexcept
     {
-        if (imageIndex + batchSize > uint(imgPaths.size()))
-            return false;
-
-        float* ptr = batchData;
-        for (size_t j = imageIndex; j < imageIndex + batchSize; ++j)
-        {
-            cv::Mat img = cv::imread(imgPaths[j], cv::IMREAD_COLOR);
-            std::vector<float>inputData = prepareImage(img, inputC, inputH, inputW, letterBox);
-
-            int len = (int)(inputData.size());
-            memcpy(ptr, inputData.data(), len * sizeof(float));
-
-            ptr += inputData.size();
-            std::cout << "Load image: " << imgPaths[j] << std::endl;
-            std::cout << "Progress: " << (j + 1)*100. / imgPaths.size() << "%" << std::endl;
+        // TensorRT only asks for batches when there is no calibration cache, so the decode pool starts here
+        if (!loader) {
+            CUDA_CHECK(cudaMalloc(&deviceInput, inputCount * sizeof(float)));
+            loader.reset(new CalibBatchLoader(imgPaths, batchSize, inputC, inputH, inputW, letterBox));
         }
-        imageIndex += batchSize;
-        CUDA_CHECK(cudaMemcpy(deviceInput, batchData, inputCount * sizeof(float), cudaMemcpyHostToDevice));
+        if (!loader->next(static_cast<float*>(deviceInput)))
+            return false;
         bindings[0] = deviceInput;
         return true;
     }
@@ -79,64 +222,3 @@ namespace nvinfer1
         output.write(reinterpret_cast<const char*>(cache), length);
     }
 }
-
-std::vector<float> prepareImage(cv::Mat& img, int input_c, int input_h, int input_w, int letter_box)
-{
-    cv::Mat out;
-    int image_w = img.cols;
-    int image_h = img.rows;
-    if (image_w != input_w || image_h != input_h)
-    {
-        if (letter_box == 1)
-        {
-            float ratio_w = (float)image_w / (float)input_w;
-            float ratio_h = (float)image_h / (float)input_h;
-            if (ratio_w > ratio_h)
-            {
-                int new_width = input_w * ratio_h;
-                int x = (image_w - new_width) / 2;
-                cv::Rect roi(abs(x), 0, new_width, image_h);
-                out = img(roi);
-            }
-            else if (ratio_w < ratio_h)
-            {
-                int new_height = input_h * ratio_w;
-                int y = (image_h - new_height) / 2;
-                cv::Rect roi(0, abs(y), image_w, new_height);
-                out = img(roi);
-            }
-            else {
-                out = img;
-            }
-            cv::resize(out, out, cv::Size(input_w, input_h), 0, 0, cv::INTER_CUBIC);
-        }
-        else
-        {
-            cv::resize(img, out, cv::Size(input_w, input_h), 0, 0, cv::INTER_CUBIC);
-        }
-        cv::cvtColor(out, out, cv::COLOR_BGR2RGB);
-    }
-    else
-    {
-        cv::cvtColor(img, out, cv::COLOR_BGR2RGB);
-    }
-    if (input_c == 3)
-    {
-        out.convertTo(out, CV_32FC3, 1.0 / 255.0);
-    }
-    else
-    {
-        out.convertTo(out, CV_32FC1, 1.0 / 255.0);
-    }
-    std::vector<cv::Mat> input_channels(input_c);
-    cv::split(out, input_channels);
-    std::vector<float> result(input_h * input_w * input_c);
-    auto data = result.data();
-    int channelLength = input_h * input_w;
-    for (int i = 0; i < input_c; ++i)
-    {
-        memcpy(data, input_channels[i].data, channelLength * sizeof(float));
-        data += channelLength;
-    }
-    return result;
-}
@@ -9,9 +9,18 @@
 #include "opencv2/opencv.hpp"
 #include "cuda_runtime.h"
 #include "NvInfer.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <string>
 
+// Decode threads of the calibration loader, defaults to the number of cores
+#define INT8_CALIB_THREADS_ENV "INT8_CALIB_THREADS"
+
 #ifndef CUDA_CHECK
 #define CUDA_CHECK(callstr)                                                                    \
     {                                                                                          \
@@ -23,6 +32,58 @@
     }
 #endif
 
+// Decodes the calibration images on a thread pool into pinned host memory, two batches in flight: while TensorRT
+// calibrates on batch n, batch n + 1 is being decoded. Resize, crop, normalization and HWC -> CHW run on the GPU.
+class CalibBatchLoader {
+public:
+    CalibBatchLoader(const std::vector<std::string>& imgPaths, const int& batchSize, const int& channels,
+                     const int& height, const int& width, const int& letterBox);
+    ~CalibBatchLoader();
+
+    // Writes the next batch to deviceInput and waits for it, false once less than a full batch is left
+    bool next(float* deviceInput);
+
+private:
+    struct Image
+    {
+        unsigned char* host {nullptr};
+        size_t capacity {0};
+        int width {0};
+        int height {0};
+    };
+
+    struct Slot
+    {
+        std::vector<Image> images;
+        size_t pending {0};
+    };
+
+    void submit(size_t batch);
+    void decode(Slot& slot, size_t index, const std::string& path);
+    void worker();
+
+    std::vector<std::string> imgPaths;
+    int batchSize;
+    int inputC;
+    int inputH;
+    int inputW;
+    int letterBox;
+    size_t numBatches;
+    size_t nextBatch {0};
+    Slot slots[2];
+
+    unsigned char* deviceImages {nullptr};
+    size_t deviceCapacity {0};
+    cudaStream_t stream {nullptr};
+
+    std::mutex lock;
+    std::condition_variable jobReady;
+    std::condition_variable slotReady;
+    std::deque<std::function<void()>> jobs;
+    std::vector<std::thread> workers;
+    bool stopping {false};
+};
+
 namespace nvinfer1 {
     class Int8EntropyCalibrator2 : public nvinfer1::IInt8EntropyCalibrator2 {
     public:
@@ -47,16 +108,13 @@ namespace nvinfer1 {
         int inputW;
         int letterBox;
         std::string calibTablePath;
-        size_t imageIndex;
         size_t inputCount;
         std::vector<std::string> imgPaths;
-        float *batchData{ nullptr };
+        std::unique_ptr<CalibBatchLoader> loader;
         void  *deviceInput{ nullptr };
-        bool readCache;
+        bool readCache{ true };
         std::vector<char> calibrationCache;
     };
 }
 
-std::vector<float> prepareImage(cv::Mat& img, int input_c, int input_h, int input_w, int letter_box);
-
 #endif //CALIBRATOR_H
@@ -0,0 +1,250 @@
+/*
+ * Created by Marcos Luciano
+ * https://www.github.com/marcoslucianops
+ */
+
+#include "engineCache.h"
+#include "utils.h"
+
+#include <cuda_runtime_api.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+namespace {
+    class CacheLogger : public nvinfer1::ILogger
+    {
+        void log(Severity severity, const char* msg) noexcept override
+        {
+            if (severity <= Severity::kWARNING)
+                std::cerr << "Engine cache: " << msg << std::endl;
+        }
+    };
+
+    CacheLogger cacheLogger;
+
+    // The runtime has to outlive every engine it deserialized, nvinfer keeps them until the pipeline stops
+    nvinfer1::IRuntime* cacheRuntime()
+    {
+        static nvinfer1::IRuntime* runtime = nvinfer1::createInferRuntime(cacheLogger);
+        return runtime;
+    }
+
+    // FNV-1a, only used to tell model revisions apart
+    uint64_t hashFile(const std::string& path, uint64_t hash)
+    {
+        std::ifstream file(path, std::ios::binary);
+        char buffer[1 << 16];
+        while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0)
+        {
+            std::streamsize n = file.gcount();
+            for (std::streamsize i = 0; i < n; ++i)
+            {
+                hash ^= static_cast<unsigned char>(buffer[i]);
+                hash *= 1099511628211ULL;
+            }
+        }
+        return hash;
+    }
+
+    // Written next to the final name and renamed, so a crash never leaves a truncated file in the cache
+    bool writeAtomically(const void* data, size_t size, const std::string& path)
+    {
+        std::string tmpPath = path + ".tmp";
+        std::ofstream file(tmpPath, std::ios::binary);
+        file.write(static_cast<const char*>(data), size);
+        file.close();
+
+        if (!file.good() || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+        {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool readFile(const std::string& path, std::vector<char>& data)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.good())
+            return false;
+        std::streamsize size = file.tellg();
+        file.seekg(0, std::ios::beg);
+        data.resize(size);
+        return static_cast<bool>(file.read(data.data(), size));
+    }
+
+    // Per device, every GPU of a multi-GPU pipeline gets its engine from here
+    std::mutex engineLock;
+    std::map<int, std::string> deviceEngines;
+
+    void noteEngine(const std::string& enginePath)
+    {
+        int device = 0;
+        cudaGetDevice(&device);
+        std::lock_guard<std::mutex> lock(engineLock);
+        deviceEngines[device] = enginePath;
+    }
+
+    // nvinfer keeps the builder config after the engine is returned, the cache it points at has to stay valid. One
+    // per config, every nvinfer of the process builds with its own
+    std::mutex timingCacheLock;
+    std::map<const nvinfer1::IBuilderConfig*, std::unique_ptr<nvinfer1::ITimingCache>> timingCaches;
+}
+
+std::string engineCachePath(
+    const std::string& cacheDir, const std::vector<std::string>& modelFiles, const std::string& networkMode,
+    const uint& maxBatchSize)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const std::string& modelFile : modelFiles)
+        hash = hashFile(modelFile, hash);
+
+    int device = 0;
+    cudaDeviceProp prop;
+    cudaGetDevice(&device);
+    cudaGetDeviceProperties(&prop, device);
+
+    // p1: one profile tuned for the bucket, engines cached before that were tuned for batch-size
+    std::stringstream s;
+    s << cacheDir << "/yolo_p1_" << std::hex << std::setw(16) << std::setfill('0') << hash << std::dec << "_"
+      << networkMode << "_b" << maxBatchSize << "_sm" << prop.major << prop.minor << "_trt" << getInferLibVersion()
+      << ".engine";
+    return s.str();
+}
+
+nvinfer1::ICudaEngine* loadCachedEngine(const std::string& enginePath)
+{
+    if (!fileExists(enginePath, false))
+        return nullptr;
+
+    std::vector<char> data;
+    if (!readFile(enginePath, data))
+        return nullptr;
+
+    nvinfer1::IRuntime* runtime = cacheRuntime();
+    if (!runtime)
+        return nullptr;
+
+    nvinfer1::ICudaEngine* engine = runtime->deserializeCudaEngine(data.data(), data.size());
+    if (engine)
+    {
+        std::cout << "Loaded cached engine " << enginePath << "\n" << std::endl;
+        noteEngine(enginePath);
+    }
+    else
+        std::cerr << "Cached engine " << enginePath << " could not be deserialized, rebuilding\n" << std::endl;
+    return engine;
+}
+
+bool saveCachedEngine(nvinfer1::ICudaEngine* engine, const std::string& enginePath)
+{
+    nvinfer1::IHostMemory* serialized = engine->serialize();
+    if (!serialized)
+        return false;
+
+    bool written = writeAtomically(serialized->data(), serialized->size(), enginePath);
+    delete serialized;
+
+    if (!written)
+    {
+        std::cerr << "Could not write engine cache " << enginePath << "\n" << std::endl;
+        return false;
+    }
+
+    std::cout << "Saved engine cache " << enginePath << "\n" << std::endl;
+    noteEngine(enginePath);
+    return true;
+}
+
+std::string lastCachedEngine(const int& device)
+{
+    std::lock_guard<std::mutex> lock(engineLock);
+    auto it = deviceEngines.find(device);
+    return it != deviceEngines.end() ? it->second : std::string();
+}
+
+std::string timingCachePath(const std::string& cacheDir)
+{
+    int device = 0;
+    cudaDeviceProp prop;
+    cudaGetDevice(&device);
+    cudaGetDeviceProperties(&prop, device);
+
+    std::string gpu = prop.name;
+    std::replace_if(gpu.begin(), gpu.end(), [](char c) { return !std::isalnum(static_cast<unsigned char>(c)); }, '-');
+
+    std::stringstream s;
+    s << cacheDir << "/timing_" << gpu << "_sm" << prop.major << prop.minor << "_trt" << getInferLibVersion()
+      << ".cache";
+    return s.str();
+}
+
+bool loadTimingCache(nvinfer1::IBuilderConfig* config, const std::string& cachePath)
+{
+    std::vector<char> data;
+    bool loaded = fileExists(cachePath, false) && readFile(cachePath, data);
+
+    std::unique_ptr<nvinfer1::ITimingCache> cache(
+        config->createTimingCache(loaded ? data.data() : nullptr, loaded ? data.size() : 0));
+    if (!cache && loaded)
+    {
+        std::cerr << "Timing cache " << cachePath << " could not be read, starting a new one\n" << std::endl;
+        loaded = false;
+        cache.reset(config->createTimingCache(nullptr, 0));
+    }
+    if (!cache)
+    {
+        std::cerr << "Could not set up the timing cache\n" << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(timingCacheLock);
+    std::unique_ptr<nvinfer1::ITimingCache>& current = timingCaches[config];
+    if (current && config->getTimingCache() == current.get())
+    {
+        // A second build on the same config, the cache it still points at takes the file in
+        if (loaded && !current->combine(*cache, true))
+            loaded = false;
+    }
+    else
+    {
+        // Not set on this config (or a new config at the address of a freed one), nothing refers to the old cache
+        if (!config->setTimingCache(*cache, false))
+        {
+            std::cerr << "Could not set up the timing cache\n" << std::endl;
+            return false;
+        }
+        current = std::move(cache);
+    }
+
+    if (loaded)
+        std::cout << "Loaded timing cache " << cachePath << "\n" << std::endl;
+    return loaded;
+}
+
+bool saveTimingCache(nvinfer1::IBuilderConfig* config, const std::string& cachePath)
+{
+    const nvinfer1::ITimingCache* cache = config->getTimingCache();
+    if (!cache)
+        return false;
+    nvinfer1::IHostMemory* serialized = cache->serialize();
+    if (!serialized)
+        return false;
+
+    bool written = writeAtomically(serialized->data(), serialized->size(), cachePath);
+    delete serialized;
+
+    if (!written)
+    {
+        std::cerr << "Could not write timing cache " << cachePath << "\n" << std::endl;
+        return false;
+    }
+    std::cout << "Saved timing cache " << cachePath << "\n" << std::endl;
+    return true;
+}
@@ -0,0 +1,35 @@
+/*
+ * Created by Marcos Luciano
+ * https://www.github.com/marcoslucianops
+ */
+
+#ifndef __ENGINE_CACHE_H__
+#define __ENGINE_CACHE_H__
+
+#include <string>
+#include <vector>
+
+#include "NvInfer.h"
+
+// Name of the cached engine for these model files, precision, largest batch profile, GPU architecture and TensorRT
+std::string engineCachePath(
+    const std::string& cacheDir, const std::vector<std::string>& modelFiles, const std::string& networkMode,
+    const uint& maxBatchSize);
+
+nvinfer1::ICudaEngine* loadCachedEngine(const std::string& enginePath);
+
+bool saveCachedEngine(nvinfer1::ICudaEngine* engine, const std::string& enginePath);
+
+// The engine last loaded from or saved to the cache on device by this process, empty when there is none
+std::string lastCachedEngine(const int& device);
+
+// Tactic timings are only valid for one GPU model and TensorRT version, every engine built there shares the file
+std::string timingCachePath(const std::string& cacheDir);
+
+// Starts an empty cache when the file is missing or stale, so the build always records into one. The cache lives as
+// long as the process, a config that already has one keeps it and merges the file in
+bool loadTimingCache(nvinfer1::IBuilderConfig* config, const std::string& cachePath);
+
+bool saveTimingCache(nvinfer1::IBuilderConfig* config, const std::string& cachePath);
+
+#endif
@@ -4,18 +4,30 @@
  */
 
 #include "activation_layer.h"
+#include "../yoloPlugins.h"
 
 nvinfer1::ILayer* activationLayer(
     int layerIdx,
-    std::string activation,
+    const ActivationType& activation,
     nvinfer1::ILayer* output,
     nvinfer1::ITensor* input,
-    nvinfer1::INetworkDefinition* network)
+    nvinfer1::INetworkDefinition* network,
+    bool activationPlugin)
 {
-    if (activation == "linear") {
+    if (activation == ActivationType::kLinear) {
         // Pass
     }
-    else if (activation == "relu")
+    else if (activationPlugin && (activation == ActivationType::kMish || activation == ActivationType::kSilu))
+    {
+        // The network only references it and the builder clones it into the engine, kept alive like YoloLayer
+        YoloActivation* plugin = new YoloActivation(activation);
+        nvinfer1::IPluginV2Layer* fused = network->addPluginV2(&input, 1, *plugin);
+        assert(fused != nullptr);
+        std::string fusedLayerName = activationName(activation) + "_" + std::to_string(layerIdx);
+        fused->setName(fusedLayerName.c_str());
+        output = fused;
+    }
+    else if (activation == ActivationType::kRelu)
     {
         nvinfer1::IActivationLayer* relu = network->addActivation(
             *input, nvinfer1::ActivationType::kRELU);
@@ -24,7 +36,7 @@ nvinfer1::ILayer* activationLayer(
         relu->setName(reluLayerName.c_str());
         output = relu;
     }
-    else if (activation == "sigmoid" || activation == "logistic")
+    else if (activation == ActivationType::kSigmoid)
     {
         nvinfer1::IActivationLayer* sigmoid = network->addActivation(
             *input, nvinfer1::ActivationType::kSIGMOID);
@@ -33,7 +45,7 @@ nvinfer1::ILayer* activationLayer(
         sigmoid->setName(sigmoidLayerName.c_str());
         output = sigmoid;
     }
-    else if (activation == "tanh")
+    else if (activation == ActivationType::kTanh)
     {
         nvinfer1::IActivationLayer* tanh = network->addActivation(
             *input, nvinfer1::ActivationType::kTANH);
@@ -42,7 +54,7 @@ nvinfer1::ILayer* activationLayer(
         tanh->setName(tanhLayerName.c_str());
         output = tanh;
     }
-    else if (activation == "leaky")
+    else if (activation == ActivationType::kLeaky)
     {
         nvinfer1::IActivationLayer* leaky = network->addActivation(
             *input, nvinfer1::ActivationType::kLEAKY_RELU);
@@ -52,7 +64,7 @@ nvinfer1::ILayer* activationLayer(
         leaky->setName(leakyLayerName.c_str());
         output = leaky;
     }
-    else if (activation == "softplus")
+    else if (activation == ActivationType::kSoftplus)
     {
         nvinfer1::IActivationLayer* softplus = network->addActivation(
             *input, nvinfer1::ActivationType::kSOFTPLUS);
@@ -61,7 +73,7 @@ nvinfer1::ILayer* activationLayer(
         softplus->setName(softplusLayerName.c_str());
         output = softplus;
     }
-    else if (activation == "mish")
+    else if (activation == ActivationType::kMish)
     {
         nvinfer1::IActivationLayer* softplus = network->addActivation(
             *input, nvinfer1::ActivationType::kSOFTPLUS);
@@ -81,7 +93,7 @@ nvinfer1::ILayer* activationLayer(
         mish->setName(mishLayerName.c_str());
         output = mish;
     }
-    else if (activation == "silu" || activation == "swish")
+    else if (activation == ActivationType::kSilu)
     {
         nvinfer1::IActivationLayer* sigmoid = network->addActivation(
             *input, nvinfer1::ActivationType::kSIGMOID);
@@ -97,7 +109,7 @@ nvinfer1::ILayer* activationLayer(
         output = silu;
     }
     else {
-        std::cerr << "Activation not supported: " << activation << std::endl;
+        std::cerr << "Activation not supported: " << activationName(activation) << std::endl;
         std::abort();
     }
     return output;
@@ -12,13 +12,14 @@
 
 #include "NvInfer.h"
 
-#include "activation_layer.h"
+#include "../yoloNetwork.h"
 
 nvinfer1::ILayer* activationLayer(
     int layerIdx,
-    std::string activation,
+    const ActivationType& activation,
     nvinfer1::ILayer* output,
     nvinfer1::ITensor* input,
-    nvinfer1::INetworkDefinition* network);
+    nvinfer1::INetworkDefinition* network,
+    bool activationPlugin = false);
 
 #endif
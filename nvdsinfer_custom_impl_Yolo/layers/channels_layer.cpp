@@ -6,21 +6,21 @@
 #include "channels_layer.h"
 
 nvinfer1::ILayer* channelsLayer(
-    std::string type,
+    const LayerType& type,
     nvinfer1::ITensor* input,
     nvinfer1::ITensor* implicitTensor,
     nvinfer1::INetworkDefinition* network)
 {
     nvinfer1::ILayer* output;
 
-    if (type == "shift") {
+    if (type == LayerType::kShiftChannels) {
     nvinfer1::IElementWiseLayer* ew = network->addElementWise(
         *input, *implicitTensor,
         nvinfer1::ElementWiseOperation::kSUM);
     assert(ew != nullptr);
     output = ew;
     }
-    else if (type == "control") {
+    else if (type == LayerType::kControlChannels) {
         nvinfer1::IElementWiseLayer* ew = network->addElementWise(
         *input, *implicitTensor,
         nvinfer1::ElementWiseOperation::kPROD);
@@ -11,8 +11,10 @@
 
 #include "NvInfer.h"
 
+#include "../yoloNetwork.h"
+
 nvinfer1::ILayer* channelsLayer(
-    std::string type,
+    const LayerType& type,
     nvinfer1::ITensor* input,
     nvinfer1::ITensor* implicitTensor,
     nvinfer1::INetworkDefinition* network);
@@ -6,165 +6,92 @@
 #include <math.h>
 #include "convolutional_layer.h"
 
+// Folds gamma * (conv(x) - mean) / sqrt(var + eps) + beta into the conv itself, in place in the weights mapping:
+// the beta slot becomes the conv bias
+static void foldBatchNorm(
+    float* __restrict__ wt, float* __restrict__ biases, const float* __restrict__ scales,
+    const float* __restrict__ mean, const float* __restrict__ var, int filters, int filterSize, float eps)
+{
+    for (int f = 0; f < filters; ++f)
+    {
+        const float scale = scales[f] / sqrtf(var[f] + eps);
+        float* __restrict__ filterWt = wt + static_cast<size_t>(f) * filterSize;
+        for (int i = 0; i < filterSize; ++i)
+            filterWt[i] *= scale;
+        biases[f] -= mean[f] * scale;
+    }
+}
+
 nvinfer1::ILayer* convolutionalLayer(
     int layerIdx,
-    std::map<std::string, std::string>& block,
-    std::vector<float>& weights,
-    std::vector<nvinfer1::Weights>& trtWeights,
+    const LayerDesc& layer,
+    YoloWeights& weights,
     int& weightPtr,
     std::string weightsType,
     int& inputChannels,
     float eps,
     nvinfer1::ITensor* input,
-    nvinfer1::INetworkDefinition* network)
+    nvinfer1::INetworkDefinition* network,
+    bool activationPlugin)
 {
-    assert(block.at("type") == "convolutional");
-    assert(block.find("filters") != block.end());
-    assert(block.find("pad") != block.end());
-    assert(block.find("size") != block.end());
-    assert(block.find("stride") != block.end());
-
-    int filters = std::stoi(block.at("filters"));
-    int padding = std::stoi(block.at("pad"));
-    int kernelSize = std::stoi(block.at("size"));
-    int stride = std::stoi(block.at("stride"));
-    std::string activation = block.at("activation");
-    int bias = filters;
-
-    bool batchNormalize = false;
-    if (block.find("batch_normalize") != block.end())
-    {
-        bias = 0;
-        batchNormalize = (block.at("batch_normalize") == "1");
-    }
+    assert(layer.type == LayerType::kConvolutional);
 
-    int groups = 1;
-    if (block.find("groups") != block.end())
-    {
-        groups = std::stoi(block.at("groups"));
-    }
+    int filters = layer.filters;
+    int kernelSize = layer.size;
+    int stride = layer.stride;
+    bool batchNormalize = layer.batchNormalize;
+    int groups = layer.groups;
 
     int pad;
-    if (padding)
+    if (layer.pad)
         pad = (kernelSize - 1) / 2;
     else
         pad = 0;
 
     int size = filters * inputChannels * kernelSize * kernelSize / groups;
-    std::vector<float> bnBiases;
-    std::vector<float> bnWeights;
-    std::vector<float> bnRunningMean;
-    std::vector<float> bnRunningVar;
     nvinfer1::Weights convWt{nvinfer1::DataType::kFLOAT, nullptr, size};
-    nvinfer1::Weights convBias{nvinfer1::DataType::kFLOAT, nullptr, bias};
+    nvinfer1::Weights convBias{nvinfer1::DataType::kFLOAT, nullptr, filters};
+
+    float* wt = nullptr;
+    float* biases = nullptr;
+    float* scales = nullptr;
+    float* mean = nullptr;
+    float* var = nullptr;
 
     if (weightsType == "weights") {
-        if (batchNormalize == false)
+        eps = 1.0e-5;
+        biases = weights.take(weightPtr, filters);
+        if (batchNormalize == true)
         {
-            float* val = new float[filters];
-            for (int i = 0; i < filters; ++i)
-            {
-                val[i] = weights[weightPtr];
-                weightPtr++;
-            }
-            convBias.values = val;
-            trtWeights.push_back(convBias);
-            val = new float[size];
-            for (int i = 0; i < size; ++i)
-            {
-                val[i] = weights[weightPtr];
-                weightPtr++;
-            }
-            convWt.values = val;
-            trtWeights.push_back(convWt);
-        }
-        else
-        {
-            for (int i = 0; i < filters; ++i)
-            {
-                bnBiases.push_back(weights[weightPtr]);
-                weightPtr++;
-            }
-            for (int i = 0; i < filters; ++i)
-            {
-                bnWeights.push_back(weights[weightPtr]);
-                weightPtr++;
-            }
-            for (int i = 0; i < filters; ++i)
-            {
-                bnRunningMean.push_back(weights[weightPtr]);
-                weightPtr++;
-            }
-            for (int i = 0; i < filters; ++i)
-            {
-                bnRunningVar.push_back(sqrt(weights[weightPtr] + 1.0e-5));
-                weightPtr++;
-            }
-            float* val = new float[size];
-            for (int i = 0; i < size; ++i)
-            {
-                val[i] = weights[weightPtr];
-                weightPtr++;
-            }
-            convWt.values = val;
-            trtWeights.push_back(convWt);
-            trtWeights.push_back(convBias);
+            scales = weights.take(weightPtr, filters);
+            mean = weights.take(weightPtr, filters);
+            var = weights.take(weightPtr, filters);
         }
+        wt = weights.take(weightPtr, size);
     }
     else {
-        if (batchNormalize == false)
+        wt = weights.take(weightPtr, size);
+        if (batchNormalize == true)
         {
-            float* val = new float[size];
-            for (int i = 0; i < size; ++i)
-            {
-                val[i] = weights[weightPtr];
-                weightPtr++;
-            }
-            convWt.values = val;
-            trtWeights.push_back(convWt);
-            val = new float[filters];
-            for (int i = 0; i < filters; ++i)
-            {
-                val[i] = weights[weightPtr];
-                weightPtr++;
-            }
-            convBias.values = val;
-            trtWeights.push_back(convBias);
+            scales = weights.take(weightPtr, filters);
         }
-        else
+        biases = weights.take(weightPtr, filters);
+        if (batchNormalize == true)
         {
-            float* val = new float[size];
-            for (int i = 0; i < size; ++i)
-            {
-                val[i] = weights[weightPtr];
-                weightPtr++;
-            }
-            convWt.values = val;
-            for (int i = 0; i < filters; ++i)
-            {
-                bnWeights.push_back(weights[weightPtr]);
-                weightPtr++;
-            }
-            for (int i = 0; i < filters; ++i)
-            {
-                bnBiases.push_back(weights[weightPtr]);
-                weightPtr++;
-            }
-            for (int i = 0; i < filters; ++i)
-            {
-                bnRunningMean.push_back(weights[weightPtr]);
-                weightPtr++;
-            }
-            for (int i = 0; i < filters; ++i)
-            {
-                bnRunningVar.push_back(sqrt(weights[weightPtr] + eps));
-                weightPtr++;
-            }
-            trtWeights.push_back(convWt);
-            trtWeights.push_back(convBias);
+            mean = weights.take(weightPtr, filters);
+            var = weights.take(weightPtr, filters);
         }
     }
 
+    if (!wt || !biases || (batchNormalize && (!scales || !mean || !var)))
+        return nullptr;
+
+    if (batchNormalize == true)
+        foldBatchNorm(wt, biases, scales, mean, var, filters, size / filters, eps);
+
+    convWt.values = wt;
+    convBias.values = biases;
+
     nvinfer1::IConvolutionLayer* conv = network->addConvolutionNd(
         *input, filters, nvinfer1::DimsHW{kernelSize, kernelSize}, convWt, convBias);
     assert(conv != nullptr);
@@ -173,51 +100,14 @@ nvinfer1::ILayer* convolutionalLayer(
     conv->setStrideNd(nvinfer1::DimsHW{stride, stride});
     conv->setPaddingNd(nvinfer1::DimsHW{pad, pad});
 
-    if (block.find("groups") != block.end())
+    if (groups > 1)
     {
         conv->setNbGroups(groups);
     }
 
     nvinfer1::ILayer* output = conv;
 
-    if (batchNormalize == true)
-    {
-        size = filters;
-        nvinfer1::Weights shift{nvinfer1::DataType::kFLOAT, nullptr, size};
-        nvinfer1::Weights scale{nvinfer1::DataType::kFLOAT, nullptr, size};
-        nvinfer1::Weights power{nvinfer1::DataType::kFLOAT, nullptr, size};
-        float* shiftWt = new float[size];
-        for (int i = 0; i < size; ++i)
-        {
-            shiftWt[i]
-                = bnBiases.at(i) - ((bnRunningMean.at(i) * bnWeights.at(i)) / bnRunningVar.at(i));
-        }
-        shift.values = shiftWt;
-        float* scaleWt = new float[size];
-        for (int i = 0; i < size; ++i)
-        {
-            scaleWt[i] = bnWeights.at(i) / bnRunningVar[i];
-        }
-        scale.values = scaleWt;
-        float* powerWt = new float[size];
-        for (int i = 0; i < size; ++i)
-        {
-            powerWt[i] = 1.0;
-        }
-        power.values = powerWt;
-        trtWeights.push_back(shift);
-        trtWeights.push_back(scale);
-        trtWeights.push_back(power);
-
-        nvinfer1::IScaleLayer* bn = network->addScale(
-            *output->getOutput(0), nvinfer1::ScaleMode::kCHANNEL, shift, scale, power);
-        assert(bn != nullptr);
-        std::string bnLayerName = "batch_norm_" + std::to_string(layerIdx);
-        bn->setName(bnLayerName.c_str());
-        output = bn;
-    }
-
-    output = activationLayer(layerIdx, activation, output, output->getOutput(0), network);
+    output = activationLayer(layerIdx, layer.activation, output, output->getOutput(0), network, activationPlugin);
     assert(output != nullptr);
 
     return output;
@@ -12,17 +12,18 @@
 #include "NvInfer.h"
 
 #include "activation_layer.h"
+#include "../yoloWeights.h"
 
 nvinfer1::ILayer* convolutionalLayer(
     int layerIdx,
-    std::map<std::string, std::string>& block,
-    std::vector<float>& weights,
-    std::vector<nvinfer1::Weights>& trtWeights,
+    const LayerDesc& layer,
+    YoloWeights& weights,
     int& weightPtr,
     std::string weightsType,
     int& inputChannels,
     float eps,
     nvinfer1::ITensor* input,
-    nvinfer1::INetworkDefinition* network);
+    nvinfer1::INetworkDefinition* network,
+    bool activationPlugin = false);
 
 #endif
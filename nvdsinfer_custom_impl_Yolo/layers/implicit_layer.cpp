@@ -7,23 +7,17 @@
 
 nvinfer1::ILayer* implicitLayer(
     int channels,
-    std::vector<float>& weights,
-    std::vector<nvinfer1::Weights>& trtWeights,
+    YoloWeights& weights,
     int& weightPtr,
     nvinfer1::INetworkDefinition* network)
 {
     nvinfer1::Weights convWt{nvinfer1::DataType::kFLOAT, nullptr, channels};
 
-    float* val = new float[channels];
-    for (int i = 0; i < channels; ++i)
-    {
-        val[i] = weights[weightPtr];
-        weightPtr++;
-    }
-    convWt.values = val;
-    trtWeights.push_back(convWt);
+    convWt.values = weights.take(weightPtr, channels);
+    if (!convWt.values)
+        return nullptr;
 
-    nvinfer1::IConstantLayer* implicit = network->addConstant(nvinfer1::Dims3{static_cast<int>(channels), 1, 1}, convWt);
+    nvinfer1::IConstantLayer* implicit = network->addConstant(nvinfer1::Dims4{1, static_cast<int>(channels), 1, 1}, convWt);
     assert(implicit != nullptr);
 
     return implicit;
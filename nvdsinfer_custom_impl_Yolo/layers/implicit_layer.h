@@ -12,10 +12,11 @@
 
 #include "NvInfer.h"
 
+#include "../yoloWeights.h"
+
 nvinfer1::ILayer* implicitLayer(
     int channels,
-    std::vector<float>& weights,
-    std::vector<nvinfer1::Weights>& trtWeights,
+    YoloWeights& weights,
     int& weightPtr,
     nvinfer1::INetworkDefinition* network);
 
@@ -7,16 +7,14 @@
 
 nvinfer1::ILayer* maxpoolLayer(
     int layerIdx,
-    std::map<std::string, std::string>& block,
+    const LayerDesc& layer,
     nvinfer1::ITensor* input,
     nvinfer1::INetworkDefinition* network)
 {
-    assert(block.at("type") == "maxpool");
-    assert(block.find("size") != block.end());
-    assert(block.find("stride") != block.end());
+    assert(layer.type == LayerType::kMaxpool);
 
-    int size = std::stoi(block.at("size"));
-    int stride = std::stoi(block.at("stride"));
+    int size = layer.size;
+    int stride = layer.stride;
 
     nvinfer1::IPoolingLayer* pool
         = network->addPoolingNd(*input, nvinfer1::PoolingType::kMAX, nvinfer1::DimsHW{size, size});
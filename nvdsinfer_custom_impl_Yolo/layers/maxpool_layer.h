@@ -11,9 +11,11 @@
 
 #include "NvInfer.h"
 
+#include "../yoloNetwork.h"
+
 nvinfer1::ILayer* maxpoolLayer(
     int layerIdx,
-    std::map<std::string, std::string>& block,
+    const LayerDesc& layer,
     nvinfer1::ITensor* input,
     nvinfer1::INetworkDefinition* network);
 
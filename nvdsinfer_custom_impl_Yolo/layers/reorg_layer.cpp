@@ -0,0 +1,36 @@
+/*
+ * Created by Marcos Luciano
+ * https://www.github.com/marcoslucianops
+ */
+
+#include "reorg_layer.h"
+
+nvinfer1::ILayer* reorgLayer(
+    int layerIdx,
+    int stride,
+    nvinfer1::ITensor* input,
+    nvinfer1::INetworkDefinition* network)
+{
+    nvinfer1::Dims prevTensorDims = input->getDimensions();
+    int channels = prevTensorDims.d[1];
+    int height = prevTensorDims.d[2];
+    int width = prevTensorDims.d[3];
+
+    // Darknet reorg reads the (C, H, W) buffer as (C / s², H * s, W * s) and stacks the s x s phases in front of
+    // the channels, the output keeps the memory order of the Reorg_TRT plugin: (C * s², H / s, W / s)
+    nvinfer1::IShuffleLayer* split = network->addShuffle(*input);
+    assert(split != nullptr);
+    nvinfer1::Dims splitDims{6, {0, channels / (stride * stride), height, stride, width, stride}};
+    split->setReshapeDimensions(splitDims);
+    std::string splitLayerName = "reorg_split_" + std::to_string(layerIdx);
+    split->setName(splitLayerName.c_str());
+
+    nvinfer1::IShuffleLayer* merge = network->addShuffle(*split->getOutput(0));
+    assert(merge != nullptr);
+    merge->setFirstTranspose(nvinfer1::Permutation{{0, 3, 5, 1, 2, 4}});
+    merge->setReshapeDimensions(nvinfer1::Dims4{0, channels * stride * stride, height / stride, width / stride});
+    std::string mergeLayerName = "reorg_" + std::to_string(layerIdx);
+    merge->setName(mergeLayerName.c_str());
+
+    return merge;
+}
@@ -11,52 +11,25 @@ nvinfer1::ILayer* reorgV5Layer(
     nvinfer1::INetworkDefinition* network)
 {
     nvinfer1::Dims prevTensorDims = input->getDimensions();
-
-    nvinfer1::ISliceLayer *slice1 = network->addSlice(
-        *input,
-        nvinfer1::Dims3{0, 0, 0},
-        nvinfer1::Dims3{prevTensorDims.d[0], prevTensorDims.d[1] / 2, prevTensorDims.d[2] / 2},
-        nvinfer1::Dims3{1, 2, 2});
-    assert(slice1 != nullptr);
-    std::string slice1LayerName = "slice1_" + std::to_string(layerIdx);
-    slice1->setName(slice1LayerName.c_str());
-
-    nvinfer1::ISliceLayer *slice2 = network->addSlice(
-        *input,
-        nvinfer1::Dims3{0, 1, 0},
-        nvinfer1::Dims3{prevTensorDims.d[0], prevTensorDims.d[1] / 2, prevTensorDims.d[2] / 2},
-        nvinfer1::Dims3{1, 2, 2});
-    assert(slice2 != nullptr);
-    std::string slice2LayerName = "slice2_" + std::to_string(layerIdx);
-    slice2->setName(slice2LayerName.c_str());
-
-    nvinfer1::ISliceLayer *slice3 = network->addSlice(
-        *input,
-        nvinfer1::Dims3{0, 0, 1},
-        nvinfer1::Dims3{prevTensorDims.d[0], prevTensorDims.d[1] / 2, prevTensorDims.d[2] / 2},
-        nvinfer1::Dims3{1, 2, 2});
-    assert(slice3 != nullptr);
-    std::string slice3LayerName = "slice3_" + std::to_string(layerIdx);
-    slice3->setName(slice3LayerName.c_str());
-
-    nvinfer1::ISliceLayer *slice4 = network->addSlice(
-        *input,
-        nvinfer1::Dims3{0, 1, 1},
-        nvinfer1::Dims3{prevTensorDims.d[0], prevTensorDims.d[1] / 2, prevTensorDims.d[2] / 2},
-        nvinfer1::Dims3{1, 2, 2});
-    assert(slice4 != nullptr);
-    std::string slice4LayerName = "slice4_" + std::to_string(layerIdx);
-    slice4->setName(slice4LayerName.c_str());
-
-    std::vector<nvinfer1::ITensor*> concatInputs;
-    concatInputs.push_back (slice1->getOutput(0));
-    concatInputs.push_back (slice2->getOutput(0));
-    concatInputs.push_back (slice3->getOutput(0));
-    concatInputs.push_back (slice4->getOutput(0));
-
-    nvinfer1::IConcatenationLayer* concat =
-        network->addConcatenation(concatInputs.data(), concatInputs.size());
-    assert(concat != nullptr);
-
-    return concat;
+    int channels = prevTensorDims.d[1];
+    int height = prevTensorDims.d[2];
+    int width = prevTensorDims.d[3];
+
+    // Same channel order as concatenating the [0::2, 0::2], [1::2, 0::2], [0::2, 1::2], [1::2, 1::2] slices, but
+    // expressed as two shuffles so the batch dimension can stay dynamic
+    nvinfer1::IShuffleLayer* split = network->addShuffle(*input);
+    assert(split != nullptr);
+    nvinfer1::Dims splitDims{6, {0, channels, height / 2, 2, width / 2, 2}};
+    split->setReshapeDimensions(splitDims);
+    std::string splitLayerName = "reorgv5_split_" + std::to_string(layerIdx);
+    split->setName(splitLayerName.c_str());
+
+    nvinfer1::IShuffleLayer* merge = network->addShuffle(*split->getOutput(0));
+    assert(merge != nullptr);
+    merge->setFirstTranspose(nvinfer1::Permutation{{0, 5, 3, 1, 2, 4}});
+    merge->setReshapeDimensions(nvinfer1::Dims4{0, channels * 4, height / 2, width / 2});
+    std::string mergeLayerName = "reorgv5_" + std::to_string(layerIdx);
+    merge->setName(mergeLayerName.c_str());
+
+    return merge;
 }
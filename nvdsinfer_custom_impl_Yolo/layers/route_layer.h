@@ -7,12 +7,15 @@
 #define __ROUTE_LAYER_H__
 
 #include "NvInfer.h"
+
+#include "../yoloNetwork.h"
 #include "../utils.h"
 
 nvinfer1::ILayer* routeLayer(
     int layerIdx,
-    std::map<std::string, std::string>& block,
-    std::vector<nvinfer1::ITensor*> tensorOutputs,
+    const LayerDesc& layer,
+    const std::vector<nvinfer1::ITensor*>& tensorOutputs,
+    std::vector<nvinfer1::Weights>& trtWeights,
     nvinfer1::INetworkDefinition* network);
 
 #endif
@@ -7,12 +7,13 @@
 
 nvinfer1::ILayer* shortcutLayer(
     int layerIdx,
-    std::string activation,
+    const ActivationType& activation,
     std::string inputVol,
     std::string shortcutVol,
     nvinfer1::ITensor* input,
     nvinfer1::ITensor* shortcutTensor,
-    nvinfer1::INetworkDefinition* network)
+    nvinfer1::INetworkDefinition* network,
+    bool activationPlugin)
 {
     nvinfer1::ILayer* output;
     nvinfer1::ITensor* outputTensor;
@@ -21,10 +22,13 @@ nvinfer1::ILayer* shortcutLayer(
     {
         nvinfer1::ISliceLayer* sl = network->addSlice(
             *shortcutTensor,
-            nvinfer1::Dims3{0, 0, 0},
+            nvinfer1::Dims4{0, 0, 0, 0},
             input->getDimensions(),
-            nvinfer1::Dims3{1, 1, 1});
+            nvinfer1::Dims4{1, 1, 1, 1});
         assert(sl != nullptr);
+        nvinfer1::IShapeLayer* shape = network->addShape(*input);
+        assert(shape != nullptr);
+        sl->setInput(2, *shape->getOutput(0));
         outputTensor = sl->getOutput(0);
         assert(outputTensor != nullptr);
     } else 
@@ -38,7 +42,7 @@ nvinfer1::ILayer* shortcutLayer(
         nvinfer1::ElementWiseOperation::kSUM);
     assert(ew != nullptr);
 
-    output = activationLayer(layerIdx, activation, ew, ew->getOutput(0), network);
+    output = activationLayer(layerIdx, activation, ew, ew->getOutput(0), network, activationPlugin);
     assert(output != nullptr);
 
     return output;
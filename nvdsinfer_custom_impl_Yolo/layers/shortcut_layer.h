@@ -12,11 +12,12 @@
 
 nvinfer1::ILayer* shortcutLayer(
     int layerIdx,
-    std::string activation,
+    const ActivationType& activation,
     std::string inputVol,
     std::string shortcutVol,
     nvinfer1::ITensor* input,
     nvinfer1::ITensor* shortcutTensor,
-    nvinfer1::INetworkDefinition* network);
+    nvinfer1::INetworkDefinition* network,
+    bool activationPlugin = false);
 
 #endif
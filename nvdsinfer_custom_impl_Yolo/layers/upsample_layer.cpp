@@ -7,17 +7,17 @@
 
 nvinfer1::ILayer* upsampleLayer(
     int layerIdx,
-    std::map<std::string, std::string>& block,
+    const LayerDesc& layer,
     nvinfer1::ITensor* input,
     nvinfer1::INetworkDefinition* network)
 {
-    assert(block.at("type") == "upsample");
-    int stride = std::stoi(block.at("stride"));
+    assert(layer.type == LayerType::kUpsample);
+    int stride = layer.stride;
 
     nvinfer1::IResizeLayer* resize_layer = network->addResize(*input);
     resize_layer->setResizeMode(nvinfer1::ResizeMode::kNEAREST);
-    float scale[3] = {1, static_cast<float>(stride), static_cast<float>(stride)};
-    resize_layer->setScales(scale, 3);
+    float scale[4] = {1, 1, static_cast<float>(stride), static_cast<float>(stride)};
+    resize_layer->setScales(scale, 4);
     std::string layer_name = "upsample_" + std::to_string(layerIdx);
     resize_layer->setName(layer_name.c_str());
     return resize_layer;
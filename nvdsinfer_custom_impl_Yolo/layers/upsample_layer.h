@@ -12,9 +12,11 @@
 
 #include "NvInfer.h"
 
+#include "../yoloNetwork.h"
+
 nvinfer1::ILayer* upsampleLayer(
     int layerIdx,
-    std::map<std::string, std::string>& block,
+    const LayerDesc& layer,
     nvinfer1::ITensor* input,
     nvinfer1::INetworkDefinition* network);
 
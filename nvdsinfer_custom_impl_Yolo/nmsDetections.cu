@@ -0,0 +1,165 @@
+/*
+ * Created by Marcos Luciano
+ * https://www.github.com/marcoslucianops
+ */
+
+#include <stdint.h>
+
+// Each mask word holds the suppression bits of one box against 64 others
+const uint threadsPerBlock = sizeof(unsigned long long) * 8;
+
+inline __device__ float iouGPU(const float* a, const float* b)
+{
+    float left = fmaxf(a[0], b[0]);
+    float top = fmaxf(a[1], b[1]);
+    float right = fminf(a[2], b[2]);
+    float bottom = fminf(a[3], b[3]);
+    float width = fmaxf(right - left, 0.f);
+    float height = fmaxf(bottom - top, 0.f);
+    float interS = width * height;
+    float unionS = (a[2] - a[0]) * (a[3] - a[1]) + (b[2] - b[0]) * (b[3] - b[1]) - interS;
+    return unionS > 0.f ? interS / unionS : 0.f;
+}
+
+__global__ void nmsMask(
+    const float* sortedBoxes, const int* sortedClasses, const int* countData, unsigned long long* mask,
+    const uint topK, const uint colBlocks, const float iouThreshold)
+{
+    const uint batch = blockIdx.z;
+    const uint rowStart = blockIdx.y;
+    const uint colStart = blockIdx.x;
+
+    const uint count = min((uint)countData[batch], topK);
+
+    // Boxes are sorted by score, so a box can only be suppressed by the ones before it
+    if (rowStart > colStart || rowStart * threadsPerBlock >= count || colStart * threadsPerBlock >= count)
+        return;
+
+    const uint rowSize = min(count - rowStart * threadsPerBlock, threadsPerBlock);
+    const uint colSize = min(count - colStart * threadsPerBlock, threadsPerBlock);
+
+    sortedBoxes += batch * 4 * topK;
+    sortedClasses += batch * topK;
+    mask += batch * topK * colBlocks;
+
+    __shared__ float blockBoxes[threadsPerBlock * 4];
+    __shared__ int blockClasses[threadsPerBlock];
+
+    if (threadIdx.x < colSize)
+    {
+        const uint colIdx = colStart * threadsPerBlock + threadIdx.x;
+        blockBoxes[threadIdx.x * 4 + 0] = sortedBoxes[colIdx * 4 + 0];
+        blockBoxes[threadIdx.x * 4 + 1] = sortedBoxes[colIdx * 4 + 1];
+        blockBoxes[threadIdx.x * 4 + 2] = sortedBoxes[colIdx * 4 + 2];
+        blockBoxes[threadIdx.x * 4 + 3] = sortedBoxes[colIdx * 4 + 3];
+        blockClasses[threadIdx.x] = sortedClasses[colIdx];
+    }
+    __syncthreads();
+
+    if (threadIdx.x < rowSize)
+    {
+        const uint curIdx = rowStart * threadsPerBlock + threadIdx.x;
+        const float* curBox = sortedBoxes + curIdx * 4;
+        const int curClass = sortedClasses[curIdx];
+
+        unsigned long long t = 0;
+        uint start = rowStart == colStart ? threadIdx.x + 1 : 0;
+        for (uint i = start; i < colSize; ++i)
+        {
+            if (blockClasses[i] == curClass && iouGPU(curBox, blockBoxes + i * 4) > iouThreshold)
+                t |= 1ULL << i;
+        }
+        mask[curIdx * colBlocks + colStart] = t;
+    }
+}
+
+__global__ void nmsGather(
+    const float* sortedBoxes, const float* sortedScores, const int* sortedClasses, const int* countData,
+    const unsigned long long* mask, int* numDetections, float* nmsedBoxes, float* nmsedScores, float* nmsedClasses,
+    const uint topK, const uint colBlocks)
+{
+    extern __shared__ unsigned long long removed[];
+
+    const uint batch = blockIdx.x;
+    const uint lane = threadIdx.x;
+
+    const uint count = min((uint)countData[batch], topK);
+
+    sortedBoxes += batch * 4 * topK;
+    sortedScores += batch * topK;
+    sortedClasses += batch * topK;
+    mask += batch * topK * colBlocks;
+    nmsedBoxes += batch * 4 * topK;
+    nmsedScores += batch * topK;
+    nmsedClasses += batch * topK;
+
+    for (uint w = lane; w < colBlocks; w += warpSize)
+        removed[w] = 0;
+    __syncwarp();
+
+    uint numKeep = 0;
+    for (uint i = 0; i < count; ++i)
+    {
+        const uint block = i / threadsPerBlock;
+        const bool keep = !(removed[block] & (1ULL << (i % threadsPerBlock)));
+        __syncwarp();
+
+        if (keep)
+        {
+            if (lane == 0)
+            {
+                nmsedBoxes[numKeep * 4 + 0] = sortedBoxes[i * 4 + 0];
+                nmsedBoxes[numKeep * 4 + 1] = sortedBoxes[i * 4 + 1];
+                nmsedBoxes[numKeep * 4 + 2] = sortedBoxes[i * 4 + 2];
+                nmsedBoxes[numKeep * 4 + 3] = sortedBoxes[i * 4 + 3];
+                nmsedScores[numKeep] = sortedScores[i];
+                nmsedClasses[numKeep] = sortedClasses[i];
+            }
+            const unsigned long long* row = mask + i * colBlocks;
+            for (uint w = block + lane; w < colBlocks; w += warpSize)
+                removed[w] |= row[w];
+            ++numKeep;
+        }
+        __syncwarp();
+    }
+
+    if (lane == 0)
+        numDetections[batch] = numKeep;
+}
+
+size_t nmsDetectionsWorkspaceSize(const uint& batchSize, const uint& topK);
+
+size_t nmsDetectionsWorkspaceSize(const uint& batchSize, const uint& topK)
+{
+    uint colBlocks = (topK + threadsPerBlock - 1) / threadsPerBlock;
+    return sizeof(unsigned long long) * batchSize * topK * colBlocks;
+}
+
+cudaError_t nmsDetections(
+    const void* sortedBoxes, const void* sortedScores, const void* sortedClasses, const void* countData,
+    void* numDetections, void* nmsedBoxes, void* nmsedScores, void* nmsedClasses, void* workspace,
+    const uint& batchSize, const uint& topK, const float& iouThreshold, cudaStream_t stream);
+
+cudaError_t nmsDetections(
+    const void* sortedBoxes, const void* sortedScores, const void* sortedClasses, const void* countData,
+    void* numDetections, void* nmsedBoxes, void* nmsedScores, void* nmsedClasses, void* workspace,
+    const uint& batchSize, const uint& topK, const float& iouThreshold, cudaStream_t stream)
+{
+    uint colBlocks = (topK + threadsPerBlock - 1) / threadsPerBlock;
+
+    dim3 number_of_blocks(colBlocks, colBlocks, batchSize);
+
+    nmsMask<<<number_of_blocks, threadsPerBlock, 0, stream>>>(
+        reinterpret_cast<const float*>(sortedBoxes), reinterpret_cast<const int*>(sortedClasses),
+        reinterpret_cast<const int*>(countData), reinterpret_cast<unsigned long long*>(workspace), topK, colBlocks,
+        iouThreshold);
+
+    nmsGather<<<batchSize, 32, sizeof(unsigned long long) * colBlocks, stream>>>(
+        reinterpret_cast<const float*>(sortedBoxes), reinterpret_cast<const float*>(sortedScores),
+        reinterpret_cast<const int*>(sortedClasses), reinterpret_cast<const int*>(countData),
+        reinterpret_cast<const unsigned long long*>(workspace), reinterpret_cast<int*>(numDetections),
+        reinterpret_cast<float*>(nmsedBoxes), reinterpret_cast<float*>(nmsedScores),
+        reinterpret_cast<float*>(nmsedClasses), topK, colBlocks);
+
+    return cudaGetLastError();
+}
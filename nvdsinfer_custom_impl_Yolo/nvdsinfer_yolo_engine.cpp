@@ -50,6 +50,7 @@ static bool getYoloNetworkInfo (NetworkInfo &networkInfo, const NvDsInferContext
     networkInfo.deviceType = (initParams->useDLA ? "kDLA" : "kGPU");
     networkInfo.numDetectedClasses = initParams->numDetectedClasses;
     networkInfo.clusterMode = initParams->clusterMode;
+    networkInfo.maxBatchSize = initParams->maxBatchSize;
 
     if(initParams->networkMode == 0) {
         networkInfo.networkMode = "FP32";
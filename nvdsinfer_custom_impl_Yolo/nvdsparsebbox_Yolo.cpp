@@ -35,60 +35,45 @@ extern "C" bool NvDsInferParseYolo(
     std::vector<NvDsInferLayerInfo> const& outputLayersInfo, NvDsInferNetworkInfo const& networkInfo,
     NvDsInferParseDetectionParams const& detectionParams, std::vector<NvDsInferParseObjectInfo>& objectList);
 
-static NvDsInferParseObjectInfo convertBBox(
-    const float& bx1, const float& by1, const float& bx2, const float& by2, const uint& netW, const uint& netH)
+static inline void addBBoxProposal(
+    const float bx1, const float by1, const float bx2, const float by2, const float netW, const float netH,
+    const int maxIndex, const float maxProb, std::vector<NvDsInferParseObjectInfo>& objectList)
 {
-    NvDsInferParseObjectInfo b;
-
-    float x1 = bx1;
-    float y1 = by1;
-    float x2 = bx2;
-    float y2 = by2;
-
-    x1 = clamp(x1, 0, netW);
-    y1 = clamp(y1, 0, netH);
-    x2 = clamp(x2, 0, netW);
-    y2 = clamp(y2, 0, netH);
-
-    b.left = x1;
-    b.width = clamp(x2 - x1, 0, netW);
-    b.top = y1;
-    b.height = clamp(y2 - y1, 0, netH);
-
-    return b;
-}
-
-static void addBBoxProposal(
-    const float bx1, const float by1, const float bx2, const float by2, const uint& netW, const uint& netH,
-    const int maxIndex, const float maxProb, std::vector<NvDsInferParseObjectInfo>& binfo)
-{
-    NvDsInferParseObjectInfo bbi = convertBBox(bx1, by1, bx2, by2, netW, netH);
+    NvDsInferParseObjectInfo bbi;
+
+    float x1 = clamp(bx1, 0, netW);
+    float y1 = clamp(by1, 0, netH);
+    float x2 = clamp(bx2, 0, netW);
+    float y2 = clamp(by2, 0, netH);
+
+    // Both ends are already within the network size, the width only needs the lower bound
+    bbi.left = x1;
+    bbi.width = fmaxf(x2 - x1, 0);
+    bbi.top = y1;
+    bbi.height = fmaxf(y2 - y1, 0);
     if (bbi.width < 1 || bbi.height < 1) return;
 
     bbi.detectionConfidence = maxProb;
     bbi.classId = maxIndex;
-    binfo.push_back(bbi);
+    objectList.push_back(bbi);
 }
 
-static std::vector<NvDsInferParseObjectInfo> decodeYoloTensor(
-    const int* counts, const float* boxes, const float* scores, const float* classes, const uint& netW, const uint& netH)
+static void decodeYoloTensor(
+    const int* counts, const float* boxes, const float* scores, const float* classes, const uint& topK,
+    const uint& netW, const uint& netH, std::vector<NvDsInferParseObjectInfo>& objectList)
 {
-    std::vector<NvDsInferParseObjectInfo> binfo;
+    const uint numBoxes = std::min(static_cast<uint>(counts[0]), topK);
+
+    // nvinfer hands the same vector back every frame, after warm-up this never allocates
+    objectList.clear();
+    objectList.reserve(topK);
 
-    uint numBoxes = counts[0];
     for (uint b = 0; b < numBoxes; ++b)
     {
-        float bx1 = boxes[b * 4 + 0];
-        float by1 = boxes[b * 4 + 1];
-        float bx2 = boxes[b * 4 + 2];
-        float by2 = boxes[b * 4 + 3];
-
-        float maxProb = scores[b];
-        int maxIndex = classes[b];
-
-        addBBoxProposal(bx1, by1, bx2, by2, netW, netH, maxIndex, maxProb, binfo);
+        addBBoxProposal(
+            boxes[b * 4 + 0], boxes[b * 4 + 1], boxes[b * 4 + 2], boxes[b * 4 + 3], netW, netH, classes[b],
+            scores[b], objectList);
     }
-    return binfo;
 }
 
 static bool NvDsInferParseCustomYolo(
@@ -108,21 +93,17 @@ static bool NvDsInferParseCustomYolo(
                   << ", detected by network: " << numClasses << std::endl;
     }
 
-    std::vector<NvDsInferParseObjectInfo> objects;
-
     const NvDsInferLayerInfo &counts = outputLayersInfo[0];
     const NvDsInferLayerInfo &boxes = outputLayersInfo[1];
     const NvDsInferLayerInfo &scores = outputLayersInfo[2];
     const NvDsInferLayerInfo &classes = outputLayersInfo[3];
 
-    std::vector<NvDsInferParseObjectInfo> outObjs =
-        decodeYoloTensor(
-            (const int*)(counts.buffer), (const float*)(boxes.buffer), (const float*)(scores.buffer),
-            (const float*)(classes.buffer), networkInfo.width, networkInfo.height);
-
-    objects.insert(objects.end(), outObjs.begin(), outObjs.end());
+    // scores is {topK} per frame
+    const uint topK = scores.inferDims.d[0];
 
-    objectList = objects;
+    decodeYoloTensor(
+        (const int*)(counts.buffer), (const float*)(boxes.buffer), (const float*)(scores.buffer),
+        (const float*)(classes.buffer), topK, networkInfo.width, networkInfo.height, objectList);
 
     return true;
 }
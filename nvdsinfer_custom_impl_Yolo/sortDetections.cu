@@ -3,93 +3,133 @@
  * https://www.github.com/marcoslucianops
  */
 
-#include <cub/device/device_radix_sort.cuh>
+#include <cub/device/device_segmented_radix_sort.cuh>
 
-__global__ void sortOutput(
-    int* d_indexes, float* d_scores, float* d_boxes, int* d_classes, float* bboxData, float* scoreData,
-    const uint numOutputClasses, const int topk)
+namespace {
+    struct SortWorkspace
+    {
+        float* keysOut {nullptr};
+        int* valuesOut {nullptr};
+        int* beginOffsets {nullptr};
+        int* endOffsets {nullptr};
+        void* tempStorage {nullptr};
+        size_t tempStorageBytes {0};
+    };
+
+    template <typename T>
+    void carve(char*& ptr, size_t& offset, T*& out, size_t count)
+    {
+        out = ptr ? reinterpret_cast<T*>(ptr + offset) : nullptr;
+        offset += (sizeof(T) * count + 255) & ~static_cast<size_t>(255);
+    }
+
+    size_t getSortWorkspaceLayout(const uint& batchSize, const uint64_t& outputSize, void* workspace, SortWorkspace* ws)
+    {
+        SortWorkspace layout;
+        char* ptr = static_cast<char*>(workspace);
+        size_t offset = 0;
+
+        carve(ptr, offset, layout.keysOut, outputSize * batchSize);
+        carve(ptr, offset, layout.valuesOut, outputSize * batchSize);
+        carve(ptr, offset, layout.beginOffsets, batchSize);
+        carve(ptr, offset, layout.endOffsets, batchSize);
+
+        cub::DeviceSegmentedRadixSort::SortPairsDescending(
+            nullptr, layout.tempStorageBytes, (const float*)nullptr, (float*)nullptr, (const int*)nullptr, (int*)nullptr,
+            (int)(outputSize * batchSize), (int)batchSize, (const int*)nullptr, (const int*)nullptr);
+
+        char* temp;
+        carve(ptr, offset, temp, layout.tempStorageBytes);
+        layout.tempStorage = temp;
+
+        if (ws)
+            *ws = layout;
+        return offset;
+    }
+}
+
+__global__ void segmentOffsets(
+    const int* countData, int* beginOffsets, int* endOffsets, const uint batchSize, const uint64_t outputSize)
 {
     uint x_id = blockIdx.x * blockDim.x + threadIdx.x;
 
-    if (x_id >= topk)
+    if (x_id >= batchSize)
         return;
 
-    int index = d_indexes[x_id];
-    int maxIndex = d_classes[index];
-    bboxData[x_id * 4 + 0] = d_boxes[index * 4 + 0];
-    bboxData[x_id * 4 + 1] = d_boxes[index * 4 + 1];
-    bboxData[x_id * 4 + 2] = d_boxes[index * 4 + 2];
-    bboxData[x_id * 4 + 3] = d_boxes[index * 4 + 3];
-    scoreData[x_id * numOutputClasses + maxIndex] = d_scores[x_id] - 1.f;
+    beginOffsets[x_id] = x_id * outputSize;
+    endOffsets[x_id] = x_id * outputSize + countData[x_id];
 }
 
-cudaError_t sortDetections(
-    void* d_indexes, void* d_scores, void* d_boxes, void* d_classes, void* bboxData, void* scoreData, void* countData,
-    const uint& batchSize, uint64_t& outputSize, uint& topK, const uint& numOutputClasses, cudaStream_t stream);
-
-cudaError_t sortDetections(
-    void* d_indexes, void* d_scores, void* d_boxes, void* d_classes, void* bboxData, void* scoreData, void* countData,
-    const uint& batchSize, uint64_t& outputSize, uint& topK, const uint& numOutputClasses, cudaStream_t stream)
+__global__ void sortOutput(
+    const int* countData, const int* d_indexes, const float* d_scores, const float* d_boxes, const int* d_classes,
+    float* sortedBoxes, float* sortedScores, int* sortedClasses, const uint64_t outputSize, const uint topK)
 {
-    for (unsigned int batch = 0; batch < batchSize; ++batch)
-    {
-        int* _d_indexes = reinterpret_cast<int*>(d_indexes) + (batch * outputSize);
-        float* _d_scores = reinterpret_cast<float*>(d_scores) + (batch * outputSize);
-
-        int* _countData = reinterpret_cast<int*>(countData) + (batch);
-        int* _count = (int*)malloc(sizeof(int));
-        cudaMemcpy(_count, (int*)&_countData[0], sizeof(int), cudaMemcpyDeviceToHost);
-        int count = _count[0];
-
-        if (count == 0)
-        {
-            free(_count);
-            return cudaGetLastError();
-        }
+    uint x_id = blockIdx.x * blockDim.x + threadIdx.x;
+    uint batch = blockIdx.y;
 
-        size_t begin_bit = 0;
-        size_t end_bit = sizeof(float) * 8;
+    uint count = countData[batch];
+    if (x_id >= count || x_id >= topK)
+        return;
 
-        float *d_keys_out = NULL;
-        int *d_values_out = NULL;
+    d_indexes += batch * outputSize;
+    d_scores += batch * outputSize;
+    d_boxes += batch * 4 * outputSize;
+    d_classes += batch * outputSize;
+    sortedBoxes += batch * 4 * topK;
+    sortedScores += batch * topK;
+    sortedClasses += batch * topK;
 
-        cudaMalloc((void **)&d_keys_out, count * sizeof(float));
-        cudaMalloc((void **)&d_values_out, count * sizeof(int));
+    int index = d_indexes[x_id];
+    sortedBoxes[x_id * 4 + 0] = d_boxes[index * 4 + 0];
+    sortedBoxes[x_id * 4 + 1] = d_boxes[index * 4 + 1];
+    sortedBoxes[x_id * 4 + 2] = d_boxes[index * 4 + 2];
+    sortedBoxes[x_id * 4 + 3] = d_boxes[index * 4 + 3];
+    sortedScores[x_id] = d_scores[x_id] - 1.f;
+    sortedClasses[x_id] = d_classes[index];
+}
 
-        void* d_temp_storage = NULL;
-        size_t temp_storage_bytes = 0;
+size_t sortDetectionsWorkspaceSize(const uint& batchSize, const uint64_t& outputSize);
 
-        cub::DeviceRadixSort::SortPairsDescending(d_temp_storage, temp_storage_bytes, _d_scores, d_keys_out, _d_indexes,
-        d_values_out, count, begin_bit, end_bit);
+size_t sortDetectionsWorkspaceSize(const uint& batchSize, const uint64_t& outputSize)
+{
+    return getSortWorkspaceLayout(batchSize, outputSize, nullptr, nullptr);
+}
 
-        cudaMalloc(&d_temp_storage, temp_storage_bytes);
+cudaError_t sortDetections(
+    void* d_indexes, void* d_scores, void* d_boxes, void* d_classes, void* countData, void* sortedBoxes,
+    void* sortedScores, void* sortedClasses, void* workspace, const uint& batchSize, uint64_t& outputSize, uint& topK,
+    cudaStream_t stream);
 
-        cub::DeviceRadixSort::SortPairsDescending(d_temp_storage, temp_storage_bytes, _d_scores, d_keys_out, _d_indexes,
-        d_values_out, count, begin_bit, end_bit);
+cudaError_t sortDetections(
+    void* d_indexes, void* d_scores, void* d_boxes, void* d_classes, void* countData, void* sortedBoxes,
+    void* sortedScores, void* sortedClasses, void* workspace, const uint& batchSize, uint64_t& outputSize, uint& topK,
+    cudaStream_t stream)
+{
+    SortWorkspace ws;
+    getSortWorkspaceLayout(batchSize, outputSize, workspace, &ws);
 
-        cudaMemcpy(_d_scores, d_keys_out, count * sizeof(float), cudaMemcpyDeviceToDevice);
-        cudaMemcpy(_d_indexes, d_values_out, count * sizeof(int), cudaMemcpyDeviceToDevice);
+    int threads_per_block = 256;
 
-        int _topK = count < topK ? count : topK;
+    // Every batch item is a segment [batch * outputSize, batch * outputSize + count), the counts never leave the GPU
+    segmentOffsets<<<(batchSize + threads_per_block - 1) / threads_per_block, threads_per_block, 0, stream>>>(
+        reinterpret_cast<const int*>(countData), ws.beginOffsets, ws.endOffsets, batchSize, outputSize);
 
-        int threads_per_block = 0;
-        int number_of_blocks = 4;
+    size_t begin_bit = 0;
+    size_t end_bit = sizeof(float) * 8;
 
-        if (_topK % 2 == 0 && _topK >= number_of_blocks)
-            threads_per_block = _topK / number_of_blocks;
-        else
-            threads_per_block = (_topK / number_of_blocks) + 1;
+    cudaError_t status = cub::DeviceSegmentedRadixSort::SortPairsDescending(
+        ws.tempStorage, ws.tempStorageBytes, reinterpret_cast<const float*>(d_scores), ws.keysOut,
+        reinterpret_cast<const int*>(d_indexes), ws.valuesOut, (int)(outputSize * batchSize), (int)batchSize,
+        ws.beginOffsets, ws.endOffsets, begin_bit, end_bit, stream);
+    if (status != cudaSuccess)
+        return status;
 
-        sortOutput<<<number_of_blocks, threads_per_block, 0, stream>>>(
-            _d_indexes, _d_scores, reinterpret_cast<float*>(d_boxes) + (batch * 4 * outputSize),
-            reinterpret_cast<int*>(d_classes) + (batch * outputSize), reinterpret_cast<float*>(bboxData) + (batch * topK),
-            reinterpret_cast<float*>(scoreData) + (batch * topK), numOutputClasses, _topK);
+    dim3 number_of_blocks((topK + threads_per_block - 1) / threads_per_block, batchSize);
 
-        cudaFree(d_keys_out);
-        cudaFree(d_values_out);
-        cudaFree(d_temp_storage);
+    sortOutput<<<number_of_blocks, threads_per_block, 0, stream>>>(
+        reinterpret_cast<const int*>(countData), ws.valuesOut, ws.keysOut, reinterpret_cast<const float*>(d_boxes),
+        reinterpret_cast<const int*>(d_classes), reinterpret_cast<float*>(sortedBoxes),
+        reinterpret_cast<float*>(sortedScores), reinterpret_cast<int*>(sortedClasses), outputSize, topK);
 
-        free(_count);
-    }
     return cudaGetLastError();
 }
@@ -29,6 +29,7 @@
 #include <iomanip>
 #include <algorithm>
 #include <math.h>
+#include <stdlib.h>
 
 static void leftTrim(std::string& s)
 {
@@ -47,12 +48,6 @@ std::string trim(std::string s)
     return s;
 }
 
-float clamp(const float val, const float minVal, const float maxVal)
-{
-    assert(minVal <= maxVal);
-    return std::min(maxVal, std::max(minVal, val));
-}
-
 bool fileExists(const std::string fileName, bool verbose)
 {
     if (!std::experimental::filesystem::exists(std::experimental::filesystem::path(fileName)))
@@ -63,71 +58,6 @@ bool fileExists(const std::string fileName, bool verbose)
     return true;
 }
 
-std::vector<float> loadWeights(const std::string weightsFilePath, const std::string& networkType)
-{
-    assert(fileExists(weightsFilePath));
-    std::cout << "\nLoading pre-trained weights" << std::endl;
-
-    std::vector<float> weights;
-
-    if (weightsFilePath.find(".weights") != std::string::npos) {
-        std::ifstream file(weightsFilePath, std::ios_base::binary);
-        assert(file.good());
-        std::string line;
-
-        if (networkType.find("yolov2") != std::string::npos && networkType.find("yolov2-tiny") == std::string::npos)
-        {
-            // Remove 4 int32 bytes of data from the stream belonging to the header
-            file.ignore(4 * 4);
-        }
-        else
-        {
-            // Remove 5 int32 bytes of data from the stream belonging to the header
-            file.ignore(4 * 5);
-        }
-
-        char floatWeight[4];
-        while (!file.eof())
-        {
-            file.read(floatWeight, 4);
-            assert(file.gcount() == 4);
-            weights.push_back(*reinterpret_cast<float*>(floatWeight));
-            if (file.peek() == std::istream::traits_type::eof()) break;
-        }
-    }
-
-    else if (weightsFilePath.find(".wts") != std::string::npos) {
-        std::ifstream file(weightsFilePath);
-        assert(file.good());
-        int32_t count;
-        file >> count;
-        assert(count > 0 && "\nInvalid .wts file.");
-
-        uint32_t floatWeight;
-        std::string name;
-        uint32_t size;
-
-        while (count--) {
-            file >> name >> std::dec >> size;
-            for (uint32_t x = 0, y = size; x < y; ++x)
-            {
-                file >> std::hex >> floatWeight;
-                weights.push_back(*reinterpret_cast<float *>(&floatWeight));
-            };
-        }
-    }
-
-    else {
-        std::cerr << "\nFile " << weightsFilePath << " is not supported" << std::endl;
-        std::abort();
-    }
-
-    std::cout << "Loading weights of " << networkType << " complete"
-            << std::endl;
-    std::cout << "Total weights read: " << weights.size() << std::endl;
-    return weights;
-}
-
 std::string dimsToString(const nvinfer1::Dims d)
 {
     std::stringstream s;
@@ -144,9 +74,9 @@ std::string dimsToString(const nvinfer1::Dims d)
 int getNumChannels(nvinfer1::ITensor* t)
 {
     nvinfer1::Dims d = t->getDimensions();
-    assert(d.nbDims == 3);
+    assert(d.nbDims == 4);
 
-    return d.d[0];
+    return d.d[1];
 }
 
 void printLayerInfo(
@@ -165,3 +95,31 @@ std::string getAbsPath(std::string path)
         path.erase(path.begin() + found, path.end());
     return path;
 }
+
+nvinfer1::ITensor* batchShapeTensor(
+    nvinfer1::INetworkDefinition* network, nvinfer1::ITensor* input, const nvinfer1::Dims& dims,
+    std::vector<nvinfer1::Weights>& trtWeights)
+{
+    // Runtime batch of the input followed by the static C, H, W of dims
+    nvinfer1::IShapeLayer* shape = network->addShape(*input);
+    assert(shape != nullptr);
+    nvinfer1::ISliceLayer* batch = network->addSlice(
+        *shape->getOutput(0), nvinfer1::Dims{1, {0}}, nvinfer1::Dims{1, {1}}, nvinfer1::Dims{1, {1}});
+    assert(batch != nullptr);
+
+    int32_t* val = reinterpret_cast<int32_t*>(malloc(sizeof(int32_t) * (dims.nbDims - 1)));
+    for (int i = 1; i < dims.nbDims; ++i)
+        val[i - 1] = dims.d[i];
+    nvinfer1::Weights dimsWt{nvinfer1::DataType::kINT32, val, dims.nbDims - 1};
+    trtWeights.push_back(dimsWt);
+
+    nvinfer1::IConstantLayer* rest = network->addConstant(nvinfer1::Dims{1, {dims.nbDims - 1}}, dimsWt);
+    assert(rest != nullptr);
+
+    nvinfer1::ITensor* concatInputs[] = {batch->getOutput(0), rest->getOutput(0)};
+    nvinfer1::IConcatenationLayer* concat = network->addConcatenation(concatInputs, 2);
+    assert(concat != nullptr);
+    concat->setAxis(0);
+
+    return concat->getOutput(0);
+}
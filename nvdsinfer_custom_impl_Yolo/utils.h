@@ -27,6 +27,7 @@
 #ifndef __UTILS_H__
 #define __UTILS_H__
 
+#include <cmath>
 #include <map>
 #include <vector>
 #include <cassert>
@@ -36,13 +37,19 @@
 #include "NvInfer.h"
 
 std::string trim(std::string s);
-float clamp(const float val, const float minVal, const float maxVal);
+// Inlined for the bbox parser hot loop, compiles to minss/maxss without branches
+inline float clamp(const float val, const float minVal, const float maxVal)
+{
+    return fminf(maxVal, fmaxf(minVal, val));
+}
 bool fileExists(const std::string fileName, bool verbose = true);
-std::vector<float> loadWeights(const std::string weightsFilePath, const std::string& networkType);
 std::string dimsToString(const nvinfer1::Dims d);
 int getNumChannels(nvinfer1::ITensor* t);
 void printLayerInfo(
     std::string layerIndex, std::string layerName, std::string layerInput,  std::string layerOutput, std::string weightPtr);
 std::string getAbsPath(std::string path);
+nvinfer1::ITensor* batchShapeTensor(
+    nvinfer1::INetworkDefinition* network, nvinfer1::ITensor* input, const nvinfer1::Dims& dims,
+    std::vector<nvinfer1::Weights>& trtWeights);
 
 #endif
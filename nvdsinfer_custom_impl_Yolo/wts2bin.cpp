@@ -0,0 +1,27 @@
+/*
+ * Created by Marcos Luciano
+ * https://www.github.com/marcoslucianops
+ */
+
+#include <iostream>
+
+#include "yoloWeights.h"
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " <model.wts> [model.wts.bin]" << std::endl;
+        return 1;
+    }
+
+    std::string wtsFilePath = argv[1];
+    std::string binFilePath = argc == 3 ? argv[2] : wtsFilePath + ".bin";
+
+    if (!convertWtsToBinary(wtsFilePath, binFilePath)) {
+        std::cerr << "Could not convert " << wtsFilePath << " to " << binFilePath << std::endl;
+        return 1;
+    }
+
+    std::cout << "Converted " << wtsFilePath << " to " << binFilePath << std::endl;
+    return 0;
+}
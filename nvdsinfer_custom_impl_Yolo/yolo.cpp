@@ -25,6 +25,10 @@
 
 #include "yolo.h"
 #include "yoloPlugins.h"
+#include "engineCache.h"
+#include <algorithm>
+#include <chrono>
+#include <sstream>
 #include <stdlib.h>
 
 #ifdef OPENCV
@@ -41,6 +45,7 @@ Yolo::Yolo(const NetworkInfo& networkInfo)
       m_NumDetectedClasses(networkInfo.numDetectedClasses),
       m_ClusterMode(networkInfo.clusterMode),
       m_NetworkMode(networkInfo.networkMode),
+      m_MaxBatchSize(networkInfo.maxBatchSize),
       m_InputH(0),
       m_InputW(0),
       m_InputC(0),
@@ -63,9 +68,6 @@ nvinfer1::ICudaEngine *Yolo::createEngine (nvinfer1::IBuilder* builder, nvinfer1
 {
     assert (builder);
 
-    m_ConfigBlocks = parseConfigFile(m_ConfigFilePath);
-    parseConfigBlocks();
-
     std::string configNMS = getAbsPath(m_WtsFilePath) + "/config_nms.txt";
     if (!fileExists(configNMS))
     {
@@ -75,13 +77,51 @@ nvinfer1::ICudaEngine *Yolo::createEngine (nvinfer1::IBuilder* builder, nvinfer1
     m_ConfigNMSBlocks = parseConfigFile(configNMS);
     parseConfigNMSBlocks();
 
-    nvinfer1::INetworkDefinition *network = builder->createNetworkV2(0);
+    // The single profile covers every batch up to the smallest bucket that fits batch-size and is tuned for the bucket,
+    // so every batch-size within a bucket builds the same engine and changing the number of sources reuses it
+    uint maxProfile = m_MaxBatchSize;
+    for (uint batch : m_BatchProfiles)
+    {
+        if (batch >= m_MaxBatchSize)
+        {
+            maxProfile = batch;
+            break;
+        }
+    }
+
+    std::string cacheDir = m_EngineCacheDir.empty() || m_EngineCacheDir == "none" ? getAbsPath(m_WtsFilePath)
+        : m_EngineCacheDir;
+    std::string enginePath;
+    if (m_EngineCacheDir != "none")
+    {
+        enginePath = engineCachePath(
+            cacheDir, {m_ConfigFilePath, m_WtsFilePath, configNMS}, m_NetworkMode, maxProfile);
+        nvinfer1::ICudaEngine *engine = loadCachedEngine(enginePath);
+        if (engine)
+            return engine;
+    }
+
+    const auto explicitBatch
+        = 1U << static_cast<uint32_t>(nvinfer1::NetworkDefinitionCreationFlag::kEXPLICIT_BATCH);
+    nvinfer1::INetworkDefinition *network = builder->createNetworkV2(explicitBatch);
     if (parseModel(*network) != NVDSINFER_SUCCESS)
     {
         delete network;
         return nullptr;
     }
 
+    nvinfer1::Dims4 minDims{1, static_cast<int>(m_InputC), static_cast<int>(m_InputH), static_cast<int>(m_InputW)};
+    nvinfer1::Dims4 optDims = minDims;
+    nvinfer1::Dims4 maxDims = minDims;
+    optDims.d[0] = maxProfile;
+    maxDims.d[0] = maxProfile;
+
+    nvinfer1::IOptimizationProfile* profile = builder->createOptimizationProfile();
+    profile->setDimensions(m_InputBlobName.c_str(), nvinfer1::OptProfileSelector::kMIN, minDims);
+    profile->setDimensions(m_InputBlobName.c_str(), nvinfer1::OptProfileSelector::kOPT, optDims);
+    profile->setDimensions(m_InputBlobName.c_str(), nvinfer1::OptProfileSelector::kMAX, maxDims);
+    config->addOptimizationProfile(profile);
+
     std::cout << "Building the TensorRT Engine\n" << std::endl;
 
     if (m_NumClasses != m_NumDetectedClasses)
@@ -124,15 +164,58 @@ nvinfer1::ICudaEngine *Yolo::createEngine (nvinfer1::IBuilder* builder, nvinfer1
             calib_batch_size, m_InputC, m_InputH, m_InputW, m_LetterBox, calib_image_list, m_Int8CalibPath);
         config->setFlag(nvinfer1::BuilderFlag::kINT8);
         config->setInt8Calibrator(calibrator);
+
+        nvinfer1::IOptimizationProfile* calibProfile = builder->createOptimizationProfile();
+        nvinfer1::Dims4 calibDims{calib_batch_size, static_cast<int>(m_InputC), static_cast<int>(m_InputH),
+            static_cast<int>(m_InputW)};
+        calibProfile->setDimensions(m_InputBlobName.c_str(), nvinfer1::OptProfileSelector::kMIN, calibDims);
+        calibProfile->setDimensions(m_InputBlobName.c_str(), nvinfer1::OptProfileSelector::kOPT, calibDims);
+        calibProfile->setDimensions(m_InputBlobName.c_str(), nvinfer1::OptProfileSelector::kMAX, calibDims);
+        config->setCalibrationProfile(calibProfile);
 #else
         std::cerr << "OpenCV is required to run INT8 calibrator\n" << std::endl;
         assert(0);
 #endif
     }
 
+    if (m_WorkspaceSize > 0)
+    {
+#if NV_TENSORRT_MAJOR > 8 || (NV_TENSORRT_MAJOR == 8 && NV_TENSORRT_MINOR >= 4)
+        config->setMemoryPoolLimit(nvinfer1::MemoryPoolType::kWORKSPACE, static_cast<size_t>(m_WorkspaceSize) << 20);
+#else
+        config->setMaxWorkspaceSize(static_cast<size_t>(m_WorkspaceSize) << 20);
+#endif
+    }
+
+    if (m_OptimizationLevel >= 0)
+    {
+#if NV_TENSORRT_MAJOR > 8 || (NV_TENSORRT_MAJOR == 8 && NV_TENSORRT_MINOR >= 6)
+        config->setBuilderOptimizationLevel(m_OptimizationLevel);
+#else
+        std::cout << "NOTE: builder-optimization-level needs TensorRT 8.6, ignored\n" << std::endl;
+#endif
+    }
+
+    // The tactic search is most of the build time, identical GPUs replay it from the shared timing cache
+    std::string timingCache;
+    if (m_TimingCache != "none")
+    {
+        timingCache = m_TimingCache.empty() ? timingCachePath(cacheDir) : m_TimingCache;
+        loadTimingCache(config, timingCache);
+    }
+
+    auto buildStart = std::chrono::steady_clock::now();
     nvinfer1::ICudaEngine *engine = builder->buildEngineWithConfig(*network, *config);
     if (engine)
-        std::cout << "Building complete\n" << std::endl;
+    {
+        std::cout << "Building complete in "
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now() - buildStart).count() << " s\n"
+                  << std::endl;
+        if (!enginePath.empty())
+            saveCachedEngine(engine, enginePath);
+        if (!timingCache.empty())
+            saveTimingCache(config, timingCache);
+    }
     else
         std::cerr << "Building engine failed\n" << std::endl;
 
@@ -143,9 +226,14 @@ nvinfer1::ICudaEngine *Yolo::createEngine (nvinfer1::IBuilder* builder, nvinfer1
 NvDsInferStatus Yolo::parseModel(nvinfer1::INetworkDefinition& network) {
     destroyNetworkUtils();
 
-    std::vector<float> weights = loadWeights(m_WtsFilePath, m_NetworkType);
+    // Only compiled on a cache miss, a cached engine never reads the cfg
+    if (m_Network.layers.empty() && !compileNetworkConfig())
+        return NVDSINFER_CONFIG_FAILED;
+
+    if (!m_Weights.load(m_WtsFilePath, m_NetworkType))
+        return NVDSINFER_CUSTOM_LIB_FAILED;
     std::cout << "Building YOLO network\n" << std::endl;
-    NvDsInferStatus status = buildYoloNetwork(weights, network);
+    NvDsInferStatus status = buildYoloNetwork(m_Weights, network);
 
     if (status == NVDSINFER_SUCCESS)
         std::cout << "Building YOLO network complete" << std::endl;
@@ -155,7 +243,7 @@ NvDsInferStatus Yolo::parseModel(nvinfer1::INetworkDefinition& network) {
     return status;
 }
 
-NvDsInferStatus Yolo::buildYoloNetwork(std::vector<float>& weights, nvinfer1::INetworkDefinition& network)
+NvDsInferStatus Yolo::buildYoloNetwork(YoloWeights& weights, nvinfer1::INetworkDefinition& network)
 {
     int weightPtr = 0;
     int channels = m_InputC;
@@ -174,216 +262,131 @@ NvDsInferStatus Yolo::buildYoloNetwork(std::vector<float>& weights, nvinfer1::IN
 
     nvinfer1::ITensor* data =
         network.addInput(m_InputBlobName.c_str(), nvinfer1::DataType::kFLOAT,
-            nvinfer1::Dims3{static_cast<int>(m_InputC),
+            nvinfer1::Dims4{-1, static_cast<int>(m_InputC),
                 static_cast<int>(m_InputH), static_cast<int>(m_InputW)});
     assert(data != nullptr && data->getDimensions().nbDims > 0);
 
-    nvinfer1::ITensor* previous = data;
     std::vector<nvinfer1::ITensor*> tensorOutputs;
     std::vector<nvinfer1::ITensor*> yoloInputs;
     uint inputYoloCount = 0;
 
     int modelType = -1;
 
-    for (uint i = 0; i < m_ConfigBlocks.size(); ++i)
+    printLayerInfo("", "layer", "     input", "     output", "weightPtr");
+
+    for (const LayerDesc& layer : m_Network.layers)
     {
-        assert(getNumChannels(previous) == channels);
+        // Names keep the cfg block index so they do not move when the passes remove layers
+        int i = layer.cfgIndex;
         std::string layerIndex = "(" + std::to_string(tensorOutputs.size()) + ")";
+        nvinfer1::ITensor* input = layer.inputs.empty() || layer.inputs[0] < 0 ? data : tensorOutputs[layer.inputs[0]];
+        int channels = getNumChannels(input);
+        std::string inputVol = dimsToString(input->getDimensions());
+        std::string layerType = layerTypeName(layer.type);
+        nvinfer1::ITensor* output = nullptr;
 
-        if (m_ConfigBlocks.at(i).at("type") == "net")
-            printLayerInfo("", "layer", "     input", "     output", "weightPtr");
-        
-        else if (m_ConfigBlocks.at(i).at("type") == "convolutional")
+        switch (layer.type)
         {
-            std::string inputVol = dimsToString(previous->getDimensions());
-            nvinfer1::ILayer* out = convolutionalLayer(
-                i, m_ConfigBlocks.at(i), weights, m_TrtWeights, weightPtr, weightsType, channels, eps, previous, &network);
-            previous = out->getOutput(0);
-            assert(previous != nullptr);
-            channels = getNumChannels(previous);
-            std::string outputVol = dimsToString(previous->getDimensions());
-            tensorOutputs.push_back(previous);
-            std::string layerType = "conv_" + m_ConfigBlocks.at(i).at("activation");
-            printLayerInfo(layerIndex, layerType, inputVol, outputVol, std::to_string(weightPtr));
-        }
+            case LayerType::kConvolutional:
+            {
+                nvinfer1::ILayer* conv = convolutionalLayer(
+                    i, layer, weights, weightPtr, weightsType, channels, eps, input, &network, m_ActivationPlugin);
+                if (!conv)
+                    return NVDSINFER_CUSTOM_LIB_FAILED;
+                output = conv->getOutput(0);
+                layerType = "conv_" + activationName(layer.activation);
+                break;
+            }
 
-        else if (m_ConfigBlocks.at(i).at("type") == "implicit_add" || m_ConfigBlocks.at(i).at("type") == "implicit_mul")
-        {
-            std::string type;
-            if (m_ConfigBlocks.at(i).at("type") == "implicit_add")
-                type = "add";
-            else if (m_ConfigBlocks.at(i).at("type") == "implicit_mul")
-                type = "mul";
-            assert(m_ConfigBlocks.at(i).find("filters") != m_ConfigBlocks.at(i).end());
-            int filters = std::stoi(m_ConfigBlocks.at(i).at("filters"));
-            nvinfer1::ILayer* out = implicitLayer(filters, weights, m_TrtWeights, weightPtr, &network);
-            previous = out->getOutput(0);
-            assert(previous != nullptr);
-            channels = getNumChannels(previous);
-            std::string outputVol = dimsToString(previous->getDimensions());
-            tensorOutputs.push_back(previous);
-            std::string layerType = "implicit_" + type;
-            printLayerInfo(layerIndex, layerType, "        -", outputVol, std::to_string(weightPtr));
-        }
+            case LayerType::kImplicitAdd:
+            case LayerType::kImplicitMul:
+            {
+                nvinfer1::ILayer* implicit = implicitLayer(layer.filters, weights, weightPtr, &network);
+                if (!implicit)
+                    return NVDSINFER_CUSTOM_LIB_FAILED;
+                output = implicit->getOutput(0);
+                inputVol = "        -";
+                break;
+            }
 
-        else if (m_ConfigBlocks.at(i).at("type") == "shift_channels" || m_ConfigBlocks.at(i).at("type") == "control_channels")
-        {
-            std::string type;
-            if (m_ConfigBlocks.at(i).at("type") == "shift_channels")
-                type = "shift";
-            else if (m_ConfigBlocks.at(i).at("type") == "control_channels")
-                type = "control";
-            assert(m_ConfigBlocks.at(i).find("from") != m_ConfigBlocks.at(i).end());
-            int from = stoi(m_ConfigBlocks.at(i).at("from"));
-            if (from > 0)
-                from = from - i + 1;
-            assert((i - 2 >= 0) && (i - 2 < tensorOutputs.size()));
-            assert((i + from - 1 >= 0) && (i + from - 1 < tensorOutputs.size()));
-            assert(i + from - 1 < i - 2);
-            nvinfer1::ILayer* out = channelsLayer(type, previous, tensorOutputs[i + from - 1], &network);
-            previous = out->getOutput(0);
-            assert(previous != nullptr);
-            std::string outputVol = dimsToString(previous->getDimensions());
-            tensorOutputs.push_back(previous);
-            std::string layerType = type + "_channels" + ": " + std::to_string(i + from - 1);
-            printLayerInfo(layerIndex, layerType, "        -", outputVol, "    -");
-        }
+            case LayerType::kShiftChannels:
+            case LayerType::kControlChannels:
+                output = channelsLayer(layer.type, input, tensorOutputs[layer.inputs[1]], &network)->getOutput(0);
+                layerType += ": " + std::to_string(layer.inputs[1]);
+                break;
 
-        else if (m_ConfigBlocks.at(i).at("type") == "dropout")
-        {
-            // Skip dropout layer
-            assert(previous != nullptr);
-            tensorOutputs.push_back(previous);
-            printLayerInfo(layerIndex, "dropout", "        -", "        -", "    -");
-        }
+            case LayerType::kDropout:
+                output = input;
+                break;
 
-        else if (m_ConfigBlocks.at(i).at("type") == "shortcut")
-        {
-            assert(m_ConfigBlocks.at(i).find("activation") != m_ConfigBlocks.at(i).end());
-            assert(m_ConfigBlocks.at(i).find("from") != m_ConfigBlocks.at(i).end());
-            std::string activation = m_ConfigBlocks.at(i).at("activation");
-            int from = stoi(m_ConfigBlocks.at(i).at("from"));
-            if (from > 0)
-                from = from - i + 1;
-            assert((i - 2 >= 0) && (i - 2 < tensorOutputs.size()));
-            assert((i + from - 1 >= 0) && (i + from - 1 < tensorOutputs.size()));
-            assert(i + from - 1 < i - 2);
-            std::string inputVol = dimsToString(previous->getDimensions());
-            std::string shortcutVol = dimsToString(tensorOutputs[i + from - 1]->getDimensions());
-            nvinfer1::ILayer* out = shortcutLayer(i, activation, inputVol, shortcutVol, previous, tensorOutputs[i + from - 1], &network);
-            previous = out->getOutput(0);
-            assert(previous != nullptr);
-            std::string outputVol = dimsToString(previous->getDimensions());
-            tensorOutputs.push_back(previous);
-            std::string layerType = "shortcut_" + m_ConfigBlocks.at(i).at("activation") + ": " + std::to_string(i + from - 1);
-            printLayerInfo(layerIndex, layerType, "        -", outputVol, "    -");
-            if (inputVol != shortcutVol) {
-                std::cout << inputVol << " +" << shortcutVol << std::endl;
+            case LayerType::kShortcut:
+            {
+                std::string shortcutVol = dimsToString(tensorOutputs[layer.inputs[1]]->getDimensions());
+                output = shortcutLayer(i, layer.activation, inputVol, shortcutVol, input,
+                    tensorOutputs[layer.inputs[1]], &network, m_ActivationPlugin)->getOutput(0);
+                layerType = "shortcut_" + activationName(layer.activation) + ": " + std::to_string(layer.inputs[1]);
+                if (inputVol != shortcutVol)
+                    std::cout << inputVol << " +" << shortcutVol << std::endl;
+                break;
             }
-        }
 
-        else if (m_ConfigBlocks.at(i).at("type") == "route")
-        {
-            assert(m_ConfigBlocks.at(i).find("layers") != m_ConfigBlocks.at(i).end());
-            nvinfer1::ILayer* out = routeLayer(i, m_ConfigBlocks.at(i), tensorOutputs, &network);
-            previous = out->getOutput(0);
-            assert(previous != nullptr);
-            channels = getNumChannels(previous);
-            std::string outputVol = dimsToString(previous->getDimensions());
-            tensorOutputs.push_back(previous);
-            printLayerInfo(layerIndex, "route", "        -", outputVol, std::to_string(weightPtr));
-        }
+            case LayerType::kRoute:
+                output = routeLayer(i, layer, tensorOutputs, m_TrtWeights, &network)->getOutput(0);
+                inputVol = "        -";
+                break;
 
-        else if (m_ConfigBlocks.at(i).at("type") == "upsample")
-        {
-            std::string inputVol = dimsToString(previous->getDimensions());
-            nvinfer1::ILayer* out = upsampleLayer(i - 1, m_ConfigBlocks[i], previous, &network);
-            previous = out->getOutput(0);
-            assert(previous != nullptr);
-            std::string outputVol = dimsToString(previous->getDimensions());
-            tensorOutputs.push_back(previous);
-            printLayerInfo(layerIndex, "upsample", inputVol, outputVol, "    -");
-        }
+            case LayerType::kUpsample:
+                output = upsampleLayer(i - 1, layer, input, &network)->getOutput(0);
+                break;
 
-        else if (m_ConfigBlocks.at(i).at("type") == "maxpool")
-        {
-            std::string inputVol = dimsToString(previous->getDimensions());
-            nvinfer1::ILayer* out = maxpoolLayer(i, m_ConfigBlocks.at(i), previous, &network);
-            previous = out->getOutput(0);
-            assert(previous != nullptr);
-            std::string outputVol = dimsToString(previous->getDimensions());
-            tensorOutputs.push_back(previous);
-            printLayerInfo(layerIndex, "maxpool", inputVol, outputVol, std::to_string(weightPtr));
-        }
+            case LayerType::kMaxpool:
+                output = maxpoolLayer(i, layer, input, &network)->getOutput(0);
+                break;
 
-        else if (m_ConfigBlocks.at(i).at("type") == "reorg")
-        {
-            if (m_NetworkType.find("yolov5") != std::string::npos || m_NetworkType.find("yolor") != std::string::npos)
-            {
-                std::string inputVol = dimsToString(previous->getDimensions());
-                nvinfer1::ILayer* out = reorgV5Layer(i, previous, &network);
-                previous = out->getOutput(0);
-                assert(previous != nullptr);
-                channels = getNumChannels(previous);
-                std::string outputVol = dimsToString(previous->getDimensions());
-                tensorOutputs.push_back(previous);
-                std::string layerType = "reorgV5";
-                printLayerInfo(layerIndex, layerType, inputVol, outputVol, std::to_string(weightPtr));
-            }
-            else 
-            {
-                std::string inputVol = dimsToString(previous->getDimensions());
-                nvinfer1::IPluginV2* reorgPlugin = createReorgPlugin(2);
-                assert(reorgPlugin != nullptr);
-                nvinfer1::IPluginV2Layer* reorg =
-                    network.addPluginV2(&previous, 1, *reorgPlugin);
-                assert(reorg != nullptr);
-                std::string layerName = "reorg_" + std::to_string(i);
-                reorg->setName(layerName.c_str());
-                previous = reorg->getOutput(0);
-                assert(previous != nullptr);
-                std::string outputVol = dimsToString(previous->getDimensions());
-                channels = getNumChannels(previous);
-                tensorOutputs.push_back(reorg->getOutput(0));
-                printLayerInfo(layerIndex, "reorg", inputVol, outputVol, std::to_string(weightPtr));
-            }
-        }
+            case LayerType::kReorg:
+                if (m_NetworkType.find("yolov5") != std::string::npos || m_NetworkType.find("yolor") != std::string::npos)
+                {
+                    output = reorgV5Layer(i, input, &network)->getOutput(0);
+                    layerType = "reorgV5";
+                }
+                else
+                    output = reorgLayer(i, layer.stride, input, &network)->getOutput(0);
+                break;
 
-        else if (m_ConfigBlocks.at(i).at("type") == "yolo" || m_ConfigBlocks.at(i).at("type") == "region")
-        {
-            if (m_ConfigBlocks.at(i).at("type") == "yolo")
+            case LayerType::kYolo:
+            case LayerType::kRegion:
             {
-                if (m_NetworkType.find("yolor") != std::string::npos)
-                    modelType = 2;
+                if (layer.type == LayerType::kYolo)
+                {
+                    if (m_NetworkType.find("yolor") != std::string::npos)
+                        modelType = 2;
+                    else
+                        modelType = 1;
+                }
                 else
-                    modelType = 1;
+                    modelType = 0;
+
+                nvinfer1::Dims inputDims = input->getDimensions();
+                TensorInfo& curYoloTensor = m_YoloTensors.at(inputYoloCount);
+                curYoloTensor.blobName = layerType + "_" + std::to_string(i);
+                curYoloTensor.gridSizeX = inputDims.d[3];
+                curYoloTensor.gridSizeY = inputDims.d[2];
+
+                output = input;
+                yoloInputs.push_back(input);
+                ++inputYoloCount;
+                break;
             }
-            else
-                modelType = 0;
-
-            std::string layerName = modelType != 0 ? "yolo_" + std::to_string(i) : "region_" + std::to_string(i);
-            nvinfer1::Dims prevTensorDims = previous->getDimensions();
-            TensorInfo& curYoloTensor = m_YoloTensors.at(inputYoloCount);
-            curYoloTensor.blobName = layerName;
-            curYoloTensor.gridSizeX = prevTensorDims.d[2];
-            curYoloTensor.gridSizeY = prevTensorDims.d[1];
-
-            std::string inputVol = dimsToString(previous->getDimensions());
-            channels = getNumChannels(previous);
-            tensorOutputs.push_back(previous);
-            yoloInputs.push_back(previous);
-            ++inputYoloCount;
-            printLayerInfo(layerIndex, modelType != 0 ? "yolo" : "region", inputVol, "        -", "    -");
         }
 
-        else
-        {
-            std::cout << "\nUnsupported layer type --> \"" << m_ConfigBlocks.at(i).at("type") << "\"" << std::endl;
-            assert(0);
-        }
+        assert(output != nullptr);
+        tensorOutputs.push_back(output);
+        bool head = layer.type == LayerType::kYolo || layer.type == LayerType::kRegion;
+        printLayerInfo(layerIndex, layerType, inputVol, head ? "        -" : dimsToString(output->getDimensions()),
+            head ? "    -" : std::to_string(weightPtr));
     }
 
-    if ((int)weights.size() != weightPtr)
+    if (weights.size() != static_cast<size_t>(weightPtr))
     {
         std::cout << "\nNumber of unused weights left: " << weights.size() - weightPtr << std::endl;
         assert(0);
@@ -409,53 +412,34 @@ NvDsInferStatus Yolo::buildYoloNetwork(std::vector<float>& weights, nvinfer1::IN
         }
 
         std::string layerName = "yolo";
-        nvinfer1::IPluginV2* yoloPlugin = new YoloLayer(
+        nvinfer1::IPluginV2DynamicExt* yoloPlugin = new YoloLayer(
             m_InputW, m_InputH, m_NumClasses, m_NewCoords, m_YoloTensors, outputSize, modelType, m_TopK,
-            m_ScoreThreshold);
+            m_ScoreThreshold, m_IouThreshold);
         assert(yoloPlugin != nullptr);
         nvinfer1::IPluginV2Layer* yolo = network.addPluginV2(yoloInputTensors, inputYoloCount, *yoloPlugin);
         assert(yolo != nullptr);
         yolo->setName(layerName.c_str());
-        previous = yolo->getOutput(0);
-        assert(previous != nullptr);
-        previous->setName(layerName.c_str());
-        tensorOutputs.push_back(yolo->getOutput(0));
-
-        nvinfer1::ITensor* yoloTensors[] = {yolo->getOutput(0), yolo->getOutput(1)};
-        std::string outputVol = dimsToString(previous->getDimensions());
-
-        nvinfer1::plugin::NMSParameters nmsParams;
-        nmsParams.shareLocation = true;
-        nmsParams.backgroundLabelId = -1;
-        nmsParams.numClasses = m_NumClasses;
-        nmsParams.topK = m_TopK;
-        nmsParams.keepTopK = m_TopK;
-        nmsParams.scoreThreshold = m_ScoreThreshold;
-        nmsParams.iouThreshold = m_IouThreshold;
-        nmsParams.isNormalized = false;
-
-        layerName = "batchedNMS";
-        nvinfer1::IPluginV2* batchedNMS = createBatchedNMSPlugin(nmsParams);
-        nvinfer1::IPluginV2Layer* nms = network.addPluginV2(yoloTensors, 2, *batchedNMS);
-        nms->setName(layerName.c_str());
-        nvinfer1::ITensor* num_detections = nms->getOutput(0);
+
+        nvinfer1::ITensor* num_detections = yolo->getOutput(0);
         layerName = "num_detections";
         num_detections->setName(layerName.c_str());
-        nvinfer1::ITensor* nmsed_boxes = nms->getOutput(1);
+        nvinfer1::ITensor* nmsed_boxes = yolo->getOutput(1);
         layerName = "nmsed_boxes";
         nmsed_boxes->setName(layerName.c_str());
-        nvinfer1::ITensor* nmsed_scores = nms->getOutput(2);
+        nvinfer1::ITensor* nmsed_scores = yolo->getOutput(2);
         layerName = "nmsed_scores";
         nmsed_scores->setName(layerName.c_str());
-        nvinfer1::ITensor* nmsed_classes = nms->getOutput(3);
+        nvinfer1::ITensor* nmsed_classes = yolo->getOutput(3);
         layerName = "nmsed_classes";
         nmsed_classes->setName(layerName.c_str());
         network.markOutput(*num_detections);
         network.markOutput(*nmsed_boxes);
         network.markOutput(*nmsed_scores);
         network.markOutput(*nmsed_classes);
+        tensorOutputs.push_back(nmsed_boxes);
 
-        printLayerInfo("", "batched_nms", "        -", outputVol, "    -");
+        std::string outputVol = dimsToString(nmsed_boxes->getDimensions());
+        printLayerInfo("", "yolo_nms", "        -", outputVol, "    -");
     }
     else {
         std::cout << "\nError in yolo cfg file" << std::endl;
@@ -513,100 +497,40 @@ Yolo::parseConfigFile (const std::string cfgFilePath)
     return blocks;
 }
 
-void Yolo::parseConfigBlocks()
+bool Yolo::compileNetworkConfig()
 {
-    for (auto block : m_ConfigBlocks)
+    if (!compileNetwork(parseConfigFile(m_ConfigFilePath), m_Network))
     {
-        if (block.at("type") == "net")
-        {
-            assert((block.find("height") != block.end()) && "Missing 'height' param in network cfg");
-            assert((block.find("width") != block.end()) && "Missing 'width' param in network cfg");
-            assert((block.find("channels") != block.end()) && "Missing 'channels' param in network cfg");
-
-            m_InputH = std::stoul(block.at("height"));
-            m_InputW = std::stoul(block.at("width"));
-            m_InputC = std::stoul(block.at("channels"));
-            m_InputSize = m_InputC * m_InputH * m_InputW;
-
-            if (block.find("letter_box") != block.end())
-            {
-                m_LetterBox = std::stoul(block.at("letter_box"));
-            }
-        }
-        else if ((block.at("type") == "region") || (block.at("type") == "yolo"))
-        {
-            assert((block.find("num") != block.end())
-                   && std::string("Missing 'num' param in " + block.at("type") + " layer").c_str());
-            assert((block.find("classes") != block.end())
-                   && std::string("Missing 'classes' param in " + block.at("type") + " layer").c_str());
-            assert((block.find("anchors") != block.end())
-                   && std::string("Missing 'anchors' param in " + block.at("type") + " layer").c_str());
-
-            ++m_YoloCount;
-
-            m_NumClasses = std::stoul(block.at("classes"));
-
-            if (block.find("new_coords") != block.end())
-            {
-                m_NewCoords = std::stoul(block.at("new_coords"));
-            }
-
-            TensorInfo outputTensor;
-
-            std::string anchorString = block.at("anchors");
-            while (!anchorString.empty())
-            {
-                int npos = anchorString.find_first_of(',');
-                if (npos != -1)
-                {
-                    float anchor = std::stof(trim(anchorString.substr(0, npos)));
-                    outputTensor.anchors.push_back(anchor);
-                    anchorString.erase(0, npos + 1);
-                }
-                else
-                {
-                    float anchor = std::stof(trim(anchorString));
-                    outputTensor.anchors.push_back(anchor);
-                    break;
-                }
-            }
+        std::cerr << "Invalid YOLO cfg " << m_ConfigFilePath << "\n" << std::endl;
+        return false;
+    }
 
-            if (block.find("mask") != block.end())
-            {
-                std::string maskString = block.at("mask");
-                while (!maskString.empty())
-                {
-                    int npos = maskString.find_first_of(',');
-                    if (npos != -1)
-                    {
-                        int mask = std::stoul(trim(maskString.substr(0, npos)));
-                        outputTensor.mask.push_back(mask);
-                        maskString.erase(0, npos + 1);
-                    }
-                    else
-                    {
-                        int mask = std::stoul(trim(maskString));
-                        outputTensor.mask.push_back(mask);
-                        break;
-                    }
-                }
-            }
+    uint removed = removeIdentityLayers(m_Network);
+    if (removed > 0)
+        std::cout << "Removed " << removed << " identity layers (dropout, single input route)\n" << std::endl;
 
-            if (block.find("scale_x_y") != block.end())
-            {
-                outputTensor.scaleXY = std::stof(block.at("scale_x_y"));
-            }
-            else
-            {
-                outputTensor.scaleXY = 1.0;
-            }
+    m_InputH = m_Network.inputH;
+    m_InputW = m_Network.inputW;
+    m_InputC = m_Network.inputC;
+    m_InputSize = m_InputC * m_InputH * m_InputW;
+    m_LetterBox = m_Network.letterBox;
+    m_NumClasses = m_Network.numClasses;
+    m_NewCoords = m_Network.newCoords;
 
-            outputTensor.numBBoxes
-                = outputTensor.mask.size() > 0 ? outputTensor.mask.size() : std::stoul(trim(block.at("num")));
-            
-            m_YoloTensors.push_back(outputTensor);
-        }
+    m_YoloTensors.clear();
+    for (const LayerDesc& layer : m_Network.layers)
+    {
+        if (layer.type != LayerType::kYolo && layer.type != LayerType::kRegion)
+            continue;
+        TensorInfo outputTensor;
+        outputTensor.anchors = layer.anchors;
+        outputTensor.mask = layer.mask;
+        outputTensor.scaleXY = layer.scaleXY;
+        outputTensor.numBBoxes = layer.numBBoxes;
+        m_YoloTensors.push_back(outputTensor);
     }
+    m_YoloCount = m_YoloTensors.size();
+    return true;
 }
 
 void Yolo::parseConfigNMSBlocks()
@@ -621,6 +545,45 @@ void Yolo::parseConfigNMSBlocks()
     m_IouThreshold = std::stof(block.at("iou-threshold"));
     m_ScoreThreshold = std::stof(block.at("score-threshold"));
     m_TopK = std::stoul(block.at("topk"));
+
+    if (block.find("batch-profiles") != block.end())
+    {
+        std::string profilesString = block.at("batch-profiles");
+        std::stringstream s(profilesString);
+        std::string batch;
+        while (std::getline(s, batch, ';'))
+        {
+            if (!trim(batch).empty())
+                m_BatchProfiles.push_back(std::stoul(trim(batch)));
+        }
+        std::sort(m_BatchProfiles.begin(), m_BatchProfiles.end());
+        m_BatchProfiles.erase(std::unique(m_BatchProfiles.begin(), m_BatchProfiles.end()), m_BatchProfiles.end());
+    }
+
+    if (block.find("engine-cache-dir") != block.end())
+    {
+        m_EngineCacheDir = block.at("engine-cache-dir");
+    }
+
+    if (block.find("activation-plugin") != block.end())
+    {
+        m_ActivationPlugin = block.at("activation-plugin") == "1";
+    }
+
+    if (block.find("timing-cache") != block.end())
+    {
+        m_TimingCache = block.at("timing-cache");
+    }
+
+    if (block.find("workspace-size") != block.end())
+    {
+        m_WorkspaceSize = std::stoul(block.at("workspace-size"));
+    }
+
+    if (block.find("builder-optimization-level") != block.end())
+    {
+        m_OptimizationLevel = std::stoi(block.at("builder-optimization-level"));
+    }
 }
 
 void Yolo::destroyNetworkUtils()
@@ -631,4 +594,5 @@ void Yolo::destroyNetworkUtils()
             free(const_cast<void*>(m_TrtWeights[i].values));
     }
     m_TrtWeights.clear();
+    m_Weights.release();
 }
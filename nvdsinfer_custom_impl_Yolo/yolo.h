@@ -34,8 +34,11 @@
 #include "layers/upsample_layer.h"
 #include "layers/maxpool_layer.h"
 #include "layers/reorgv5_layer.h"
+#include "layers/reorg_layer.h"
 
 #include "nvdsinfer_custom_impl.h"
+#include "yoloWeights.h"
+#include "yoloNetwork.h"
 
 struct NetworkInfo
 {
@@ -48,6 +51,7 @@ struct NetworkInfo
     uint numDetectedClasses;
     int clusterMode;
     std::string networkMode;
+    uint maxBatchSize;
 };
 
 struct TensorInfo
@@ -67,7 +71,7 @@ public:
 
     ~Yolo() override;
 
-    bool hasFullDimsSupported() const override { return false; }
+    bool hasFullDimsSupported() const override { return true; }
 
     const char* getModelName() const override {
         return m_ConfigFilePath.empty() ? m_NetworkType.c_str() : m_ConfigFilePath.c_str();
@@ -87,6 +91,7 @@ protected:
     const uint m_NumDetectedClasses;
     const int m_ClusterMode;
     const std::string m_NetworkMode;
+    const uint m_MaxBatchSize;
 
     uint m_InputH;
     uint m_InputW;
@@ -99,18 +104,27 @@ protected:
     float m_IouThreshold;
     float m_ScoreThreshold;
     uint m_TopK;
+    std::vector<uint> m_BatchProfiles;
+    std::string m_EngineCacheDir;
+    bool m_ActivationPlugin {false};
+    std::string m_TimingCache;
+    uint m_WorkspaceSize {0};
+    int m_OptimizationLevel {-1};
 
     std::vector<TensorInfo> m_YoloTensors;
-    std::vector<std::map<std::string, std::string>> m_ConfigBlocks;
+    NetworkDesc m_Network;
     std::vector<std::map<std::string, std::string>> m_ConfigNMSBlocks;
     std::vector<nvinfer1::Weights> m_TrtWeights;
+    // Conv and implicit weights are views into this mapping (batch-norm folded in), it has to live until the engine
+    // is built
+    YoloWeights m_Weights;
 
 private:
-    NvDsInferStatus buildYoloNetwork(std::vector<float>& weights, nvinfer1::INetworkDefinition& network);
+    NvDsInferStatus buildYoloNetwork(YoloWeights& weights, nvinfer1::INetworkDefinition& network);
 
     std::vector<std::map<std::string, std::string>> parseConfigFile(const std::string cfgFilePath);
 
-    void parseConfigBlocks();
+    bool compileNetworkConfig();
 
     void parseConfigNMSBlocks();
 
@@ -0,0 +1,381 @@
+/*
+ * Created by Marcos Luciano
+ * https://www.github.com/marcoslucianops
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "nvdsinfer_custom_impl.h"
+#include "yoloForward.h"
+
+// Normally set by the engine build, the bench links the parser on its own
+uint kNUM_CLASSES = 1;
+
+size_t sortDetectionsWorkspaceSize(const uint& batchSize, const uint64_t& outputSize);
+
+cudaError_t sortDetections(
+    void* d_indexes, void* d_scores, void* d_boxes, void* d_classes, void* countData, void* sortedBoxes,
+    void* sortedScores, void* sortedClasses, void* workspace, const uint& batchSize, uint64_t& outputSize, uint& topK,
+    cudaStream_t stream);
+
+size_t nmsDetectionsWorkspaceSize(const uint& batchSize, const uint& topK);
+
+cudaError_t nmsDetections(
+    const void* sortedBoxes, const void* sortedScores, const void* sortedClasses, const void* countData,
+    void* numDetections, void* nmsedBoxes, void* nmsedScores, void* nmsedClasses, void* workspace,
+    const uint& batchSize, const uint& topK, const float& iouThreshold, cudaStream_t stream);
+
+extern "C" bool NvDsInferParseYolo(
+    std::vector<NvDsInferLayerInfo> const& outputLayersInfo, NvDsInferNetworkInfo const& networkInfo,
+    NvDsInferParseDetectionParams const& detectionParams, std::vector<NvDsInferParseObjectInfo>& objectList);
+
+#define BENCH_CHECK(status)                                                                                          \
+    {                                                                                                                \
+        cudaError_t err = status;                                                                                    \
+        if (err != cudaSuccess) {                                                                                    \
+            std::cerr << "CUDA error " << cudaGetErrorString(err) << " at " << __FILE__ << ":" << __LINE__            \
+                      << std::endl;                                                                                  \
+            std::exit(1);                                                                                            \
+        }                                                                                                            \
+    }
+
+namespace {
+    const float kScoreThreshold = 0.25f;
+    const float kIouThreshold = 0.45f;
+    const uint kNumBBoxes = 3;
+    const uint kStrides[] = {8, 16, 32};
+    // yolov5s anchors, one row of kNumBBoxes pairs per stride
+    const float kAnchors[][kNumBBoxes * 2] = {
+        {10, 13, 16, 30, 33, 23}, {30, 61, 62, 45, 59, 119}, {116, 90, 156, 198, 373, 326}};
+
+    struct BenchCase
+    {
+        uint decodeType;
+        uint batchSize;
+        uint netSize;
+        uint numClasses;
+        float density;
+        uint topK;
+    };
+
+    struct BenchResult
+    {
+        uint64_t candidates;
+        uint kept;
+        double decodeUs;
+        double sortUs;
+        double nmsUs;
+        double parseUs;
+    };
+
+    const char* decodeTypeName(uint decodeType)
+    {
+        switch (decodeType) {
+        case kREGION_DECODE: return "region";
+        case kYOLO_DECODE: return "yolo";
+        case kYOLO_NC_DECODE: return "yolo_nc";
+        case kYOLO_R_DECODE: return "yolo_r";
+        default: return "unknown";
+        }
+    }
+
+    // Raw head outputs in the [bbox][4 + 1 + classes][grid] layout the decoder reads, a density fraction of the
+    // cells clears the score threshold. new_coords heads are already activated, the others hold logits.
+    std::vector<float> makeHead(const BenchCase& c, uint gridSize, std::mt19937& rng, uint64_t& candidates)
+    {
+        const bool activated = c.decodeType == kYOLO_NC_DECODE;
+        const uint numGridCells = gridSize * gridSize;
+        const uint channels = 4 + 1 + c.numClasses;
+
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        std::normal_distribution<float> logit(-4.f, 1.f);
+        std::uniform_int_distribution<uint> winner(0, c.numClasses - 1);
+
+        std::vector<float> head(static_cast<size_t>(c.batchSize) * kNumBBoxes * channels * numGridCells);
+        float* p = head.data();
+        for (uint b = 0; b < c.batchSize; ++b) {
+            for (uint z = 0; z < kNumBBoxes; ++z, p += channels * numGridCells) {
+                for (uint i = 0; i < numGridCells; ++i) {
+                    bool hit = unit(rng) < c.density;
+                    candidates += hit;
+                    p[numGridCells * 0 + i] = activated ? unit(rng) : logit(rng) + 4.f;
+                    p[numGridCells * 1 + i] = activated ? unit(rng) : logit(rng) + 4.f;
+                    p[numGridCells * 2 + i] = activated ? 0.5f : 0.f;
+                    p[numGridCells * 3 + i] = activated ? 0.5f : 0.f;
+                    if (activated)
+                        p[numGridCells * 4 + i] = hit ? 0.9f : 0.01f;
+                    else
+                        p[numGridCells * 4 + i] = hit ? 4.f : -8.f;
+                    uint best = winner(rng);
+                    for (uint k = 0; k < c.numClasses; ++k) {
+                        float val = activated ? unit(rng) * 0.5f : logit(rng);
+                        p[numGridCells * (5 + k) + i] = k == best ? (activated ? 0.95f : 4.f) : val;
+                    }
+                }
+            }
+        }
+        return head;
+    }
+
+    BenchResult runCase(const BenchCase& c, uint iterations, cudaStream_t stream)
+    {
+        std::mt19937 rng(0);
+        BenchResult r {};
+
+        YoloHeadsInfo headsInfo {};
+        YoloInputs inputs {};
+        std::vector<void*> d_heads;
+        for (uint i = 0; i < sizeof(kStrides) / sizeof(kStrides[0]); ++i) {
+            uint gridSize = c.netSize / kStrides[i];
+            YoloHeadInfo& head = headsInfo.heads[i];
+            head.gridSizeX = gridSize;
+            head.gridSizeY = gridSize;
+            head.numBBoxes = kNumBBoxes;
+            head.cellOffset = headsInfo.totalCells;
+            head.inputSize = static_cast<uint64_t>(gridSize) * gridSize * kNumBBoxes * (4 + 1 + c.numClasses);
+            head.scaleXY = c.decodeType == kREGION_DECODE ? 1.0f : 2.0f;
+            std::copy(kAnchors[i], kAnchors[i] + kNumBBoxes * 2, head.anchors);
+            headsInfo.totalCells += gridSize * gridSize * kNumBBoxes;
+            headsInfo.numHeads++;
+
+            std::vector<float> host = makeHead(c, gridSize, rng, r.candidates);
+            void* d_head;
+            BENCH_CHECK(cudaMalloc(&d_head, host.size() * sizeof(float)));
+            BENCH_CHECK(cudaMemcpy(d_head, host.data(), host.size() * sizeof(float), cudaMemcpyHostToDevice));
+            inputs.data[i] = d_head;
+            d_heads.push_back(d_head);
+        }
+
+        int slot = acquireYoloHeadsSlot(headsInfo);
+        if (slot < 0) {
+            std::cerr << "Could not get a constant memory slot for the heads" << std::endl;
+            std::exit(1);
+        }
+
+        uint64_t outputSize = headsInfo.totalCells;
+        uint topK = std::min<uint64_t>(c.topK, outputSize);
+        const uint batchSize = c.batchSize;
+
+        void *countData, *indexes, *scores, *boxes, *classes, *sortWs;
+        void *sortedBoxes, *sortedScores, *sortedClasses, *nmsWs;
+        void *numDetections, *nmsedBoxes, *nmsedScores, *nmsedClasses;
+        BENCH_CHECK(cudaMalloc(&countData, sizeof(int) * batchSize));
+        BENCH_CHECK(cudaMalloc(&indexes, sizeof(int) * outputSize * batchSize));
+        BENCH_CHECK(cudaMalloc(&scores, sizeof(float) * outputSize * batchSize));
+        BENCH_CHECK(cudaMalloc(&boxes, sizeof(float) * 4 * outputSize * batchSize));
+        BENCH_CHECK(cudaMalloc(&classes, sizeof(int) * outputSize * batchSize));
+        BENCH_CHECK(cudaMalloc(&sortWs, sortDetectionsWorkspaceSize(batchSize, outputSize)));
+        BENCH_CHECK(cudaMalloc(&sortedBoxes, sizeof(float) * 4 * topK * batchSize));
+        BENCH_CHECK(cudaMalloc(&sortedScores, sizeof(float) * topK * batchSize));
+        BENCH_CHECK(cudaMalloc(&sortedClasses, sizeof(int) * topK * batchSize));
+        BENCH_CHECK(cudaMalloc(&nmsWs, nmsDetectionsWorkspaceSize(batchSize, topK)));
+        BENCH_CHECK(cudaMalloc(&numDetections, sizeof(int) * batchSize));
+        BENCH_CHECK(cudaMalloc(&nmsedBoxes, sizeof(float) * 4 * topK * batchSize));
+        BENCH_CHECK(cudaMalloc(&nmsedScores, sizeof(float) * topK * batchSize));
+        BENCH_CHECK(cudaMalloc(&nmsedClasses, sizeof(float) * topK * batchSize));
+
+        cudaEvent_t events[4];
+        for (uint i = 0; i < 4; ++i)
+            BENCH_CHECK(cudaEventCreate(&events[i]));
+
+        // Same launch sequence as YoloLayer::enqueue, the first pass is a warm-up and does not count
+        for (uint it = 0; it <= iterations; ++it) {
+            BENCH_CHECK(cudaEventRecord(events[0], stream));
+            BENCH_CHECK(cudaMemsetAsync(countData, 0, sizeof(int) * batchSize, stream));
+            BENCH_CHECK(cudaYoloLayer(
+                inputs, indexes, scores, boxes, classes, countData, slot, headsInfo.totalCells, c.decodeType, false,
+                batchSize, outputSize, kScoreThreshold, c.netSize, c.netSize, c.numClasses, stream));
+            BENCH_CHECK(cudaEventRecord(events[1], stream));
+            BENCH_CHECK(sortDetections(
+                indexes, scores, boxes, classes, countData, sortedBoxes, sortedScores, sortedClasses, sortWs,
+                batchSize, outputSize, topK, stream));
+            BENCH_CHECK(cudaEventRecord(events[2], stream));
+            BENCH_CHECK(nmsDetections(
+                sortedBoxes, sortedScores, sortedClasses, countData, numDetections, nmsedBoxes, nmsedScores,
+                nmsedClasses, nmsWs, batchSize, topK, kIouThreshold, stream));
+            BENCH_CHECK(cudaEventRecord(events[3], stream));
+            BENCH_CHECK(cudaEventSynchronize(events[3]));
+
+            if (it == 0)
+                continue;
+            float ms;
+            BENCH_CHECK(cudaEventElapsedTime(&ms, events[0], events[1]));
+            r.decodeUs += ms * 1e3;
+            BENCH_CHECK(cudaEventElapsedTime(&ms, events[1], events[2]));
+            r.sortUs += ms * 1e3;
+            BENCH_CHECK(cudaEventElapsedTime(&ms, events[2], events[3]));
+            r.nmsUs += ms * 1e3;
+        }
+        r.decodeUs /= iterations;
+        r.sortUs /= iterations;
+        r.nmsUs /= iterations;
+
+        // The parser runs on the host copy of the first frame, like nvinfer hands it over
+        std::vector<int> hostCount(batchSize);
+        std::vector<float> hostBoxes(topK * 4), hostScores(topK), hostClasses(topK);
+        BENCH_CHECK(cudaMemcpy(hostCount.data(), numDetections, sizeof(int) * batchSize, cudaMemcpyDeviceToHost));
+        BENCH_CHECK(cudaMemcpy(hostBoxes.data(), nmsedBoxes, sizeof(float) * 4 * topK, cudaMemcpyDeviceToHost));
+        BENCH_CHECK(cudaMemcpy(hostScores.data(), nmsedScores, sizeof(float) * topK, cudaMemcpyDeviceToHost));
+        BENCH_CHECK(cudaMemcpy(hostClasses.data(), nmsedClasses, sizeof(float) * topK, cudaMemcpyDeviceToHost));
+
+        std::vector<NvDsInferLayerInfo> layers(4);
+        layers[0].buffer = hostCount.data();
+        layers[1].buffer = hostBoxes.data();
+        layers[2].buffer = hostScores.data();
+        layers[3].buffer = hostClasses.data();
+        layers[2].inferDims.numDims = 1;
+        layers[2].inferDims.d[0] = topK;
+
+        NvDsInferNetworkInfo networkInfo {c.netSize, c.netSize, 3};
+        NvDsInferParseDetectionParams detectionParams;
+        detectionParams.numClassesConfigured = kNUM_CLASSES;
+
+        // nvinfer keeps its object list across frames, so does the bench
+        std::vector<NvDsInferParseObjectInfo> objectList;
+        NvDsInferParseYolo(layers, networkInfo, detectionParams, objectList);
+        uint parseIterations = iterations * 100;
+        auto start = std::chrono::steady_clock::now();
+        for (uint it = 0; it < parseIterations; ++it)
+            NvDsInferParseYolo(layers, networkInfo, detectionParams, objectList);
+        auto end = std::chrono::steady_clock::now();
+        r.parseUs = std::chrono::duration<double, std::micro>(end - start).count() / parseIterations;
+        r.kept = objectList.size();
+        r.candidates /= batchSize;
+
+        for (uint i = 0; i < 4; ++i)
+            cudaEventDestroy(events[i]);
+        for (void* p : {countData, indexes, scores, boxes, classes, sortWs, sortedBoxes, sortedScores, sortedClasses,
+                        nmsWs, numDetections, nmsedBoxes, nmsedScores, nmsedClasses})
+            cudaFree(p);
+        for (void* p : d_heads)
+            cudaFree(p);
+        releaseYoloHeadsSlot(slot);
+
+        return r;
+    }
+
+    std::vector<uint> parseList(const char* arg)
+    {
+        std::vector<uint> values;
+        std::stringstream ss(arg);
+        std::string item;
+        while (std::getline(ss, item, ','))
+            values.push_back(std::stoul(item));
+        return values;
+    }
+
+    std::vector<float> parseFloatList(const char* arg)
+    {
+        std::vector<float> values;
+        std::stringstream ss(arg);
+        std::string item;
+        while (std::getline(ss, item, ','))
+            values.push_back(std::stof(item));
+        return values;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<uint> decodeTypes = {kREGION_DECODE, kYOLO_DECODE, kYOLO_NC_DECODE, kYOLO_R_DECODE};
+    std::vector<uint> batchSizes = {1, 4, 8};
+    std::vector<uint> netSizes = {320, 640, 1280};
+    std::vector<uint> numClasses = {1, 80};
+    std::vector<float> densities = {0.001f, 0.01f, 0.1f};
+    uint topK = 300;
+    uint iterations = 100;
+    std::string jsonPath;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value)
+            arg.clear();
+        if (arg == "--batch")
+            batchSizes = parseList(value);
+        else if (arg == "--net-size")
+            netSizes = parseList(value);
+        else if (arg == "--classes")
+            numClasses = parseList(value);
+        else if (arg == "--density")
+            densities = parseFloatList(value);
+        else if (arg == "--topk")
+            topK = std::stoul(value);
+        else if (arg == "--iterations")
+            iterations = std::max(1ul, std::stoul(value));
+        else if (arg == "--json")
+            jsonPath = value;
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--batch 1,4,8] [--net-size 320,640,1280] [--classes 1,80]"
+                      << " [--density 0.001,0.01,0.1] [--topk 300] [--iterations 100] [--json results.json]"
+                      << std::endl;
+            return 1;
+        }
+        ++i;
+    }
+
+    cudaStream_t stream;
+    BENCH_CHECK(cudaStreamCreate(&stream));
+
+    std::ostringstream json;
+    json << "[";
+
+    std::cout << std::left << std::setw(9) << "decode" << std::right << std::setw(6) << "batch" << std::setw(6)
+              << "net" << std::setw(8) << "classes" << std::setw(9) << "density" << std::setw(11) << "candidates"
+              << std::setw(6) << "kept" << std::setw(12) << "decode us" << std::setw(10) << "sort us" << std::setw(10)
+              << "nms us" << std::setw(11) << "parse us" << std::endl;
+
+    bool first = true;
+    for (uint decodeType : decodeTypes) {
+        for (uint batchSize : batchSizes) {
+            for (uint netSize : netSizes) {
+                for (uint classes : numClasses) {
+                    for (float density : densities) {
+                        BenchCase c {decodeType, batchSize, netSize, classes, density, topK};
+                        BenchResult r = runCase(c, iterations, stream);
+
+                        std::cout << std::left << std::setw(9) << decodeTypeName(decodeType) << std::right
+                                  << std::setw(6) << batchSize << std::setw(6) << netSize << std::setw(8) << classes
+                                  << std::setw(9) << density << std::setw(11) << r.candidates << std::setw(6)
+                                  << r.kept << std::fixed << std::setprecision(1) << std::setw(12) << r.decodeUs
+                                  << std::setw(10) << r.sortUs << std::setw(10) << r.nmsUs << std::setprecision(2)
+                                  << std::setw(11) << r.parseUs << std::defaultfloat << std::endl;
+
+                        json << (first ? "\n" : ",\n") << "  {\"decode\": \"" << decodeTypeName(decodeType)
+                             << "\", \"batch\": " << batchSize << ", \"net_size\": " << netSize
+                             << ", \"classes\": " << classes << ", \"density\": " << density
+                             << ", \"topk\": " << topK << ", \"candidates\": " << r.candidates
+                             << ", \"kept\": " << r.kept << ", \"decode_us\": " << r.decodeUs
+                             << ", \"sort_us\": " << r.sortUs << ", \"nms_us\": " << r.nmsUs
+                             << ", \"parse_us\": " << r.parseUs << "}";
+                        first = false;
+                    }
+                }
+            }
+        }
+    }
+    json << "\n]\n";
+
+    cudaStreamDestroy(stream);
+
+    if (!jsonPath.empty()) {
+        std::ofstream out(jsonPath);
+        if (!out) {
+            std::cerr << "Could not write " << jsonPath << std::endl;
+            return 1;
+        }
+        out << json.str();
+        std::cout << "Wrote " << jsonPath << std::endl;
+    }
+    return 0;
+}
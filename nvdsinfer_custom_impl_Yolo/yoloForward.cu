@@ -3,64 +3,198 @@
  * https://www.github.com/marcoslucianops
  */
 
-#include <stdint.h>
+#include <map>
+#include <math.h>
+#include <mutex>
+
+#include <cuda_fp16.h>
+
+#include "yoloForward.h"
+
+// One slot per live plugin instance on a device, so engines sharing a GPU never overwrite each other's heads
+#define kMAX_YOLO_HEADS_SLOTS 16
+
+__constant__ YoloHeadsInfo c_YoloHeads[kMAX_YOLO_HEADS_SLOTS];
+
+namespace {
+    std::mutex slotsMutex;
+    std::map<int, uint32_t> slotsInUse;
+}
+
+int acquireYoloHeadsSlot(const YoloHeadsInfo& headsInfo)
+{
+    int device;
+    if (cudaGetDevice(&device) != cudaSuccess)
+        return -1;
+
+    std::lock_guard<std::mutex> lock(slotsMutex);
+    uint32_t& used = slotsInUse[device];
+    for (int slot = 0; slot < kMAX_YOLO_HEADS_SLOTS; ++slot)
+    {
+        if (used & (1u << slot))
+            continue;
+        if (cudaMemcpyToSymbol(c_YoloHeads, &headsInfo, sizeof(YoloHeadsInfo), slot * sizeof(YoloHeadsInfo))
+            != cudaSuccess)
+            return -1;
+        used |= 1u << slot;
+        return device * kMAX_YOLO_HEADS_SLOTS + slot;
+    }
+    return -1;
+}
+
+void releaseYoloHeadsSlot(int slot)
+{
+    if (slot < 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(slotsMutex);
+    slotsInUse[slot / kMAX_YOLO_HEADS_SLOTS] &= ~(1u << (slot % kMAX_YOLO_HEADS_SLOTS));
+}
 
 inline __device__ float sigmoidGPU(const float& x) { return 1.0f / (1.0f + __expf(-x)); }
 
+template <uint DecodeType>
+inline __device__ float activateGPU(const float& x)
+{
+    return DecodeType == kYOLO_NC_DECODE ? x : sigmoidGPU(x);
+}
+
+inline __device__ float toFloat(const float& x) { return x; }
+
+inline __device__ float toFloat(const __half& x) { return __half2float(x); }
+
+template <uint DecodeType, typename T>
 __global__ void gpuYoloLayer(
-    const float* input, int* d_indexes, float* d_scores, float* d_boxes, int* d_classes, int* countData,
-    const float scoreThreshold, const uint netWidth, const uint netHeight, const uint gridSizeX, const uint gridSizeY,
-    const uint numOutputClasses, const uint numBBoxes, const float scaleXY, const float* anchors, const int* mask)
+    const YoloInputs inputs, int* d_indexes, float* d_scores, float* d_boxes, int* d_classes, int* countData,
+    const int headsSlot, const uint totalCells, const float scoreThreshold, const float objLogitThreshold,
+    const uint netWidth, const uint netHeight, const uint numOutputClasses, const uint64_t outputSize)
 {
-    uint x_id = blockIdx.x * blockDim.x + threadIdx.x;
-    uint y_id = blockIdx.y * blockDim.y + threadIdx.y;
-    uint z_id = blockIdx.z * blockDim.z + threadIdx.z;
+    uint cell_id = blockIdx.x * blockDim.x + threadIdx.x;
+    uint batch = blockIdx.y;
 
-    if (x_id >= gridSizeX || y_id >= gridSizeY || z_id >= numBBoxes)
-        return;
+    // No early return before the ballot, the whole warp has to take part in the compaction
+    const bool inRange = cell_id < totalCells;
+    if (!inRange)
+        cell_id = totalCells - 1;
+
+    const YoloHeadsInfo& headsInfo = c_YoloHeads[headsSlot];
+
+    uint head = 0;
+    while (head + 1 < headsInfo.numHeads && cell_id >= headsInfo.heads[head + 1].cellOffset)
+        ++head;
+
+    const YoloHeadInfo& info = headsInfo.heads[head];
+
+    const T* input = nullptr;
+#pragma unroll
+    for (uint i = 0; i < kMAX_YOLO_HEADS; ++i)
+    {
+        if (i == head)
+            input = reinterpret_cast<const T*>(inputs.data[i]);
+    }
+    input += batch * info.inputSize;
 
+    const uint gridSizeX = info.gridSizeX;
+    const uint gridSizeY = info.gridSizeY;
     const int numGridCells = gridSizeX * gridSizeY;
-    const int bbindex = y_id * gridSizeX + x_id;
 
-    const float objectness
-        = sigmoidGPU(input[bbindex + numGridCells * (z_id * (5 + numOutputClasses) + 4)]);
+    const uint local_id = cell_id - info.cellOffset;
+    const uint z_id = local_id / numGridCells;
+    const int bbindex = local_id % numGridCells;
+    const uint x_id = bbindex % gridSizeX;
+    const uint y_id = bbindex / gridSizeX;
 
-    if (objectness < scoreThreshold)
+    const T* bbox = input + bbindex + numGridCells * (z_id * (5 + numOutputClasses));
+
+    // The raw logit is compared first so most rejected cells never pay for the sigmoid
+    const float rawObjectness = toFloat(bbox[numGridCells * 4]);
+    float objectness = 0.0f;
+    bool keep = inRange && rawObjectness >= objLogitThreshold;
+    if (keep)
+    {
+        objectness = activateGPU<DecodeType>(rawObjectness);
+        keep = objectness >= scoreThreshold;
+    }
+
+    // One atomic per warp: the first surviving lane reserves room for all survivors of the warp
+    const uint lane = threadIdx.x & 31;
+    const uint ballot = __ballot_sync(0xffffffff, keep);
+    if (ballot == 0)
         return;
 
-    int count = (int)atomicAdd(&countData[0], 1);
+    int base = 0;
+    if (lane == __ffs(ballot) - 1)
+        base = atomicAdd(&countData[batch], __popc(ballot));
+    base = __shfl_sync(0xffffffff, base, __ffs(ballot) - 1);
+
+    if (!keep)
+        return;
+
+    const int count = base + __popc(ballot & ((1u << lane) - 1));
+
+    d_indexes += batch * outputSize;
+    d_scores += batch * outputSize;
+    d_boxes += batch * 4 * outputSize;
+    d_classes += batch * outputSize;
 
-    const float alpha = scaleXY;
-    const float beta = -0.5 * (scaleXY - 1);
+    const float alpha = info.scaleXY;
+    const float beta = -0.5 * (info.scaleXY - 1);
 
     float x
-        = (sigmoidGPU(input[bbindex + numGridCells * (z_id * (5 + numOutputClasses) + 0)])
+        = (activateGPU<DecodeType>(toFloat(bbox[numGridCells * 0]))
           * alpha + beta + x_id) * netWidth / gridSizeX;
 
     float y
-        = (sigmoidGPU(input[bbindex + numGridCells * (z_id * (5 + numOutputClasses) + 1)])
+        = (activateGPU<DecodeType>(toFloat(bbox[numGridCells * 1]))
           * alpha + beta + y_id) * netHeight / gridSizeY;
 
-    float w
-        = __expf(input[bbindex + numGridCells * (z_id * (5 + numOutputClasses) + 2)])
-          * anchors[mask[z_id] * 2];
-
-    float h
-        = __expf(input[bbindex + numGridCells * (z_id * (5 + numOutputClasses) + 3)])
-          * anchors[mask[z_id] * 2 + 1];
+    float w;
+    float h;
+    if (DecodeType == kYOLO_NC_DECODE || DecodeType == kYOLO_R_DECODE)
+    {
+        w = __powf(activateGPU<DecodeType>(toFloat(bbox[numGridCells * 2])) * 2, 2) * info.anchors[z_id * 2];
+        h = __powf(activateGPU<DecodeType>(toFloat(bbox[numGridCells * 3])) * 2, 2) * info.anchors[z_id * 2 + 1];
+    }
+    else
+    {
+        w = __expf(toFloat(bbox[numGridCells * 2])) * info.anchors[z_id * 2];
+        h = __expf(toFloat(bbox[numGridCells * 3])) * info.anchors[z_id * 2 + 1];
+    }
 
     float maxProb = 0.0f;
     int maxIndex = -1;
 
-    for (uint i = 0; i < numOutputClasses; ++i)
+    if (DecodeType == kREGION_DECODE)
     {
-        float prob
-            = sigmoidGPU(input[bbindex + numGridCells * (z_id * (5 + numOutputClasses) + (5 + i))]);
-
-        if (prob > maxProb)
+        // Softmax over the classes, only the winning probability is needed: exp(max - max) / sum
+        float largest = -INFINITY;
+        for (uint i = 0; i < numOutputClasses; ++i)
         {
-            maxProb = prob;
-            maxIndex = i;
+            float val = toFloat(bbox[numGridCells * (5 + i)]);
+            if (val > largest)
+            {
+                largest = val;
+                maxIndex = i;
+            }
+        }
+        float sum = 0;
+        for (uint i = 0; i < numOutputClasses; ++i)
+        {
+            sum += __expf(toFloat(bbox[numGridCells * (5 + i)]) - largest);
+        }
+        maxProb = 1.0f / sum;
+    }
+    else
+    {
+        for (uint i = 0; i < numOutputClasses; ++i)
+        {
+            float prob = activateGPU<DecodeType>(toFloat(bbox[numGridCells * (5 + i)]));
+
+            if (prob > maxProb)
+            {
+                maxProb = prob;
+                maxIndex = i;
+            }
         }
     }
 
@@ -74,32 +208,59 @@ __global__ void gpuYoloLayer(
 }
 
 cudaError_t cudaYoloLayer(
-    const void* input, void* d_indexes, void* d_scores, void* d_boxes, void* d_classes, void* countData,
-    const uint& batchSize, uint64_t& inputSize, uint64_t& outputSize, const float& scoreThreshold, const uint& netWidth,
-    const uint& netHeight, const uint& gridSizeX, const uint& gridSizeY, const uint& numOutputClasses, const uint& numBBoxes,
-    const float& scaleXY, const void* anchors, const void* mask, cudaStream_t stream);
-
-cudaError_t cudaYoloLayer(
-    const void* input, void* d_indexes, void* d_scores, void* d_boxes, void* d_classes, void* countData,
-    const uint& batchSize, uint64_t& inputSize, uint64_t& outputSize, const float& scoreThreshold, const uint& netWidth,
-    const uint& netHeight, const uint& gridSizeX, const uint& gridSizeY, const uint& numOutputClasses, const uint& numBBoxes,
-    const float& scaleXY, const void* anchors, const void* mask, cudaStream_t stream)
+    const YoloInputs& inputs, void* d_indexes, void* d_scores, void* d_boxes, void* d_classes, void* countData,
+    const int& headsSlot, const uint& totalCells, const uint& decodeType, const bool& halfInputs, const uint& batchSize,
+    uint64_t& outputSize, const float& scoreThreshold, const uint& netWidth, const uint& netHeight, const uint& numOutputClasses,
+    cudaStream_t stream)
 {
-    dim3 threads_per_block(16, 16, 4);
-    dim3 number_of_blocks((gridSizeX / threads_per_block.x) + 1,
-                          (gridSizeY / threads_per_block.y) + 1,
-                          (numBBoxes / threads_per_block.z) + 1);
+    int threads_per_block = 128;
+    dim3 number_of_blocks((totalCells + threads_per_block - 1) / threads_per_block, batchSize);
+
+    // Threshold of the raw objectness: sigmoid(x) >= t <=> x >= log(t / (1 - t)), new_coords is already activated
+    float objLogitThreshold;
+    if (decodeType == kYOLO_NC_DECODE)
+        objLogitThreshold = scoreThreshold;
+    else if (scoreThreshold <= 0.0f)
+        objLogitThreshold = -INFINITY;
+    else if (scoreThreshold >= 1.0f)
+        objLogitThreshold = INFINITY;
+    else
+        objLogitThreshold = logf(scoreThreshold / (1.0f - scoreThreshold));
+
+    int slot = headsSlot % kMAX_YOLO_HEADS_SLOTS;
+
+#define LAUNCH_YOLO_LAYER(type)                                                                                      \
+    if (halfInputs)                                                                                                  \
+        LAUNCH_YOLO_LAYER_T(type, __half);                                                                           \
+    else                                                                                                             \
+        LAUNCH_YOLO_LAYER_T(type, float)
 
-    for (unsigned int batch = 0; batch < batchSize; ++batch)
+#define LAUNCH_YOLO_LAYER_T(type, T)                                                                                 \
+    gpuYoloLayer<type, T><<<number_of_blocks, threads_per_block, 0, stream>>>(                                       \
+        inputs, reinterpret_cast<int*>(d_indexes), reinterpret_cast<float*>(d_scores),                               \
+        reinterpret_cast<float*>(d_boxes), reinterpret_cast<int*>(d_classes), reinterpret_cast<int*>(countData),     \
+        slot, totalCells, scoreThreshold, objLogitThreshold, netWidth, netHeight, numOutputClasses, outputSize)
+
+    switch (decodeType)
     {
-        gpuYoloLayer<<<number_of_blocks, threads_per_block, 0, stream>>>(
-            reinterpret_cast<const float*>(input) + (batch * inputSize),
-            reinterpret_cast<int*>(d_indexes) + (batch * outputSize),
-            reinterpret_cast<float*>(d_scores) + (batch * outputSize),
-            reinterpret_cast<float*>(d_boxes) + (batch * 4 * outputSize),
-            reinterpret_cast<int*>(d_classes) + (batch * outputSize), reinterpret_cast<int*>(countData) + (batch),
-            scoreThreshold, netWidth, netHeight, gridSizeX, gridSizeY, numOutputClasses, numBBoxes, scaleXY,
-            reinterpret_cast<const float*>(anchors), reinterpret_cast<const int*>(mask));
+    case kREGION_DECODE:
+        LAUNCH_YOLO_LAYER(kREGION_DECODE);
+        break;
+    case kYOLO_DECODE:
+        LAUNCH_YOLO_LAYER(kYOLO_DECODE);
+        break;
+    case kYOLO_NC_DECODE:
+        LAUNCH_YOLO_LAYER(kYOLO_NC_DECODE);
+        break;
+    case kYOLO_R_DECODE:
+        LAUNCH_YOLO_LAYER(kYOLO_R_DECODE);
+        break;
+    default:
+        return cudaErrorInvalidValue;
     }
+
+#undef LAUNCH_YOLO_LAYER
+#undef LAUNCH_YOLO_LAYER_T
+
     return cudaGetLastError();
 }
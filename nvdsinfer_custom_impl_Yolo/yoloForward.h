@@ -0,0 +1,58 @@
+/*
+ * Created by Marcos Luciano
+ * https://www.github.com/marcoslucianops
+ */
+
+#ifndef __YOLO_FORWARD_H__
+#define __YOLO_FORWARD_H__
+
+#include <stdint.h>
+#include <cuda_runtime_api.h>
+
+#define kMAX_YOLO_HEADS 8
+#define kMAX_YOLO_BBOXES 16
+
+enum YoloDecodeType
+{
+    kREGION_DECODE = 0,
+    kYOLO_DECODE = 1,
+    kYOLO_NC_DECODE = 2,
+    kYOLO_R_DECODE = 3
+};
+
+// Static description of one yolo/region head, kept in constant memory for the lifetime of the plugin
+struct YoloHeadInfo
+{
+    uint gridSizeX;
+    uint gridSizeY;
+    uint numBBoxes;
+    uint cellOffset;
+    uint64_t inputSize;
+    float scaleXY;
+    float anchors[kMAX_YOLO_BBOXES * 2];
+};
+
+struct YoloHeadsInfo
+{
+    uint numHeads;
+    uint totalCells;
+    YoloHeadInfo heads[kMAX_YOLO_HEADS];
+};
+
+struct YoloInputs
+{
+    const void* data[kMAX_YOLO_HEADS];
+};
+
+int acquireYoloHeadsSlot(const YoloHeadsInfo& headsInfo);
+
+void releaseYoloHeadsSlot(int slot);
+
+cudaError_t cudaYoloLayer(
+    const YoloInputs& inputs, void* d_indexes, void* d_scores, void* d_boxes, void* d_classes, void* countData,
+    const int& headsSlot, const uint& totalCells, const uint& decodeType, const bool& halfInputs, const uint& batchSize,
+    uint64_t& outputSize,
+    const float& scoreThreshold, const uint& netWidth, const uint& netHeight, const uint& numOutputClasses,
+    cudaStream_t stream);
+
+#endif
@@ -0,0 +1,27 @@
+/*
+ * Created by Marcos Luciano
+ * https://www.github.com/marcoslucianops
+ */
+
+#ifndef __YOLO_KERNEL_STATS_H__
+#define __YOLO_KERNEL_STATS_H__
+
+#include <stdint.h>
+
+// Set to 1 before the engine is deserialized to time the YoloLayer kernels with CUDA events
+#define YOLO_PLUGIN_PROFILE_ENV "YOLO_PLUGIN_PROFILE"
+
+// Cumulative over every YoloLayer instance of the process, plain C so the app can dlsym it
+typedef struct
+{
+    uint64_t enqueues;
+    uint64_t decodeNs;
+    uint64_t sortNs;
+    uint64_t nmsNs;
+} NvDsInferYoloKernelStats;
+
+typedef void (*NvDsInferYoloGetKernelStatsFunc)(NvDsInferYoloKernelStats* stats);
+
+#define YOLO_KERNEL_STATS_FUNC_NAME "NvDsInferYoloGetKernelStats"
+
+#endif
@@ -0,0 +1,347 @@
+/*
+ * Created by Marcos Luciano
+ * https://www.github.com/marcoslucianops
+ */
+
+#include "yoloNetwork.h"
+#include "utils.h"
+
+#include <sstream>
+
+namespace {
+    typedef std::map<std::string, std::string> Block;
+
+    bool fail(const Block& block, const uint& cfgIndex, const std::string& msg)
+    {
+        auto type = block.find("type");
+        std::cerr << "YOLO cfg block " << cfgIndex << " [" << (type != block.end() ? type->second : "?") << "]: "
+                  << msg << std::endl;
+        return false;
+    }
+
+    bool readInt(const Block& block, const uint& cfgIndex, const std::string& key, int& value, bool required = true)
+    {
+        auto it = block.find(key);
+        if (it == block.end())
+            return required ? fail(block, cfgIndex, "missing '" + key + "'") : true;
+        try
+        {
+            size_t end;
+            value = std::stoi(it->second, &end);
+            if (end == it->second.size())
+                return true;
+        }
+        catch (const std::exception&) {}
+        return fail(block, cfgIndex, "'" + key + "' is not an integer: " + it->second);
+    }
+
+    template <typename T>
+    bool readList(const Block& block, const uint& cfgIndex, const std::string& key, std::vector<T>& values)
+    {
+        std::stringstream s(block.at(key));
+        std::string item;
+        while (std::getline(s, item, ','))
+        {
+            item = trim(item);
+            if (item.empty())
+                continue;
+            try
+            {
+                values.push_back(static_cast<T>(std::stod(item)));
+            }
+            catch (const std::exception&)
+            {
+                return fail(block, cfgIndex, "bad value in '" + key + "': " + item);
+            }
+        }
+        return !values.empty() || fail(block, cfgIndex, "'" + key + "' is empty");
+    }
+
+    bool readActivation(const Block& block, const uint& cfgIndex, ActivationType& activation)
+    {
+        static const std::map<std::string, ActivationType> names {
+            {"linear", ActivationType::kLinear},
+            {"relu", ActivationType::kRelu},
+            {"sigmoid", ActivationType::kSigmoid},
+            {"logistic", ActivationType::kSigmoid},
+            {"tanh", ActivationType::kTanh},
+            {"leaky", ActivationType::kLeaky},
+            {"softplus", ActivationType::kSoftplus},
+            {"mish", ActivationType::kMish},
+            {"silu", ActivationType::kSilu},
+            {"swish", ActivationType::kSilu}};
+
+        auto it = block.find("activation");
+        if (it == block.end())
+            return fail(block, cfgIndex, "missing 'activation'");
+        auto name = names.find(it->second);
+        if (name == names.end())
+            return fail(block, cfgIndex, "activation not supported: " + it->second);
+        activation = name->second;
+        return true;
+    }
+
+    // from is relative when negative, absolute otherwise. The other operand is the previous layer, so the source has
+    // to be an earlier one
+    bool readFrom(const Block& block, const uint& cfgIndex, const int& layerIdx, std::vector<int>& inputs)
+    {
+        int from;
+        if (!readInt(block, cfgIndex, "from", from))
+            return false;
+        int source = from < 0 ? layerIdx + from : from;
+        if (source < 0 || source >= layerIdx - 1)
+            return fail(block, cfgIndex, "'from' out of range: " + block.at("from"));
+        inputs = {layerIdx - 1, source};
+        return true;
+    }
+
+    bool compileLayer(const Block& block, const uint& cfgIndex, const int& layerIdx, NetworkDesc& desc)
+    {
+        const std::string& type = block.at("type");
+        LayerDesc layer;
+        layer.cfgIndex = cfgIndex;
+        layer.inputs = {layerIdx - 1};
+
+        if (type == "convolutional")
+        {
+            layer.type = LayerType::kConvolutional;
+            int pad, batchNormalize = 0;
+            if (!readInt(block, cfgIndex, "filters", layer.filters) || !readInt(block, cfgIndex, "size", layer.size)
+                || !readInt(block, cfgIndex, "stride", layer.stride) || !readInt(block, cfgIndex, "pad", pad)
+                || !readInt(block, cfgIndex, "groups", layer.groups, false)
+                || !readInt(block, cfgIndex, "batch_normalize", batchNormalize, false)
+                || !readActivation(block, cfgIndex, layer.activation))
+                return false;
+            layer.pad = pad != 0;
+            layer.batchNormalize = batchNormalize == 1;
+            if (layer.filters <= 0 || layer.size <= 0 || layer.stride <= 0 || layer.groups <= 0
+                || layer.filters % layer.groups != 0)
+                return fail(block, cfgIndex, "bad filters, size, stride or groups");
+        }
+        else if (type == "implicit_add" || type == "implicit_mul")
+        {
+            layer.type = type == "implicit_add" ? LayerType::kImplicitAdd : LayerType::kImplicitMul;
+            layer.inputs.clear();
+            if (!readInt(block, cfgIndex, "filters", layer.filters))
+                return false;
+            if (layer.filters <= 0)
+                return fail(block, cfgIndex, "bad filters");
+        }
+        else if (type == "shift_channels" || type == "control_channels")
+        {
+            layer.type = type == "shift_channels" ? LayerType::kShiftChannels : LayerType::kControlChannels;
+            if (!readFrom(block, cfgIndex, layerIdx, layer.inputs))
+                return false;
+        }
+        else if (type == "dropout")
+        {
+            layer.type = LayerType::kDropout;
+        }
+        else if (type == "shortcut")
+        {
+            layer.type = LayerType::kShortcut;
+            if (!readActivation(block, cfgIndex, layer.activation)
+                || !readFrom(block, cfgIndex, layerIdx, layer.inputs))
+                return false;
+        }
+        else if (type == "route")
+        {
+            layer.type = LayerType::kRoute;
+            layer.inputs.clear();
+            if (block.find("layers") == block.end())
+                return fail(block, cfgIndex, "missing 'layers'");
+            if (!readList(block, cfgIndex, "layers", layer.inputs))
+                return false;
+            for (int& input : layer.inputs)
+            {
+                if (input < 0)
+                    input += layerIdx;
+                if (input < 0 || input >= layerIdx)
+                    return fail(block, cfgIndex, "'layers' out of range: " + block.at("layers"));
+            }
+            if (block.find("groups") != block.end())
+            {
+                if (!readInt(block, cfgIndex, "groups", layer.groups)
+                    || !readInt(block, cfgIndex, "group_id", layer.groupId))
+                    return false;
+                if (layer.groups <= 0 || layer.groupId < 0 || layer.groupId >= layer.groups)
+                    return fail(block, cfgIndex, "bad groups or group_id");
+            }
+        }
+        else if (type == "upsample")
+        {
+            layer.type = LayerType::kUpsample;
+            if (!readInt(block, cfgIndex, "stride", layer.stride))
+                return false;
+            if (layer.stride <= 0)
+                return fail(block, cfgIndex, "bad stride");
+        }
+        else if (type == "maxpool")
+        {
+            layer.type = LayerType::kMaxpool;
+            if (!readInt(block, cfgIndex, "size", layer.size) || !readInt(block, cfgIndex, "stride", layer.stride))
+                return false;
+            if (layer.size <= 0 || layer.stride <= 0)
+                return fail(block, cfgIndex, "bad size or stride");
+        }
+        else if (type == "reorg")
+        {
+            layer.type = LayerType::kReorg;
+            layer.stride = 2;
+        }
+        else if (type == "yolo" || type == "region")
+        {
+            layer.type = type == "yolo" ? LayerType::kYolo : LayerType::kRegion;
+            int num, classes, newCoords = 0;
+            if (!readInt(block, cfgIndex, "num", num) || !readInt(block, cfgIndex, "classes", classes)
+                || !readInt(block, cfgIndex, "new_coords", newCoords, false))
+                return false;
+            if (block.find("anchors") == block.end())
+                return fail(block, cfgIndex, "missing 'anchors'");
+            if (!readList(block, cfgIndex, "anchors", layer.anchors))
+                return false;
+            if (block.find("mask") != block.end() && !readList(block, cfgIndex, "mask", layer.mask))
+                return false;
+            if (block.find("scale_x_y") != block.end())
+            {
+                try
+                {
+                    layer.scaleXY = std::stof(block.at("scale_x_y"));
+                }
+                catch (const std::exception&)
+                {
+                    return fail(block, cfgIndex, "'scale_x_y' is not a number: " + block.at("scale_x_y"));
+                }
+            }
+
+            if (classes <= 0 || num <= 0 || layer.anchors.size() % 2 != 0)
+                return fail(block, cfgIndex, "bad num, classes or anchors");
+            for (int mask : layer.mask)
+            {
+                if (mask < 0 || 2 * static_cast<size_t>(mask) >= layer.anchors.size())
+                    return fail(block, cfgIndex, "mask " + std::to_string(mask) + " has no anchor");
+            }
+            if (desc.numClasses != 0 && desc.numClasses != static_cast<uint>(classes))
+                return fail(block, cfgIndex, "classes differs from the previous head");
+
+            layer.numBBoxes = layer.mask.size() > 0 ? layer.mask.size() : num;
+            desc.numClasses = classes;
+            desc.newCoords = newCoords;
+        }
+        else
+            return fail(block, cfgIndex, "unsupported layer type");
+
+        desc.layers.push_back(std::move(layer));
+        return true;
+    }
+}
+
+bool compileNetwork(const std::vector<std::map<std::string, std::string>>& blocks, NetworkDesc& desc)
+{
+    desc = NetworkDesc();
+
+    for (uint i = 0; i < blocks.size(); ++i)
+    {
+        if (blocks[i].find("type") == blocks[i].end())
+            return fail(blocks[i], i, "keys before the first [section]");
+    }
+    if (blocks.empty() || blocks[0].at("type") != "net")
+    {
+        std::cerr << "YOLO cfg has to start with a [net] block" << std::endl;
+        return false;
+    }
+
+    int height, width, channels, letterBox = 0;
+    if (!readInt(blocks[0], 0, "height", height) || !readInt(blocks[0], 0, "width", width)
+        || !readInt(blocks[0], 0, "channels", channels) || !readInt(blocks[0], 0, "letter_box", letterBox, false))
+        return false;
+    if (height <= 0 || width <= 0 || channels <= 0)
+        return fail(blocks[0], 0, "bad height, width or channels");
+    desc.inputH = height;
+    desc.inputW = width;
+    desc.inputC = channels;
+    desc.letterBox = letterBox;
+
+    for (uint i = 1; i < blocks.size(); ++i)
+    {
+        if (!compileLayer(blocks[i], i, desc.layers.size(), desc))
+            return false;
+    }
+
+    for (const LayerDesc& layer : desc.layers)
+    {
+        if (layer.type == LayerType::kYolo || layer.type == LayerType::kRegion)
+            return true;
+    }
+    std::cerr << "YOLO cfg has no [yolo] or [region] block" << std::endl;
+    return false;
+}
+
+uint removeIdentityLayers(NetworkDesc& desc)
+{
+    // Old index -> index of the layer that now produces its output
+    std::vector<int> remap(desc.layers.size());
+    std::vector<LayerDesc> kept;
+    kept.reserve(desc.layers.size());
+
+    for (size_t i = 0; i < desc.layers.size(); ++i)
+    {
+        LayerDesc& layer = desc.layers[i];
+        for (int& input : layer.inputs)
+        {
+            if (input >= 0)
+                input = remap[input];
+        }
+
+        bool identity = layer.type == LayerType::kDropout
+            || (layer.type == LayerType::kRoute && layer.inputs.size() == 1 && layer.groups == 1);
+        if (identity)
+        {
+            remap[i] = layer.inputs[0];
+            continue;
+        }
+        remap[i] = kept.size();
+        kept.push_back(std::move(layer));
+    }
+
+    uint removed = desc.layers.size() - kept.size();
+    desc.layers = std::move(kept);
+    return removed;
+}
+
+std::string layerTypeName(const LayerType& type)
+{
+    switch (type)
+    {
+        case LayerType::kConvolutional: return "conv";
+        case LayerType::kImplicitAdd: return "implicit_add";
+        case LayerType::kImplicitMul: return "implicit_mul";
+        case LayerType::kShiftChannels: return "shift_channels";
+        case LayerType::kControlChannels: return "control_channels";
+        case LayerType::kDropout: return "dropout";
+        case LayerType::kShortcut: return "shortcut";
+        case LayerType::kRoute: return "route";
+        case LayerType::kUpsample: return "upsample";
+        case LayerType::kMaxpool: return "maxpool";
+        case LayerType::kReorg: return "reorg";
+        case LayerType::kYolo: return "yolo";
+        case LayerType::kRegion: return "region";
+    }
+    return "?";
+}
+
+std::string activationName(const ActivationType& activation)
+{
+    switch (activation)
+    {
+        case ActivationType::kLinear: return "linear";
+        case ActivationType::kRelu: return "relu";
+        case ActivationType::kSigmoid: return "logistic";
+        case ActivationType::kTanh: return "tanh";
+        case ActivationType::kLeaky: return "leaky";
+        case ActivationType::kSoftplus: return "softplus";
+        case ActivationType::kMish: return "mish";
+        case ActivationType::kSilu: return "silu";
+    }
+    return "?";
+}
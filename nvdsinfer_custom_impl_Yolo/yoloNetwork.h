@@ -0,0 +1,92 @@
+/*
+ * Created by Marcos Luciano
+ * https://www.github.com/marcoslucianops
+ */
+
+#ifndef __YOLO_NETWORK_H__
+#define __YOLO_NETWORK_H__
+
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+enum class LayerType
+{
+    kConvolutional,
+    kImplicitAdd,
+    kImplicitMul,
+    kShiftChannels,
+    kControlChannels,
+    kDropout,
+    kShortcut,
+    kRoute,
+    kUpsample,
+    kMaxpool,
+    kReorg,
+    kYolo,
+    kRegion
+};
+
+enum class ActivationType
+{
+    kLinear,
+    kRelu,
+    kSigmoid,
+    kTanh,
+    kLeaky,
+    kSoftplus,
+    kMish,
+    kSilu
+};
+
+// One cfg block with every field it uses parsed and checked. inputs are absolute layer indices (the [net] block is
+// not a layer), -1 is the network input
+struct LayerDesc
+{
+    LayerType type;
+    int cfgIndex {0};
+    std::vector<int> inputs;
+    ActivationType activation {ActivationType::kLinear};
+
+    // convolutional, implicit, maxpool, upsample
+    int filters {0};
+    int size {0};
+    int stride {1};
+    bool pad {false};
+    bool batchNormalize {false};
+
+    // convolutional, route
+    int groups {1};
+    int groupId {0};
+
+    // yolo, region
+    std::vector<float> anchors;
+    std::vector<int> mask;
+    uint numBBoxes {0};
+    float scaleXY {1.0};
+};
+
+struct NetworkDesc
+{
+    uint inputH {0};
+    uint inputW {0};
+    uint inputC {0};
+    uint letterBox {0};
+    uint numClasses {0};
+    uint newCoords {0};
+    std::vector<LayerDesc> layers;
+};
+
+// Turns the parsed cfg blocks into layer descriptors, reporting the first bad block instead of asserting mid build
+bool compileNetwork(const std::vector<std::map<std::string, std::string>>& blocks, NetworkDesc& desc);
+
+// Drops layers that only forward their input (dropout, single input route without groups) and points the layers
+// reading them at the source, returns how many were removed
+uint removeIdentityLayers(NetworkDesc& desc);
+
+std::string layerTypeName(const LayerType& type);
+
+std::string activationName(const ActivationType& activation);
+
+#endif
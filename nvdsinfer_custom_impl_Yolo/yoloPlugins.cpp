@@ -25,7 +25,9 @@
 
 #include "yoloPlugins.h"
 #include "NvInferPlugin.h"
+#include <atomic>
 #include <cassert>
+#include <cstdlib>
 #include <iostream>
 #include <memory>
 
@@ -45,35 +47,59 @@ namespace {
         val = *reinterpret_cast<const T*>(buffer);
         buffer += sizeof(T);
     }
+
+    // Carves the next 256-byte aligned chunk out of the plugin workspace
+    template <typename T>
+    void carve(char*& ptr, size_t& offset, T*& out, size_t count)
+    {
+        out = ptr ? reinterpret_cast<T*>(ptr + offset) : nullptr;
+        offset += (sizeof(T) * count + 255) & ~static_cast<size_t>(255);
+    }
+
+    struct KernelStats
+    {
+        std::atomic<uint64_t> enqueues {0};
+        std::atomic<uint64_t> decodeNs {0};
+        std::atomic<uint64_t> sortNs {0};
+        std::atomic<uint64_t> nmsNs {0};
+    } kernelStats;
+
+    uint64_t elapsedNs(cudaEvent_t start, cudaEvent_t end)
+    {
+        float ms = 0;
+        if (cudaEventElapsedTime(&ms, start, end) != cudaSuccess)
+            return 0;
+        return static_cast<uint64_t>(ms * 1e6);
+    }
+}
+
+extern "C" void NvDsInferYoloGetKernelStats(NvDsInferYoloKernelStats* stats);
+
+extern "C" void NvDsInferYoloGetKernelStats(NvDsInferYoloKernelStats* stats)
+{
+    stats->enqueues = kernelStats.enqueues.load(std::memory_order_relaxed);
+    stats->decodeNs = kernelStats.decodeNs.load(std::memory_order_relaxed);
+    stats->sortNs = kernelStats.sortNs.load(std::memory_order_relaxed);
+    stats->nmsNs = kernelStats.nmsNs.load(std::memory_order_relaxed);
 }
 
-cudaError_t cudaYoloLayer_r(
-    const void* input, void* d_indexes, void* d_scores, void* d_boxes, void* d_classes, void* countData,
-    const uint& batchSize, uint64_t& inputSize, uint64_t& outputSize, const float& scoreThreshold, const uint& netWidth,
-    const uint& netHeight, const uint& gridSizeX, const uint& gridSizeY, const uint& numOutputClasses, const uint& numBBoxes,
-    const float& scaleXY, const void* anchors, const void* mask, cudaStream_t stream);
-
-cudaError_t cudaYoloLayer_nc(
-    const void* input, void* d_indexes, void* d_scores, void* d_boxes, void* d_classes, void* countData,
-    const uint& batchSize, uint64_t& inputSize, uint64_t& outputSize, const float& scoreThreshold, const uint& netWidth,
-    const uint& netHeight, const uint& gridSizeX, const uint& gridSizeY, const uint& numOutputClasses, const uint& numBBoxes,
-    const float& scaleXY, const void* anchors, const void* mask, cudaStream_t stream);
-
-cudaError_t cudaYoloLayer(
-    const void* input, void* d_indexes, void* d_scores, void* d_boxes, void* d_classes, void* countData,
-    const uint& batchSize, uint64_t& inputSize, uint64_t& outputSize, const float& scoreThreshold, const uint& netWidth,
-    const uint& netHeight, const uint& gridSizeX, const uint& gridSizeY, const uint& numOutputClasses, const uint& numBBoxes,
-    const float& scaleXY, const void* anchors, const void* mask, cudaStream_t stream);
-
-cudaError_t cudaRegionLayer(
-    const void* input, void* softmax, void* d_indexes, void* d_scores, void* d_boxes, void* d_classes, void* countData,
-    const uint& batchSize, uint64_t& inputSize, uint64_t& outputSize, const float& scoreThreshold, const uint& netWidth,
-    const uint& netHeight, const uint& gridSizeX, const uint& gridSizeY, const uint& numOutputClasses, const uint& numBBoxes,
-    const void* anchors, cudaStream_t stream);
+size_t sortDetectionsWorkspaceSize(const uint& batchSize, const uint64_t& outputSize);
 
 cudaError_t sortDetections(
-    void* d_indexes, void* d_scores, void* d_boxes, void* d_classes, void* bboxData, void* scoreData, void* countData,
-    const uint& batchSize, uint64_t& outputSize, uint& topK, const uint& numOutputClasses, cudaStream_t stream);
+    void* d_indexes, void* d_scores, void* d_boxes, void* d_classes, void* countData, void* sortedBoxes,
+    void* sortedScores, void* sortedClasses, void* workspace, const uint& batchSize, uint64_t& outputSize, uint& topK,
+    cudaStream_t stream);
+
+size_t nmsDetectionsWorkspaceSize(const uint& batchSize, const uint& topK);
+
+cudaError_t nmsDetections(
+    const void* sortedBoxes, const void* sortedScores, const void* sortedClasses, const void* countData,
+    void* numDetections, void* nmsedBoxes, void* nmsedScores, void* nmsedClasses, void* workspace,
+    const uint& batchSize, const uint& topK, const float& iouThreshold, cudaStream_t stream);
+
+cudaError_t cudaActivation(
+    const void* input, void* output, const uint64_t& count, const ActivationType& activation, const bool& half,
+    cudaStream_t stream);
 
 YoloLayer::YoloLayer (const void* data, size_t length)
 {
@@ -87,6 +113,7 @@ YoloLayer::YoloLayer (const void* data, size_t length)
     read(d, m_Type);
     read(d, m_TopK);
     read(d, m_ScoreThreshold);
+    read(d, m_IouThreshold);
 
     uint yoloTensorsSize;
     read(d, yoloTensorsSize);
@@ -124,7 +151,7 @@ YoloLayer::YoloLayer (const void* data, size_t length)
 YoloLayer::YoloLayer(
     const uint& netWidth, const uint& netHeight, const uint& numClasses, const uint& newCoords,
     const std::vector<TensorInfo>& yoloTensors, const uint64_t& outputSize, const uint& modelType, const uint& topK,
-    const float& scoreThreshold) :
+    const float& scoreThreshold, const float& iouThreshold) :
     m_NetWidth(netWidth),
     m_NetHeight(netHeight),
     m_NumClasses(numClasses),
@@ -133,7 +160,8 @@ YoloLayer::YoloLayer(
     m_OutputSize(outputSize),
     m_Type(modelType),
     m_TopK(topK),
-    m_ScoreThreshold(scoreThreshold)
+    m_ScoreThreshold(scoreThreshold),
+    m_IouThreshold(iouThreshold)
 {
     assert(m_NetWidth > 0);
     assert(m_NetHeight > 0);
@@ -141,138 +169,246 @@ YoloLayer::YoloLayer(
     kNUM_CLASSES = m_NumClasses;
 };
 
-nvinfer1::Dims
+nvinfer1::DimsExprs
 YoloLayer::getOutputDimensions(
-    int index, const nvinfer1::Dims* inputs, int nbInputDims) noexcept
+    int index, const nvinfer1::DimsExprs* inputs, int nbInputDims, nvinfer1::IExprBuilder& exprBuilder) noexcept
 {
-    assert(index < 3);
+    assert(index < 4);
+    nvinfer1::DimsExprs outputDims;
+    outputDims.d[0] = inputs[0].d[0];
     if (index == 0) {
-        return nvinfer1::Dims3(m_TopK, 1, 4);
+        outputDims.nbDims = 2;
+        outputDims.d[1] = exprBuilder.constant(1);
+    }
+    else if (index == 1) {
+        outputDims.nbDims = 3;
+        outputDims.d[1] = exprBuilder.constant(m_TopK);
+        outputDims.d[2] = exprBuilder.constant(4);
+    }
+    else {
+        outputDims.nbDims = 2;
+        outputDims.d[1] = exprBuilder.constant(m_TopK);
     }
-    return nvinfer1::DimsHW(m_TopK, m_NumClasses);
+    return outputDims;
 }
 
-bool YoloLayer::supportsFormat (
-    nvinfer1::DataType type, nvinfer1::PluginFormat format) const noexcept {
-    return (type == nvinfer1::DataType::kFLOAT &&
-            format == nvinfer1::PluginFormat::kLINEAR);
+nvinfer1::DataType YoloLayer::getOutputDataType (
+    int index, const nvinfer1::DataType* inputTypes, int nbInputs) const noexcept
+{
+    return index == 0 ? nvinfer1::DataType::kINT32 : nvinfer1::DataType::kFLOAT;
+}
+
+bool YoloLayer::supportsFormatCombination (
+    int pos, const nvinfer1::PluginTensorDesc* inOut, int nbInputs, int nbOutputs) noexcept
+{
+    if (inOut[pos].format != nvinfer1::TensorFormat::kLINEAR)
+        return false;
+
+    // The heads are decoded in FP32 or FP16, all of them in the same precision
+    if (pos < nbInputs) {
+        if (inOut[pos].type != nvinfer1::DataType::kFLOAT && inOut[pos].type != nvinfer1::DataType::kHALF)
+            return false;
+        return pos == 0 || inOut[pos].type == inOut[0].type;
+    }
+
+    if (pos == nbInputs)
+        return inOut[pos].type == nvinfer1::DataType::kINT32;
+    return inOut[pos].type == nvinfer1::DataType::kFLOAT;
 }
 
 void
-YoloLayer::configureWithFormat (
-    const nvinfer1::Dims* inputDims, int nbInputs,
-    const nvinfer1::Dims* outputDims, int nbOutputs,
-    nvinfer1::DataType type, nvinfer1::PluginFormat format, int maxBatchSize) noexcept
+YoloLayer::configurePlugin (
+    const nvinfer1::DynamicPluginTensorDesc* in, int nbInputs, const nvinfer1::DynamicPluginTensorDesc* out,
+    int nbOutputs) noexcept
 {
-    assert(nbInputs > 0);
-    assert(format == nvinfer1::PluginFormat::kLINEAR);
-    assert(inputDims != nullptr);
+    assert(nbInputs == static_cast<int>(m_YoloTensors.size()));
+    assert(nbOutputs == 4);
+    assert(in != nullptr);
 }
 
-int32_t YoloLayer::enqueue (
-    int batchSize, void const* const* inputs, void* const* outputs, void* workspace,	
-    cudaStream_t stream) noexcept
+int YoloLayer::initialize () noexcept
 {
-    void* countData = workspace;
-    void* bboxData = outputs[0];
-    void* scoreData = outputs[1];
+    if (m_YoloTensors.size() > kMAX_YOLO_HEADS) {
+        std::cerr << "YoloLayer supports up to " << kMAX_YOLO_HEADS << " heads, got " << m_YoloTensors.size()
+                  << std::endl;
+        return -1;
+    }
 
-    CUDA_CHECK(cudaMemsetAsync((int*)countData, 0, sizeof(int) * batchSize, stream));
-    CUDA_CHECK(cudaMemsetAsync((float*)bboxData, 0, sizeof(float) * m_TopK * 4 * batchSize, stream));
-    CUDA_CHECK(cudaMemsetAsync((float*)scoreData, 0, sizeof(float) * m_TopK * m_NumClasses * batchSize, stream));
+    YoloHeadsInfo headsInfo;
+    std::memset(&headsInfo, 0, sizeof(headsInfo));
+    headsInfo.numHeads = m_YoloTensors.size();
 
-    void* d_indexes;
-    CUDA_CHECK(cudaMallocHost(&d_indexes, sizeof(int) * m_OutputSize * batchSize));
-    CUDA_CHECK(cudaMemsetAsync((float*)d_indexes, 0, sizeof(int) * m_OutputSize * batchSize, stream));
+    for (uint i = 0; i < m_YoloTensors.size(); ++i)
+    {
+        const TensorInfo& curYoloTensor = m_YoloTensors.at(i);
+        YoloHeadInfo& head = headsInfo.heads[i];
 
-    void* d_scores;
-    CUDA_CHECK(cudaMallocHost(&d_scores, sizeof(float) * m_OutputSize * batchSize));
-    CUDA_CHECK(cudaMemsetAsync((float*)d_scores, 0, sizeof(float) * m_OutputSize * batchSize, stream));
+        if (curYoloTensor.numBBoxes > kMAX_YOLO_BBOXES) {
+            std::cerr << "YoloLayer supports up to " << kMAX_YOLO_BBOXES << " bboxes per head, got "
+                      << curYoloTensor.numBBoxes << std::endl;
+            return -1;
+        }
 
-    void* d_boxes;
-    CUDA_CHECK(cudaMallocHost(&d_boxes, sizeof(float) * m_OutputSize * 4 * batchSize));
-    CUDA_CHECK(cudaMemsetAsync((float*)d_boxes, 0, sizeof(float) * m_OutputSize * 4 * batchSize, stream));
+        head.gridSizeX = curYoloTensor.gridSizeX;
+        head.gridSizeY = curYoloTensor.gridSizeY;
+        head.numBBoxes = curYoloTensor.numBBoxes;
+        head.cellOffset = headsInfo.totalCells;
+        head.inputSize = curYoloTensor.gridSizeX * curYoloTensor.gridSizeY
+            * (curYoloTensor.numBBoxes * (4 + 1 + m_NumClasses));
+
+        if (m_Type == 2)  // YOLOR incorrect param: scale_x_y = 2.0
+            head.scaleXY = 2.0;
+        else if (m_Type == 1)
+            head.scaleXY = curYoloTensor.scaleXY;
+        else
+            head.scaleXY = 1.0;
+
+        // Resolve the mask and, for region heads, the grid scaling here so the kernel reads anchors directly
+        for (uint z = 0; z < curYoloTensor.numBBoxes; ++z)
+        {
+            uint anchorIdx = m_Type != 0 && curYoloTensor.mask.size() > 0 ? curYoloTensor.mask[z] : z;
+            if (anchorIdx * 2 + 1 >= curYoloTensor.anchors.size())
+                continue;
+            float anchorW = curYoloTensor.anchors[anchorIdx * 2];
+            float anchorH = curYoloTensor.anchors[anchorIdx * 2 + 1];
+            if (m_Type == 0) {
+                anchorW *= static_cast<float>(m_NetWidth) / curYoloTensor.gridSizeX;
+                anchorH *= static_cast<float>(m_NetHeight) / curYoloTensor.gridSizeY;
+            }
+            head.anchors[z * 2] = anchorW;
+            head.anchors[z * 2 + 1] = anchorH;
+        }
 
-    void* d_classes;
-    CUDA_CHECK(cudaMallocHost(&d_classes, sizeof(int) * m_OutputSize * batchSize));
-    CUDA_CHECK(cudaMemsetAsync((float*)d_classes, 0, sizeof(int) * m_OutputSize * batchSize, stream));
+        headsInfo.totalCells += curYoloTensor.gridSizeX * curYoloTensor.gridSizeY * curYoloTensor.numBBoxes;
+    }
 
-    uint yoloTensorsSize = m_YoloTensors.size();
-    for (uint i = 0; i < yoloTensorsSize; ++i)
-    {
-        TensorInfo& curYoloTensor = m_YoloTensors.at(i);
-
-        uint numBBoxes = curYoloTensor.numBBoxes;
-        float scaleXY = curYoloTensor.scaleXY;
-        uint gridSizeX = curYoloTensor.gridSizeX;
-        uint gridSizeY = curYoloTensor.gridSizeY;
-        std::vector<float> anchors = curYoloTensor.anchors;
-        std::vector<int> mask = curYoloTensor.mask;
-
-        void* v_anchors;
-        void* v_mask;
-        if (anchors.size() > 0) {
-            float* f_anchors = anchors.data();
-            CUDA_CHECK(cudaMallocHost(&v_anchors, sizeof(float) * anchors.size()));
-            CUDA_CHECK(cudaMemcpy(v_anchors, f_anchors, sizeof(float) * anchors.size(), cudaMemcpyHostToDevice));
-        }
-        if (mask.size() > 0) {
-            int* f_mask = mask.data();
-            CUDA_CHECK(cudaMallocHost(&v_mask, sizeof(int) * mask.size()));
-            CUDA_CHECK(cudaMemcpy(v_mask, f_mask, sizeof(int) * mask.size(), cudaMemcpyHostToDevice));
-        }
+    m_HeadsSlot = acquireYoloHeadsSlot(headsInfo);
+    if (m_HeadsSlot < 0) {
+        std::cerr << "YoloLayer could not get a constant memory slot for its heads" << std::endl;
+        return -1;
+    }
+    m_TotalCells = headsInfo.totalCells;
 
-        uint64_t inputSize = gridSizeX * gridSizeY * (numBBoxes * (4 + 1 + m_NumClasses));
+    const char* profile = std::getenv(YOLO_PLUGIN_PROFILE_ENV);
+    m_Profile = profile && std::atoi(profile) != 0;
+    for (uint i = 0; m_Profile && i < 4; ++i) {
+        if (cudaEventCreate(&m_ProfileEvents[i]) != cudaSuccess)
+            m_Profile = false;
+    }
 
-        if (m_Type == 2) {  // YOLOR incorrect param: scale_x_y = 2.0
-            CUDA_CHECK(cudaYoloLayer_r(
-                inputs[i], d_indexes, d_scores, d_boxes, d_classes, countData, batchSize, inputSize, m_OutputSize,
-                m_ScoreThreshold, m_NetWidth, m_NetHeight, gridSizeX, gridSizeY, m_NumClasses, numBBoxes, 2.0, v_anchors,
-                v_mask, stream));
-        }
-        else if (m_Type == 1) {
-            if (m_NewCoords) {
-                CUDA_CHECK(cudaYoloLayer_nc(
-                    inputs[i], d_indexes, d_scores, d_boxes, d_classes, countData, batchSize, inputSize, m_OutputSize,
-                    m_ScoreThreshold, m_NetWidth, m_NetHeight, gridSizeX, gridSizeY, m_NumClasses, numBBoxes, scaleXY,
-                    v_anchors, v_mask, stream));
-            }
-            else {
-                CUDA_CHECK(cudaYoloLayer(
-                    inputs[i], d_indexes, d_scores, d_boxes, d_classes, countData, batchSize, inputSize, m_OutputSize,
-                    m_ScoreThreshold, m_NetWidth, m_NetHeight, gridSizeX, gridSizeY, m_NumClasses, numBBoxes, scaleXY,
-                    v_anchors, v_mask, stream));
-            }
-        }
-        else {
-            void* softmax;
-            CUDA_CHECK(cudaMallocHost(&softmax, sizeof(float) * inputSize * batchSize));
-            CUDA_CHECK(cudaMemsetAsync((float*)softmax, 0, sizeof(float) * inputSize * batchSize));
+    return 0;
+}
+
+void YoloLayer::terminate () noexcept
+{
+    releaseYoloHeadsSlot(m_HeadsSlot);
+    m_HeadsSlot = -1;
 
-            CUDA_CHECK(cudaRegionLayer(
-                inputs[i], softmax, d_indexes, d_scores, d_boxes, d_classes, countData, batchSize, inputSize, m_OutputSize,
-                m_ScoreThreshold, m_NetWidth, m_NetHeight, gridSizeX, gridSizeY, m_NumClasses, numBBoxes, v_anchors,
-                stream));
+    for (uint i = 0; i < 4; ++i) {
+        if (m_ProfileEvents[i])
+            cudaEventDestroy(m_ProfileEvents[i]);
+        m_ProfileEvents[i] = nullptr;
+    }
+    m_Profile = false;
+    m_ProfilePending = false;
+}
 
-            CUDA_CHECK(cudaFreeHost(softmax));
-        }
+void YoloLayer::collectKernelTimes () noexcept
+{
+    // Still in flight: drop this sample rather than block, enqueue records the events again
+    if (!m_ProfilePending || cudaEventQuery(m_ProfileEvents[3]) != cudaSuccess)
+        return;
+
+    kernelStats.decodeNs.fetch_add(elapsedNs(m_ProfileEvents[0], m_ProfileEvents[1]), std::memory_order_relaxed);
+    kernelStats.sortNs.fetch_add(elapsedNs(m_ProfileEvents[1], m_ProfileEvents[2]), std::memory_order_relaxed);
+    kernelStats.nmsNs.fetch_add(elapsedNs(m_ProfileEvents[2], m_ProfileEvents[3]), std::memory_order_relaxed);
+    kernelStats.enqueues.fetch_add(1, std::memory_order_relaxed);
+    m_ProfilePending = false;
+}
 
-        if (anchors.size() > 0) {
-            CUDA_CHECK(cudaFreeHost(v_anchors));
-        }
-        if (mask.size() > 0) {
-            CUDA_CHECK(cudaFreeHost(v_mask));
-        }
+size_t YoloLayer::getWorkspaceLayout (int batchSize, void* workspace, Workspace* ws) const noexcept
+{
+    Workspace layout;
+    char* ptr = static_cast<char*>(workspace);
+    size_t offset = 0;
+
+    carve(ptr, offset, layout.countData, batchSize);
+    carve(ptr, offset, layout.indexes, m_OutputSize * batchSize);
+    carve(ptr, offset, layout.scores, m_OutputSize * batchSize);
+    carve(ptr, offset, layout.boxes, m_OutputSize * 4 * batchSize);
+    carve(ptr, offset, layout.classes, m_OutputSize * batchSize);
+    char* sort;
+    carve(ptr, offset, sort, sortDetectionsWorkspaceSize(batchSize, m_OutputSize));
+    layout.sort = sort;
+    carve(ptr, offset, layout.sortedBoxes, m_TopK * 4 * batchSize);
+    carve(ptr, offset, layout.sortedScores, m_TopK * batchSize);
+    carve(ptr, offset, layout.sortedClasses, m_TopK * batchSize);
+    char* nms;
+    carve(ptr, offset, nms, nmsDetectionsWorkspaceSize(batchSize, m_TopK));
+    layout.nms = nms;
+
+    if (ws)
+        *ws = layout;
+    return offset;
+}
+
+int32_t YoloLayer::enqueue (
+    const nvinfer1::PluginTensorDesc* inputDesc, const nvinfer1::PluginTensorDesc* outputDesc,
+    void const* const* inputs, void* const* outputs, void* workspace, cudaStream_t stream) noexcept
+{
+    uint batchSize = inputDesc[0].dims.d[0];
+    bool halfInputs = inputDesc[0].type == nvinfer1::DataType::kHALF;
+
+    Workspace ws;
+    getWorkspaceLayout(batchSize, workspace, &ws);
+
+    void* numDetections = outputs[0];
+    void* nmsedBoxes = outputs[1];
+    void* nmsedScores = outputs[2];
+    void* nmsedClasses = outputs[3];
+
+    if (m_Profile) {
+        collectKernelTimes();
+        CUDA_CHECK(cudaEventRecord(m_ProfileEvents[0], stream));
     }
 
+    CUDA_CHECK(cudaMemsetAsync(ws.countData, 0, sizeof(int) * batchSize, stream));
+
+    YoloInputs yoloInputs;
+    for (uint i = 0; i < kMAX_YOLO_HEADS; ++i)
+        yoloInputs.data[i] = i < m_YoloTensors.size() ? inputs[i] : nullptr;
+
+    uint decodeType;
+    if (m_Type == 2)
+        decodeType = kYOLO_R_DECODE;
+    else if (m_Type == 1)
+        decodeType = m_NewCoords ? kYOLO_NC_DECODE : kYOLO_DECODE;
+    else
+        decodeType = kREGION_DECODE;
+
+    // Every head and every batch item is decoded by a single launch
+    CUDA_CHECK(cudaYoloLayer(
+        yoloInputs, ws.indexes, ws.scores, ws.boxes, ws.classes, ws.countData, m_HeadsSlot, m_TotalCells, decodeType,
+        halfInputs, batchSize, m_OutputSize, m_ScoreThreshold, m_NetWidth, m_NetHeight, m_NumClasses, stream));
+
+    if (m_Profile)
+        CUDA_CHECK(cudaEventRecord(m_ProfileEvents[1], stream));
+
     CUDA_CHECK(sortDetections(
-        d_indexes, d_scores, d_boxes, d_classes, bboxData, scoreData, countData, batchSize, m_OutputSize, m_TopK,
-        m_NumClasses, stream));
+        ws.indexes, ws.scores, ws.boxes, ws.classes, ws.countData, ws.sortedBoxes, ws.sortedScores, ws.sortedClasses,
+        ws.sort, batchSize, m_OutputSize, m_TopK, stream));
 
-    CUDA_CHECK(cudaFreeHost(d_indexes));
-    CUDA_CHECK(cudaFreeHost(d_scores));
-    CUDA_CHECK(cudaFreeHost(d_boxes));
-    CUDA_CHECK(cudaFreeHost(d_classes));
+    if (m_Profile)
+        CUDA_CHECK(cudaEventRecord(m_ProfileEvents[2], stream));
+
+    CUDA_CHECK(nmsDetections(
+        ws.sortedBoxes, ws.sortedScores, ws.sortedClasses, ws.countData, numDetections, nmsedBoxes, nmsedScores,
+        nmsedClasses, ws.nms, batchSize, m_TopK, m_IouThreshold, stream));
+
+    if (m_Profile) {
+        CUDA_CHECK(cudaEventRecord(m_ProfileEvents[3], stream));
+        m_ProfilePending = true;
+    }
 
     return 0;
 }
@@ -289,6 +425,7 @@ size_t YoloLayer::getSerializationSize() const noexcept
     totalSize += sizeof(m_Type);
     totalSize += sizeof(m_TopK);
     totalSize += sizeof(m_ScoreThreshold);
+    totalSize += sizeof(m_IouThreshold);
 
     uint yoloTensorsSize = m_YoloTensors.size();
     totalSize += sizeof(yoloTensorsSize);
@@ -319,6 +456,7 @@ void YoloLayer::serialize(void* buffer) const noexcept
     write(d, m_Type);
     write(d, m_TopK);
     write(d, m_ScoreThreshold);
+    write(d, m_IouThreshold);
 
     uint yoloTensorsSize = m_YoloTensors.size();
     write(d, yoloTensorsSize);
@@ -346,11 +484,64 @@ void YoloLayer::serialize(void* buffer) const noexcept
     }
 }
 
-nvinfer1::IPluginV2* YoloLayer::clone() const noexcept
+nvinfer1::IPluginV2DynamicExt* YoloLayer::clone() const noexcept
 {
-    return new YoloLayer (
+    YoloLayer* plugin = new YoloLayer (
         m_NetWidth, m_NetHeight, m_NumClasses, m_NewCoords, m_YoloTensors, m_OutputSize, m_Type, m_TopK,
-        m_ScoreThreshold);
+        m_ScoreThreshold, m_IouThreshold);
+    plugin->setPluginNamespace(m_Namespace.c_str());
+    return plugin;
 }
 
 REGISTER_TENSORRT_PLUGIN(YoloLayerPluginCreator);
+
+YoloActivation::YoloActivation (const void* data, size_t length)
+{
+    const char *d = static_cast<const char*>(data);
+    uint activation;
+    read(d, activation);
+    m_Activation = static_cast<ActivationType>(activation);
+}
+
+YoloActivation::YoloActivation (const ActivationType& activation) : m_Activation(activation)
+{
+    assert(m_Activation == ActivationType::kSilu || m_Activation == ActivationType::kMish);
+}
+
+bool YoloActivation::supportsFormatCombination (
+    int pos, const nvinfer1::PluginTensorDesc* inOut, int nbInputs, int nbOutputs) noexcept
+{
+    if (inOut[pos].format != nvinfer1::TensorFormat::kLINEAR)
+        return false;
+    if (pos == 0)
+        return inOut[0].type == nvinfer1::DataType::kFLOAT || inOut[0].type == nvinfer1::DataType::kHALF;
+    return inOut[pos].type == inOut[0].type;
+}
+
+int32_t YoloActivation::enqueue (
+    const nvinfer1::PluginTensorDesc* inputDesc, const nvinfer1::PluginTensorDesc* outputDesc,
+    void const* const* inputs, void* const* outputs, void* workspace, cudaStream_t stream) noexcept
+{
+    uint64_t count = 1;
+    for (int i = 0; i < inputDesc[0].dims.nbDims; ++i)
+        count *= inputDesc[0].dims.d[i];
+
+    CUDA_CHECK(cudaActivation(
+        inputs[0], outputs[0], count, m_Activation, inputDesc[0].type == nvinfer1::DataType::kHALF, stream));
+    return 0;
+}
+
+void YoloActivation::serialize(void* buffer) const noexcept
+{
+    char *d = static_cast<char*>(buffer);
+    write(d, static_cast<uint>(m_Activation));
+}
+
+nvinfer1::IPluginV2DynamicExt* YoloActivation::clone() const noexcept
+{
+    YoloActivation* plugin = new YoloActivation(m_Activation);
+    plugin->setPluginNamespace(m_Namespace.c_str());
+    return plugin;
+}
+
+REGISTER_TENSORRT_PLUGIN(YoloActivationPluginCreator);
@@ -37,6 +37,8 @@
 #include "NvInferPlugin.h"
 
 #include "yolo.h"
+#include "yoloForward.h"
+#include "yoloKernelStats.h"
 
 #define CUDA_CHECK(status)                                                                                         \
     {                                                                                                              \
@@ -50,11 +52,11 @@
 
 namespace
 {
-const char* YOLOLAYER_PLUGIN_VERSION {"1"};
+const char* YOLOLAYER_PLUGIN_VERSION {"3"};
 const char* YOLOLAYER_PLUGIN_NAME {"YoloLayer_TRT"};
 } // namespace
 
-class YoloLayer : public nvinfer1::IPluginV2
+class YoloLayer : public nvinfer1::IPluginV2DynamicExt
 {
 public:
     YoloLayer (const void* data, size_t length);
@@ -62,36 +64,41 @@ public:
     YoloLayer (
         const uint& netWidth, const uint& netHeight, const uint& numClasses, const uint& newCoords,
         const std::vector<TensorInfo>& yoloTensors, const uint64_t& outputSize, const uint& modelType, const uint& topK,
-        const float& scoreThreshold);
+        const float& scoreThreshold, const float& iouThreshold);
 
     const char* getPluginType () const noexcept override { return YOLOLAYER_PLUGIN_NAME; }
 
     const char* getPluginVersion () const noexcept override { return YOLOLAYER_PLUGIN_VERSION; }
 
-    int getNbOutputs () const noexcept override { return 2; }
+    int getNbOutputs () const noexcept override { return 4; }
 
-    nvinfer1::Dims getOutputDimensions (
-        int index, const nvinfer1::Dims* inputs,
-        int nbInputDims) noexcept override;
+    nvinfer1::DimsExprs getOutputDimensions (
+        int index, const nvinfer1::DimsExprs* inputs, int nbInputDims,
+        nvinfer1::IExprBuilder& exprBuilder) noexcept override;
 
-    bool supportsFormat (
-        nvinfer1::DataType type, nvinfer1::PluginFormat format) const noexcept override;
+    bool supportsFormatCombination (
+        int pos, const nvinfer1::PluginTensorDesc* inOut, int nbInputs, int nbOutputs) noexcept override;
 
-    void configureWithFormat (
-        const nvinfer1::Dims* inputDims, int nbInputs, const nvinfer1::Dims* outputDims, int nbOutputs,
-        nvinfer1::DataType type, nvinfer1::PluginFormat format, int maxBatchSize) noexcept override;
+    nvinfer1::DataType getOutputDataType (
+        int index, const nvinfer1::DataType* inputTypes, int nbInputs) const noexcept override;
 
-    int initialize () noexcept override { return 0; }
+    void configurePlugin (
+        const nvinfer1::DynamicPluginTensorDesc* in, int nbInputs, const nvinfer1::DynamicPluginTensorDesc* out,
+        int nbOutputs) noexcept override;
 
-    void terminate () noexcept override {}
+    int initialize () noexcept override;
+
+    void terminate () noexcept override;
 
-    size_t getWorkspaceSize (int maxBatchSize) const noexcept override {
-        return maxBatchSize * sizeof(int);
+    size_t getWorkspaceSize (
+        const nvinfer1::PluginTensorDesc* inputs, int nbInputs, const nvinfer1::PluginTensorDesc* outputs,
+        int nbOutputs) const noexcept override {
+        return getWorkspaceLayout(inputs[0].dims.d[0], nullptr, nullptr);
     }
 
     int32_t enqueue (
-        int batchSize, void const* const* inputs, void* const* outputs, void* workspace, cudaStream_t stream)
-        noexcept override;
+        const nvinfer1::PluginTensorDesc* inputDesc, const nvinfer1::PluginTensorDesc* outputDesc,
+        void const* const* inputs, void* const* outputs, void* workspace, cudaStream_t stream) noexcept override;
 
     size_t getSerializationSize() const noexcept override;
 
@@ -99,7 +106,7 @@ public:
 
     void destroy () noexcept override { delete this; }
 
-    nvinfer1::IPluginV2* clone() const noexcept override;
+    nvinfer1::IPluginV2DynamicExt* clone() const noexcept override;
 
     void setPluginNamespace (const char* pluginNamespace) noexcept override {
         m_Namespace = pluginNamespace;
@@ -110,6 +117,24 @@ public:
     }
 
 private:
+    struct Workspace
+    {
+        int* countData {nullptr};
+        int* indexes {nullptr};
+        float* scores {nullptr};
+        float* boxes {nullptr};
+        int* classes {nullptr};
+        void* sort {nullptr};
+        float* sortedBoxes {nullptr};
+        float* sortedScores {nullptr};
+        int* sortedClasses {nullptr};
+        void* nms {nullptr};
+    };
+
+    size_t getWorkspaceLayout (int batchSize, void* workspace, Workspace* ws) const noexcept;
+
+    void collectKernelTimes () noexcept;
+
     std::string m_Namespace {""};
     uint m_NetWidth {0};
     uint m_NetHeight {0};
@@ -120,6 +145,16 @@ private:
     uint m_Type {0};
     uint m_TopK {0};
     float m_ScoreThreshold {0};
+    float m_IouThreshold {0};
+
+    int m_HeadsSlot {-1};
+    uint m_TotalCells {0};
+
+    // decode start, sort start, nms start, nms end. Only created with YOLO_PLUGIN_PROFILE=1, the events of one
+    // enqueue are read back on a later one so enqueue never waits for the GPU
+    cudaEvent_t m_ProfileEvents[4] {};
+    bool m_Profile {false};
+    bool m_ProfilePending {false};
 };
 
 class YoloLayerPluginCreator : public nvinfer1::IPluginCreator
@@ -163,6 +198,111 @@ private:
     std::string m_Namespace {""};
 };
 
+namespace
+{
+const char* YOLOACTIVATION_PLUGIN_VERSION {"1"};
+const char* YOLOACTIVATION_PLUGIN_NAME {"YoloActivation_TRT"};
+} // namespace
+
+// silu and mish in one elementwise kernel instead of the sigmoid/softplus, tanh and prod chain, FP32 or FP16
+class YoloActivation : public nvinfer1::IPluginV2DynamicExt
+{
+public:
+    YoloActivation (const void* data, size_t length);
+
+    YoloActivation (const ActivationType& activation);
+
+    const char* getPluginType () const noexcept override { return YOLOACTIVATION_PLUGIN_NAME; }
+
+    const char* getPluginVersion () const noexcept override { return YOLOACTIVATION_PLUGIN_VERSION; }
+
+    int getNbOutputs () const noexcept override { return 1; }
+
+    nvinfer1::DimsExprs getOutputDimensions (
+        int index, const nvinfer1::DimsExprs* inputs, int nbInputDims,
+        nvinfer1::IExprBuilder& exprBuilder) noexcept override { return inputs[0]; }
+
+    bool supportsFormatCombination (
+        int pos, const nvinfer1::PluginTensorDesc* inOut, int nbInputs, int nbOutputs) noexcept override;
+
+    nvinfer1::DataType getOutputDataType (
+        int index, const nvinfer1::DataType* inputTypes, int nbInputs) const noexcept override {
+        return inputTypes[0];
+    }
+
+    void configurePlugin (
+        const nvinfer1::DynamicPluginTensorDesc* in, int nbInputs, const nvinfer1::DynamicPluginTensorDesc* out,
+        int nbOutputs) noexcept override {}
+
+    int initialize () noexcept override { return 0; }
+
+    void terminate () noexcept override {}
+
+    size_t getWorkspaceSize (
+        const nvinfer1::PluginTensorDesc* inputs, int nbInputs, const nvinfer1::PluginTensorDesc* outputs,
+        int nbOutputs) const noexcept override { return 0; }
+
+    int32_t enqueue (
+        const nvinfer1::PluginTensorDesc* inputDesc, const nvinfer1::PluginTensorDesc* outputDesc,
+        void const* const* inputs, void* const* outputs, void* workspace, cudaStream_t stream) noexcept override;
+
+    size_t getSerializationSize() const noexcept override { return sizeof(uint); }
+
+    void serialize (void* buffer) const noexcept override;
+
+    void destroy () noexcept override { delete this; }
+
+    nvinfer1::IPluginV2DynamicExt* clone() const noexcept override;
+
+    void setPluginNamespace (const char* pluginNamespace) noexcept override {
+        m_Namespace = pluginNamespace;
+    }
+
+    virtual const char* getPluginNamespace () const noexcept override {
+        return m_Namespace.c_str();
+    }
+
+private:
+    std::string m_Namespace {""};
+    ActivationType m_Activation {ActivationType::kSilu};
+};
+
+class YoloActivationPluginCreator : public nvinfer1::IPluginCreator
+{
+public:
+    const char* getPluginName () const noexcept override { return YOLOACTIVATION_PLUGIN_NAME; }
+
+    const char* getPluginVersion () const noexcept override { return YOLOACTIVATION_PLUGIN_VERSION; }
+
+    const nvinfer1::PluginFieldCollection* getFieldNames() noexcept override {
+        std::cerr<< "YoloActivationPluginCreator::getFieldNames is not implemented" << std::endl;
+        return nullptr;
+    }
+
+    nvinfer1::IPluginV2* createPlugin (
+        const char* name, const nvinfer1::PluginFieldCollection* fc) noexcept override
+    {
+        std::cerr<< "YoloActivationPluginCreator::createPlugin is not implemented" << std::endl;
+        return nullptr;
+    }
+
+    nvinfer1::IPluginV2* deserializePlugin (
+        const char* name, const void* serialData, size_t serialLength) noexcept override
+    {
+        return new YoloActivation(serialData, serialLength);
+    }
+
+    void setPluginNamespace(const char* libNamespace) noexcept override {
+        m_Namespace = libNamespace;
+    }
+    const char* getPluginNamespace() const noexcept override {
+        return m_Namespace.c_str();
+    }
+
+private:
+    std::string m_Namespace {""};
+};
+
 extern uint kNUM_CLASSES;
 
 #endif // __YOLO_PLUGINS__
@@ -0,0 +1,230 @@
+/*
+ * Created by Marcos Luciano
+ * https://www.github.com/marcoslucianops
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cuda_runtime_api.h>
+
+#include "NvInfer.h"
+
+#define PROFILE_CHECK(status)                                                                                        \
+    {                                                                                                                \
+        cudaError_t err = status;                                                                                    \
+        if (err != cudaSuccess) {                                                                                    \
+            std::cerr << "CUDA error " << cudaGetErrorString(err) << " at " << __FILE__ << ":" << __LINE__            \
+                      << std::endl;                                                                                  \
+            std::exit(1);                                                                                            \
+        }                                                                                                            \
+    }
+
+namespace {
+    class Logger : public nvinfer1::ILogger
+    {
+        void log(Severity severity, const char* msg) noexcept override
+        {
+            if (severity <= Severity::kWARNING)
+                std::cerr << msg << std::endl;
+        }
+    } logger;
+
+    // Layers are reported once per execution in engine order, after fusion, so the names show what got merged
+    class LayerProfiler : public nvinfer1::IProfiler
+    {
+    public:
+        struct Layer
+        {
+            std::string name;
+            double totalMs {0};
+        };
+
+        void reportLayerTime(const char* layerName, float ms) noexcept override
+        {
+            auto it = index.find(layerName);
+            if (it == index.end()) {
+                it = index.emplace(layerName, layers.size()).first;
+                layers.push_back({layerName, 0});
+            }
+            layers[it->second].totalMs += ms;
+        }
+
+        std::vector<Layer> layers;
+
+    private:
+        std::map<std::string, size_t> index;
+    };
+
+    size_t elementSize(const nvinfer1::DataType& type)
+    {
+        switch (type) {
+            case nvinfer1::DataType::kFLOAT: return 4;
+            case nvinfer1::DataType::kHALF: return 2;
+            case nvinfer1::DataType::kINT8: return 1;
+            case nvinfer1::DataType::kINT32: return 4;
+            case nvinfer1::DataType::kBOOL: return 1;
+        }
+        return 4;
+    }
+
+    std::string jsonEscape(const std::string& s)
+    {
+        std::string out;
+        for (char c : s) {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            out += c;
+        }
+        return out;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string enginePath;
+    int batchSize = 1;
+    uint iterations = 100;
+    std::string jsonPath;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value)
+            arg.clear();
+        if (arg == "--engine")
+            enginePath = value;
+        else if (arg == "--batch")
+            batchSize = std::max(1, std::stoi(value));
+        else if (arg == "--iterations")
+            iterations = std::max(1ul, std::stoul(value));
+        else if (arg == "--json")
+            jsonPath = value;
+        else {
+            std::cerr << "Usage: " << argv[0] << " --engine yolo.engine [--batch 1] [--iterations 100]"
+                      << " [--json layers.json]" << std::endl;
+            return 1;
+        }
+        ++i;
+    }
+    if (enginePath.empty()) {
+        std::cerr << "--engine is required" << std::endl;
+        return 1;
+    }
+
+    std::ifstream file(enginePath, std::ios::binary);
+    std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.empty()) {
+        std::cerr << "Could not read " << enginePath << std::endl;
+        return 1;
+    }
+
+    // The YoloLayer and YoloActivation creators register themselves when the custom library is loaded
+    std::unique_ptr<nvinfer1::IRuntime> runtime(nvinfer1::createInferRuntime(logger));
+    std::unique_ptr<nvinfer1::ICudaEngine> engine(runtime->deserializeCudaEngine(data.data(), data.size()));
+    if (!engine) {
+        std::cerr << "Could not deserialize " << enginePath << std::endl;
+        return 1;
+    }
+    std::unique_ptr<nvinfer1::IExecutionContext> context(engine->createExecutionContext());
+
+    int nbBindings = engine->getNbBindings();
+    for (int b = 0; b < nbBindings; ++b) {
+        if (!engine->bindingIsInput(b))
+            continue;
+        nvinfer1::Dims dims = engine->getBindingDimensions(b);
+        dims.d[0] = batchSize;
+        if (!context->setBindingDimensions(b, dims)) {
+            std::cerr << "Batch " << batchSize << " is outside the engine's first profile" << std::endl;
+            return 1;
+        }
+    }
+
+    // Uniform [0, 1) input like a normalized image, so the decode and nms see a realistic candidate count
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+    std::vector<void*> buffers(nbBindings, nullptr);
+    for (int b = 0; b < nbBindings; ++b) {
+        nvinfer1::Dims dims = context->getBindingDimensions(b);
+        size_t count = 1;
+        for (int d = 0; d < dims.nbDims; ++d)
+            count *= dims.d[d];
+        nvinfer1::DataType type = engine->getBindingDataType(b);
+        PROFILE_CHECK(cudaMalloc(&buffers[b], count * elementSize(type)));
+        if (engine->bindingIsInput(b) && type == nvinfer1::DataType::kFLOAT) {
+            std::vector<float> host(count);
+            for (float& v : host)
+                v = uniform(rng);
+            PROFILE_CHECK(cudaMemcpy(buffers[b], host.data(), count * sizeof(float), cudaMemcpyHostToDevice));
+        }
+    }
+
+    cudaStream_t stream;
+    PROFILE_CHECK(cudaStreamCreate(&stream));
+
+    // Warm-up, then wall time without the profiler since per layer reporting serializes the layers
+    for (uint it = 0; it < 10; ++it)
+        context->enqueueV2(buffers.data(), stream, nullptr);
+    PROFILE_CHECK(cudaStreamSynchronize(stream));
+    auto start = std::chrono::steady_clock::now();
+    for (uint it = 0; it < iterations; ++it)
+        context->enqueueV2(buffers.data(), stream, nullptr);
+    PROFILE_CHECK(cudaStreamSynchronize(stream));
+    auto end = std::chrono::steady_clock::now();
+    double wallMs = std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+
+    LayerProfiler profiler;
+    context->setProfiler(&profiler);
+    for (uint it = 0; it < iterations; ++it)
+        context->executeV2(buffers.data());
+
+    double layerMs = 0;
+    for (const LayerProfiler::Layer& layer : profiler.layers)
+        layerMs += layer.totalMs / iterations;
+
+    std::cout << std::left << std::setw(6) << "index" << std::right << std::setw(10) << "ms" << std::setw(8) << "%"
+              << "  layer" << std::endl;
+    std::ostringstream json;
+    json << "{\n  \"engine\": \"" << jsonEscape(enginePath) << "\",\n  \"batch\": " << batchSize
+         << ",\n  \"layers\": [";
+    for (size_t i = 0; i < profiler.layers.size(); ++i) {
+        const LayerProfiler::Layer& layer = profiler.layers[i];
+        double ms = layer.totalMs / iterations;
+        std::cout << std::left << std::setw(6) << i << std::right << std::fixed << std::setprecision(4)
+                  << std::setw(10) << ms << std::setprecision(1) << std::setw(8) << 100. * ms / layerMs
+                  << std::defaultfloat << "  " << layer.name << std::endl;
+        json << (i ? ",\n" : "\n") << "    {\"name\": \"" << jsonEscape(layer.name) << "\", \"ms\": " << ms << "}";
+    }
+    json << "\n  ],\n  \"num_layers\": " << profiler.layers.size() << ",\n  \"layer_ms\": " << layerMs
+         << ",\n  \"wall_ms\": " << wallMs << "\n}\n";
+
+    std::cout << "\n" << profiler.layers.size() << " layers, " << std::fixed << std::setprecision(3) << layerMs
+              << " ms summed per inference, " << wallMs << " ms wall per inference at batch " << batchSize
+              << std::endl;
+
+    context->setProfiler(nullptr);
+    cudaStreamDestroy(stream);
+    for (void* p : buffers)
+        cudaFree(p);
+
+    if (!jsonPath.empty()) {
+        std::ofstream out(jsonPath);
+        if (!out) {
+            std::cerr << "Could not write " << jsonPath << std::endl;
+            return 1;
+        }
+        out << json.str();
+        std::cout << "Wrote " << jsonPath << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,227 @@
+/*
+ * Created by Marcos Luciano
+ * https://www.github.com/marcoslucianops
+ */
+
+#include "yoloWarmup.h"
+#include "engineCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <cuda_runtime_api.h>
+
+#include "NvInfer.h"
+
+namespace {
+    class WarmupLogger : public nvinfer1::ILogger
+    {
+        void log(Severity severity, const char* msg) noexcept override
+        {
+            if (severity <= Severity::kWARNING)
+                std::cerr << "Warm-up: " << msg << std::endl;
+        }
+    };
+
+    WarmupLogger warmupLogger;
+
+    size_t elementSize(const nvinfer1::DataType& type)
+    {
+        switch (type) {
+            case nvinfer1::DataType::kFLOAT: return 4;
+            case nvinfer1::DataType::kHALF: return 2;
+            case nvinfer1::DataType::kINT8: return 1;
+            case nvinfer1::DataType::kINT32: return 4;
+            case nvinfer1::DataType::kBOOL: return 1;
+        }
+        return 4;
+    }
+
+    double msSince(const std::chrono::steady_clock::time_point& start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Device buffers only grow, every batch size of every profile reuses the largest allocation of its binding
+    struct Bindings
+    {
+        std::vector<void*> pointers;
+        std::vector<size_t> sizes;
+
+        ~Bindings()
+        {
+            clear();
+        }
+
+        void clear()
+        {
+            for (void* p : pointers)
+                cudaFree(p);
+            pointers.assign(pointers.size(), nullptr);
+            sizes.assign(sizes.size(), 0);
+        }
+
+        bool reserve(const int& index, const size_t& size)
+        {
+            if (sizes[index] >= size)
+                return true;
+            cudaFree(pointers[index]);
+            pointers[index] = nullptr;
+            sizes[index] = 0;
+            if (cudaMalloc(&pointers[index], size) != cudaSuccess || cudaMemset(pointers[index], 0, size) != cudaSuccess)
+                return false;
+            sizes[index] = size;
+            return true;
+        }
+    };
+
+    bool runWarmup(const std::string& enginePath, unsigned int iterations, NvDsInferYoloWarmupStats* stats)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::ifstream file(enginePath, std::ios::binary);
+        std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (data.empty())
+        {
+            std::cerr << "Warm-up: could not read " << enginePath << std::endl;
+            return false;
+        }
+
+        // Declared in destruction order: buffers and context go before the engine, the engine before the runtime
+        std::unique_ptr<nvinfer1::IRuntime> runtime(nvinfer1::createInferRuntime(warmupLogger));
+        std::unique_ptr<nvinfer1::ICudaEngine> engine(
+            runtime ? runtime->deserializeCudaEngine(data.data(), data.size()) : nullptr);
+        if (!engine)
+        {
+            std::cerr << "Warm-up: could not deserialize " << enginePath << std::endl;
+            return false;
+        }
+        stats->loadMs = msSince(start);
+
+        start = std::chrono::steady_clock::now();
+        std::unique_ptr<nvinfer1::IExecutionContext> context(engine->createExecutionContext());
+        cudaStream_t stream;
+        if (!context || cudaStreamCreate(&stream) != cudaSuccess)
+        {
+            std::cerr << "Warm-up: could not create an execution context" << std::endl;
+            return false;
+        }
+        stats->contextMs = msSince(start);
+
+        int nbBindings = engine->getNbBindings();
+        int nbProfiles = engine->getNbOptimizationProfiles();
+        int perProfile = nbBindings / nbProfiles;
+        Bindings bindings;
+        bindings.pointers.assign(nbBindings, nullptr);
+        bindings.sizes.assign(nbBindings, 0);
+
+        double warmMs = 0;
+        uint warmRuns = 0;
+        bool ok = true;
+        for (int p = 0; p < nbProfiles && ok; ++p)
+        {
+            if (p > 0 && !context->setOptimizationProfileAsync(p, stream))
+                break;
+
+            int input = -1;
+            for (int b = p * perProfile; b < (p + 1) * perProfile; ++b)
+                if (engine->bindingIsInput(b))
+                    input = b;
+            if (input < 0)
+                break;
+
+            std::set<int> batches;
+            for (nvinfer1::OptProfileSelector selector : {nvinfer1::OptProfileSelector::kMIN,
+                     nvinfer1::OptProfileSelector::kOPT, nvinfer1::OptProfileSelector::kMAX})
+                batches.insert(engine->getProfileDimensions(input, p, selector).d[0]);
+
+            for (int batch : batches)
+            {
+                nvinfer1::Dims dims = engine->getProfileDimensions(input, p, nvinfer1::OptProfileSelector::kMAX);
+                dims.d[0] = batch;
+                if (!context->setBindingDimensions(input, dims))
+                {
+                    ok = false;
+                    break;
+                }
+
+                // Only the bindings of this profile are read, the others stay null
+                std::vector<void*> enqueueBindings(nbBindings, nullptr);
+                for (int b = p * perProfile; b < (p + 1) * perProfile && ok; ++b)
+                {
+                    nvinfer1::Dims bindingDims = context->getBindingDimensions(b);
+                    size_t count = 1;
+                    for (int d = 0; d < bindingDims.nbDims; ++d)
+                        count *= std::max(bindingDims.d[d], 1);
+                    ok = bindings.reserve(b, count * elementSize(engine->getBindingDataType(b)));
+                    enqueueBindings[b] = bindings.pointers[b];
+                }
+                if (!ok)
+                {
+                    std::cerr << "Warm-up: could not allocate the bindings for batch " << batch << std::endl;
+                    break;
+                }
+
+                for (uint it = 0; it < iterations && ok; ++it)
+                {
+                    start = std::chrono::steady_clock::now();
+                    ok = context->enqueueV2(enqueueBindings.data(), stream, nullptr)
+                        && cudaStreamSynchronize(stream) == cudaSuccess;
+                    double ms = msSince(start);
+                    if (stats->inferences++ == 0)
+                        stats->firstInferenceMs = ms;
+                    else
+                    {
+                        warmMs += ms;
+                        ++warmRuns;
+                    }
+                }
+                stats->batchSizes++;
+            }
+        }
+
+        stats->inferenceMs = warmRuns ? warmMs / warmRuns : stats->firstInferenceMs;
+        cudaStreamDestroy(stream);
+
+        // The YoloLayer of this copy holds one of the kMAX_YOLO_HEADS_SLOTS constant memory head slots of the device
+        // until its context goes, on top of a second copy of the engine memory. Bindings, context, engine and runtime
+        // are released here, before the next GPU is warmed up and before the sources connect, so the warm-up never
+        // keeps a slot an nvinfer instance needs
+        bindings.clear();
+        context.reset();
+        engine.reset();
+        runtime.reset();
+        if (!ok)
+            std::cerr << "Warm-up: inference failed on " << enginePath << std::endl;
+        return ok;
+    }
+}
+
+extern "C" bool NvDsInferYoloWarmup(
+    const char* enginePath, int gpuId, unsigned int iterations, NvDsInferYoloWarmupStats* stats);
+
+extern "C" bool NvDsInferYoloWarmup(
+    const char* enginePath, int gpuId, unsigned int iterations, NvDsInferYoloWarmupStats* stats)
+{
+    *stats = NvDsInferYoloWarmupStats();
+
+    // The engine nvinfer actually runs when it came from the cache, its model-engine-file may be stale or missing
+    std::string path = lastCachedEngine(gpuId);
+    if (path.empty() && enginePath)
+        path = enginePath;
+    if (path.empty())
+        return false;
+
+    int device = 0;
+    cudaGetDevice(&device);
+    if (cudaSetDevice(gpuId) != cudaSuccess)
+        return false;
+    bool ok = runWarmup(path, std::max(iterations, 1u), stats);
+    cudaSetDevice(device);
+    return ok;
+}
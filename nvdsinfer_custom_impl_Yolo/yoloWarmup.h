@@ -0,0 +1,30 @@
+/*
+ * Created by Marcos Luciano
+ * https://www.github.com/marcoslucianops
+ */
+
+#ifndef __YOLO_WARMUP_H__
+#define __YOLO_WARMUP_H__
+
+// Filled by NvDsInferYoloWarmup, plain C so the app can dlsym it like the kernel stats
+typedef struct
+{
+    double loadMs;
+    double contextMs;
+    double firstInferenceMs;
+    double inferenceMs;
+    unsigned int batchSizes;
+    unsigned int inferences;
+} NvDsInferYoloWarmupStats;
+
+// Deserializes the engine nvinfer got from this library on gpuId, or enginePath when it loaded a model-engine-file
+// itself, and runs iterations inferences on zeros at the min, opt and max batch of every profile. Meant to run once
+// nvinfer is PAUSED and before the sources connect, so the CUDA, cuBLAS and plugin kernel loading and the first
+// enqueue costs are paid there instead of on the first frames. While it runs the copy takes a second head slot of
+// gpuId and a second engine's memory, both are freed before it returns
+typedef bool (*NvDsInferYoloWarmupFunc)(
+    const char* enginePath, int gpuId, unsigned int iterations, NvDsInferYoloWarmupStats* stats);
+
+#define YOLO_WARMUP_FUNC_NAME "NvDsInferYoloWarmup"
+
+#endif
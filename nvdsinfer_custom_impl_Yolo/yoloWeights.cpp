@@ -0,0 +1,319 @@
+/*
+ * Created by Marcos Luciano
+ * https://www.github.com/marcoslucianops
+ */
+
+#include "yoloWeights.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    const char* skipSpaces(const char* p, const char* end)
+    {
+        while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+            ++p;
+        return p;
+    }
+
+    const char* nextToken(const char* p, const char* end)
+    {
+        while (p < end && *p != ' ' && *p != '\n' && *p != '\r' && *p != '\t')
+            ++p;
+        return p;
+    }
+
+    bool sourceStamp(const std::string& filePath, uint64_t& size, int64_t& mtime)
+    {
+        struct stat st;
+        if (stat(filePath.c_str(), &st) != 0)
+            return false;
+        size = st.st_size;
+        mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+        return true;
+    }
+
+    bool readHeader(const std::string& binFilePath, YoloWeightsHeader& header)
+    {
+        std::ifstream file(binFilePath, std::ios::binary);
+        return file.read(reinterpret_cast<char*>(&header), sizeof(header))
+            && std::memcmp(header.magic, kYOLO_WEIGHTS_MAGIC, sizeof(header.magic)) == 0
+            && header.version == kYOLO_WEIGHTS_VERSION;
+    }
+
+    // Any replacement of the .wts changes its size or mtime, older dated copies included
+    bool isCurrent(const YoloWeightsHeader& header, const std::string& wtsFilePath)
+    {
+        uint64_t size;
+        int64_t mtime;
+        return sourceStamp(wtsFilePath, size, mtime) && header.sourceSize == size && header.sourceMtime == mtime;
+    }
+}
+
+bool YoloWeights::map(const std::string& filePath, size_t dataOffset)
+{
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < dataOffset)
+    {
+        close(fd);
+        return false;
+    }
+
+    // Private writable mapping: batch-norm is folded in place, only the touched pages get copied
+    void* mapping = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return false;
+
+    // The layers are built front to back, so let the kernel read ahead
+    madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+
+    m_Mapping = mapping;
+    m_MappingSize = st.st_size;
+    m_Data = reinterpret_cast<float*>(static_cast<char*>(mapping) + dataOffset);
+    m_Size = (st.st_size - dataOffset) / sizeof(float);
+    return true;
+}
+
+void YoloWeights::release()
+{
+    if (m_Mapping)
+        munmap(m_Mapping, m_MappingSize);
+    m_Mapping = nullptr;
+    m_MappingSize = 0;
+    m_Data = nullptr;
+    m_Size = 0;
+    m_Tensors = nullptr;
+    m_NumTensors = 0;
+    m_NextTensor = 0;
+    std::vector<float>().swap(m_Fallback);
+    std::vector<YoloWeightsTensor>().swap(m_FallbackTensors);
+}
+
+bool YoloWeights::checkTensors(uint64_t numWeights)
+{
+    uint64_t offset = 0;
+    for (size_t i = 0; i < m_NumTensors; ++i) {
+        if (m_Tensors[i].offset != offset)
+            return false;
+        offset += m_Tensors[i].count;
+    }
+    return offset == numWeights;
+}
+
+float* YoloWeights::take(int& weightPtr, int count)
+{
+    if (count < 0 || static_cast<size_t>(weightPtr) + count > m_Size) {
+        std::cerr << "\nThe cfg needs more weights than the " << m_Size << " in the weights file" << std::endl;
+        return nullptr;
+    }
+
+    if (m_Tensors) {
+        if (m_NextTensor >= m_NumTensors) {
+            std::cerr << "\nThe cfg needs more tensors than the " << m_NumTensors << " in the weights file"
+                << std::endl;
+            return nullptr;
+        }
+        const YoloWeightsTensor& tensor = m_Tensors[m_NextTensor];
+        if (tensor.offset != static_cast<uint64_t>(weightPtr) || tensor.count != static_cast<uint64_t>(count)) {
+            std::cerr << "\nTensor " << tensor.name << " has " << tensor.count << " weights, the cfg expects "
+                << count << std::endl;
+            return nullptr;
+        }
+        ++m_NextTensor;
+    }
+
+    float* values = m_Data + weightPtr;
+    weightPtr += count;
+    return values;
+}
+
+bool YoloWeights::load(const std::string& weightsFilePath, const std::string& networkType)
+{
+    release();
+
+    std::cout << "\nLoading pre-trained weights" << std::endl;
+
+    if (weightsFilePath.find(".weights") != std::string::npos) {
+        // Remove the int32 header: 4 words for yolov2, 5 for the rest
+        size_t header = 4 * 5;
+        if (networkType.find("yolov2") != std::string::npos && networkType.find("yolov2-tiny") == std::string::npos)
+            header = 4 * 4;
+
+        if (!map(weightsFilePath, header)) {
+            std::cerr << "\nCould not map " << weightsFilePath << std::endl;
+            return false;
+        }
+    }
+
+    else if (weightsFilePath.find(".wts") != std::string::npos) {
+        std::string binFilePath = weightsFilePath + ".bin";
+
+        YoloWeightsHeader header;
+        if (!readHeader(binFilePath, header) || !isCurrent(header, weightsFilePath)) {
+            if (!parseWts(weightsFilePath, m_Fallback, m_FallbackTensors)) {
+                std::cerr << "\nInvalid .wts file: " << weightsFilePath << std::endl;
+                return false;
+            }
+            if (!writeWeightsBinary(binFilePath, weightsFilePath, m_Fallback, m_FallbackTensors)
+                || !readHeader(binFilePath, header)) {
+                // Read-only model directory, keep the parsed copy for this build
+                std::cout << "Could not write " << binFilePath << ", using the parsed weights" << std::endl;
+                m_Data = m_Fallback.data();
+                m_Size = m_Fallback.size();
+                m_Tensors = m_FallbackTensors.data();
+                m_NumTensors = m_FallbackTensors.size();
+            }
+            else {
+                std::vector<float>().swap(m_Fallback);
+                std::vector<YoloWeightsTensor>().swap(m_FallbackTensors);
+                std::cout << "Converted " << weightsFilePath << " to " << binFilePath << std::endl;
+            }
+        }
+
+        if (!m_Data) {
+            size_t tableEnd = sizeof(header) + sizeof(YoloWeightsTensor) * header.numTensors;
+            if (header.dataOffset < tableEnd || !map(binFilePath, header.dataOffset) || m_Size < header.numWeights) {
+                std::cerr << "\nCould not map " << binFilePath << std::endl;
+                release();
+                return false;
+            }
+            m_Size = header.numWeights;
+            m_Tensors = reinterpret_cast<const YoloWeightsTensor*>(static_cast<char*>(m_Mapping) + sizeof(header));
+            m_NumTensors = header.numTensors;
+        }
+
+        if (!checkTensors(m_Size)) {
+            std::cerr << "\nInvalid tensor table in " << binFilePath << std::endl;
+            release();
+            return false;
+        }
+    }
+
+    else {
+        std::cerr << "\nFile " << weightsFilePath << " is not supported" << std::endl;
+        return false;
+    }
+
+    std::cout << "Loading weights of " << networkType << " complete" << std::endl;
+    std::cout << "Total weights read: " << m_Size << std::endl;
+    return true;
+}
+
+bool parseWts(const std::string& wtsFilePath, std::vector<float>& weights, std::vector<YoloWeightsTensor>& tensors)
+{
+    std::ifstream file(wtsFilePath, std::ios::binary | std::ios::ate);
+    if (!file.good())
+        return false;
+    std::string text(file.tellg(), '\0');
+    file.seekg(0, std::ios::beg);
+    if (!file.read(&text[0], text.size()))
+        return false;
+
+    const char* p = text.data();
+    const char* end = p + text.size();
+
+    int32_t count = 0;
+    p = skipSpaces(p, end);
+    std::from_chars_result r = std::from_chars(p, end, count);
+    if (r.ec != std::errc() || count <= 0)
+        return false;
+    p = r.ptr;
+
+    // Every float is at least one hex digit and a separator, usually eight digits
+    weights.clear();
+    weights.reserve(text.size() / 9);
+    tensors.clear();
+    tensors.reserve(count);
+
+    while (count--) {
+        YoloWeightsTensor tensor;
+        std::memset(&tensor, 0, sizeof(tensor));
+
+        p = skipSpaces(p, end);
+        const char* nameEnd = nextToken(p, end);
+        std::memcpy(tensor.name, p, std::min<size_t>(nameEnd - p, sizeof(tensor.name) - 1));
+        p = skipSpaces(nameEnd, end);
+
+        uint32_t size = 0;
+        r = std::from_chars(p, end, size);
+        if (r.ec != std::errc())
+            return false;
+        p = r.ptr;
+
+        tensor.offset = weights.size();
+        tensor.count = size;
+
+        for (uint32_t x = 0; x < size; ++x) {
+            p = skipSpaces(p, end);
+            uint32_t floatWeight;
+            r = std::from_chars(p, end, floatWeight, 16);
+            if (r.ec != std::errc())
+                return false;
+            p = r.ptr;
+            float value;
+            std::memcpy(&value, &floatWeight, sizeof(value));
+            weights.push_back(value);
+        }
+        tensors.push_back(tensor);
+    }
+
+    return true;
+}
+
+bool writeWeightsBinary(
+    const std::string& binFilePath, const std::string& wtsFilePath, const std::vector<float>& weights,
+    const std::vector<YoloWeightsTensor>& tensors)
+{
+    YoloWeightsHeader header;
+    std::memset(&header, 0, sizeof(header));
+    if (!sourceStamp(wtsFilePath, header.sourceSize, header.sourceMtime))
+        return false;
+    std::memcpy(header.magic, kYOLO_WEIGHTS_MAGIC, sizeof(header.magic));
+    header.version = kYOLO_WEIGHTS_VERSION;
+    header.numTensors = tensors.size();
+    header.numWeights = weights.size();
+    size_t tableEnd = sizeof(header) + sizeof(YoloWeightsTensor) * tensors.size();
+    header.dataOffset = (tableEnd + kYOLO_WEIGHTS_ALIGNMENT - 1) & ~static_cast<size_t>(kYOLO_WEIGHTS_ALIGNMENT - 1);
+
+    // Written next to the final name and renamed, a concurrent build never maps a half written file
+    std::string tmpFilePath = binFilePath + ".tmp";
+    std::ofstream file(tmpFilePath, std::ios::binary);
+    if (!file.good())
+        return false;
+
+    std::vector<char> padding(header.dataOffset - tableEnd, 0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(tensors.data()), sizeof(YoloWeightsTensor) * tensors.size());
+    file.write(padding.data(), padding.size());
+    file.write(reinterpret_cast<const char*>(weights.data()), sizeof(float) * weights.size());
+    file.close();
+
+    if (!file.good() || std::rename(tmpFilePath.c_str(), binFilePath.c_str()) != 0) {
+        std::remove(tmpFilePath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool convertWtsToBinary(const std::string& wtsFilePath, const std::string& binFilePath)
+{
+    std::vector<float> weights;
+    std::vector<YoloWeightsTensor> tensors;
+    if (!parseWts(wtsFilePath, weights, tensors))
+        return false;
+    return writeWeightsBinary(binFilePath, wtsFilePath, weights, tensors);
+}
@@ -0,0 +1,88 @@
+/*
+ * Created by Marcos Luciano
+ * https://www.github.com/marcoslucianops
+ */
+
+#ifndef __YOLO_WEIGHTS_H__
+#define __YOLO_WEIGHTS_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define kYOLO_WEIGHTS_MAGIC "YOLOWTS1"
+#define kYOLO_WEIGHTS_VERSION 2
+#define kYOLO_WEIGHTS_ALIGNMENT 64
+
+// Binary weights file: header, tensor table, then all the floats contiguous at dataOffset in .wts order. The size and
+// mtime (ns) of the .wts it was converted from tell when it is stale
+struct YoloWeightsHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t numTensors;
+    uint64_t numWeights;
+    uint64_t dataOffset;
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+};
+
+struct YoloWeightsTensor
+{
+    char name[64];
+    uint64_t offset;
+    uint64_t count;
+};
+
+// Flat view of the model weights, memory mapped from .weights or .wts.bin files
+class YoloWeights
+{
+public:
+    YoloWeights () {}
+
+    ~YoloWeights () { release(); }
+
+    YoloWeights (const YoloWeights&) = delete;
+
+    YoloWeights& operator= (const YoloWeights&) = delete;
+
+    bool load (const std::string& weightsFilePath, const std::string& networkType);
+
+    void release ();
+
+    float* data () { return m_Data; }
+
+    size_t size () const { return m_Size; }
+
+    float& operator[] (size_t i) { return m_Data[i]; }
+
+    // The next count weights at weightPtr, nullptr when they run past the end or, with a tensor table, are not the
+    // whole next .wts tensor
+    float* take (int& weightPtr, int count);
+
+private:
+    bool map (const std::string& filePath, size_t dataOffset);
+
+    bool checkTensors (uint64_t numWeights);
+
+    void* m_Mapping {nullptr};
+    size_t m_MappingSize {0};
+    float* m_Data {nullptr};
+    size_t m_Size {0};
+    const YoloWeightsTensor* m_Tensors {nullptr};
+    size_t m_NumTensors {0};
+    size_t m_NextTensor {0};
+    std::vector<float> m_Fallback;
+    std::vector<YoloWeightsTensor> m_FallbackTensors;
+};
+
+bool parseWts (
+    const std::string& wtsFilePath, std::vector<float>& weights, std::vector<YoloWeightsTensor>& tensors);
+
+bool writeWeightsBinary (
+    const std::string& binFilePath, const std::string& wtsFilePath, const std::vector<float>& weights,
+    const std::vector<YoloWeightsTensor>& tensors);
+
+bool convertWtsToBinary (const std::string& wtsFilePath, const std::string& binFilePath);
+
+#endif
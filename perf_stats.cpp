@@ -0,0 +1,676 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "perf_stats.h"
+
+#include <dlfcn.h>
+#include <string.h>
+#include <gio/gio.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "gstnvdsmeta.h"
+#include "nvdsinfer_custom_impl_Yolo/yoloKernelStats.h"
+
+/* Track ids not seen for this long are forgotten, a later one with the same
+ * id counts as new again */
+#define PERF_STATS_TRACK_ID_TIMEOUT_US (10 * G_USEC_PER_SEC)
+
+/* Refresh period of the Prometheus snapshot when no summary is printed */
+#define PERF_STATS_DEFAULT_INTERVAL_SEC 5
+
+/* In-flight buffers an element may hold before the PTS map is considered
+ * stale, e.g. a buffer that was dropped and never reached the src pad. */
+#define PERF_STATS_MAX_IN_FLIGHT 256
+
+typedef struct
+{
+  std::string name;
+  std::mutex lock;
+  std::unordered_map<GstClockTime, gint64> in_flight;
+  std::vector<gint64> samples;
+  guint64 total;
+} ElementStats;
+
+typedef struct
+{
+  std::mutex lock;
+  std::map<guint, guint64> frames;
+} FrameStats;
+
+typedef struct
+{
+  GstElement *queue;
+  gulong overrun_id;
+  /* Incremented on the streaming thread that found the queue full */
+  std::atomic<guint64> overruns;
+  guint64 last_overruns;
+} QueueStats;
+
+typedef struct
+{
+  guint64 latency_us;
+  guint64 batches;
+  guint64 frames;
+  guint64 objects;
+  guint64 new_ids;
+  std::unordered_map<guint64, gint64> last_seen_us;
+} TrackerStreamStats;
+
+/* The batch latency is read on the src pad, where the frames of the batch
+ * and their tracked objects are known. */
+typedef struct
+{
+  std::mutex lock;
+  std::unordered_map<GstClockTime, gint64> in_flight;
+  std::map<guint, TrackerStreamStats> streams;
+  guint stream_offset;
+  guint stream_stride;
+} TrackerStats;
+
+/* Counters of the last report, the deltas give the interval values */
+typedef struct
+{
+  guint64 latency_us;
+  guint64 batches;
+  guint64 frames;
+  guint64 objects;
+  guint64 new_ids;
+} TrackerTotals;
+
+/* One per counted pad, maps the pad_index of a sub-pipeline batch back to
+ * the global stream id. */
+typedef struct
+{
+  FrameStats *frame_stats;
+  guint stream_offset;
+  guint stream_stride;
+} FrameCounter;
+
+struct _PerfStats
+{
+  guint interval_sec;
+  gboolean print_summary;
+  guint timer_id;
+  gint64 last_report_us;
+
+  std::vector<std::unique_ptr<ElementStats>> elements;
+  std::vector<std::unique_ptr<QueueStats>> queues;
+  std::vector<std::unique_ptr<TrackerStats>> trackers;
+  std::map<guint, TrackerTotals> last_tracker;
+  std::unique_ptr<FrameStats> frame_stats;
+  std::map<guint, guint64> last_frames;
+
+  Startup *startup;
+
+  std::string yolo_lib_path;
+  void *yolo_lib;
+  NvDsInferYoloGetKernelStatsFunc get_kernel_stats;
+  NvDsInferYoloKernelStats last_kernel_stats;
+
+  GSocketService *service;
+  std::mutex prometheus_lock;
+  std::string prometheus_text;
+};
+
+static GstPadProbeReturn
+element_sink_probe (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  ElementStats *element = (ElementStats *) u_data;
+  GstBuffer *buf = (GstBuffer *) info->data;
+  gint64 now = g_get_monotonic_time ();
+
+  std::lock_guard<std::mutex> lock (element->lock);
+  if (element->in_flight.size () >= PERF_STATS_MAX_IN_FLIGHT)
+    element->in_flight.clear ();
+  element->in_flight[GST_BUFFER_PTS (buf)] = now;
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+element_src_probe (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  ElementStats *element = (ElementStats *) u_data;
+  GstBuffer *buf = (GstBuffer *) info->data;
+  gint64 now = g_get_monotonic_time ();
+
+  std::lock_guard<std::mutex> lock (element->lock);
+  auto it = element->in_flight.find (GST_BUFFER_PTS (buf));
+  if (it == element->in_flight.end ())
+    return GST_PAD_PROBE_OK;
+
+  if (element->samples.size () < PERF_STATS_MAX_SAMPLES)
+    element->samples.push_back (now - it->second);
+  element->total++;
+  element->in_flight.erase (it);
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+tracker_sink_probe (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  TrackerStats *tracker = (TrackerStats *) u_data;
+  GstBuffer *buf = (GstBuffer *) info->data;
+  gint64 now = g_get_monotonic_time ();
+
+  std::lock_guard<std::mutex> lock (tracker->lock);
+  if (tracker->in_flight.size () >= PERF_STATS_MAX_IN_FLIGHT)
+    tracker->in_flight.clear ();
+  tracker->in_flight[GST_BUFFER_PTS (buf)] = now;
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+tracker_src_probe (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  TrackerStats *tracker = (TrackerStats *) u_data;
+  GstBuffer *buf = (GstBuffer *) info->data;
+  NvDsBatchMeta *batch_meta = gst_buffer_get_nvds_batch_meta (buf);
+  gint64 now = g_get_monotonic_time ();
+  gint64 latency = -1;
+
+  if (!batch_meta)
+    return GST_PAD_PROBE_OK;
+
+  std::lock_guard<std::mutex> lock (tracker->lock);
+  auto it = tracker->in_flight.find (GST_BUFFER_PTS (buf));
+  if (it != tracker->in_flight.end ()) {
+    latency = now - it->second;
+    tracker->in_flight.erase (it);
+  }
+
+  for (NvDsMetaList * l_frame = batch_meta->frame_meta_list; l_frame != NULL;
+      l_frame = l_frame->next) {
+    NvDsFrameMeta *frame_meta = (NvDsFrameMeta *) (l_frame->data);
+    TrackerStreamStats & stream = tracker->streams[frame_meta->pad_index *
+        tracker->stream_stride + tracker->stream_offset];
+
+    if (latency >= 0) {
+      stream.latency_us += latency;
+      stream.batches++;
+    }
+    stream.frames++;
+    for (NvDsMetaList * l_obj = frame_meta->obj_meta_list; l_obj != NULL;
+        l_obj = l_obj->next) {
+      NvDsObjectMeta *obj_meta = (NvDsObjectMeta *) (l_obj->data);
+      if (obj_meta->object_id == UNTRACKED_OBJECT_ID)
+        continue;
+      stream.objects++;
+      auto seen = stream.last_seen_us.emplace (obj_meta->object_id, now);
+      if (seen.second)
+        stream.new_ids++;
+      else
+        seen.first->second = now;
+    }
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+frame_counter_probe (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  FrameCounter *counter = (FrameCounter *) u_data;
+  FrameStats *frame_stats = counter->frame_stats;
+  NvDsBatchMeta *batch_meta =
+      gst_buffer_get_nvds_batch_meta ((GstBuffer *) info->data);
+
+  if (!batch_meta)
+    return GST_PAD_PROBE_OK;
+
+  std::lock_guard<std::mutex> lock (frame_stats->lock);
+  for (NvDsMetaList * l_frame = batch_meta->frame_meta_list; l_frame != NULL;
+      l_frame = l_frame->next) {
+    NvDsFrameMeta *frame_meta = (NvDsFrameMeta *) (l_frame->data);
+    frame_stats->frames[frame_meta->pad_index * counter->stream_stride +
+        counter->stream_offset]++;
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+static gdouble
+percentile_ms (std::vector<gint64> & samples, gdouble q)
+{
+  if (samples.empty ())
+    return 0;
+  size_t idx = std::min (samples.size () - 1, (size_t) (q * samples.size ()));
+  std::nth_element (samples.begin (), samples.begin () + idx, samples.end ());
+  return samples[idx] / 1000.0;
+}
+
+static void
+resolve_kernel_stats (PerfStats * stats)
+{
+  if (stats->get_kernel_stats || stats->yolo_lib_path.empty ())
+    return;
+
+  /* Only look the library up once nvinfer has dlopen'ed it, never load a
+   * second copy from here */
+  stats->yolo_lib =
+      dlopen (stats->yolo_lib_path.c_str (), RTLD_LAZY | RTLD_NOLOAD);
+  if (!stats->yolo_lib)
+    return;
+  stats->get_kernel_stats = (NvDsInferYoloGetKernelStatsFunc)
+      dlsym (stats->yolo_lib, YOLO_KERNEL_STATS_FUNC_NAME);
+}
+
+static gboolean
+report_cb (gpointer data)
+{
+  PerfStats *stats = (PerfStats *) data;
+  gint64 now = g_get_monotonic_time ();
+  gdouble elapsed = (now - stats->last_report_us) / 1e6;
+  GString *summary = g_string_new (NULL);
+  GString *prom = g_string_new (NULL);
+
+  stats->last_report_us = now;
+  if (elapsed <= 0)
+    elapsed = 1;
+
+  /* Per stream throughput */
+  std::map<guint, guint64> frames;
+  if (stats->frame_stats) {
+    std::lock_guard<std::mutex> lock (stats->frame_stats->lock);
+    frames = stats->frame_stats->frames;
+  }
+  GString *prom_fps = g_string_new ("# TYPE tpd_stream_fps gauge\n");
+  g_string_append (summary, "**PERF:  ");
+  g_string_append (prom, "# TYPE tpd_stream_frames_total counter\n");
+  for (auto & stream : frames) {
+    guint64 delta = stream.second - stats->last_frames[stream.first];
+    gdouble fps = delta / elapsed;
+    g_string_append_printf (summary, "FPS %u %.2f\t", stream.first, fps);
+    g_string_append_printf (prom,
+        "tpd_stream_frames_total{stream=\"%u\"} %" G_GUINT64_FORMAT "\n",
+        stream.first, stream.second);
+    g_string_append_printf (prom_fps, "tpd_stream_fps{stream=\"%u\"} %.3f\n",
+        stream.first, fps);
+  }
+  g_string_append_len (prom, prom_fps->str, prom_fps->len);
+  g_string_free (prom_fps, TRUE);
+  stats->last_frames = frames;
+  g_string_append (summary, "\n");
+
+  /* Element latency over the interval */
+  g_string_append (prom, "# TYPE tpd_element_latency_seconds summary\n");
+  for (auto & element : stats->elements) {
+    std::vector<gint64> samples;
+    guint64 total;
+    {
+      std::lock_guard<std::mutex> lock (element->lock);
+      samples.swap (element->samples);
+      total = element->total;
+    }
+    gdouble p50 = percentile_ms (samples, 0.50);
+    gdouble p99 = percentile_ms (samples, 0.99);
+    g_string_append_printf (summary,
+        "**PERF:  %-16s p50 %8.3f ms  p99 %8.3f ms\n", element->name.c_str (),
+        p50, p99);
+    g_string_append_printf (prom,
+        "tpd_element_latency_seconds{element=\"%s\",quantile=\"0.5\"} %.6f\n"
+        "tpd_element_latency_seconds{element=\"%s\",quantile=\"0.99\"} %.6f\n"
+        "tpd_element_latency_seconds_count{element=\"%s\"} %"
+        G_GUINT64_FORMAT "\n", element->name.c_str (), p50 / 1000,
+        element->name.c_str (), p99 / 1000, element->name.c_str (), total);
+  }
+
+  /* Queue fill levels, a full queue sits in front of the bottleneck. An
+   * overrun is a buffer that found it full: it blocked upstream, or was
+   * dropped by a leaky queue. */
+  GString *prom_overruns =
+      g_string_new ("# TYPE tpd_queue_overruns_total counter\n");
+  if (!stats->queues.empty ()) {
+    g_string_append (summary, "**PERF:  queues");
+    g_string_append (prom, "# TYPE tpd_queue_level_buffers gauge\n");
+  }
+  for (auto & queue : stats->queues) {
+    const gchar *name = GST_ELEMENT_NAME (queue->queue);
+    guint64 overruns = queue->overruns.load ();
+    guint level = 0;
+    g_object_get (G_OBJECT (queue->queue), "current-level-buffers", &level,
+        NULL);
+    g_string_append_printf (summary, " %s=%u", name, level);
+    if (overruns != queue->last_overruns)
+      g_string_append_printf (summary, "(+%" G_GUINT64_FORMAT " overruns)",
+          overruns - queue->last_overruns);
+    queue->last_overruns = overruns;
+    g_string_append_printf (prom, "tpd_queue_level_buffers{queue=\"%s\"} %u\n",
+        name, level);
+    g_string_append_printf (prom_overruns,
+        "tpd_queue_overruns_total{queue=\"%s\"} %" G_GUINT64_FORMAT "\n",
+        name, overruns);
+  }
+  if (!stats->queues.empty ()) {
+    g_string_append (summary, "\n");
+    g_string_append_len (prom, prom_overruns->str, prom_overruns->len);
+  }
+  g_string_free (prom_overruns, TRUE);
+
+  /* Tracker cost and track churn per stream, a tracker that loses people
+   * shows up as new ids while the occupancy stays the same */
+  GString *prom_latency =
+      g_string_new ("# TYPE tpd_tracker_latency_seconds gauge\n");
+  GString *prom_objects =
+      g_string_new ("# TYPE tpd_tracker_objects_per_frame gauge\n");
+  GString *prom_new_ids =
+      g_string_new ("# TYPE tpd_tracker_new_ids_total counter\n");
+  for (auto & tracker : stats->trackers) {
+    std::lock_guard<std::mutex> lock (tracker->lock);
+    for (auto & entry : tracker->streams) {
+      TrackerStreamStats & stream = entry.second;
+      TrackerTotals & last = stats->last_tracker[entry.first];
+      guint64 batches = stream.batches - last.batches;
+      guint64 frames = stream.frames - last.frames;
+      gdouble new_ids = (stream.new_ids - last.new_ids) / elapsed;
+      gdouble latency_ms = batches ?
+          (stream.latency_us - last.latency_us) / 1000.0 / batches : 0;
+      gdouble objects = frames ?
+          (gdouble) (stream.objects - last.objects) / frames : 0;
+
+      for (auto id = stream.last_seen_us.begin ();
+          id != stream.last_seen_us.end ();) {
+        if (now - id->second > PERF_STATS_TRACK_ID_TIMEOUT_US)
+          id = stream.last_seen_us.erase (id);
+        else
+          ++id;
+      }
+
+      g_string_append_printf (summary, "**PERF:  tracker stream %u  %.3f ms"
+          "  %.2f objects/frame  %.2f new ids/s\n", entry.first, latency_ms,
+          objects, new_ids);
+      g_string_append_printf (prom_latency,
+          "tpd_tracker_latency_seconds{stream=\"%u\"} %.6f\n", entry.first,
+          latency_ms / 1000);
+      g_string_append_printf (prom_objects,
+          "tpd_tracker_objects_per_frame{stream=\"%u\"} %.3f\n", entry.first,
+          objects);
+      g_string_append_printf (prom_new_ids,
+          "tpd_tracker_new_ids_total{stream=\"%u\"} %" G_GUINT64_FORMAT "\n",
+          entry.first, stream.new_ids);
+      last = {stream.latency_us, stream.batches, stream.frames, stream.objects,
+        stream.new_ids};
+    }
+  }
+  /* One contiguous group per family */
+  if (!stats->trackers.empty ()) {
+    g_string_append_len (prom, prom_latency->str, prom_latency->len);
+    g_string_append_len (prom, prom_objects->str, prom_objects->len);
+    g_string_append_len (prom, prom_new_ids->str, prom_new_ids->len);
+  }
+  g_string_free (prom_latency, TRUE);
+  g_string_free (prom_objects, TRUE);
+  g_string_free (prom_new_ids, TRUE);
+
+  /* GPU time of the YoloLayer kernels */
+  resolve_kernel_stats (stats);
+  if (stats->get_kernel_stats) {
+    NvDsInferYoloKernelStats kernel;
+    NvDsInferYoloKernelStats *last = &stats->last_kernel_stats;
+    stats->get_kernel_stats (&kernel);
+
+    guint64 enqueues = kernel.enqueues - last->enqueues;
+    if (enqueues)
+      g_string_append_printf (summary,
+          "**PERF:  yolo gpu per enqueue  decode %.3f ms  sort %.3f ms  "
+          "nms %.3f ms\n", (kernel.decodeNs - last->decodeNs) / 1e6 / enqueues,
+          (kernel.sortNs - last->sortNs) / 1e6 / enqueues,
+          (kernel.nmsNs - last->nmsNs) / 1e6 / enqueues);
+    g_string_append_printf (prom,
+        "# TYPE tpd_yolo_kernel_seconds_total counter\n"
+        "tpd_yolo_kernel_seconds_total{kernel=\"decode\"} %.6f\n"
+        "tpd_yolo_kernel_seconds_total{kernel=\"sort\"} %.6f\n"
+        "tpd_yolo_kernel_seconds_total{kernel=\"nms\"} %.6f\n"
+        "# TYPE tpd_yolo_enqueues_total counter\n"
+        "tpd_yolo_enqueues_total %" G_GUINT64_FORMAT "\n",
+        kernel.decodeNs / 1e9, kernel.sortNs / 1e9, kernel.nmsNs / 1e9,
+        kernel.enqueues);
+    *last = kernel;
+  }
+
+  if (stats->startup)
+    startup_append_prometheus (stats->startup, prom);
+
+  if (stats->print_summary)
+    g_print ("%s", summary->str);
+
+  {
+    std::lock_guard<std::mutex> lock (stats->prometheus_lock);
+    stats->prometheus_text.assign (prom->str, prom->len);
+  }
+
+  g_string_free (summary, TRUE);
+  g_string_free (prom, TRUE);
+  return G_SOURCE_CONTINUE;
+}
+
+/* Runs on a GThreadedSocketService worker, any request gets the snapshot */
+static gboolean
+serve_metrics (GThreadedSocketService * service, GSocketConnection * connection,
+    GObject * source_object, gpointer user_data)
+{
+  PerfStats *stats = (PerfStats *) user_data;
+  GInputStream *in = g_io_stream_get_input_stream (G_IO_STREAM (connection));
+  GOutputStream *out = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+  gchar request[1024];
+  std::string body;
+
+  if (g_input_stream_read (in, request, sizeof (request), NULL, NULL) <= 0)
+    return TRUE;
+
+  {
+    std::lock_guard<std::mutex> lock (stats->prometheus_lock);
+    body = stats->prometheus_text;
+  }
+
+  gchar *header = g_strdup_printf ("HTTP/1.0 200 OK\r\n"
+      "Content-Type: text/plain; version=0.0.4\r\n"
+      "Content-Length: %" G_GSIZE_FORMAT "\r\n\r\n", body.size ());
+  g_output_stream_write_all (out, header, strlen (header), NULL, NULL, NULL);
+  g_output_stream_write_all (out, body.data (), body.size (), NULL, NULL,
+      NULL);
+  g_free (header);
+  return TRUE;
+}
+
+PerfStats *
+perf_stats_new (guint interval_sec, guint port, const gchar * yolo_lib_path)
+{
+  PerfStats *stats = new PerfStats ();
+  GError *error = NULL;
+
+  stats->print_summary = interval_sec > 0;
+  stats->interval_sec =
+      interval_sec > 0 ? interval_sec : PERF_STATS_DEFAULT_INTERVAL_SEC;
+  stats->last_report_us = g_get_monotonic_time ();
+  stats->frame_stats.reset (new FrameStats ());
+  stats->startup = NULL;
+  stats->yolo_lib = NULL;
+  stats->get_kernel_stats = NULL;
+  memset (&stats->last_kernel_stats, 0, sizeof (stats->last_kernel_stats));
+  stats->service = NULL;
+  if (yolo_lib_path)
+    stats->yolo_lib_path = yolo_lib_path;
+
+  /* Read by YoloLayer::initialize when nvinfer deserializes the engine */
+  g_setenv (YOLO_PLUGIN_PROFILE_ENV, "1", TRUE);
+
+  if (port > 0) {
+    stats->service = g_threaded_socket_service_new (2);
+    if (!g_socket_listener_add_inet_port (G_SOCKET_LISTENER (stats->service),
+            port, NULL, &error)) {
+      g_printerr ("Failed to listen on metrics port %u: %s\n", port,
+          error->message);
+      g_error_free (error);
+      g_object_unref (stats->service);
+      stats->service = NULL;
+    } else {
+      g_signal_connect (stats->service, "run", G_CALLBACK (serve_metrics),
+          stats);
+      g_socket_service_start (stats->service);
+      g_print ("Serving metrics on port %u\n", port);
+    }
+  }
+
+  stats->timer_id =
+      g_timeout_add_seconds (stats->interval_sec, report_cb, stats);
+  return stats;
+}
+
+void
+perf_stats_add_element (PerfStats * stats, GstElement * element)
+{
+  GstPad *sinkpad = gst_element_get_static_pad (element, "sink");
+  GstPad *srcpad = gst_element_get_static_pad (element, "src");
+
+  if (sinkpad && srcpad) {
+    ElementStats *element_stats = new ElementStats ();
+    element_stats->name = GST_ELEMENT_NAME (element);
+    element_stats->total = 0;
+    element_stats->samples.reserve (PERF_STATS_MAX_SAMPLES);
+    stats->elements.emplace_back (element_stats);
+
+    gst_pad_add_probe (sinkpad, GST_PAD_PROBE_TYPE_BUFFER, element_sink_probe,
+        element_stats, NULL);
+    gst_pad_add_probe (srcpad, GST_PAD_PROBE_TYPE_BUFFER, element_src_probe,
+        element_stats, NULL);
+  } else {
+    g_printerr ("Cannot time %s, it needs static sink and src pads\n",
+        GST_ELEMENT_NAME (element));
+  }
+
+  if (sinkpad)
+    gst_object_unref (sinkpad);
+  if (srcpad)
+    gst_object_unref (srcpad);
+}
+
+static void
+queue_overrun (GstElement * element, gpointer user_data)
+{
+  ((QueueStats *) user_data)->overruns++;
+}
+
+void
+perf_stats_add_queue (PerfStats * stats, GstElement * queue)
+{
+  QueueStats *queue_stats = new QueueStats ();
+
+  queue_stats->queue = (GstElement *) gst_object_ref (queue);
+  queue_stats->overruns = 0;
+  queue_stats->last_overruns = 0;
+  queue_stats->overrun_id = g_signal_connect (queue, "overrun",
+      G_CALLBACK (queue_overrun), queue_stats);
+  stats->queues.emplace_back (queue_stats);
+}
+
+void
+perf_stats_add_frame_counter (PerfStats * stats, GstPad * pad,
+    guint stream_offset, guint stream_stride)
+{
+  FrameCounter *counter = g_new0 (FrameCounter, 1);
+
+  counter->frame_stats = stats->frame_stats.get ();
+  counter->stream_offset = stream_offset;
+  counter->stream_stride = MAX (stream_stride, 1);
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, frame_counter_probe,
+      counter, g_free);
+}
+
+void
+perf_stats_add_tracker (PerfStats * stats, GstElement * tracker,
+    guint stream_offset, guint stream_stride)
+{
+  GstPad *sinkpad = gst_element_get_static_pad (tracker, "sink");
+  GstPad *srcpad = gst_element_get_static_pad (tracker, "src");
+
+  if (sinkpad && srcpad) {
+    TrackerStats *tracker_stats = new TrackerStats ();
+    tracker_stats->stream_offset = stream_offset;
+    tracker_stats->stream_stride = MAX (stream_stride, 1);
+    stats->trackers.emplace_back (tracker_stats);
+
+    gst_pad_add_probe (sinkpad, GST_PAD_PROBE_TYPE_BUFFER, tracker_sink_probe,
+        tracker_stats, NULL);
+    gst_pad_add_probe (srcpad, GST_PAD_PROBE_TYPE_BUFFER, tracker_src_probe,
+        tracker_stats, NULL);
+  }
+
+  if (sinkpad)
+    gst_object_unref (sinkpad);
+  if (srcpad)
+    gst_object_unref (srcpad);
+}
+
+void
+perf_stats_add_startup (PerfStats * stats, Startup * startup)
+{
+  stats->startup = startup;
+}
+
+void
+perf_stats_free (PerfStats * stats)
+{
+  if (!stats)
+    return;
+
+  g_source_remove (stats->timer_id);
+  if (stats->service) {
+    g_socket_service_stop (stats->service);
+    g_socket_listener_close (G_SOCKET_LISTENER (stats->service));
+    g_object_unref (stats->service);
+  }
+  for (auto & queue : stats->queues) {
+    g_signal_handler_disconnect (queue->queue, queue->overrun_id);
+    gst_object_unref (queue->queue);
+  }
+  if (stats->yolo_lib)
+    dlclose (stats->yolo_lib);
+  delete stats;
+}
+
+gchar *
+perf_stats_get_custom_lib_path (const gchar * infer_config_path)
+{
+  GKeyFile *key_file = g_key_file_new ();
+  gchar *lib_path = NULL;
+
+  if (g_key_file_load_from_file (key_file, infer_config_path, G_KEY_FILE_NONE,
+          NULL))
+    lib_path =
+        g_key_file_get_string (key_file, "property", "custom-lib-path", NULL);
+  g_key_file_free (key_file);
+
+  if (lib_path && !g_path_is_absolute (lib_path)) {
+    gchar *dir = g_path_get_dirname (infer_config_path);
+    gchar *abs_dir = g_canonicalize_filename (dir, NULL);
+    gchar *abs_path = g_build_filename (abs_dir, lib_path, NULL);
+    g_free (dir);
+    g_free (abs_dir);
+    g_free (lib_path);
+    lib_path = abs_path;
+  }
+  return lib_path;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __PERF_STATS_H__
+#define __PERF_STATS_H__
+
+#include <gst/gst.h>
+
+#include "startup.h"
+
+/* Latency samples kept per element and reporting interval, percentiles are
+ * computed over these. */
+#define PERF_STATS_MAX_SAMPLES 2048
+
+typedef struct _PerfStats PerfStats;
+
+/* interval_sec > 0 prints a summary on that period, port > 0 serves the
+ * last snapshot as Prometheus text. yolo_lib_path is the nvinfer
+ * custom-lib-path, used to read the YoloLayer kernel times once nvinfer has
+ * loaded it. Must be created before the pipeline leaves NULL so the plugin
+ * sees YOLO_PLUGIN_PROFILE. */
+PerfStats *perf_stats_new (guint interval_sec, guint port,
+    const gchar * yolo_lib_path);
+
+/* Per buffer latency from the element's sink pad to its src pad, matched on
+ * the buffer PTS. Elements with several sink pads are not supported. */
+void perf_stats_add_element (PerfStats * stats, GstElement * element);
+
+/* Samples current-level-buffers on every report and counts the "overrun"
+ * signals of the queue. */
+void perf_stats_add_queue (PerfStats * stats, GstElement * queue);
+
+/* Counts frames of the batches crossing pad, per stream id
+ * pad_index * stream_stride + stream_offset. A single pipeline passes 0, 1. */
+void perf_stats_add_frame_counter (PerfStats * stats, GstPad * pad,
+    guint stream_offset, guint stream_stride);
+
+/* Per stream mean latency of the tracker batches the stream was part of,
+ * tracked objects per frame and new track ids per second, to compare
+ * trackers by cost and by how often they lose a person. Streams are mapped
+ * as in perf_stats_add_frame_counter. */
+void perf_stats_add_tracker (PerfStats * stats, GstElement * tracker,
+    guint stream_offset, guint stream_stride);
+
+/* Exports the startup phases and the per stream time to first frame and
+ * first detection with the other metrics. */
+void perf_stats_add_startup (PerfStats * stats, Startup * startup);
+
+void perf_stats_free (PerfStats * stats);
+
+/* Reads custom-lib-path from an nvinfer config, relative paths are resolved
+ * against the config directory like nvinfer does. */
+gchar *perf_stats_get_custom_lib_path (const gchar * infer_config_path);
+
+#endif
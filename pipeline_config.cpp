@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pipeline_config.h"
+
+#include <string.h>
+
+#define TRACKER_LIB \
+  "/opt/nvidia/deepstream/deepstream/lib/libnvds_nvmultiobjecttracker.so"
+#define TRACKER_NVDCF_CONFIG \
+  "/opt/nvidia/deepstream/deepstream/samples/configs/deepstream-app/" \
+  "config_tracker_NvDCF_perf.yml"
+#define TRACKER_IOU_CONFIG "config_tracker_IOU.yml"
+
+static void
+set_string (gchar ** dst, const gchar * src)
+{
+  g_free (*dst);
+  *dst = g_strdup (src);
+}
+
+static void
+set_queues (PipelineConfig * config, guint max_size_buffers,
+    guint max_size_bytes, guint64 max_size_time_ns, gint leaky)
+{
+  for (guint i = 0; i < PIPELINE_NUM_QUEUES; i++) {
+    config->queues[i].max_size_buffers = max_size_buffers;
+    config->queues[i].max_size_bytes = max_size_bytes;
+    config->queues[i].max_size_time_ns = max_size_time_ns;
+    config->queues[i].leaky = leaky;
+  }
+}
+
+gboolean
+pipeline_config_preset (const gchar * name, PipelineConfig * config)
+{
+  config->streammux.width = 1920;
+  config->streammux.height = 1080;
+  config->streammux.live_source = -1;
+  pipeline_config_tracker (PIPELINE_TRACKER_NVDCF, config);
+
+  if (!g_strcmp0 (name, PIPELINE_PRESET_DEFAULT)) {
+    set_queues (config, 200, 10 * 1024 * 1024, GST_SECOND, 0);
+    config->streammux.batched_push_timeout_us = 40000;
+  } else if (!g_strcmp0 (name, PIPELINE_PRESET_LOW_LATENCY)) {
+    /* Every stage holds at most two batches, a stall drops frames instead
+     * of queueing NVMM surfaces */
+    set_queues (config, 2, 0, 0, 2);
+    config->streammux.batched_push_timeout_us = 33000;
+  } else if (!g_strcmp0 (name, PIPELINE_PRESET_MAX_THROUGHPUT)) {
+    /* Deep enough to absorb per batch jitter, nothing is dropped */
+    set_queues (config, 16, 0, 0, 0);
+    config->streammux.batched_push_timeout_us = 100000;
+  } else {
+    return FALSE;
+  }
+  return TRUE;
+}
+
+gboolean
+pipeline_config_tracker (const gchar * type, PipelineConfig * config)
+{
+  set_string (&config->tracker.ll_lib_file, TRACKER_LIB);
+  if (!g_strcmp0 (type, PIPELINE_TRACKER_NVDCF)) {
+    set_string (&config->tracker.ll_config_file, TRACKER_NVDCF_CONFIG);
+    config->tracker.width = 640;
+    config->tracker.height = 480;
+  } else if (!g_strcmp0 (type, PIPELINE_TRACKER_IOU)) {
+    /* Only the boxes are used, a small scaling buffer is enough */
+    set_string (&config->tracker.ll_config_file, TRACKER_IOU_CONFIG);
+    config->tracker.width = 640;
+    config->tracker.height = 384;
+  } else {
+    return FALSE;
+  }
+  return TRUE;
+}
+
+void
+pipeline_config_resolve_tracker (PipelineConfig * config,
+    const gchar * config_file)
+{
+  gchar *file = config->tracker.ll_config_file;
+  gchar *dir;
+
+  if (!file || g_path_is_absolute (file))
+    return;
+  dir = g_path_get_dirname (config_file);
+  config->tracker.ll_config_file = g_build_filename (dir, file, NULL);
+  g_free (dir);
+  g_free (file);
+}
+
+static gboolean
+load_tracker (GKeyFile * key_file, const gchar * path,
+    PipelineConfig * config)
+{
+  const gchar *group = "tracker";
+  gchar *value;
+
+  if (!g_key_file_has_group (key_file, group))
+    return TRUE;
+
+  value = g_key_file_get_string (key_file, group, "type", NULL);
+  if (value && !pipeline_config_tracker (value, config)) {
+    g_printerr ("Unknown tracker type %s in [%s]\n", value, group);
+    g_free (value);
+    return FALSE;
+  }
+  g_free (value);
+
+  value = g_key_file_get_string (key_file, group, "ll-lib-file", NULL);
+  if (value)
+    set_string (&config->tracker.ll_lib_file, value);
+  g_free (value);
+  value = g_key_file_get_string (key_file, group, "ll-config-file", NULL);
+  if (value) {
+    set_string (&config->tracker.ll_config_file, value);
+    pipeline_config_resolve_tracker (config, path);
+  }
+  g_free (value);
+
+  if (g_key_file_has_key (key_file, group, "width", NULL))
+    config->tracker.width =
+        g_key_file_get_integer (key_file, group, "width", NULL);
+  if (g_key_file_has_key (key_file, group, "height", NULL))
+    config->tracker.height =
+        g_key_file_get_integer (key_file, group, "height", NULL);
+  return TRUE;
+}
+
+static gboolean
+parse_leaky (const gchar * str, gint * leaky)
+{
+  if (!g_strcmp0 (str, "no"))
+    *leaky = 0;
+  else if (!g_strcmp0 (str, "upstream"))
+    *leaky = 1;
+  else if (!g_strcmp0 (str, "downstream"))
+    *leaky = 2;
+  else
+    return FALSE;
+  return TRUE;
+}
+
+static gboolean
+load_queue (GKeyFile * key_file, const gchar * group, QueueConfig * queue)
+{
+  if (!g_key_file_has_group (key_file, group))
+    return TRUE;
+
+  if (g_key_file_has_key (key_file, group, "max-size-buffers", NULL))
+    queue->max_size_buffers =
+        g_key_file_get_integer (key_file, group, "max-size-buffers", NULL);
+  if (g_key_file_has_key (key_file, group, "max-size-bytes", NULL))
+    queue->max_size_bytes =
+        g_key_file_get_integer (key_file, group, "max-size-bytes", NULL);
+  if (g_key_file_has_key (key_file, group, "max-size-time-ms", NULL))
+    queue->max_size_time_ns = (guint64) g_key_file_get_integer (key_file,
+        group, "max-size-time-ms", NULL) * GST_MSECOND;
+  if (g_key_file_has_key (key_file, group, "leaky", NULL)) {
+    gchar *leaky = g_key_file_get_string (key_file, group, "leaky", NULL);
+    gboolean ok = parse_leaky (leaky, &queue->leaky);
+    if (!ok)
+      g_printerr ("Unknown leaky mode %s in [%s]\n", leaky, group);
+    g_free (leaky);
+    return ok;
+  }
+  return TRUE;
+}
+
+gboolean
+pipeline_config_load (const gchar * path, PipelineConfig * config)
+{
+  GKeyFile *key_file = g_key_file_new ();
+  GError *error = NULL;
+  gboolean ok = FALSE;
+  gchar *preset = NULL;
+  const gchar *group = "streammux";
+
+  if (!g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, &error)) {
+    g_printerr ("Failed to read %s: %s\n", path, error->message);
+    g_error_free (error);
+    goto done;
+  }
+
+  preset = g_key_file_get_string (key_file, "property", "preset", NULL);
+  if (preset && !pipeline_config_preset (preset, config)) {
+    g_printerr ("Unknown pipeline preset %s in %s\n", preset, path);
+    goto done;
+  }
+
+  if (g_key_file_has_key (key_file, group, "width", NULL))
+    config->streammux.width =
+        g_key_file_get_integer (key_file, group, "width", NULL);
+  if (g_key_file_has_key (key_file, group, "height", NULL))
+    config->streammux.height =
+        g_key_file_get_integer (key_file, group, "height", NULL);
+  if (g_key_file_has_key (key_file, group, "batched-push-timeout", NULL))
+    config->streammux.batched_push_timeout_us =
+        g_key_file_get_integer (key_file, group, "batched-push-timeout", NULL);
+  if (g_key_file_has_key (key_file, group, "live-source", NULL))
+    config->streammux.live_source =
+        g_key_file_get_integer (key_file, group, "live-source", NULL);
+
+  /* [queue] first, so [queueN] wins */
+  for (guint i = 0; i < PIPELINE_NUM_QUEUES; i++) {
+    gchar name[16];
+    g_snprintf (name, sizeof (name), "queue%u", i + 1);
+    if (!load_queue (key_file, "queue", &config->queues[i]) ||
+        !load_queue (key_file, name, &config->queues[i]))
+      goto done;
+  }
+  if (!load_tracker (key_file, path, config))
+    goto done;
+  ok = TRUE;
+
+done:
+  g_free (preset);
+  g_key_file_free (key_file);
+  return ok;
+}
+
+void
+pipeline_config_apply_queue (const PipelineConfig * config, guint index,
+    GstElement * queue)
+{
+  const QueueConfig *queue_config = &config->queues[index - 1];
+
+  g_object_set (G_OBJECT (queue),
+      "max-size-buffers", queue_config->max_size_buffers,
+      "max-size-bytes", queue_config->max_size_bytes,
+      "max-size-time", queue_config->max_size_time_ns,
+      "leaky", queue_config->leaky, NULL);
+}
+
+void
+pipeline_config_apply_tracker (const PipelineConfig * config,
+    GstElement * tracker)
+{
+  g_object_set (G_OBJECT (tracker),
+      "ll-lib-file", config->tracker.ll_lib_file,
+      "ll-config-file", config->tracker.ll_config_file,
+      "tracker-width", config->tracker.width,
+      "tracker-height", config->tracker.height, NULL);
+}
+
+void
+pipeline_config_clear (PipelineConfig * config)
+{
+  g_clear_pointer (&config->tracker.ll_lib_file, g_free);
+  g_clear_pointer (&config->tracker.ll_config_file, g_free);
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __PIPELINE_CONFIG_H__
+#define __PIPELINE_CONFIG_H__
+
+#include <gst/gst.h>
+
+/* queue1 .. queue4 run from streammux to nvdsanalytics, queue5 .. queue7
+ * between tiler, nvvideoconvert, nvdsosd and the sink. */
+#define PIPELINE_NUM_QUEUES 7
+
+#define PIPELINE_PRESET_DEFAULT "default"
+#define PIPELINE_PRESET_LOW_LATENCY "low-latency"
+#define PIPELINE_PRESET_MAX_THROUGHPUT "max-throughput"
+
+/* NvDCF with visual features, or boxes only: IOU association with a Kalman
+ * filter, the config bundled as config_tracker_IOU.yml */
+#define PIPELINE_TRACKER_NVDCF "nvdcf"
+#define PIPELINE_TRACKER_IOU "iou"
+
+typedef struct
+{
+  guint max_size_buffers;
+  guint max_size_bytes;
+  guint64 max_size_time_ns;
+  /* GstQueue "leaky": 0 no, 1 upstream, 2 downstream */
+  gint leaky;
+} QueueConfig;
+
+typedef struct
+{
+  guint width;
+  guint height;
+  guint batched_push_timeout_us;
+  /* -1 turns it on when any uri is not a file */
+  gint live_source;
+} StreammuxConfig;
+
+typedef struct
+{
+  gchar *ll_lib_file;
+  gchar *ll_config_file;
+  /* Resolution the tracker sees the frames at, NvDCF extracts its features
+   * there */
+  guint width;
+  guint height;
+} TrackerConfig;
+
+typedef struct
+{
+  QueueConfig queues[PIPELINE_NUM_QUEUES];
+  StreammuxConfig streammux;
+  TrackerConfig tracker;
+} PipelineConfig;
+
+/* Every preset tracks with NvDCF at 640x480.
+ * default: GStreamer queue defaults (200 buffers, 10 MB, 1 s, blocking) and
+ * a 40 ms batch timeout. low-latency: two buffer queues dropping the oldest
+ * and a one frame timeout, latency stays bounded when a stage falls behind.
+ * max-throughput: deeper blocking queues and a longer timeout for full
+ * batches. FALSE for an unknown name. */
+gboolean pipeline_config_preset (const gchar * name, PipelineConfig * config);
+
+/* Sets the tracker library, config and resolution of type. FALSE for an
+ * unknown type. The bundled IOU config is left relative until
+ * pipeline_config_resolve_tracker. */
+gboolean pipeline_config_tracker (const gchar * type, PipelineConfig * config);
+
+/* Makes a relative tracker config relative to the directory of
+ * config_file, the way nvinfer resolves its paths. */
+void pipeline_config_resolve_tracker (PipelineConfig * config,
+    const gchar * config_file);
+
+/* Reads path over config: preset= in [property] starts from that preset,
+ * then [streammux], [queue] (every queue) and [queue1] .. [queue7] override
+ * single keys. In [tracker], type= starts from that tracker and
+ * ll-lib-file, ll-config-file, width and height override it; a relative
+ * ll-config-file is relative to path. */
+gboolean pipeline_config_load (const gchar * path, PipelineConfig * config);
+
+/* index is the 1 based queue number. */
+void pipeline_config_apply_queue (const PipelineConfig * config, guint index,
+    GstElement * queue);
+
+void pipeline_config_apply_tracker (const PipelineConfig * config,
+    GstElement * tracker);
+
+/* Frees the tracker paths, the struct itself is the caller's. */
+void pipeline_config_clear (PipelineConfig * config);
+
+#endif
@@ -0,0 +1,368 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "roi_aggregator.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "gstnvdsmeta.h"
+#include "nvds_analytics_meta.h"
+#include "metrics_sink.h"
+
+static const gint64 dwell_bounds_sec[] = ROI_AGGREGATOR_DWELL_BOUNDS_SEC;
+
+G_STATIC_ASSERT (G_N_ELEMENTS (dwell_bounds_sec) ==
+    ROI_AGGREGATOR_DWELL_BINS - 1);
+
+/* Laid out by field rather than by object: the per frame lookup only scans
+ * object_ids, the expiry pass only last_seen_us, and the window sum one
+ * bucket array at a time. */
+typedef struct
+{
+  std::string name;
+  /* Escaped once, the summary writes it every window */
+  std::string json_name;
+  guint occupancy;
+
+  /* Objects inside */
+  std::vector<guint64> object_ids;
+  std::vector<gint64> enter_us;
+  std::vector<gint64> last_seen_us;
+
+  /* One bucket per second of stream time, a ring of window_sec */
+  std::vector<gint64> bucket_second;
+  std::vector<guint> bucket_frames;
+  std::vector<guint64> bucket_occupancy;
+  std::vector<guint> bucket_peak;
+  std::vector<guint> bucket_entries;
+  std::vector<guint> bucket_exits;
+
+  guint64 dwell_hist[ROI_AGGREGATOR_DWELL_BINS];
+  guint64 total_entries;
+  guint64 total_exits;
+} RoiState;
+
+typedef struct
+{
+  gint64 last_us;
+  std::vector<RoiState> rois;
+} StreamState;
+
+struct _RoiAggregator
+{
+  guint window_sec;
+  guint timer_id;
+  FILE *file;
+
+  /* Streaming threads of every branch update, the main loop summarizes */
+  std::mutex lock;
+  std::map<guint, StreamState> streams;
+};
+
+typedef struct
+{
+  RoiAggregator *aggregator;
+  guint stream_offset;
+  guint stream_stride;
+} AggregatorPad;
+
+static RoiState &
+get_roi (RoiAggregator * aggregator, StreamState & stream,
+    const std::string & name)
+{
+  for (RoiState & roi : stream.rois)
+    if (roi.name == name)
+      return roi;
+
+  stream.rois.emplace_back ();
+  RoiState & roi = stream.rois.back ();
+  roi.name = name;
+  std::vector<gchar> escaped (name.size () * 6 + 1);
+  roi.json_name =
+      metrics_json_escape (name.c_str (), escaped.data (), escaped.size ());
+  roi.occupancy = 0;
+  roi.bucket_second.assign (aggregator->window_sec, -1);
+  roi.bucket_frames.assign (aggregator->window_sec, 0);
+  roi.bucket_occupancy.assign (aggregator->window_sec, 0);
+  roi.bucket_peak.assign (aggregator->window_sec, 0);
+  roi.bucket_entries.assign (aggregator->window_sec, 0);
+  roi.bucket_exits.assign (aggregator->window_sec, 0);
+  memset (roi.dwell_hist, 0, sizeof (roi.dwell_hist));
+  roi.total_entries = 0;
+  roi.total_exits = 0;
+  return roi;
+}
+
+/* Slot of the second t_us falls into, recycled when it last held an older
+ * second */
+static size_t
+get_bucket (RoiState & roi, gint64 t_us)
+{
+  gint64 second = t_us / G_USEC_PER_SEC;
+  size_t slot = second % roi.bucket_second.size ();
+
+  if (roi.bucket_second[slot] != second) {
+    roi.bucket_second[slot] = second;
+    roi.bucket_frames[slot] = 0;
+    roi.bucket_occupancy[slot] = 0;
+    roi.bucket_peak[slot] = 0;
+    roi.bucket_entries[slot] = 0;
+    roi.bucket_exits[slot] = 0;
+  }
+  return slot;
+}
+
+static void
+mark_seen (RoiState & roi, guint64 object_id, gint64 t_us)
+{
+  auto it = std::find (roi.object_ids.begin (), roi.object_ids.end (),
+      object_id);
+
+  if (it != roi.object_ids.end ()) {
+    roi.last_seen_us[it - roi.object_ids.begin ()] = t_us;
+    return;
+  }
+
+  roi.object_ids.push_back (object_id);
+  roi.enter_us.push_back (t_us);
+  roi.last_seen_us.push_back (t_us);
+  roi.bucket_entries[get_bucket (roi, t_us)]++;
+  roi.total_entries++;
+}
+
+static void
+expire (RoiState & roi, gint64 t_us, gint64 exit_us)
+{
+  size_t i = 0;
+
+  while (i < roi.object_ids.size ()) {
+    if (t_us - roi.last_seen_us[i] <= exit_us) {
+      i++;
+      continue;
+    }
+
+    gint64 dwell_sec = (roi.last_seen_us[i] - roi.enter_us[i]) /
+        G_USEC_PER_SEC;
+    guint bin = 0;
+    while (bin < ROI_AGGREGATOR_DWELL_BINS - 1 &&
+        dwell_sec >= dwell_bounds_sec[bin])
+      bin++;
+    roi.dwell_hist[bin]++;
+    roi.bucket_exits[get_bucket (roi, t_us)]++;
+    roi.total_exits++;
+
+    /* Order does not matter, the last object fills the hole */
+    roi.object_ids[i] = roi.object_ids.back ();
+    roi.enter_us[i] = roi.enter_us.back ();
+    roi.last_seen_us[i] = roi.last_seen_us.back ();
+    roi.object_ids.pop_back ();
+    roi.enter_us.pop_back ();
+    roi.last_seen_us.pop_back ();
+  }
+}
+
+static GstPadProbeReturn
+aggregate_probe (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  AggregatorPad *aggregator_pad = (AggregatorPad *) u_data;
+  RoiAggregator *aggregator = aggregator_pad->aggregator;
+  NvDsBatchMeta *batch_meta =
+      gst_buffer_get_nvds_batch_meta ((GstBuffer *) info->data);
+  const gint64 exit_us = ROI_AGGREGATOR_EXIT_MS * 1000;
+
+  if (!batch_meta)
+    return GST_PAD_PROBE_OK;
+
+  std::lock_guard<std::mutex> lock (aggregator->lock);
+  for (NvDsMetaList * l_frame = batch_meta->frame_meta_list; l_frame != NULL;
+      l_frame = l_frame->next) {
+    NvDsFrameMeta *frame_meta = (NvDsFrameMeta *) (l_frame->data);
+    guint id = frame_meta->pad_index * aggregator_pad->stream_stride +
+        aggregator_pad->stream_offset;
+    gint64 t_us = GST_TIME_AS_USECONDS (frame_meta->buf_pts);
+    StreamState & stream = aggregator->streams[id];
+
+    /* Stream time went back: the slot got a new source or a file looped,
+     * the objects inside belong to the old one */
+    if (t_us < stream.last_us) {
+      for (RoiState & roi : stream.rois) {
+        roi.object_ids.clear ();
+        roi.enter_us.clear ();
+        roi.last_seen_us.clear ();
+        roi.bucket_second.assign (aggregator->window_sec, -1);
+      }
+    }
+    stream.last_us = t_us;
+
+    /* nvdsanalytics reports every ROI of the stream, empty or not */
+    for (NvDsMetaList * l_user = frame_meta->frame_user_meta_list;
+        l_user != NULL; l_user = l_user->next) {
+      NvDsUserMeta *user_meta = (NvDsUserMeta *) l_user->data;
+      if (user_meta->base_meta.meta_type != NVDS_USER_FRAME_META_NVDSANALYTICS)
+        continue;
+      NvDsAnalyticsFrameMeta *meta =
+          (NvDsAnalyticsFrameMeta *) user_meta->user_meta_data;
+      for (const std::pair<const std::string, uint32_t> & count :
+          meta->objInROIcnt)
+        get_roi (aggregator, stream, count.first).occupancy = count.second;
+    }
+
+    for (NvDsMetaList * l_obj = frame_meta->obj_meta_list; l_obj != NULL;
+        l_obj = l_obj->next) {
+      NvDsObjectMeta *obj_meta = (NvDsObjectMeta *) (l_obj->data);
+      if (obj_meta->object_id == UNTRACKED_OBJECT_ID)
+        continue;
+      for (NvDsMetaList * l_user = obj_meta->obj_user_meta_list;
+          l_user != NULL; l_user = l_user->next) {
+        NvDsUserMeta *user_meta = (NvDsUserMeta *) l_user->data;
+        if (user_meta->base_meta.meta_type != NVDS_USER_OBJ_META_NVDSANALYTICS)
+          continue;
+        NvDsAnalyticsObjInfo *obj_info =
+            (NvDsAnalyticsObjInfo *) user_meta->user_meta_data;
+        for (const std::string & name : obj_info->roiStatus)
+          mark_seen (get_roi (aggregator, stream, name), obj_meta->object_id,
+              t_us);
+      }
+    }
+
+    for (RoiState & roi : stream.rois) {
+      expire (roi, t_us, exit_us);
+      size_t slot = get_bucket (roi, t_us);
+      roi.bucket_frames[slot]++;
+      roi.bucket_occupancy[slot] += roi.occupancy;
+      roi.bucket_peak[slot] = MAX (roi.bucket_peak[slot], roi.occupancy);
+    }
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+write_summary (RoiAggregator * aggregator)
+{
+  GString *out = g_string_new (NULL);
+  guint64 timestamp_us = g_get_real_time ();
+
+  {
+    std::lock_guard<std::mutex> lock (aggregator->lock);
+    for (auto & entry : aggregator->streams) {
+      StreamState & stream = entry.second;
+      gint64 newest = stream.last_us / G_USEC_PER_SEC;
+
+      for (RoiState & roi : stream.rois) {
+        guint64 frames = 0, occupancy = 0, entries = 0, exits = 0;
+        guint peak = 0;
+
+        for (size_t slot = 0; slot < roi.bucket_second.size (); slot++) {
+          if (roi.bucket_second[slot] < 0 ||
+              roi.bucket_second[slot] <= newest - aggregator->window_sec)
+            continue;
+          frames += roi.bucket_frames[slot];
+          occupancy += roi.bucket_occupancy[slot];
+          peak = MAX (peak, roi.bucket_peak[slot]);
+          entries += roi.bucket_entries[slot];
+          exits += roi.bucket_exits[slot];
+        }
+
+        g_string_append_printf (out,
+            "{\"timestamp_us\":%" G_GUINT64_FORMAT ",\"stream_id\":%u,"
+            "\"roi\":\"%s\",\"occupancy\":%u,\"inside\":%u,"
+            "\"window_sec\":%u,\"window_mean\":%.2f,\"window_peak\":%u,"
+            "\"window_entries\":%" G_GUINT64_FORMAT ","
+            "\"window_exits\":%" G_GUINT64_FORMAT ","
+            "\"total_entries\":%" G_GUINT64_FORMAT ","
+            "\"total_exits\":%" G_GUINT64_FORMAT ",\"dwell_hist\":[",
+            timestamp_us, entry.first, roi.json_name.c_str (), roi.occupancy,
+            (guint) roi.object_ids.size (), aggregator->window_sec,
+            frames ? (gdouble) occupancy / frames : 0.0, peak, entries, exits,
+            roi.total_entries, roi.total_exits);
+        for (guint bin = 0; bin < ROI_AGGREGATOR_DWELL_BINS; bin++)
+          g_string_append_printf (out, bin ? ",%" G_GUINT64_FORMAT :
+              "%" G_GUINT64_FORMAT, roi.dwell_hist[bin]);
+        g_string_append (out, "]}\n");
+      }
+    }
+  }
+
+  /* Outside the lock, the streaming threads do not wait on the file */
+  fwrite (out->str, 1, out->len, aggregator->file);
+  fflush (aggregator->file);
+  g_string_free (out, TRUE);
+}
+
+static gboolean
+summary_cb (gpointer data)
+{
+  write_summary ((RoiAggregator *) data);
+  return G_SOURCE_CONTINUE;
+}
+
+RoiAggregator *
+roi_aggregator_new (guint interval_sec, guint window_sec, const gchar * path)
+{
+  FILE *file = stdout;
+
+  if (path) {
+    file = fopen (path, "w");
+    if (!file) {
+      g_printerr ("Failed to open ROI summary file %s\n", path);
+      return NULL;
+    }
+  }
+
+  RoiAggregator *aggregator = new RoiAggregator ();
+  aggregator->window_sec = MAX (window_sec, 1);
+  aggregator->file = file;
+  aggregator->timer_id =
+      g_timeout_add_seconds (MAX (interval_sec, 1), summary_cb, aggregator);
+  return aggregator;
+}
+
+void
+roi_aggregator_attach (RoiAggregator * aggregator, GstPad * pad,
+    guint stream_offset, guint stream_stride)
+{
+  AggregatorPad *aggregator_pad = g_new0 (AggregatorPad, 1);
+
+  aggregator_pad->aggregator = aggregator;
+  aggregator_pad->stream_offset = stream_offset;
+  aggregator_pad->stream_stride = MAX (stream_stride, 1);
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, aggregate_probe,
+      aggregator_pad, g_free);
+}
+
+void
+roi_aggregator_free (RoiAggregator * aggregator)
+{
+  if (!aggregator)
+    return;
+
+  g_source_remove (aggregator->timer_id);
+  write_summary (aggregator);
+  if (aggregator->file != stdout)
+    fclose (aggregator->file);
+  delete aggregator;
+}
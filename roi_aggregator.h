@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __ROI_AGGREGATOR_H__
+#define __ROI_AGGREGATOR_H__
+
+#include <gst/gst.h>
+
+/* An object not reported in an ROI for this long has left it. Covers the
+ * frames nvinfer skips and short tracker misses. */
+#define ROI_AGGREGATOR_EXIT_MS 1000
+
+/* Dwell time histogram, upper bounds in seconds of all bins but the last. */
+#define ROI_AGGREGATOR_DWELL_BOUNDS_SEC { 1, 2, 5, 10, 30, 60, 120, 300, 600 }
+#define ROI_AGGREGATOR_DWELL_BINS 10
+
+typedef struct _RoiAggregator RoiAggregator;
+
+/* Keeps, per stream and ROI, the tracked objects inside, one second
+ * occupancy and enter/exit buckets over the last window_sec of stream time
+ * and a histogram of the dwell time of the objects that left. Every
+ * interval_sec one JSON line per stream and ROI is written to path (stdout
+ * when NULL) from the main loop. */
+RoiAggregator *roi_aggregator_new (guint interval_sec, guint window_sec,
+    const gchar * path);
+
+/* Feeds the nvdsanalytics meta of the batches crossing pad, downstream of
+ * nvdsanalytics. Streams are identified as
+ * pad_index * stream_stride + stream_offset. */
+void roi_aggregator_attach (RoiAggregator * aggregator, GstPad * pad,
+    guint stream_offset, guint stream_stride);
+
+/* Writes a last summary. */
+void roi_aggregator_free (RoiAggregator * aggregator);
+
+#endif
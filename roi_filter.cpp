@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "roi_filter.h"
+
+#include <string.h>
+#include <utility>
+#include <vector>
+#include "gstnvdsmeta.h"
+
+/* Edges of every polygon of a stream, one entry per non-horizontal edge.
+ * A crossing test is then y_min <= y < y_max && x < x0 + (y - y_min) * dxdy
+ * with no branches on the edge direction. */
+typedef struct
+{
+  std::vector<gfloat> y_min;
+  std::vector<gfloat> y_max;
+  std::vector<gfloat> x0;
+  std::vector<gfloat> dxdy;
+  /* End of each polygon in the edge arrays, the ROIs are a union */
+  std::vector<guint> polygon_end;
+  gint class_id;
+  gboolean inverse;
+} StreamRoi;
+
+struct _RoiFilter
+{
+  std::vector<StreamRoi> streams;
+};
+
+static void
+add_polygon (StreamRoi * roi, const std::vector<gfloat> & xs,
+    const std::vector<gfloat> & ys)
+{
+  gsize n = xs.size ();
+
+  for (gsize i = 0; i < n; i++) {
+    gfloat ax = xs[i], ay = ys[i];
+    gfloat bx = xs[(i + 1) % n], by = ys[(i + 1) % n];
+    if (ay == by)
+      continue;
+    if (ay > by) {
+      std::swap (ax, bx);
+      std::swap (ay, by);
+    }
+    roi->y_min.push_back (ay);
+    roi->y_max.push_back (by);
+    roi->x0.push_back (ax);
+    roi->dxdy.push_back ((bx - ax) / (by - ay));
+  }
+  roi->polygon_end.push_back (roi->y_min.size ());
+}
+
+RoiFilter *
+roi_filter_new (const gchar * analytics_config, guint frame_width,
+    guint frame_height)
+{
+  GKeyFile *key_file = g_key_file_new ();
+  GError *error = NULL;
+  gchar **groups;
+  gint config_width, config_height;
+  RoiFilter *filter;
+
+  g_key_file_set_list_separator (key_file, ';');
+  if (!g_key_file_load_from_file (key_file, analytics_config, G_KEY_FILE_NONE,
+          &error)) {
+    g_printerr ("Failed to load %s: %s\n", analytics_config, error->message);
+    g_error_free (error);
+    g_key_file_free (key_file);
+    return NULL;
+  }
+
+  config_width = g_key_file_get_integer (key_file, "property", "config-width",
+      NULL);
+  config_height = g_key_file_get_integer (key_file, "property",
+      "config-height", NULL);
+  if (config_width <= 0 || config_height <= 0) {
+    config_width = frame_width;
+    config_height = frame_height;
+  }
+  gfloat scale_x = (gfloat) frame_width / config_width;
+  gfloat scale_y = (gfloat) frame_height / config_height;
+
+  filter = new RoiFilter ();
+  groups = g_key_file_get_groups (key_file, NULL);
+  for (gchar ** group = groups; *group; group++) {
+    guint id;
+    gchar **keys;
+
+    if (!g_str_has_prefix (*group, "roi-filtering-stream-") ||
+        !g_key_file_get_integer (key_file, *group, "enable", NULL))
+      continue;
+    id = (guint) g_ascii_strtoull (*group + strlen ("roi-filtering-stream-"),
+        NULL, 10);
+    if (filter->streams.size () <= id)
+      filter->streams.resize (id + 1);
+
+    StreamRoi *roi = &filter->streams[id];
+    roi->inverse = g_key_file_get_integer (key_file, *group, "inverse-roi",
+        NULL);
+    roi->class_id = g_key_file_has_key (key_file, *group, "class-id", NULL) ?
+        g_key_file_get_integer (key_file, *group, "class-id", NULL) : -1;
+
+    keys = g_key_file_get_keys (key_file, *group, NULL, NULL);
+    for (gchar ** key = keys; key && *key; key++) {
+      gsize count = 0;
+      gint *points;
+      std::vector<gfloat> xs, ys;
+
+      if (!g_str_has_prefix (*key, "roi-"))
+        continue;
+      points = g_key_file_get_integer_list (key_file, *group, *key, &count,
+          NULL);
+      for (gsize i = 0; i + 1 < count; i += 2) {
+        xs.push_back (points[i] * scale_x);
+        ys.push_back (points[i + 1] * scale_y);
+      }
+      g_free (points);
+      if (xs.size () >= 3)
+        add_polygon (roi, xs, ys);
+    }
+    g_strfreev (keys);
+  }
+  g_strfreev (groups);
+  g_key_file_free (key_file);
+  return filter;
+}
+
+gboolean
+roi_filter_contains (RoiFilter * filter, guint stream_id, gint class_id,
+    gfloat x, gfloat y)
+{
+  if (stream_id >= filter->streams.size ())
+    return TRUE;
+
+  const StreamRoi & roi = filter->streams[stream_id];
+  if (roi.polygon_end.empty () ||
+      (roi.class_id >= 0 && roi.class_id != class_id))
+    return TRUE;
+
+  gboolean inside = FALSE;
+  guint start = 0;
+  for (guint end : roi.polygon_end) {
+    gboolean odd = FALSE;
+    for (guint e = start; e < end; e++)
+      odd ^= (y >= roi.y_min[e] && y < roi.y_max[e] &&
+          x < roi.x0[e] + (y - roi.y_min[e]) * roi.dxdy[e]);
+    start = end;
+    if (odd) {
+      inside = TRUE;
+      break;
+    }
+  }
+  return inside != roi.inverse;
+}
+
+static GstPadProbeReturn
+roi_filter_probe (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  RoiFilter *filter = (RoiFilter *) u_data;
+  NvDsBatchMeta *batch_meta =
+      gst_buffer_get_nvds_batch_meta ((GstBuffer *) info->data);
+
+  if (!batch_meta)
+    return GST_PAD_PROBE_OK;
+
+  for (NvDsMetaList * l_frame = batch_meta->frame_meta_list; l_frame != NULL;
+      l_frame = l_frame->next) {
+    NvDsFrameMeta *frame_meta = (NvDsFrameMeta *) (l_frame->data);
+    NvDsMetaList *l_obj = frame_meta->obj_meta_list;
+
+    while (l_obj != NULL) {
+      NvDsObjectMeta *obj_meta = (NvDsObjectMeta *) (l_obj->data);
+      NvOSD_RectParams *rect = &obj_meta->rect_params;
+      /* Removing unlinks the node, step first */
+      l_obj = l_obj->next;
+
+      if (!roi_filter_contains (filter, frame_meta->pad_index,
+              obj_meta->class_id, rect->left + rect->width / 2,
+              rect->top + rect->height))
+        nvds_remove_obj_meta_from_frame (frame_meta, obj_meta);
+    }
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+void
+roi_filter_attach (RoiFilter * filter, GstPad * pad)
+{
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, roi_filter_probe, filter,
+      NULL);
+}
+
+void
+roi_filter_free (RoiFilter * filter)
+{
+  delete filter;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __ROI_FILTER_H__
+#define __ROI_FILTER_H__
+
+#include <gst/gst.h>
+
+typedef struct _RoiFilter RoiFilter;
+
+/* Loads the roi-filtering-stream-<id> groups of an nvdsanalytics config,
+ * polygons scaled from config-width/height to the frame size. class-id and
+ * inverse-roi are honoured like nvdsanalytics does. */
+RoiFilter *roi_filter_new (const gchar * analytics_config, guint frame_width,
+    guint frame_height);
+
+/* Bottom center of the box, the point nvdsanalytics tests against the ROI */
+gboolean roi_filter_contains (RoiFilter * filter, guint stream_id,
+    gint class_id, gfloat x, gfloat y);
+
+/* Removes the objects outside the ROI from the batches crossing pad, which
+ * has to be between nvinfer and nvtracker. */
+void roi_filter_attach (RoiFilter * filter, GstPad * pad);
+
+void roi_filter_free (RoiFilter * filter);
+
+#endif
@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "roi_preprocess.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* nvdspreprocess unique-id, anything but the gie-unique-id of the pgie */
+#define ROI_PREPROCESS_UNIQUE_ID 15
+
+typedef struct
+{
+  guint width;
+  guint height;
+  guint channels;
+} NetworkSize;
+
+/* The darknet cfg repeats section names, so it is not a GKeyFile: only the
+ * [net] section at the top is read. */
+static gboolean
+read_network_size (const gchar * cfg_path, NetworkSize * net)
+{
+  gchar *contents = NULL;
+  gchar **lines;
+  gboolean in_net = FALSE;
+
+  net->width = net->height = 0;
+  net->channels = 3;
+
+  if (!g_file_get_contents (cfg_path, &contents, NULL, NULL))
+    return FALSE;
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (gchar ** line = lines; *line; line++) {
+    gchar *l = g_strstrip (*line);
+    if (l[0] == '[') {
+      if (in_net)
+        break;
+      in_net = !g_strcmp0 (l, "[net]");
+      continue;
+    }
+    if (!in_net)
+      continue;
+    if (g_str_has_prefix (l, "width="))
+      net->width = atoi (l + 6);
+    else if (g_str_has_prefix (l, "height="))
+      net->height = atoi (l + 7);
+    else if (g_str_has_prefix (l, "channels="))
+      net->channels = atoi (l + 9);
+  }
+  g_strfreev (lines);
+  g_free (contents);
+  return net->width > 0 && net->height > 0;
+}
+
+gboolean
+roi_preprocess_get_stream_rect (GKeyFile * analytics, guint id,
+    guint frame_width, guint frame_height, guint margin, RoiRect * rect)
+{
+  gchar group[64];
+  gchar **keys;
+  gint config_width, config_height;
+  gint min_x = G_MAXINT, min_y = G_MAXINT, max_x = G_MININT, max_y = G_MININT;
+
+  g_snprintf (group, sizeof (group), "roi-filtering-stream-%u", id);
+  if (!g_key_file_has_group (analytics, group) ||
+      !g_key_file_get_integer (analytics, group, "enable", NULL))
+    return FALSE;
+
+  /* inverse-roi keeps everything outside the polygon, nothing to crop */
+  if (g_key_file_get_integer (analytics, group, "inverse-roi", NULL))
+    return FALSE;
+
+  config_width = g_key_file_get_integer (analytics, "property", "config-width",
+      NULL);
+  config_height = g_key_file_get_integer (analytics, "property",
+      "config-height", NULL);
+  if (config_width <= 0 || config_height <= 0) {
+    config_width = frame_width;
+    config_height = frame_height;
+  }
+
+  keys = g_key_file_get_keys (analytics, group, NULL, NULL);
+  for (gchar ** key = keys; key && *key; key++) {
+    gsize count = 0;
+    gint *points;
+
+    if (!g_str_has_prefix (*key, "roi-"))
+      continue;
+    points = g_key_file_get_integer_list (analytics, group, *key, &count,
+        NULL);
+    for (gsize i = 0; i + 1 < count; i += 2) {
+      gint x = (gint64) points[i] * frame_width / config_width;
+      gint y = (gint64) points[i + 1] * frame_height / config_height;
+      min_x = MIN (min_x, x);
+      max_x = MAX (max_x, x);
+      min_y = MIN (min_y, y);
+      max_y = MAX (max_y, y);
+    }
+    g_free (points);
+  }
+  g_strfreev (keys);
+
+  if (min_x > max_x)
+    return FALSE;
+
+  min_x = CLAMP (min_x - (gint) margin, 0, (gint) frame_width);
+  min_y = CLAMP (min_y - (gint) margin, 0, (gint) frame_height);
+  max_x = CLAMP (max_x + (gint) margin, 0, (gint) frame_width);
+  max_y = CLAMP (max_y + (gint) margin, 0, (gint) frame_height);
+
+  /* The scaler works on even coordinates */
+  rect->left = min_x & ~1;
+  rect->top = min_y & ~1;
+  rect->width = (max_x - rect->left) & ~1;
+  rect->height = (max_y - rect->top) & ~1;
+  return rect->width > 0 && rect->height > 0;
+}
+
+gchar *
+roi_preprocess_write_config (const gchar * analytics_config,
+    const gchar * infer_config, guint num_sources, guint frame_width,
+    guint frame_height, guint margin, gint gpu_id)
+{
+  GKeyFile *analytics = g_key_file_new ();
+  GKeyFile *infer = g_key_file_new ();
+  GString *config = NULL;
+  GError *error = NULL;
+  gchar *path = NULL;
+  gchar *cfg_path = NULL;
+  gchar *scale_factor = NULL;
+  NetworkSize net;
+  gint fd;
+
+  g_key_file_set_list_separator (analytics, ';');
+  if (!g_key_file_load_from_file (analytics, analytics_config,
+          G_KEY_FILE_NONE, &error) ||
+      !g_key_file_load_from_file (infer, infer_config, G_KEY_FILE_NONE,
+          &error)) {
+    g_printerr ("Failed to read ROI crop inputs: %s\n", error->message);
+    g_error_free (error);
+    goto done;
+  }
+
+  cfg_path = g_key_file_get_string (infer, "property", "custom-network-config",
+      NULL);
+  /* Relative to the nvinfer config, the way nvinfer resolves it */
+  if (cfg_path && !g_path_is_absolute (cfg_path)) {
+    gchar *dir = g_path_get_dirname (infer_config);
+    gchar *abs_path = g_build_filename (dir, cfg_path, NULL);
+    g_free (dir);
+    g_free (cfg_path);
+    cfg_path = abs_path;
+  }
+  if (!cfg_path || !read_network_size (cfg_path, &net)) {
+    g_printerr ("Failed to read the network size from %s\n",
+        cfg_path ? cfg_path : infer_config);
+    goto done;
+  }
+
+  scale_factor = g_key_file_get_value (infer, "property", "net-scale-factor",
+      NULL);
+
+  config = g_string_new (NULL);
+  g_string_append_printf (config,
+      "[property]\n"
+      "enable=1\n"
+      "unique-id=%d\n"
+      "target-unique-ids=%d\n"
+      "gpu-id=%d\n"
+      "process-on-frame=1\n"
+      "network-input-order=0\n"
+      "network-input-shape=%u;%u;%u;%u\n"
+      "processing-width=%u\n"
+      "processing-height=%u\n"
+      "network-color-format=%d\n"
+      "maintain-aspect-ratio=%d\n"
+      "symmetric-padding=0\n"
+      "tensor-data-type=0\n"
+      "tensor-name=data\n"
+      "scaling-buf-pool-size=6\n"
+      "tensor-buf-pool-size=6\n"
+      "scaling-pool-memory-type=0\n"
+      "scaling-pool-compute-hw=0\n"
+      "scaling-filter=0\n"
+      "custom-lib-path=" ROI_PREPROCESS_LIB "\n"
+      "custom-tensor-preparation-function=CustomTensorPreparation\n"
+      "\n"
+      "[user-configs]\n"
+      "pixel-normalization-factor=%s\n"
+      "\n"
+      "[group-0]\n"
+      "process-on-roi=1\n"
+      "custom-input-transformation-function=CustomAsyncTransformation\n"
+      "src-ids=",
+      ROI_PREPROCESS_UNIQUE_ID,
+      g_key_file_get_integer (infer, "property", "gie-unique-id", NULL),
+      gpu_id >= 0 ? gpu_id :
+      g_key_file_get_integer (infer, "property", "gpu-id", NULL),
+      num_sources, net.channels, net.height, net.width, net.width, net.height,
+      g_key_file_get_integer (infer, "property", "model-color-format", NULL),
+      g_key_file_get_integer (infer, "property", "maintain-aspect-ratio",
+          NULL),
+      scale_factor ? scale_factor : "1.0");
+
+  for (guint id = 0; id < num_sources; id++)
+    g_string_append_printf (config, id ? ";%u" : "%u", id);
+  g_string_append (config, "\n");
+
+  for (guint id = 0; id < num_sources; id++) {
+    RoiRect rect = { 0, 0, frame_width, frame_height };
+    if (roi_preprocess_get_stream_rect (analytics, id, frame_width,
+            frame_height, margin, &rect))
+      g_print ("Stream %u inference cropped to %ux%u+%u+%u\n", id, rect.width,
+          rect.height, rect.left, rect.top);
+    g_string_append_printf (config, "roi-params-src-%u=%u;%u;%u;%u\n", id,
+        rect.left, rect.top, rect.width, rect.height);
+  }
+
+  fd = g_file_open_tmp ("tpd-preprocess-XXXXXX.txt", &path, &error);
+  if (fd < 0) {
+    g_printerr ("Failed to create the preprocess config: %s\n",
+        error->message);
+    g_error_free (error);
+    goto done;
+  }
+  if (write (fd, config->str, config->len) != (gssize) config->len) {
+    g_printerr ("Failed to write %s\n", path);
+    unlink (path);
+    g_free (path);
+    path = NULL;
+  }
+  close (fd);
+
+done:
+  if (config)
+    g_string_free (config, TRUE);
+  g_free (cfg_path);
+  g_free (scale_factor);
+  g_key_file_free (analytics);
+  g_key_file_free (infer);
+  return path;
+}
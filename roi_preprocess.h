@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __ROI_PREPROCESS_H__
+#define __ROI_PREPROCESS_H__
+
+#include <glib.h>
+
+#define ROI_PREPROCESS_LIB \
+  "/opt/nvidia/deepstream/deepstream/lib/gst-plugins/libcustom2d_preprocess.so"
+
+typedef struct
+{
+  guint left;
+  guint top;
+  guint width;
+  guint height;
+} RoiRect;
+
+/* Bounding box of every enabled roi-* polygon of roi-filtering-stream-<id>
+ * in analytics_config, scaled from config-width/height to frame size and
+ * grown by margin pixels. FALSE when the stream has no ROI. */
+gboolean roi_preprocess_get_stream_rect (GKeyFile * analytics, guint id,
+    guint frame_width, guint frame_height, guint margin, RoiRect * rect);
+
+/* Generates an nvdspreprocess config that crops every stream to its ROI
+ * rect (full frame when it has none) and prepares the tensor the way the
+ * nvinfer config would: network size from custom-network-config,
+ * net-scale-factor, model-color-format and maintain-aspect-ratio. gpu_id
+ * -1 keeps the gpu-id of the nvinfer config. Returns the path of the file,
+ * to be freed and unlinked by the caller. */
+gchar *roi_preprocess_write_config (const gchar * analytics_config,
+    const gchar * infer_config, guint num_sources, guint frame_width,
+    guint frame_height, guint margin, gint gpu_id);
+
+#endif
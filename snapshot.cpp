@@ -0,0 +1,356 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "snapshot.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <cuda_runtime_api.h>
+#include "gstnvdsmeta.h"
+#include "nvbufsurface.h"
+#include "nvds_analytics_meta.h"
+#include "nvds_obj_encode.h"
+
+typedef struct
+{
+  std::string name;
+  std::vector<guint8> jpeg;
+} EncodedImage;
+
+/* Private copies of the meta of an entering object, the encoder attaches
+ * its output to these instead of the object the main path still reads */
+typedef struct
+{
+  NvDsFrameMeta frame;
+  NvDsObjectMeta obj;
+} EnteringObject;
+
+typedef struct
+{
+  SnapshotWriter *writer;
+  guint stream_offset;
+  guint stream_stride;
+  guint gpu_id;
+  guint64 batches;
+
+  /* Streaming thread of the branch only. The encoder context is created
+   * there so it lands on gpu_id. */
+  NvDsObjEncCtxHandle ctx;
+  std::map<std::pair<guint, guint64>, guint64> inside;
+  std::map<guint, guint64> last_frame;
+} SnapshotBranch;
+
+struct _SnapshotWriter
+{
+  std::string dir;
+  std::string roi;
+  guint pool_size;
+  guint quality;
+  std::vector<std::unique_ptr<SnapshotBranch>> branches;
+
+  /* Encoding threads push, the worker writes */
+  std::mutex lock;
+  std::condition_variable ready;
+  std::deque<EncodedImage> pool;
+  guint64 dropped;
+  bool running;
+  std::thread worker;
+};
+
+static void
+writer_thread (SnapshotWriter * writer)
+{
+  std::unique_lock<std::mutex> guard (writer->lock);
+
+  while (true) {
+    writer->ready.wait (guard, [writer] {
+          return !writer->running || !writer->pool.empty ();
+        });
+    if (writer->pool.empty ())
+      return;
+
+    EncodedImage image = std::move (writer->pool.front ());
+    writer->pool.pop_front ();
+    guard.unlock ();
+
+    gchar *path = g_build_filename (writer->dir.c_str (), image.name.c_str (),
+        NULL);
+    FILE *file = fopen (path, "wb");
+    if (!file || fwrite (image.jpeg.data (), 1, image.jpeg.size (),
+            file) != image.jpeg.size ())
+      g_printerr ("Failed to write snapshot %s\n", path);
+    if (file)
+      fclose (file);
+    g_free (path);
+
+    guard.lock ();
+  }
+}
+
+static void
+push_image (SnapshotWriter * writer, std::string && name, const guint8 * data,
+    gsize length)
+{
+  {
+    std::lock_guard<std::mutex> guard (writer->lock);
+    if (writer->pool.size () >= writer->pool_size) {
+      writer->dropped++;
+      return;
+    }
+    writer->pool.emplace_back ();
+    writer->pool.back ().name = std::move (name);
+    writer->pool.back ().jpeg.assign (data, data + length);
+  }
+  writer->ready.notify_one ();
+}
+
+static gboolean
+in_roi (NvDsObjectMeta * obj_meta, const std::string & roi)
+{
+  for (NvDsMetaList * l_user = obj_meta->obj_user_meta_list; l_user != NULL;
+      l_user = l_user->next) {
+    NvDsUserMeta *user_meta = (NvDsUserMeta *) l_user->data;
+    if (user_meta->base_meta.meta_type != NVDS_USER_OBJ_META_NVDSANALYTICS)
+      continue;
+    NvDsAnalyticsObjInfo *obj_info =
+        (NvDsAnalyticsObjInfo *) user_meta->user_meta_data;
+    for (const std::string & name : obj_info->roiStatus)
+      if (name == roi)
+        return TRUE;
+  }
+  return FALSE;
+}
+
+/* Forgets objects that left long ago, so the map stays the size of the
+ * crowd rather than of the whole run */
+static void
+prune (SnapshotBranch * branch)
+{
+  for (auto it = branch->inside.begin (); it != branch->inside.end ();) {
+    if (branch->last_frame[it->first.first] - it->second >
+        SNAPSHOT_REENTRY_FRAMES)
+      it = branch->inside.erase (it);
+    else
+      ++it;
+  }
+}
+
+static GstPadProbeReturn
+encode_probe (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  SnapshotBranch *branch = (SnapshotBranch *) u_data;
+  SnapshotWriter *writer = branch->writer;
+  GstBuffer *buf = (GstBuffer *) info->data;
+  NvDsBatchMeta *batch_meta = gst_buffer_get_nvds_batch_meta (buf);
+  std::vector<EnteringObject> entering;
+  GstMapInfo map;
+
+  if (!batch_meta)
+    return GST_PAD_PROBE_OK;
+
+  /* The batch meta is shared with the main path through the tee */
+  nvds_acquire_meta_lock (batch_meta);
+  for (NvDsMetaList * l_frame = batch_meta->frame_meta_list; l_frame != NULL;
+      l_frame = l_frame->next) {
+    NvDsFrameMeta *frame_meta = (NvDsFrameMeta *) (l_frame->data);
+    guint id = frame_meta->pad_index * branch->stream_stride +
+        branch->stream_offset;
+
+    branch->last_frame[id] = frame_meta->frame_num;
+    for (NvDsMetaList * l_obj = frame_meta->obj_meta_list; l_obj != NULL;
+        l_obj = l_obj->next) {
+      NvDsObjectMeta *obj_meta = (NvDsObjectMeta *) (l_obj->data);
+      if (obj_meta->object_id == UNTRACKED_OBJECT_ID ||
+          !in_roi (obj_meta, writer->roi))
+        continue;
+
+      auto key = std::make_pair (id, obj_meta->object_id);
+      auto it = branch->inside.find (key);
+      if (it == branch->inside.end () ||
+          frame_meta->frame_num - it->second > SNAPSHOT_REENTRY_FRAMES) {
+        entering.emplace_back ();
+        entering.back ().frame = *frame_meta;
+        entering.back ().obj = *obj_meta;
+        entering.back ().obj.obj_user_meta_list = NULL;
+        entering.back ().obj.classifier_meta_list = NULL;
+      }
+      branch->inside[key] = frame_meta->frame_num;
+    }
+  }
+  nvds_release_meta_lock (batch_meta);
+  if (++branch->batches % SNAPSHOT_REENTRY_FRAMES == 0)
+    prune (branch);
+
+  if (entering.empty () || !gst_buffer_map (buf, &map, GST_MAP_READ))
+    return GST_PAD_PROBE_OK;
+
+  if (!branch->ctx) {
+    cudaSetDevice (branch->gpu_id);
+    branch->ctx = nvds_obj_enc_create_context ();
+    if (!branch->ctx) {
+      g_printerr ("Failed to create the snapshot encoder\n");
+      gst_buffer_unmap (buf, &map);
+      return GST_PAD_PROBE_OK;
+    }
+  }
+
+  /* The crops are read from the NVMM surface in place, the JPEGs come back
+   * as NVDS_CROP_IMAGE_META on the copies. The user meta is taken from and
+   * given back to the pool of the shared batch meta, under its lock. */
+  nvds_acquire_meta_lock (batch_meta);
+  for (auto & entry : entering) {
+    NvDsObjEncUsrArgs args;
+    memset (&args, 0, sizeof (args));
+    args.attachUsrMeta = true;
+    args.quality = writer->quality;
+    nvds_obj_enc_process (branch->ctx, &args, (NvBufSurface *) map.data,
+        &entry.obj, &entry.frame);
+  }
+  nvds_obj_enc_finish (branch->ctx);
+  gst_buffer_unmap (buf, &map);
+
+  for (auto & entry : entering) {
+    NvDsObjectMeta *obj_meta = &entry.obj;
+    NvDsUserMeta *crop = NULL;
+
+    for (NvDsMetaList * l_user = obj_meta->obj_user_meta_list;
+        l_user != NULL; l_user = l_user->next) {
+      NvDsUserMeta *user_meta = (NvDsUserMeta *) l_user->data;
+      if (user_meta->base_meta.meta_type == NVDS_CROP_IMAGE_META)
+        crop = user_meta;
+    }
+    if (!crop)
+      continue;
+
+    NvDsObjEncOutParams *out = (NvDsObjEncOutParams *) crop->user_meta_data;
+    gchar *name = g_strdup_printf ("stream%u-obj%" G_GUINT64_FORMAT "-%d.jpg",
+        entry.frame.pad_index * branch->stream_stride + branch->stream_offset,
+        obj_meta->object_id, entry.frame.frame_num);
+    push_image (writer, name, out->outBuffer, out->outLen);
+    g_free (name);
+    nvds_remove_user_meta_from_object (obj_meta, crop);
+  }
+  nvds_release_meta_lock (batch_meta);
+  return GST_PAD_PROBE_OK;
+}
+
+SnapshotWriter *
+snapshot_writer_new (const gchar * dir, const gchar * roi, guint pool_size,
+    guint quality)
+{
+  if (g_mkdir_with_parents (dir, 0755) < 0) {
+    g_printerr ("Failed to create snapshot directory %s\n", dir);
+    return NULL;
+  }
+
+  SnapshotWriter *writer = new SnapshotWriter ();
+  writer->dir = dir;
+  writer->roi = roi;
+  writer->pool_size = pool_size > 0 ? pool_size : SNAPSHOT_POOL_SIZE;
+  writer->quality = CLAMP (quality, 1, 100);
+  writer->dropped = 0;
+  writer->running = true;
+  writer->worker = std::thread (writer_thread, writer);
+  return writer;
+}
+
+GstElement *
+snapshot_writer_add_branch (SnapshotWriter * writer, GstElement * pipeline,
+    GstElement * upstream, guint stream_offset, guint stream_stride,
+    guint gpu_id)
+{
+  guint index = writer->branches.size ();
+  gchar *tee_name = g_strdup_printf ("snapshot-tee-%u", index);
+  gchar *queue_name = g_strdup_printf ("snapshot-queue-%u", index);
+  gchar *sink_name = g_strdup_printf ("snapshot-sink-%u", index);
+  GstElement *tee = gst_element_factory_make ("tee", tee_name);
+  GstElement *queue = gst_element_factory_make ("queue", queue_name);
+  GstElement *sink = gst_element_factory_make ("fakesink", sink_name);
+  GstPad *sink_pad;
+
+  g_free (tee_name);
+  g_free (queue_name);
+  g_free (sink_name);
+  if (!tee || !queue || !sink) {
+    g_printerr ("Failed to create the snapshot branch\n");
+    return NULL;
+  }
+
+  /* leaky=downstream drops the oldest batch instead of blocking the tee */
+  g_object_set (G_OBJECT (queue), "leaky", 2, "max-size-buffers",
+      SNAPSHOT_QUEUE_BUFFERS, "max-size-bytes", 0, "max-size-time",
+      (guint64) 0, NULL);
+  g_object_set (G_OBJECT (sink), "sync", FALSE, "async", FALSE, NULL);
+
+  gst_bin_add_many (GST_BIN (pipeline), tee, queue, sink, NULL);
+  if (!gst_element_link (upstream, tee) ||
+      !gst_element_link_many (tee, queue, sink, NULL)) {
+    g_printerr ("Failed to link the snapshot branch\n");
+    return NULL;
+  }
+
+  SnapshotBranch *branch = new SnapshotBranch ();
+  branch->writer = writer;
+  branch->stream_offset = stream_offset;
+  branch->stream_stride = MAX (stream_stride, 1);
+  branch->gpu_id = gpu_id;
+  branch->batches = 0;
+  branch->ctx = NULL;
+  writer->branches.emplace_back (branch);
+
+  sink_pad = gst_element_get_static_pad (sink, "sink");
+  gst_pad_add_probe (sink_pad, GST_PAD_PROBE_TYPE_BUFFER, encode_probe,
+      branch, NULL);
+  gst_object_unref (sink_pad);
+  return tee;
+}
+
+void
+snapshot_writer_free (SnapshotWriter * writer)
+{
+  if (!writer)
+    return;
+
+  {
+    std::lock_guard<std::mutex> guard (writer->lock);
+    writer->running = false;
+  }
+  writer->ready.notify_one ();
+  writer->worker.join ();
+
+  for (auto & branch : writer->branches)
+    if (branch->ctx)
+      nvds_obj_enc_destroy_context (branch->ctx);
+  if (writer->dropped)
+    g_printerr ("WARNING: %" G_GUINT64_FORMAT " snapshots dropped, the "
+        "pool was full\n", writer->dropped);
+  delete writer;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include <gst/gst.h>
+
+/* Buffers the snapshot branch may fall behind before its queue drops the
+ * oldest, the main path never waits on the encoder. */
+#define SNAPSHOT_QUEUE_BUFFERS 4
+
+/* Encoded images held for the writer thread, further ones are dropped. */
+#define SNAPSHOT_POOL_SIZE 16
+
+/* An object missing from the ROI for this many frames of its stream enters
+ * again when it comes back. */
+#define SNAPSHOT_REENTRY_FRAMES 30
+
+typedef struct _SnapshotWriter SnapshotWriter;
+
+/* Writes a JPEG of every tracked object entering roi (an nvdsanalytics ROI
+ * label, e.g. "RF" for roi-RF) to dir as
+ * stream<id>-obj<object_id>-<frame>.jpg. Files are written by a worker
+ * thread from a pool of pool_size encoded images. */
+SnapshotWriter *snapshot_writer_new (const gchar * dir, const gchar * roi,
+    guint pool_size, guint quality);
+
+/* Links upstream -> tee -> leaky queue -> fakesink in pipeline and encodes
+ * the entering objects on the fakesink's streaming thread, with nvds_obj_enc
+ * straight from the NVMM surface on gpu_id. Streams are identified as
+ * pad_index * stream_stride + stream_offset. Returns the tee, the main path
+ * links its next element to it. */
+GstElement *snapshot_writer_add_branch (SnapshotWriter * writer,
+    GstElement * pipeline, GstElement * upstream, guint stream_offset,
+    guint stream_stride, guint gpu_id);
+
+/* Writes what is left in the pool. The pipeline must be in NULL. */
+void snapshot_writer_free (SnapshotWriter * writer);
+
+#endif
@@ -0,0 +1,495 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "source_manager.h"
+
+#include <string.h>
+#include <unistd.h>
+#ifndef PLATFORM_TEGRA
+#include "gst-nvmessage.h"
+#endif
+
+/* NVIDIA Decoder source pad memory feature. This feature signifies that source
+ * pads having this capability will push GstBuffers containing cuda buffers. */
+#define GST_CAPS_FEATURES_NVMM "memory:NVMM"
+
+typedef struct
+{
+  SourceManager *manager;
+  guint id;
+  /* Where the slot feeds in: id = pad_id * num_muxes + mux index */
+  GstElement *streammux;
+  guint pad_id;
+  gint gpu_id;
+  gchar *uri;
+  GstElement *bin;
+  gboolean live;
+  guint retry_sec;
+  guint retry_id;
+  gint64 started_us;
+} SourceSlot;
+
+struct _SourceManager
+{
+  GstElement *pipeline;
+  GstElement **streammuxes;
+  guint num_muxes;
+  guint max_sources;
+  SourceSlot *slots;
+  GIOChannel *stdin_channel;
+  guint stdin_watch_id;
+};
+
+static void
+cb_newpad (GstElement * decodebin, GstPad * decoder_src_pad, gpointer data)
+{
+  g_print ("In cb_newpad\n");
+  GstCaps *caps = gst_pad_get_current_caps (decoder_src_pad);
+  const GstStructure *str = gst_caps_get_structure (caps, 0);
+  const gchar *name = gst_structure_get_name (str);
+  GstElement *source_bin = (GstElement *) data;
+  GstCapsFeatures *features = gst_caps_get_features (caps, 0);
+
+  /* Need to check if the pad created by the decodebin is for video and not
+   * audio. */
+  if (!strncmp (name, "video", 5)) {
+    /* Link the decodebin pad only if decodebin has picked nvidia
+     * decoder plugin nvdec_*. We do this by checking if the pad caps contain
+     * NVMM memory features. */
+    if (gst_caps_features_contains (features, GST_CAPS_FEATURES_NVMM)) {
+      /* Get the source bin ghost pad */
+      GstPad *bin_ghost_pad = gst_element_get_static_pad (source_bin, "src");
+      if (!gst_ghost_pad_set_target (GST_GHOST_PAD (bin_ghost_pad),
+              decoder_src_pad)) {
+        g_printerr ("Failed to link decoder src pad to source bin ghost pad\n");
+      }
+      gst_object_unref (bin_ghost_pad);
+    } else {
+      g_printerr ("Error: Decodebin did not pick nvidia decoder plugin.\n");
+    }
+  }
+  gst_caps_unref (caps);
+}
+
+static void
+decodebin_child_added (GstChildProxy * child_proxy, GObject * object,
+    gchar * name, gpointer user_data)
+{
+  g_print ("Decodebin child added: %s\n", name);
+  if (g_strrstr (name, "decodebin") == name) {
+    g_signal_connect (G_OBJECT (object), "child-added",
+        G_CALLBACK (decodebin_child_added), user_data);
+  }
+  /* Decode on the GPU that runs the stream's inference */
+  if (g_strrstr (name, "nvv4l2decoder") == name) {
+    gint gpu_id = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (user_data),
+            "gpu-id")) - 1;
+    if (gpu_id >= 0)
+      g_object_set (object, "gpu-id", gpu_id, NULL);
+  }
+}
+
+GstElement *
+source_manager_create_bin (guint index, const gchar * uri, gint gpu_id)
+{
+  GstElement *bin = NULL, *uri_decode_bin = NULL;
+  gchar bin_name[16] = { };
+
+  g_snprintf (bin_name, 15, "source-bin-%02d", index);
+  /* Create a source GstBin to abstract this bin's content from the rest of the
+   * pipeline */
+  bin = gst_bin_new (bin_name);
+
+  /* Source element for reading from the uri.
+   * We will use decodebin and let it figure out the container format of the
+   * stream and the codec and plug the appropriate demux and decode plugins. */
+  uri_decode_bin = gst_element_factory_make ("uridecodebin", "uri-decode-bin");
+
+  if (!bin || !uri_decode_bin) {
+    g_printerr ("One element in source bin could not be created.\n");
+    return NULL;
+  }
+
+  /* We set the input uri to the source element */
+  g_object_set (G_OBJECT (uri_decode_bin), "uri", uri, NULL);
+  g_object_set_data (G_OBJECT (bin), "gpu-id", GINT_TO_POINTER (gpu_id + 1));
+
+  /* Connect to the "pad-added" signal of the decodebin which generates a
+   * callback once a new pad for raw data has beed created by the decodebin */
+  g_signal_connect (G_OBJECT (uri_decode_bin), "pad-added",
+      G_CALLBACK (cb_newpad), bin);
+  g_signal_connect (G_OBJECT (uri_decode_bin), "child-added",
+      G_CALLBACK (decodebin_child_added), bin);
+
+  gst_bin_add (GST_BIN (bin), uri_decode_bin);
+
+  /* We need to create a ghost pad for the source bin which will act as a proxy
+   * for the video decoder src pad. The ghost pad will not have a target right
+   * now. Once the decode bin creates the video decoder and generates the
+   * cb_newpad callback, we will set the ghost pad target to the video decoder
+   * src pad. */
+  if (!gst_element_add_pad (bin, gst_ghost_pad_new_no_target ("src",
+              GST_PAD_SRC))) {
+    g_printerr ("Failed to add ghost pad in source bin\n");
+    return NULL;
+  }
+
+  return bin;
+}
+
+/* Stops the bin first so nothing is pushed into the pad being released,
+ * then resets the streammux pad so a new source can take the slot. */
+static void
+detach_slot (SourceManager * manager, SourceSlot * slot)
+{
+  gchar pad_name[16] = { };
+  GstPad *sinkpad;
+
+  if (!slot->bin)
+    return;
+
+  gst_element_set_state (slot->bin, GST_STATE_NULL);
+  gst_element_get_state (slot->bin, NULL, NULL, GST_CLOCK_TIME_NONE);
+
+  g_snprintf (pad_name, 15, "sink_%u", slot->pad_id);
+  sinkpad = gst_element_get_static_pad (slot->streammux, pad_name);
+  if (sinkpad) {
+    gst_pad_send_event (sinkpad, gst_event_new_flush_stop (FALSE));
+    gst_element_release_request_pad (slot->streammux, sinkpad);
+    gst_object_unref (sinkpad);
+  }
+
+  gst_bin_remove (GST_BIN (manager->pipeline), slot->bin);
+  slot->bin = NULL;
+}
+
+static gboolean
+attach_slot (SourceManager * manager, SourceSlot * slot)
+{
+  GstPad *sinkpad, *srcpad;
+  gchar pad_name[16] = { };
+  GstElement *source_bin = source_manager_create_bin (slot->id, slot->uri,
+      slot->gpu_id);
+
+  if (!source_bin) {
+    g_printerr ("Failed to create source bin for %s\n", slot->uri);
+    return FALSE;
+  }
+
+  gst_bin_add (GST_BIN (manager->pipeline), source_bin);
+  slot->bin = source_bin;
+
+  g_snprintf (pad_name, 15, "sink_%u", slot->pad_id);
+  sinkpad = gst_element_get_request_pad (slot->streammux, pad_name);
+  if (!sinkpad) {
+    g_printerr ("Streammux request sink pad failed.\n");
+    gst_bin_remove (GST_BIN (manager->pipeline), source_bin);
+    slot->bin = NULL;
+    return FALSE;
+  }
+
+  srcpad = gst_element_get_static_pad (source_bin, "src");
+  if (gst_pad_link (srcpad, sinkpad) != GST_PAD_LINK_OK) {
+    g_printerr ("Failed to link source bin to stream muxer.\n");
+    gst_object_unref (srcpad);
+    gst_object_unref (sinkpad);
+    detach_slot (manager, slot);
+    return FALSE;
+  }
+  gst_object_unref (srcpad);
+  gst_object_unref (sinkpad);
+
+  slot->started_us = g_get_monotonic_time ();
+  if (!gst_element_sync_state_with_parent (source_bin)) {
+    g_printerr ("Failed to start %s\n", slot->uri);
+    detach_slot (manager, slot);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static void schedule_reconnect (SourceManager * manager, SourceSlot * slot);
+
+static gboolean
+reconnect_cb (gpointer data)
+{
+  SourceSlot *slot = (SourceSlot *) data;
+
+  slot->retry_id = 0;
+  g_print ("Reconnecting stream %u: %s\n", slot->id, slot->uri);
+  if (!attach_slot (slot->manager, slot))
+    schedule_reconnect (slot->manager, slot);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_reconnect (SourceManager * manager, SourceSlot * slot)
+{
+  if (slot->retry_id)
+    return;
+
+  detach_slot (manager, slot);
+
+  if (g_get_monotonic_time () - slot->started_us >=
+      SOURCE_STABLE_SEC * G_USEC_PER_SEC)
+    slot->retry_sec = SOURCE_RETRY_MIN_SEC;
+
+  g_print ("Stream %u lost, retrying in %u s\n", slot->id, slot->retry_sec);
+  slot->retry_id = g_timeout_add_seconds (slot->retry_sec, reconnect_cb, slot);
+  slot->retry_sec = MIN (slot->retry_sec * 2, SOURCE_RETRY_MAX_SEC);
+}
+
+SourceManager *
+source_manager_new (GstElement * pipeline, GstElement ** streammuxes,
+    guint num_muxes, guint max_sources)
+{
+  SourceManager *manager = g_new0 (SourceManager, 1);
+  guint i;
+
+  manager->pipeline = pipeline;
+  manager->streammuxes = g_new0 (GstElement *, num_muxes);
+  memcpy (manager->streammuxes, streammuxes, sizeof (GstElement *) * num_muxes);
+  manager->num_muxes = num_muxes;
+  manager->max_sources = max_sources;
+  manager->slots = g_new0 (SourceSlot, max_sources);
+  for (i = 0; i < max_sources; i++) {
+    SourceSlot *slot = &manager->slots[i];
+    slot->manager = manager;
+    slot->id = i;
+    slot->streammux = streammuxes[i % num_muxes];
+    slot->pad_id = i / num_muxes;
+    /* A single mux leaves the decoder on the default device */
+    slot->gpu_id = num_muxes > 1 ? (gint) (i % num_muxes) : -1;
+  }
+  return manager;
+}
+
+/* The free slot on the mux with the fewest streams, so the GPUs stay even */
+static SourceSlot *
+find_free_slot (SourceManager * manager)
+{
+  SourceSlot *best = NULL;
+  guint *active = g_new0 (guint, manager->num_muxes);
+  guint i, best_active = G_MAXUINT;
+
+  for (i = 0; i < manager->max_sources; i++)
+    if (manager->slots[i].uri)
+      active[i % manager->num_muxes]++;
+  for (i = 0; i < manager->max_sources; i++) {
+    if (manager->slots[i].uri || active[i % manager->num_muxes] >= best_active)
+      continue;
+    best = &manager->slots[i];
+    best_active = active[i % manager->num_muxes];
+  }
+  g_free (active);
+  return best;
+}
+
+gint
+source_manager_add (SourceManager * manager, const gchar * uri)
+{
+  SourceSlot *slot = find_free_slot (manager);
+  gchar *protocol;
+
+  if (!slot) {
+    g_printerr ("All %u source slots are in use\n", manager->max_sources);
+    return -1;
+  }
+
+  protocol = gst_uri_get_protocol (uri);
+  slot->uri = g_strdup (uri);
+  slot->live = protocol && g_strcmp0 (protocol, "file") != 0;
+  slot->retry_sec = SOURCE_RETRY_MIN_SEC;
+  g_free (protocol);
+
+  if (!attach_slot (manager, slot)) {
+    /* A camera that is not up yet is worth waiting for, a bad file is not */
+    if (slot->live) {
+      schedule_reconnect (manager, slot);
+    } else {
+      g_free (slot->uri);
+      slot->uri = NULL;
+      return -1;
+    }
+  }
+  return slot->id;
+}
+
+gboolean
+source_manager_remove (SourceManager * manager, guint id)
+{
+  SourceSlot *slot;
+
+  if (id >= manager->max_sources || !manager->slots[id].uri)
+    return FALSE;
+
+  slot = &manager->slots[id];
+  if (slot->retry_id)
+    g_source_remove (slot->retry_id);
+  slot->retry_id = 0;
+  detach_slot (manager, slot);
+  g_free (slot->uri);
+  slot->uri = NULL;
+  return TRUE;
+}
+
+gboolean
+source_manager_handle_message (SourceManager * manager, GstMessage * msg)
+{
+  guint i;
+
+  switch (GST_MESSAGE_TYPE (msg)) {
+    case GST_MESSAGE_ERROR:
+    {
+      for (i = 0; i < manager->max_sources; i++) {
+        SourceSlot *slot = &manager->slots[i];
+        if (!slot->bin || !gst_object_has_as_ancestor (GST_MESSAGE_SRC (msg),
+                GST_OBJECT (slot->bin)))
+          continue;
+
+        gchar *debug;
+        GError *error;
+        gst_message_parse_error (msg, &error, &debug);
+        g_printerr ("ERROR from stream %u (%s): %s\n", slot->id, slot->uri,
+            error->message);
+        g_free (debug);
+        g_error_free (error);
+
+        if (slot->live)
+          schedule_reconnect (manager, slot);
+        else
+          source_manager_remove (manager, slot->id);
+        return TRUE;
+      }
+      break;
+    }
+#ifndef PLATFORM_TEGRA
+    case GST_MESSAGE_ELEMENT:
+    {
+      guint stream_id, mux;
+      if (!gst_nvmessage_is_stream_eos (msg) ||
+          !gst_nvmessage_parse_stream_eos (msg, &stream_id))
+        break;
+      /* Each streammux numbers its own pads */
+      for (mux = 0; mux < manager->num_muxes; mux++)
+        if (GST_MESSAGE_SRC (msg) == GST_OBJECT (manager->streammuxes[mux]))
+          break;
+      stream_id = stream_id * manager->num_muxes + mux;
+      /* End of a file is the normal end of the run, only cameras come back */
+      if (mux < manager->num_muxes && stream_id < manager->max_sources &&
+          manager->slots[stream_id].live) {
+        g_print ("Got EOS from stream %d\n", stream_id);
+        schedule_reconnect (manager, &manager->slots[stream_id]);
+        return TRUE;
+      }
+      break;
+    }
+#endif
+    default:
+      break;
+  }
+  return FALSE;
+}
+
+static gboolean
+stdin_cb (GIOChannel * channel, GIOCondition condition, gpointer data)
+{
+  SourceManager *manager = (SourceManager *) data;
+  gchar *line = NULL;
+  gchar **args;
+  guint i;
+
+  if (condition & (G_IO_HUP | G_IO_ERR) ||
+      g_io_channel_read_line (channel, &line, NULL, NULL, NULL) !=
+      G_IO_STATUS_NORMAL) {
+    g_free (line);
+    manager->stdin_watch_id = 0;
+    return G_SOURCE_REMOVE;
+  }
+
+  args = g_strsplit (g_strstrip (line), " ", 2);
+  if (!g_strcmp0 (args[0], "add") && args[1]) {
+    gint id = source_manager_add (manager, g_strstrip (args[1]));
+    if (id >= 0)
+      g_print ("Added stream %d: %s\n", id, args[1]);
+  } else if (!g_strcmp0 (args[0], "remove") && args[1]) {
+    guint id = (guint) g_ascii_strtoull (args[1], NULL, 10);
+    if (source_manager_remove (manager, id))
+      g_print ("Removed stream %u\n", id);
+    else
+      g_printerr ("No stream %s\n", args[1]);
+  } else if (!g_strcmp0 (args[0], "list")) {
+    for (i = 0; i < manager->max_sources; i++)
+      if (manager->slots[i].uri)
+        g_print ("%u %s%s\n", i, manager->slots[i].uri,
+            manager->slots[i].retry_id ? " (reconnecting)" : "");
+  } else if (args[0] && *args[0]) {
+    g_printerr ("Commands: add <uri> | remove <id> | list\n");
+  }
+
+  g_strfreev (args);
+  g_free (line);
+  return G_SOURCE_CONTINUE;
+}
+
+void
+source_manager_watch_stdin (SourceManager * manager)
+{
+  manager->stdin_channel = g_io_channel_unix_new (STDIN_FILENO);
+  manager->stdin_watch_id = g_io_add_watch (manager->stdin_channel,
+      (GIOCondition) (G_IO_IN | G_IO_HUP | G_IO_ERR), stdin_cb, manager);
+}
+
+guint
+source_manager_num_active (SourceManager * manager)
+{
+  guint i, count = 0;
+
+  for (i = 0; i < manager->max_sources; i++)
+    if (manager->slots[i].uri)
+      count++;
+  return count;
+}
+
+void
+source_manager_free (SourceManager * manager)
+{
+  guint i;
+
+  if (!manager)
+    return;
+
+  if (manager->stdin_watch_id)
+    g_source_remove (manager->stdin_watch_id);
+  if (manager->stdin_channel)
+    g_io_channel_unref (manager->stdin_channel);
+
+  /* The bins belong to the pipeline */
+  for (i = 0; i < manager->max_sources; i++) {
+    if (manager->slots[i].retry_id)
+      g_source_remove (manager->slots[i].retry_id);
+    g_free (manager->slots[i].uri);
+  }
+  g_free (manager->slots);
+  g_free (manager->streammuxes);
+  g_free (manager);
+}
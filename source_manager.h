@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __SOURCE_MANAGER_H__
+#define __SOURCE_MANAGER_H__
+
+#include <gst/gst.h>
+
+/* Reconnect delay of a failed live source, doubled on every failure up to
+ * the maximum. A source that ran for SOURCE_STABLE_SEC starts over. */
+#define SOURCE_RETRY_MIN_SEC 1
+#define SOURCE_RETRY_MAX_SEC 60
+#define SOURCE_STABLE_SEC 30
+
+typedef struct _SourceManager SourceManager;
+
+/* Owns the source bins linked to the streammux sink pads. Slot id is
+ * spread over the muxes: mux id % num_muxes, pad sink_<id / num_muxes>.
+ * With one mux the slot index is the pad_index seen downstream. With
+ * several, mux i is GPU i and the decoders run there too. */
+SourceManager *source_manager_new (GstElement * pipeline,
+    GstElement ** streammuxes, guint num_muxes, guint max_sources);
+
+/* Links a new source bin to a free slot on the least loaded mux and syncs it
+ * with the pipeline state, so it works before and while PLAYING. Returns
+ * the slot or -1. */
+gint source_manager_add (SourceManager * manager, const gchar * uri);
+
+/* Stops the bin and releases its streammux pad, the other streams keep
+ * running. */
+gboolean source_manager_remove (SourceManager * manager, guint id);
+
+/* Errors from inside a source bin tear it down: live sources reconnect with
+ * backoff, files are removed. Per stream EOS of a live source reconnects it,
+ * files keep the normal EOS handling. Returns TRUE when the message was
+ * consumed. */
+gboolean source_manager_handle_message (SourceManager * manager,
+    GstMessage * msg);
+
+/* "add <uri>", "remove <id>" and "list" commands, one per line on stdin. */
+void source_manager_watch_stdin (SourceManager * manager);
+
+guint source_manager_num_active (SourceManager * manager);
+
+void source_manager_free (SourceManager * manager);
+
+/* uridecodebin wrapped in a "source-bin-<index>" bin, its ghost "src" pad is
+ * targeted at the NVMM decoder pad once decodebin has plugged it. gpu_id -1
+ * leaves the decoder on its default device. */
+GstElement *source_manager_create_bin (guint index, const gchar * uri,
+    gint gpu_id);
+
+#endif
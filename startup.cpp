@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "startup.h"
+
+#include <dlfcn.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include "gstnvdsmeta.h"
+#include "nvdsinfer_custom_impl_Yolo/yoloWarmup.h"
+
+/* Microseconds since start, -1 until reached */
+typedef struct
+{
+  gint64 first_frame_us;
+  gint64 first_detection_us;
+} StreamStartup;
+
+struct _Startup
+{
+  gint64 start_us;
+  guint timeout_sec;
+  guint timer_id;
+  GMainLoop *loop;
+  gboolean timed_out;
+
+  /* Phases come from the main thread, streams from every branch's
+   * streaming thread */
+  std::mutex lock;
+  std::map<std::string, gint64> phases;
+  std::map<guint, StreamStartup> streams;
+};
+
+/* One per probed pad */
+typedef struct
+{
+  Startup *startup;
+  gint person_class_id;
+  guint stream_offset;
+  guint stream_stride;
+} StartupPad;
+
+static void
+mark_phase (Startup * startup, const gchar * phase)
+{
+  gint64 elapsed_us = g_get_monotonic_time () - startup->start_us;
+
+  {
+    std::lock_guard<std::mutex> lock (startup->lock);
+    startup->phases[phase] = elapsed_us;
+  }
+  g_print ("**STARTUP: %s after %.3f s\n", phase, elapsed_us / 1e6);
+}
+
+static gboolean
+timeout_cb (gpointer data)
+{
+  Startup *startup = (Startup *) data;
+
+  startup->timer_id = 0;
+  {
+    std::lock_guard<std::mutex> lock (startup->lock);
+    if (!startup->streams.empty ())
+      return G_SOURCE_REMOVE;
+  }
+  g_printerr ("No frame analyzed %u s after start, quitting\n",
+      startup->timeout_sec);
+  startup->timed_out = TRUE;
+  g_main_loop_quit (startup->loop);
+  return G_SOURCE_REMOVE;
+}
+
+static GstPadProbeReturn
+startup_probe (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  StartupPad *startup_pad = (StartupPad *) u_data;
+  Startup *startup = startup_pad->startup;
+  NvDsBatchMeta *batch_meta =
+      gst_buffer_get_nvds_batch_meta ((GstBuffer *) info->data);
+  gint64 now_us = g_get_monotonic_time () - startup->start_us;
+
+  if (!batch_meta)
+    return GST_PAD_PROBE_OK;
+
+  std::lock_guard<std::mutex> lock (startup->lock);
+  for (NvDsMetaList * l_frame = batch_meta->frame_meta_list; l_frame != NULL;
+      l_frame = l_frame->next) {
+    NvDsFrameMeta *frame_meta = (NvDsFrameMeta *) (l_frame->data);
+    guint id = frame_meta->pad_index * startup_pad->stream_stride +
+        startup_pad->stream_offset;
+    StreamStartup & stream =
+        startup->streams.emplace (id, StreamStartup { -1, -1 }).first->second;
+
+    /* Done with this stream, the objects are not looked at again */
+    if (stream.first_detection_us >= 0)
+      continue;
+    if (stream.first_frame_us < 0) {
+      stream.first_frame_us = now_us;
+      g_print ("**STARTUP: stream %u first frame after %.3f s\n", id,
+          now_us / 1e6);
+    }
+    for (NvDsMetaList * l_obj = frame_meta->obj_meta_list; l_obj != NULL;
+        l_obj = l_obj->next) {
+      NvDsObjectMeta *obj_meta = (NvDsObjectMeta *) (l_obj->data);
+      if (obj_meta->class_id == startup_pad->person_class_id) {
+        stream.first_detection_us = now_us;
+        g_print ("**STARTUP: stream %u first detection after %.3f s\n", id,
+            now_us / 1e6);
+        break;
+      }
+    }
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+Startup *
+startup_new (gint64 start_us, guint timeout_sec, GMainLoop * loop)
+{
+  Startup *startup = new Startup ();
+
+  startup->start_us = start_us;
+  startup->timeout_sec = timeout_sec;
+  startup->timer_id = 0;
+  startup->loop = loop;
+  startup->timed_out = FALSE;
+  return startup;
+}
+
+gboolean
+startup_preroll (Startup * startup, GstElement * pipeline)
+{
+  /* Returns ASYNC as the sinks wait for a first buffer, every other
+   * element has gone through its start by then */
+  if (gst_element_set_state (pipeline, GST_STATE_PAUSED) ==
+      GST_STATE_CHANGE_FAILURE) {
+    g_printerr ("Failed to preroll the pipeline\n");
+    return FALSE;
+  }
+  mark_phase (startup, "preroll");
+  return TRUE;
+}
+
+void
+startup_warmup (Startup * startup, const gchar * yolo_lib_path,
+    GstElement * pgie, guint iterations)
+{
+  void *lib = NULL;
+  NvDsInferYoloWarmupFunc warmup = NULL;
+  NvDsInferYoloWarmupStats stats;
+  gchar *engine = NULL;
+  guint gpu_id = 0;
+  gchar *phase;
+
+  /* The copy nvinfer loaded during the preroll, never a second one */
+  if (yolo_lib_path)
+    lib = dlopen (yolo_lib_path, RTLD_LAZY | RTLD_NOLOAD);
+  if (lib)
+    warmup = (NvDsInferYoloWarmupFunc) dlsym (lib, YOLO_WARMUP_FUNC_NAME);
+  if (!warmup) {
+    g_print ("No warm-up for %s, its custom library has no %s\n",
+        GST_ELEMENT_NAME (pgie), YOLO_WARMUP_FUNC_NAME);
+    if (lib)
+      dlclose (lib);
+    return;
+  }
+
+  /* The device nvinfer runs on, set by the config or per branch */
+  g_object_get (G_OBJECT (pgie), "model-engine-file", &engine, "gpu-id",
+      &gpu_id, NULL);
+  if (engine && !g_file_test (engine, G_FILE_TEST_IS_REGULAR))
+    g_clear_pointer (&engine, g_free);
+
+  if (warmup (engine, gpu_id, iterations, &stats)) {
+    g_print ("**STARTUP: %s warm-up  engine %.1f ms  context %.1f ms  "
+        "first inference %.1f ms  then %.2f ms  (%u inferences at %u batch "
+        "sizes)\n", GST_ELEMENT_NAME (pgie), stats.loadMs, stats.contextMs,
+        stats.firstInferenceMs, stats.inferenceMs, stats.inferences,
+        stats.batchSizes);
+    phase = g_strdup_printf ("warmup-gpu%u", gpu_id);
+    mark_phase (startup, phase);
+    g_free (phase);
+  } else {
+    g_print ("No warm-up for %s, no engine to run\n", GST_ELEMENT_NAME (pgie));
+  }
+  g_free (engine);
+  dlclose (lib);
+}
+
+void
+startup_attach (Startup * startup, GstPad * pad, gint person_class_id,
+    guint stream_offset, guint stream_stride)
+{
+  StartupPad *startup_pad = g_new0 (StartupPad, 1);
+
+  startup_pad->startup = startup;
+  startup_pad->person_class_id = person_class_id;
+  startup_pad->stream_offset = stream_offset;
+  startup_pad->stream_stride = MAX (stream_stride, 1);
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, startup_probe,
+      startup_pad, g_free);
+}
+
+void
+startup_playing (Startup * startup)
+{
+  gint64 elapsed_ms =
+      (g_get_monotonic_time () - startup->start_us) / 1000;
+
+  mark_phase (startup, "playing");
+  if (startup->timeout_sec > 0)
+    startup->timer_id = g_timeout_add (MAX ((gint64) startup->timeout_sec *
+            1000 - elapsed_ms, 0), timeout_cb, startup);
+}
+
+gboolean
+startup_timed_out (Startup * startup)
+{
+  return startup && startup->timed_out;
+}
+
+void
+startup_append_prometheus (Startup * startup, GString * out)
+{
+  std::lock_guard<std::mutex> lock (startup->lock);
+
+  g_string_append (out, "# TYPE tpd_startup_seconds gauge\n");
+  for (auto & phase : startup->phases)
+    g_string_append_printf (out, "tpd_startup_seconds{phase=\"%s\"} %.6f\n",
+        phase.first.c_str (), phase.second / 1e6);
+
+  /* One contiguous group per family */
+  g_string_append (out, "# TYPE tpd_first_frame_seconds gauge\n");
+  for (auto & stream : startup->streams)
+    g_string_append_printf (out,
+        "tpd_first_frame_seconds{stream=\"%u\"} %.6f\n", stream.first,
+        stream.second.first_frame_us / 1e6);
+
+  g_string_append (out, "# TYPE tpd_first_detection_seconds gauge\n");
+  for (auto & stream : startup->streams)
+    if (stream.second.first_detection_us >= 0)
+      g_string_append_printf (out,
+          "tpd_first_detection_seconds{stream=\"%u\"} %.6f\n", stream.first,
+          stream.second.first_detection_us / 1e6);
+}
+
+void
+startup_free (Startup * startup)
+{
+  if (!startup)
+    return;
+
+  if (startup->timer_id)
+    g_source_remove (startup->timer_id);
+  delete startup;
+}
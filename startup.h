@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __STARTUP_H__
+#define __STARTUP_H__
+
+#include <gst/gst.h>
+
+/* Dummy inferences per batch size of the warm-up. */
+#define STARTUP_WARMUP_ITERATIONS 3
+
+typedef struct _Startup Startup;
+
+/* Times the startup from start_us, taken at the top of main: engine load,
+ * warm-up, PLAYING, and per stream the first analyzed frame and the first
+ * detection. With timeout_sec > 0 the loop is quit with an error when no
+ * frame got through nvdsanalytics by then, so a supervisor restarts a
+ * pipeline that came back stuck. */
+Startup *startup_new (gint64 start_us, guint timeout_sec, GMainLoop * loop);
+
+/* Brings pipeline to PAUSED before any source is linked: every nvinfer
+ * deserializes its engine and creates its CUDA context here instead of on
+ * the first buffers. FALSE when an element failed to start. */
+gboolean startup_preroll (Startup * startup, GstElement * pipeline);
+
+/* Runs iterations dummy inferences at every profile batch size of the
+ * engine pgie loaded on its gpu-id, through the YOLO custom library nvinfer
+ * has loaded from yolo_lib_path. Only a note when the library or the
+ * engine are not available, the pipeline starts cold then. */
+void startup_warmup (Startup * startup, const gchar * yolo_lib_path,
+    GstElement * pgie, guint iterations);
+
+/* Records the first frame and the first object of person_class_id of every
+ * stream crossing pad, downstream of nvdsanalytics. Streams are identified
+ * as pad_index * stream_stride + stream_offset. */
+void startup_attach (Startup * startup, GstPad * pad, gint person_class_id,
+    guint stream_offset, guint stream_stride);
+
+/* Call right after setting the pipeline to PLAYING, arms the timeout. */
+void startup_playing (Startup * startup);
+
+/* TRUE when the timeout quit the loop. */
+gboolean startup_timed_out (Startup * startup);
+
+/* The phases and per stream times reached so far as Prometheus gauges. */
+void startup_append_prometheus (Startup * startup, GString * out);
+
+void startup_free (Startup * startup);
+
+#endif
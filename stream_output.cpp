@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "stream_output.h"
+
+#include <atomic>
+#include <gst/rtsp-server/rtsp-server.h>
+#include <gst/video/video.h>
+
+struct _StreamOutput
+{
+  GstRTSPServer *server;
+  guint server_id;
+  GstElement *encoder;
+
+  /* Prepared RTSP media, updated by the RTSP server on the main loop, read
+   * by the streaming thread of the encoder queue */
+  std::atomic<gint> viewers;
+  std::atomic<bool> key_unit_pending;
+};
+
+gboolean
+stream_output_type_from_string (const gchar * str, StreamOutputType * type)
+{
+  if (!g_strcmp0 (str, "display"))
+    *type = STREAM_OUTPUT_DISPLAY;
+  else if (!g_strcmp0 (str, "rtsp"))
+    *type = STREAM_OUTPUT_RTSP;
+  else if (!g_strcmp0 (str, "file"))
+    *type = STREAM_OUTPUT_FILE;
+  else
+    return FALSE;
+  return TRUE;
+}
+
+/* Nothing reaches the encoder without prepared media. The first batch
+ * after it is prepared asks for a key frame so the client can start
+ * decoding. */
+static GstPadProbeReturn
+viewer_gate_probe (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  StreamOutput *output = (StreamOutput *) u_data;
+
+  if (output->viewers.load () == 0) {
+    output->key_unit_pending = true;
+    return GST_PAD_PROBE_DROP;
+  }
+
+  if (output->key_unit_pending.exchange (false)) {
+    GstPad *enc_src = gst_element_get_static_pad (output->encoder, "src");
+    gst_pad_send_event (enc_src,
+        gst_video_event_new_upstream_force_key_unit (GST_CLOCK_TIME_NONE,
+            TRUE, 0));
+    gst_object_unref (enc_src);
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+media_unprepared (GstRTSPMedia * media, gpointer user_data)
+{
+  StreamOutput *output = (StreamOutput *) user_data;
+
+  if (--output->viewers == 0)
+    g_print ("RTSP: last viewer left, encoding paused\n");
+}
+
+static void
+media_prepared (GstRTSPMedia * media, gpointer user_data)
+{
+  StreamOutput *output = (StreamOutput *) user_data;
+
+  if (output->viewers++ == 0)
+    g_print ("RTSP: viewer connected, encoding\n");
+}
+
+/* A client that connects without asking for the stream, or keeps its
+ * connection after the teardown, does not keep the encoder running. The media is
+ * shared, it is prepared for the first viewer and unprepared after the
+ * last one. */
+static void
+media_configure (GstRTSPMediaFactory * factory, GstRTSPMedia * media,
+    gpointer user_data)
+{
+  g_signal_connect (media, "prepared", G_CALLBACK (media_prepared),
+      user_data);
+  g_signal_connect (media, "unprepared", G_CALLBACK (media_unprepared),
+      user_data);
+}
+
+static gboolean
+start_rtsp_server (StreamOutput * output, const StreamOutputConfig * config)
+{
+  GstRTSPMountPoints *mounts;
+  GstRTSPMediaFactory *factory;
+  gchar *port = g_strdup_printf ("%u", config->rtsp_port);
+  gchar *launch = g_strdup_printf ("( udpsrc name=pay0 port=%d "
+      "buffer-size=524288 caps=\"application/x-rtp, media=video, "
+      "clock-rate=90000, encoding-name=%s, payload=96\" )",
+      STREAM_OUTPUT_UDP_PORT, config->h265 ? "H265" : "H264");
+
+  output->server = gst_rtsp_server_new ();
+  g_object_set (output->server, "service", port, NULL);
+  g_free (port);
+
+  factory = gst_rtsp_media_factory_new ();
+  gst_rtsp_media_factory_set_launch (factory, launch);
+  gst_rtsp_media_factory_set_shared (factory, TRUE);
+  g_signal_connect (factory, "media-configure", G_CALLBACK (media_configure),
+      output);
+  g_free (launch);
+
+  mounts = gst_rtsp_server_get_mount_points (output->server);
+  gst_rtsp_mount_points_add_factory (mounts, STREAM_OUTPUT_RTSP_MOUNT,
+      factory);
+  g_object_unref (mounts);
+
+  output->server_id = gst_rtsp_server_attach (output->server, NULL);
+  if (!output->server_id) {
+    g_printerr ("Failed to start the RTSP server on port %u\n",
+        config->rtsp_port);
+    return FALSE;
+  }
+  g_print ("Streaming at rtsp://localhost:%u" STREAM_OUTPUT_RTSP_MOUNT "\n",
+      config->rtsp_port);
+  return TRUE;
+}
+
+StreamOutput *
+stream_output_new (GstElement * pipeline, GstElement * upstream,
+    const StreamOutputConfig * config)
+{
+  GstElement *tee, *sink, *queue, *conv, *caps, *encoder, *parser, *out;
+  GstElement *pay = NULL, *muxer = NULL;
+  GstCaps *raw_caps;
+  GstPad *queue_src;
+
+  tee = gst_element_factory_make ("tee", "output-tee");
+  sink = gst_element_factory_make ("fakesink", "nvvideo-renderer");
+  queue = gst_element_factory_make ("queue", "output-queue");
+  conv = gst_element_factory_make ("nvvideoconvert", "output-converter");
+  caps = gst_element_factory_make ("capsfilter", "output-caps");
+  encoder = gst_element_factory_make (config->h265 ? "nvv4l2h265enc" :
+      "nvv4l2h264enc", "output-encoder");
+  parser = gst_element_factory_make (config->h265 ? "h265parse" : "h264parse",
+      "output-parser");
+  if (config->type == STREAM_OUTPUT_RTSP) {
+    pay = gst_element_factory_make (config->h265 ? "rtph265pay" :
+        "rtph264pay", "output-payloader");
+    out = gst_element_factory_make ("udpsink", "output-sink");
+  } else {
+    muxer = gst_element_factory_make ("mp4mux", "output-muxer");
+    out = gst_element_factory_make ("splitmuxsink", "output-sink");
+  }
+
+  if (!tee || !sink || !queue || !conv || !caps || !encoder || !parser ||
+      !out || (config->type == STREAM_OUTPUT_RTSP ? !pay : !muxer)) {
+    g_printerr ("Failed to create the %s output. Exiting.\n",
+        config->type == STREAM_OUTPUT_RTSP ? "RTSP" : "file");
+    return NULL;
+  }
+
+  /* leaky=downstream drops the oldest batch instead of blocking the tee */
+  g_object_set (G_OBJECT (queue), "leaky", 2, "max-size-buffers",
+      STREAM_OUTPUT_QUEUE_BUFFERS, "max-size-bytes", 0, "max-size-time",
+      (guint64) 0, NULL);
+  g_object_set (G_OBJECT (sink), "qos", 0, NULL);
+
+  raw_caps = gst_caps_from_string ("video/x-raw(memory:NVMM), format=I420");
+  g_object_set (G_OBJECT (caps), "caps", raw_caps, NULL);
+  gst_caps_unref (raw_caps);
+
+  g_object_set (G_OBJECT (encoder), "bitrate", config->bitrate,
+      "iframeinterval", config->gop, NULL);
+#ifdef PLATFORM_TEGRA
+  g_object_set (G_OBJECT (encoder), "preset-level", 1, "insert-sps-pps", 1,
+      NULL);
+#else
+  g_object_set (G_OBJECT (conv), "gpu-id", config->gpu_id, NULL);
+  g_object_set (G_OBJECT (encoder), "gpu-id", config->gpu_id, NULL);
+#endif
+  /* Parameter sets with every key frame, viewers join at any time */
+  g_object_set (G_OBJECT (parser), "config-interval", -1, NULL);
+
+  if (config->type == STREAM_OUTPUT_RTSP) {
+    g_object_set (G_OBJECT (out), "host", "127.0.0.1", "port",
+        STREAM_OUTPUT_UDP_PORT, "sync", FALSE, "async", FALSE, NULL);
+  } else {
+    g_object_set (G_OBJECT (out), "location", config->location, "muxer",
+        muxer, "max-size-time",
+        (guint64) config->segment_sec * GST_SECOND,
+        "send-keyframe-requests", TRUE, NULL);
+  }
+
+  gst_bin_add_many (GST_BIN (pipeline), tee, sink, queue, conv, caps, encoder,
+      parser, out, NULL);
+  if (pay)
+    gst_bin_add (GST_BIN (pipeline), pay);
+  if (!gst_element_link (upstream, tee) || !gst_element_link (tee, sink) ||
+      !gst_element_link_many (tee, queue, conv, caps, encoder, parser, NULL) ||
+      (pay ? !gst_element_link_many (parser, pay, out, NULL) :
+          !gst_element_link (parser, out))) {
+    g_printerr ("Failed to link the output. Exiting.\n");
+    return NULL;
+  }
+
+  StreamOutput *output = new StreamOutput ();
+  output->server = NULL;
+  output->server_id = 0;
+  output->encoder = encoder;
+  output->viewers = 0;
+  output->key_unit_pending = false;
+
+  if (config->type == STREAM_OUTPUT_RTSP) {
+    if (!start_rtsp_server (output, config)) {
+      stream_output_free (output);
+      return NULL;
+    }
+    queue_src = gst_element_get_static_pad (queue, "src");
+    gst_pad_add_probe (queue_src, GST_PAD_PROBE_TYPE_BUFFER,
+        viewer_gate_probe, output, NULL);
+    gst_object_unref (queue_src);
+  }
+  return output;
+}
+
+void
+stream_output_free (StreamOutput * output)
+{
+  if (!output)
+    return;
+
+  if (output->server_id)
+    g_source_remove (output->server_id);
+  if (output->server)
+    g_object_unref (output->server);
+  delete output;
+}
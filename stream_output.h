@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __STREAM_OUTPUT_H__
+#define __STREAM_OUTPUT_H__
+
+#include <gst/gst.h>
+
+/* Batches the encoder may fall behind before its queue drops the oldest,
+ * back-pressure never reaches the OSD. */
+#define STREAM_OUTPUT_QUEUE_BUFFERS 4
+
+/* Loopback port between the udpsink of the pipeline and the udpsrc of the
+ * RTSP media. */
+#define STREAM_OUTPUT_UDP_PORT 5400
+
+#define STREAM_OUTPUT_RTSP_MOUNT "/track-person-detect"
+
+typedef enum
+{
+  STREAM_OUTPUT_DISPLAY,
+  STREAM_OUTPUT_RTSP,
+  STREAM_OUTPUT_FILE,
+} StreamOutputType;
+
+typedef struct
+{
+  StreamOutputType type;
+  gboolean h265;
+  guint bitrate;
+  guint gop;
+  guint gpu_id;
+  guint rtsp_port;
+  /* splitmuxsink location, e.g. "out-%05d.mp4" */
+  const gchar *location;
+  guint segment_sec;
+} StreamOutputConfig;
+
+typedef struct _StreamOutput StreamOutput;
+
+/* "display", "rtsp" or "file". */
+gboolean stream_output_type_from_string (const gchar * str,
+    StreamOutputType * type);
+
+/* Links upstream -> tee -> fakesink and tee -> leaky queue -> nvvideoconvert
+ * -> NVENC -> parser, into an RTSP server or MP4 segments. The fakesink
+ * keeps the clock sync a display sink would. RTSP only encodes while its
+ * media is prepared for a viewer. Not for STREAM_OUTPUT_DISPLAY. */
+StreamOutput *stream_output_new (GstElement * pipeline, GstElement * upstream,
+    const StreamOutputConfig * config);
+
+void stream_output_free (StreamOutput * output);
+
+#endif
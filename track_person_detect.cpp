@@ -26,13 +26,27 @@
 #include <math.h>
 #include <string.h>
 #include <sys/time.h>
+#include <unistd.h>
 #include <iostream>
 #include <vector>
 #include <unordered_map>
-#include <sstream>
 #include <cuda_runtime_api.h>
 #include "gstnvdsmeta.h"
 #include "nvds_analytics_meta.h"
+#include "metrics_sink.h"
+#include "analytics_meta.h"
+#include "perf_stats.h"
+#include "source_manager.h"
+#include "adaptive_interval.h"
+#include "roi_preprocess.h"
+#include "roi_filter.h"
+#include "benchmark.h"
+#include "multi_gpu.h"
+#include "roi_aggregator.h"
+#include "snapshot.h"
+#include "stream_output.h"
+#include "pipeline_config.h"
+#include "startup.h"
 #ifndef PLATFORM_TEGRA
 #include "gst-nvmessage.h"
 #endif
@@ -41,99 +55,184 @@
 
 #define PGIE_CLASS_ID_PERSON 0
 
-/* The muxer output resolution must be set if the input streams will be of
- * different resolution. The muxer will scale all the input frames to this
- * resolution. */
-#define MUXER_OUTPUT_WIDTH 1920
-#define MUXER_OUTPUT_HEIGHT 1080
-
-/* Muxer batch formation timeout, for e.g. 40 millisec. Should ideally be set
- * based on the fastest source's framerate. */
-#define MUXER_BATCH_TIMEOUT_USEC 4000000
-
 #define TILED_OUTPUT_WIDTH 1920
 #define TILED_OUTPUT_HEIGHT 1080
 
-/* NVIDIA Decoder source pad memory feature. This feature signifies that source
- * pads having this capability will push GstBuffers containing cuda buffers. */
-#define GST_CAPS_FEATURES_NVMM "memory:NVMM"
-
 gchar pgie_classes_str[1][32] = { "person",};
 
-
-/* nvdsanalytics_src_pad_buffer_probe  will extract metadata received on tiler sink pad
- * and extract nvanalytics metadata etc. */
-static GstPadProbeReturn
-nvdsanalytics_src_pad_buffer_probe (GstPad * pad, GstPadProbeInfo * info,
-    gpointer u_data)
+static gchar *metrics_format_str = NULL;
+static gchar *metrics_file = NULL;
+static guint perf_interval = 0;
+static guint perf_port = 0;
+static gboolean headless = FALSE;
+static guint max_sources = 0;
+static guint adaptive_max_interval = 0;
+static guint idle_seconds = 10;
+static gboolean roi_crop = FALSE;
+static guint roi_crop_margin = 64;
+static gboolean roi_prefilter = FALSE;
+static gchar *pgie_config = NULL;
+static guint benchmark_streams = 0;
+static guint benchmark_duration = 30;
+static gboolean benchmark_sweep_mode = FALSE;
+static gdouble benchmark_target_fps = 30;
+static guint benchmark_max_streams = 64;
+static guint num_gpus = 1;
+static guint roi_summary_interval = 0;
+static guint roi_summary_window = 60;
+static gchar *roi_summary_file = NULL;
+static gchar *snapshot_dir = NULL;
+static gchar *snapshot_roi = NULL;
+static guint snapshot_quality = 80;
+static gchar *output_str = NULL;
+static gchar *output_codec = NULL;
+static guint output_bitrate = 4000000;
+static guint output_gop = 30;
+static guint rtsp_port = 8554;
+static gchar *output_location = NULL;
+static guint output_segment_sec = 60;
+static gchar *pipeline_config_path = NULL;
+static gchar *pipeline_preset = NULL;
+static gchar *tracker_type = NULL;
+static guint warmup_iterations = STARTUP_WARMUP_ITERATIONS;
+static guint startup_timeout = 0;
+
+/* Queue sizes and the streammux output resolution, batch timeout and live
+ * mode. The muxer scales every input to its resolution, the batch timeout
+ * should follow the fastest source's framerate. */
+static PipelineConfig pipeline_settings;
+
+static SourceManager *sources = NULL;
+
+static GOptionEntry entries[] = {
+  {"metrics-format", 0, 0, G_OPTION_ARG_STRING, &metrics_format_str,
+      "Per frame ROI metrics format: json (default), csv, binary or none",
+      "FORMAT"},
+  {"metrics-file", 0, 0, G_OPTION_ARG_FILENAME, &metrics_file,
+      "Write the metrics to this file instead of stdout", "PATH"},
+  {"perf-interval", 0, 0, G_OPTION_ARG_INT, &perf_interval,
+      "Print per element latency, per stream FPS, queue levels and YOLO "
+      "kernel times every SECONDS", "SECONDS"},
+  {"perf-port", 0, 0, G_OPTION_ARG_INT, &perf_port,
+      "Serve the same statistics as Prometheus text on this port", "PORT"},
+  {"headless", 0, 0, G_OPTION_ARG_NONE, &headless,
+      "End the pipeline after nvdsanalytics in a fakesink, no tiling, OSD "
+      "or display", NULL},
+  {"max-sources", 0, 0, G_OPTION_ARG_INT, &max_sources,
+      "Batch size and number of streams that can be attached at runtime "
+      "with 'add <uri>' on stdin, defaults to the number of uris", "N"},
+  {"adaptive-interval", 0, 0, G_OPTION_ARG_INT, &adaptive_max_interval,
+      "Skip up to N frames between inferences while no stream has a person, "
+      "0 runs inference on every frame", "N"},
+  {"idle-seconds", 0, 0, G_OPTION_ARG_INT, &idle_seconds,
+      "Seconds without a person before each increase of the interval "
+      "(default 10)", "SECONDS"},
+  {"roi-crop", 0, 0, G_OPTION_ARG_NONE, &roi_crop,
+      "Run inference only on the bounding box of each stream's "
+      "nvdsanalytics ROIs, through nvdspreprocess", NULL},
+  {"roi-crop-margin", 0, 0, G_OPTION_ARG_INT, &roi_crop_margin,
+      "Pixels added around the ROI bounding box (default 64), people "
+      "standing in the ROI stick out of it", "PIXELS"},
+  {"roi-prefilter", 0, 0, G_OPTION_ARG_NONE, &roi_prefilter,
+      "Drop detections outside the nvdsanalytics ROIs before nvtracker",
+      NULL},
+  {"pgie-config", 0, 0, G_OPTION_ARG_FILENAME, &pgie_config,
+      "nvinfer config file (default nvdsanalytics_pgie_config.txt)", "PATH"},
+  {"benchmark-streams", 0, 0, G_OPTION_ARG_INT, &benchmark_streams,
+      "Decode the uri (default video.mp4, or videotestsrc) once, feed it to N "
+      "streams headless and report sustained FPS, GPU use and latency", "N"},
+  {"benchmark-duration", 0, 0, G_OPTION_ARG_INT, &benchmark_duration,
+      "Seconds measured after the warm-up (default 30)", "SECONDS"},
+  {"benchmark-sweep", 0, 0, G_OPTION_ARG_NONE, &benchmark_sweep_mode,
+      "Rerun the benchmark with more streams until one falls below "
+      "--benchmark-target-fps", NULL},
+  {"benchmark-target-fps", 0, 0, G_OPTION_ARG_DOUBLE, &benchmark_target_fps,
+      "Real-time FPS every stream has to keep in the sweep (default 30)",
+      "FPS"},
+  {"benchmark-max-streams", 0, 0, G_OPTION_ARG_INT, &benchmark_max_streams,
+      "Upper bound of the sweep (default 64)", "N"},
+  {"gpus", 0, 0, G_OPTION_ARG_INT, &num_gpus,
+      "Deal the streams round robin over N GPUs, each with its own streammux, "
+      "nvinfer, nvtracker and nvdsanalytics, headless (default 1)", "N"},
+  {"roi-summary-interval", 0, 0, G_OPTION_ARG_INT, &roi_summary_interval,
+      "Every SECONDS, write per stream and ROI occupancy, enter/exit counts "
+      "and dwell time histograms of the tracked objects", "SECONDS"},
+  {"roi-summary-window", 0, 0, G_OPTION_ARG_INT, &roi_summary_window,
+      "Sliding window of the occupancy and enter/exit counts (default 60)",
+      "SECONDS"},
+  {"roi-summary-file", 0, 0, G_OPTION_ARG_FILENAME, &roi_summary_file,
+      "Write the ROI summaries to this file instead of stdout", "PATH"},
+  {"snapshot-dir", 0, 0, G_OPTION_ARG_FILENAME, &snapshot_dir,
+      "Save a JPEG crop of every person entering --snapshot-roi here, "
+      "encoded on the GPU off the main path", "DIR"},
+  {"snapshot-roi", 0, 0, G_OPTION_ARG_STRING, &snapshot_roi,
+      "nvdsanalytics ROI label that triggers a snapshot (default RF)", "NAME"},
+  {"snapshot-quality", 0, 0, G_OPTION_ARG_INT, &snapshot_quality,
+      "JPEG quality of the snapshots (default 80)", "QUALITY"},
+  {"output", 0, 0, G_OPTION_ARG_STRING, &output_str,
+      "Where the OSD goes: display (default), rtsp or file, the last two "
+      "encoded with NVENC", "TYPE"},
+  {"output-codec", 0, 0, G_OPTION_ARG_STRING, &output_codec,
+      "h264 (default) or h265", "CODEC"},
+  {"output-bitrate", 0, 0, G_OPTION_ARG_INT, &output_bitrate,
+      "Encoder bitrate in bits per second (default 4000000)", "BPS"},
+  {"output-gop", 0, 0, G_OPTION_ARG_INT, &output_gop,
+      "Frames between key frames (default 30)", "FRAMES"},
+  {"rtsp-port", 0, 0, G_OPTION_ARG_INT, &rtsp_port,
+      "Port of the RTSP server (default 8554)", "PORT"},
+  {"output-location", 0, 0, G_OPTION_ARG_FILENAME, &output_location,
+      "MP4 segment file pattern (default out-%05d.mp4)", "PATTERN"},
+  {"output-segment-sec", 0, 0, G_OPTION_ARG_INT, &output_segment_sec,
+      "Length of each MP4 segment (default 60)", "SECONDS"},
+  {"pipeline-config", 0, 0, G_OPTION_ARG_FILENAME, &pipeline_config_path,
+      "Queue sizes, leaky modes and streammux settings, see "
+      "config_pipeline.txt", "PATH"},
+  {"pipeline-preset", 0, 0, G_OPTION_ARG_STRING, &pipeline_preset,
+      "default, low-latency or max-throughput, --pipeline-config overrides "
+      "single values", "PRESET"},
+  {"tracker", 0, 0, G_OPTION_ARG_STRING, &tracker_type,
+      "nvdcf (default) or iou, replaces the [tracker] of --pipeline-config",
+      "TYPE"},
+  {"warmup-iterations", 0, 0, G_OPTION_ARG_INT, &warmup_iterations,
+      "Dummy inferences per engine batch size before the sources connect, "
+      "0 skips the warm-up (default 3)", "N"},
+  {"startup-timeout", 0, 0, G_OPTION_ARG_INT, &startup_timeout,
+      "Exit with an error when no frame was analyzed SECONDS after start, "
+      "for a supervisor to restart (default 0, no limit)", "SECONDS"},
+  {NULL},
+};
+
+/* Everything from streammux to the queue after nvdsanalytics, one per GPU.
+ * Element names get a -gpu<N> suffix past the first GPU. */
+typedef struct
 {
-    GstBuffer *buf = (GstBuffer *) info->data;
-    guint num_rects = 0;
-    NvDsObjectMeta *obj_meta = NULL;
-    guint vehicle_count = 0;
-    guint person_count = 0;
-    NvDsMetaList * l_frame = NULL;
-    NvDsMetaList * l_obj = NULL;
-
-    NvDsBatchMeta *batch_meta = gst_buffer_get_nvds_batch_meta (buf);
-
-    for (l_frame = batch_meta->frame_meta_list; l_frame != NULL;
-      l_frame = l_frame->next) {
-        NvDsFrameMeta *frame_meta = (NvDsFrameMeta *) (l_frame->data);
-        std::stringstream out_string;
-        vehicle_count = 0;
-        num_rects = 0;
-        person_count = 0;
-        for (l_obj = frame_meta->obj_meta_list; l_obj != NULL;
-                l_obj = l_obj->next) {
-            obj_meta = (NvDsObjectMeta *) (l_obj->data);
-            if (obj_meta->class_id == PGIE_CLASS_ID_PERSON) {
-                person_count++;
-                num_rects++;
-            }
-
-            // Access attached user meta for each object
-            for (NvDsMetaList *l_user_meta = obj_meta->obj_user_meta_list; l_user_meta != NULL;
-                    l_user_meta = l_user_meta->next) {
-                NvDsUserMeta *user_meta = (NvDsUserMeta *) (l_user_meta->data);
-                if(user_meta->base_meta.meta_type == NVDS_USER_OBJ_META_NVDSANALYTICS)
-                {
-                    NvDsAnalyticsObjInfo * user_meta_data = (NvDsAnalyticsObjInfo *)user_meta->user_meta_data;
-                }
-            }
-        }
-
-        /* Iterate user metadata in frames to search analytics metadata */
-        for (NvDsMetaList * l_user = frame_meta->frame_user_meta_list;
-                l_user != NULL; l_user = l_user->next) {
-            NvDsUserMeta *user_meta = (NvDsUserMeta *) l_user->data;
-            if (user_meta->base_meta.meta_type != NVDS_USER_FRAME_META_NVDSANALYTICS)
-                continue;
-
-            /* convert to  metadata */
-            NvDsAnalyticsFrameMeta *meta =
-                (NvDsAnalyticsFrameMeta *) user_meta->user_meta_data;
-            /* Get the labels from nvdsanalytics config file */
-            for (std::pair<std::string, uint32_t> status : meta->objInROIcnt){
-                out_string << "Objs in ROI ";
-                out_string << status.first;
-                out_string << " = ";
-                out_string << status.second;
-            }
-        }
-        g_print ("Frame Number = %d of Stream = %d, Number of objects = %d "
-                "Person Count = %d %s\n",
-            frame_meta->frame_num, frame_meta->pad_index,
-            num_rects, person_count, out_string.str().c_str());
-    }
-    return GST_PAD_PROBE_OK;
-}
-
+  GstElement *streammux;
+  GstElement *queue1;
+  GstElement *preprocess;
+  GstElement *pgie;
+  GstElement *queue2;
+  GstElement *nvtracker;
+  GstElement *queue3;
+  GstElement *nvdsanalytics;
+  GstElement *queue4;
+  /* Where the rest of the pipeline links: queue4, or the snapshot tee */
+  GstElement *output;
+  gchar *analytics_config;
+  gchar *preprocess_config;
+  gchar *engine_file;
+  RoiFilter *roi_filter;
+  AdaptiveInterval *adaptive;
+} InferBranch;
 
 static gboolean
 bus_call (GstBus * bus, GstMessage * msg, gpointer data)
 {
   GMainLoop *loop = (GMainLoop *) data;
+
+  /* A failing camera must not stop the other streams */
+  if (sources && source_manager_handle_message (sources, msg))
+    return TRUE;
+
   switch (GST_MESSAGE_TYPE (msg)) {
     case GST_MESSAGE_EOS:
       g_print ("End of stream\n");
@@ -183,267 +282,557 @@ bus_call (GstBus * bus, GstMessage * msg, gpointer data)
   return TRUE;
 }
 
-static void
-cb_newpad (GstElement * decodebin, GstPad * decoder_src_pad, gpointer data)
+static GstElement *
+make_branch_element (const gchar * factory, const gchar * name,
+    guint gpu_index)
 {
-  g_print ("In cb_newpad\n");
-  GstCaps *caps = gst_pad_get_current_caps (decoder_src_pad);
-  const GstStructure *str = gst_caps_get_structure (caps, 0);
-  const gchar *name = gst_structure_get_name (str);
-  GstElement *source_bin = (GstElement *) data;
-  GstCapsFeatures *features = gst_caps_get_features (caps, 0);
-
-  /* Need to check if the pad created by the decodebin is for video and not
-   * audio. */
-  if (!strncmp (name, "video", 5)) {
-    /* Link the decodebin pad only if decodebin has picked nvidia
-     * decoder plugin nvdec_*. We do this by checking if the pad caps contain
-     * NVMM memory features. */
-    if (gst_caps_features_contains (features, GST_CAPS_FEATURES_NVMM)) {
-      /* Get the source bin ghost pad */
-      GstPad *bin_ghost_pad = gst_element_get_static_pad (source_bin, "src");
-      if (!gst_ghost_pad_set_target (GST_GHOST_PAD (bin_ghost_pad),
-              decoder_src_pad)) {
-        g_printerr ("Failed to link decoder src pad to source bin ghost pad\n");
-      }
-      gst_object_unref (bin_ghost_pad);
-    } else {
-      g_printerr ("Error: Decodebin did not pick nvidia decoder plugin.\n");
-    }
-  }
+  gchar *full_name = gpu_index ? g_strdup_printf ("%s-gpu%u", name, gpu_index)
+      : g_strdup (name);
+  GstElement *element = gst_element_factory_make (factory, full_name);
+  g_free (full_name);
+  return element;
 }
 
-static void
-decodebin_child_added (GstChildProxy * child_proxy, GObject * object,
-    gchar * name, gpointer user_data)
+/* Creates, configures and links the branch of one GPU into pipeline, up to
+ * queue4. batch_size is the number of streammux pads of this GPU. */
+static gboolean
+create_infer_branch (InferBranch * branch, GstElement * pipeline,
+    guint gpu_index, guint batch_size, gboolean live)
 {
-  g_print ("Decodebin child added: %s\n", name);
-  if (g_strrstr (name, "decodebin") == name) {
-    g_signal_connect (G_OBJECT (object), "child-added",
-        G_CALLBACK (decodebin_child_added), user_data);
+  const gchar *analytics_config = "config_nvdsanalytics.txt";
+  const StreammuxConfig *mux = &pipeline_settings.streammux;
+  guint pgie_batch_size;
+
+  branch->streammux = make_branch_element ("nvstreammux", "stream-muxer",
+      gpu_index);
+
+  /* Use nvinfer to infer on batched frame. */
+  branch->pgie = make_branch_element ("nvinfer", "primary-nvinference-engine",
+      gpu_index);
+
+  /* Use nvtracker to track detections on batched frame. */
+  branch->nvtracker = make_branch_element ("nvtracker", "nvtracker",
+      gpu_index);
+
+  /* Use nvdsanalytics to perform analytics on object */
+  branch->nvdsanalytics = make_branch_element ("nvdsanalytics",
+      "nvdsanalytics", gpu_index);
+
+  /* Add queue elements between every two elements */
+  branch->queue1 = make_branch_element ("queue", "queue1", gpu_index);
+  branch->queue2 = make_branch_element ("queue", "queue2", gpu_index);
+  branch->queue3 = make_branch_element ("queue", "queue3", gpu_index);
+  branch->queue4 = make_branch_element ("queue", "queue4", gpu_index);
+
+  if (!branch->streammux || !branch->pgie || !branch->nvtracker ||
+      !branch->nvdsanalytics || !branch->queue1 || !branch->queue2 ||
+      !branch->queue3 || !branch->queue4) {
+    g_printerr ("One element could not be created. Exiting.\n");
+    return FALSE;
+  }
+  pipeline_config_apply_queue (&pipeline_settings, 1, branch->queue1);
+  pipeline_config_apply_queue (&pipeline_settings, 2, branch->queue2);
+  pipeline_config_apply_queue (&pipeline_settings, 3, branch->queue3);
+  pipeline_config_apply_queue (&pipeline_settings, 4, branch->queue4);
+
+  /* Per stream groups are numbered by pad_index of this GPU's batch */
+  if (num_gpus > 1) {
+    branch->analytics_config = multi_gpu_write_analytics_config (
+        analytics_config, gpu_index, num_gpus);
+    if (!branch->analytics_config)
+      return FALSE;
+    analytics_config = branch->analytics_config;
   }
-}
 
-static GstElement *
-create_source_bin (guint index, gchar * uri)
-{
-  GstElement *bin = NULL, *uri_decode_bin = NULL;
-  gchar bin_name[16] = { };
+  /* Crop every stream to its ROI before scaling to the network input, the
+   * tensors are handed to nvinfer as meta */
+  if (roi_crop) {
+    branch->preprocess_config = roi_preprocess_write_config (analytics_config,
+        pgie_config, batch_size, mux->width, mux->height, roi_crop_margin,
+        num_gpus > 1 ? (gint) gpu_index : -1);
+    branch->preprocess = make_branch_element ("nvdspreprocess", "preprocess",
+        gpu_index);
+    if (!branch->preprocess_config || !branch->preprocess) {
+      g_printerr ("Failed to set up ROI cropping. Exiting.\n");
+      return FALSE;
+    }
+    g_object_set (G_OBJECT (branch->preprocess), "config-file",
+        branch->preprocess_config, NULL);
+  }
+
+  g_object_set (G_OBJECT (branch->streammux), "width", mux->width, "height",
+      mux->height, "batch-size", batch_size, "batched-push-timeout",
+      mux->batched_push_timeout_us, NULL);
 
-  g_snprintf (bin_name, 15, "source-bin-%02d", index);
-  /* Create a source GstBin to abstract this bin's content from the rest of the
-   * pipeline */
-  bin = gst_bin_new (bin_name);
+  /* Cameras do not wait for a full batch, streammux pushes what it has */
+  if (mux->live_source >= 0)
+    live = mux->live_source > 0;
+  if (live)
+    g_object_set (G_OBJECT (branch->streammux), "live-source", TRUE, NULL);
 
-  /* Source element for reading from the uri.
-   * We will use decodebin and let it figure out the container format of the
-   * stream and the codec and plug the appropriate demux and decode plugins. */
-  uri_decode_bin = gst_element_factory_make ("uridecodebin", "uri-decode-bin");
+  /* Configure the nvinfer element using the nvinfer config file. */
+  g_object_set (G_OBJECT (branch->pgie),
+      "config-file-path", pgie_config, NULL);
+  if (branch->preprocess)
+    g_object_set (G_OBJECT (branch->pgie), "input-tensor-meta", TRUE, NULL);
+
+  /* Configure the nvtracker element for using the particular tracker algorithm. */
+  pipeline_config_apply_tracker (&pipeline_settings, branch->nvtracker);
+
+  /* Configure the nvdsanalytics element for using the particular analytics config file*/
+  g_object_set (G_OBJECT (branch->nvdsanalytics),
+      "config-file", analytics_config,
+       NULL);
+
+  /* Every element of the branch, and the decoders feeding its streammux,
+   * run on its GPU. An engine is only valid on the device it was built for. */
+  if (num_gpus > 1) {
+    g_object_set (G_OBJECT (branch->streammux), "gpu-id", gpu_index, NULL);
+    g_object_set (G_OBJECT (branch->pgie), "gpu-id", gpu_index, NULL);
+    g_object_set (G_OBJECT (branch->nvtracker), "gpu-id", gpu_index, NULL);
+    if (branch->preprocess)
+      g_object_set (G_OBJECT (branch->preprocess), "gpu-id", gpu_index, NULL);
+    branch->engine_file = multi_gpu_engine_path (pgie_config, gpu_index);
+    if (branch->engine_file)
+      g_object_set (G_OBJECT (branch->pgie), "model-engine-file",
+          branch->engine_file, NULL);
+  }
 
-  if (!bin || !uri_decode_bin) {
-    g_printerr ("One element in source bin could not be created.\n");
-    return NULL;
+  /* Override the batch-size set in the config file with the number of sources. */
+  g_object_get (G_OBJECT (branch->pgie), "batch-size", &pgie_batch_size, NULL);
+  if (pgie_batch_size != batch_size) {
+    g_printerr
+        ("WARNING: Overriding infer-config batch-size (%d) with number of sources (%d)\n",
+        pgie_batch_size, batch_size);
+    g_object_set (G_OBJECT (branch->pgie), "batch-size", batch_size, NULL);
   }
 
-  /* We set the input uri to the source element */
-  g_object_set (G_OBJECT (uri_decode_bin), "uri", uri, NULL);
+  /* nvstreammux -> (nvdspreprocess ->) nvinfer -> nvtracker -> nvdsanalytics */
+  gst_bin_add_many (GST_BIN (pipeline), branch->streammux, branch->queue1,
+      branch->pgie, branch->queue2, branch->nvtracker, branch->queue3,
+      branch->nvdsanalytics, branch->queue4, NULL);
+  if (branch->preprocess) {
+    gst_bin_add (GST_BIN (pipeline), branch->preprocess);
+    if (!gst_element_link_many (branch->streammux, branch->queue1,
+            branch->preprocess, branch->pgie, NULL)) {
+      g_printerr ("Elements could not be linked. Exiting.\n");
+      return FALSE;
+    }
+  } else if (!gst_element_link_many (branch->streammux, branch->queue1,
+          branch->pgie, NULL)) {
+    g_printerr ("Elements could not be linked. Exiting.\n");
+    return FALSE;
+  }
+  if (!gst_element_link_many (branch->pgie, branch->queue2, branch->nvtracker,
+          branch->queue3, branch->nvdsanalytics, branch->queue4, NULL)) {
+    g_printerr ("Elements could not be linked. Exiting.\n");
+    return FALSE;
+  }
+  branch->output = branch->queue4;
+
+  /* Out of ROI detections go back to the meta pool before the tracker has
+   * to associate them */
+  if (roi_prefilter) {
+    GstPad *pgie_src_pad = gst_element_get_static_pad (branch->pgie, "src");
+    branch->roi_filter = roi_filter_new (analytics_config, mux->width,
+        mux->height);
+    if (!branch->roi_filter || !pgie_src_pad) {
+      g_printerr ("Failed to set up the ROI prefilter. Exiting.\n");
+      return FALSE;
+    }
+    roi_filter_attach (branch->roi_filter, pgie_src_pad);
+    gst_object_unref (pgie_src_pad);
+  }
+  return TRUE;
+}
 
-  /* Connect to the "pad-added" signal of the decodebin which generates a
-   * callback once a new pad for raw data has beed created by the decodebin */
-  g_signal_connect (G_OBJECT (uri_decode_bin), "pad-added",
-      G_CALLBACK (cb_newpad), bin);
-  g_signal_connect (G_OBJECT (uri_decode_bin), "child-added",
-      G_CALLBACK (decodebin_child_added), bin);
+/* Lets add probe to get informed of the meta data generated, we add probe to
+ * the src pad of the nvdsanalytics element, since by that time, the buffer
+ * would have had got all the metadata. */
+static void
+attach_branch_probes (InferBranch * branch, guint gpu_index,
+    AnalyticsMeta * analytics, PerfStats * perf, RoiAggregator * aggregator,
+    Startup * startup)
+{
+  GstPad *nvdsanalytics_src_pad =
+      gst_element_get_static_pad (branch->nvdsanalytics, "src");
 
-  gst_bin_add (GST_BIN (bin), uri_decode_bin);
+  if (!nvdsanalytics_src_pad) {
+    g_print ("Unable to get src pad\n");
+    return;
+  }
 
-  /* We need to create a ghost pad for the source bin which will act as a proxy
-   * for the video decoder src pad. The ghost pad will not have a target right
-   * now. Once the decode bin creates the video decoder and generates the
-   * cb_newpad callback, we will set the ghost pad target to the video decoder
-   * src pad. */
-  if (!gst_element_add_pad (bin, gst_ghost_pad_new_no_target ("src",
-              GST_PAD_SRC))) {
-    g_printerr ("Failed to add ghost pad in source bin\n");
-    return NULL;
+  /* Every GPU pushes to its own metrics ring */
+  analytics_meta_attach (analytics, nvdsanalytics_src_pad, gpu_index,
+      gpu_index, num_gpus);
+  startup_attach (startup, nvdsanalytics_src_pad, PGIE_CLASS_ID_PERSON,
+      gpu_index, num_gpus);
+  if (perf) {
+    GstElement *timed[] = { branch->queue1, branch->preprocess, branch->pgie,
+      branch->queue2, branch->nvtracker, branch->queue3, branch->nvdsanalytics,
+      branch->queue4
+    };
+    GstElement *queues[] = { branch->queue1, branch->queue2, branch->queue3,
+      branch->queue4
+    };
+
+    /* preprocess only exists with --roi-crop */
+    for (guint i = 0; i < G_N_ELEMENTS (timed); i++)
+      if (timed[i])
+        perf_stats_add_element (perf, timed[i]);
+    for (guint i = 0; i < G_N_ELEMENTS (queues); i++)
+      perf_stats_add_queue (perf, queues[i]);
+    perf_stats_add_frame_counter (perf, nvdsanalytics_src_pad, gpu_index,
+        num_gpus);
+    perf_stats_add_tracker (perf, branch->nvtracker, gpu_index, num_gpus);
   }
+  if (aggregator)
+    roi_aggregator_attach (aggregator, nvdsanalytics_src_pad, gpu_index,
+        num_gpus);
+  /* After nvtracker, so objects carried through skipped frames keep the
+   * interval down */
+  if (adaptive_max_interval > 0) {
+    branch->adaptive = adaptive_interval_new (branch->pgie,
+        adaptive_max_interval, idle_seconds);
+    adaptive_interval_attach (branch->adaptive, nvdsanalytics_src_pad);
+  }
+  gst_object_unref (nvdsanalytics_src_pad);
+}
 
-  return bin;
+static void
+free_infer_branch (InferBranch * branch)
+{
+  adaptive_interval_free (branch->adaptive);
+  roi_filter_free (branch->roi_filter);
+  if (branch->preprocess_config) {
+    unlink (branch->preprocess_config);
+    g_free (branch->preprocess_config);
+  }
+  if (branch->analytics_config) {
+    unlink (branch->analytics_config);
+    g_free (branch->analytics_config);
+  }
+  g_free (branch->engine_file);
 }
 
 int
 main (int argc, char *argv[])
 {
+  /* Time to first detection counts from here, restarts included */
+  gint64 start_us = g_get_monotonic_time ();
   GMainLoop *loop = NULL;
-  GstElement *pipeline = NULL, *streammux = NULL, *sink = NULL, *pgie = NULL,
-             *nvtracker = NULL, *nvdsanalytics = NULL,
+  GstElement *pipeline = NULL, *sink = NULL,
       *nvvidconv = NULL, *nvosd = NULL, *tiler = NULL,
-      *queue1, *queue2, *queue3, *queue4, *queue5, *queue6, *queue7;
+      *queue5 = NULL, *queue6 = NULL, *queue7 = NULL;
   GstElement *transform = NULL;
+  GstElement **streammuxes = NULL;
+  InferBranch *branches = NULL;
   GstBus *bus = NULL;
   guint bus_watch_id;
-  GstPad *nvdsanalytics_src_pad = NULL;
-  guint i, num_sources;
+  guint i, num_sources, streams_per_gpu;
   guint tiler_rows, tiler_columns;
-  guint pgie_batch_size;
+  gboolean live = FALSE;
+  GOptionContext *ctx = NULL;
+  GOptionGroup *group = NULL;
+  GError *error = NULL;
+  MetricsFormat metrics_format = METRICS_FORMAT_JSON;
+  MetricsSink *metrics = NULL;
+  AnalyticsMeta *analytics = NULL;
+  Startup *startup = NULL;
+  gboolean timed_out;
+  PerfStats *perf = NULL;
+  RoiAggregator *aggregator = NULL;
+  SnapshotWriter *snapshots = NULL;
+  StreamOutputType output_type = STREAM_OUTPUT_DISPLAY;
+  StreamOutput *output = NULL;
+  Benchmark *bench = NULL;
+  gchar **sweep_argv = NULL;
 
   int current_device = -1;
   cudaGetDevice(&current_device);
   struct cudaDeviceProp prop;
   cudaGetDeviceProperties(&prop, current_device);
 
+  ctx = g_option_context_new ("<uri1> [uri2] ... [uriN]");
+  group = g_option_group_new ("abc", NULL, NULL, NULL, NULL);
+  g_option_group_add_entries (group, entries);
+
+  g_option_context_set_main_group (ctx, group);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+
+  /* The sweep reruns this binary with the original arguments */
+  sweep_argv = g_strdupv (argv);
+  if (!g_option_context_parse (ctx, &argc, &argv, &error)) {
+    g_printerr ("%s\n", error->message);
+    g_error_free (error);
+    return -1;
+  }
+  g_option_context_free (ctx);
+
+  if (benchmark_sweep_mode) {
+    gint max_streams = benchmark_sweep (sweep_argv, benchmark_target_fps,
+        benchmark_max_streams);
+    g_strfreev (sweep_argv);
+    return max_streams < 0 ? -1 : 0;
+  }
+  g_strfreev (sweep_argv);
+
+  if (!pgie_config)
+    pgie_config = g_strdup ("nvdsanalytics_pgie_config.txt");
+
+  /* Benchmark runs are unsynchronized and only count frames */
+  if (benchmark_streams > 0) {
+    headless = TRUE;
+    if (!metrics_format_str)
+      metrics_format = METRICS_FORMAT_NONE;
+  }
+
   /* Check input arguments */
-  if (argc < 2) {
-    g_printerr ("Usage: %s <uri1> [uri2] ... [uriN] \n", argv[0]);
+  if (argc < 2 && max_sources == 0 && benchmark_streams == 0) {
+    g_printerr ("Usage: %s [OPTION...] <uri1> [uri2] ... [uriN] \n", argv[0]);
+    return -1;
+  }
+  if (benchmark_streams > 0)
+    num_sources = benchmark_streams;
+  else
+    num_sources = MAX ((guint) argc - 1, max_sources);
+
+  if (metrics_format_str &&
+      !metrics_format_from_string (metrics_format_str, &metrics_format)) {
+    g_printerr ("Unknown metrics format %s\n", metrics_format_str);
+    return -1;
+  }
+
+  if (output_str && !stream_output_type_from_string (output_str, &output_type)) {
+    g_printerr ("Unknown output %s\n", output_str);
+    return -1;
+  }
+  if (output_codec && g_strcmp0 (output_codec, "h264") &&
+      g_strcmp0 (output_codec, "h265")) {
+    g_printerr ("Unknown output codec %s\n", output_codec);
+    return -1;
+  }
+
+  if (!pipeline_config_preset (pipeline_preset ? pipeline_preset :
+          PIPELINE_PRESET_DEFAULT, &pipeline_settings)) {
+    g_printerr ("Unknown pipeline preset %s\n", pipeline_preset);
     return -1;
   }
-  num_sources = argc - 1;
+  if (pipeline_config_path &&
+      !pipeline_config_load (pipeline_config_path, &pipeline_settings))
+    return -1;
+  if (tracker_type &&
+      !pipeline_config_tracker (tracker_type, &pipeline_settings)) {
+    g_printerr ("Unknown tracker %s\n", tracker_type);
+    return -1;
+  }
+  /* The bundled IOU config sits next to the nvinfer config */
+  pipeline_config_resolve_tracker (&pipeline_settings, pgie_config);
+
+  /* The benchmark tee feeds a single streammux */
+  num_gpus = multi_gpu_count (num_gpus);
+  if (num_gpus > 1 && benchmark_streams > 0) {
+    g_printerr ("--gpus does not combine with --benchmark-streams\n");
+    return -1;
+  }
+  /* No tiler composites streams from several GPUs */
+  if (num_gpus > 1 && !headless) {
+    g_printerr ("WARNING: running headless on %u GPUs\n", num_gpus);
+    headless = TRUE;
+  }
+  /* The encoded output is the OSD picture */
+  if (output_type != STREAM_OUTPUT_DISPLAY && headless) {
+    g_printerr ("--output=%s needs the OSD, it does not combine with "
+        "--headless, --gpus or the benchmark\n", output_str);
+    return -1;
+  }
+  streams_per_gpu = (num_sources + num_gpus - 1) / num_gpus;
+
+  for (i = 1; i < (guint) argc && benchmark_streams == 0; i++) {
+    if (!g_str_has_prefix (argv[i], "file:")) {
+      live = TRUE;
+      break;
+    }
+  }
 
   /* Standard GStreamer initialization */
   gst_init (&argc, &argv);
   loop = g_main_loop_new (NULL, FALSE);
+  startup = startup_new (start_us, startup_timeout, loop);
 
   /* Create gstreamer elements */
   /* Create Pipeline element that will form a connection of other elements */
   pipeline = gst_pipeline_new ("nvdsanalytics-test-pipeline");
-
-  /* Create nvstreammux instance to form batches from one or more sources. */
-  streammux = gst_element_factory_make ("nvstreammux", "stream-muxer");
-
-  if (!pipeline || !streammux) {
+  if (!pipeline) {
     g_printerr ("One element could not be created. Exiting.\n");
     return -1;
   }
-  gst_bin_add (GST_BIN (pipeline), streammux);
 
-  for (i = 0; i < num_sources; i++) {
-    GstPad *sinkpad, *srcpad;
-    gchar pad_name[16] = { };
-    GstElement *source_bin = create_source_bin (i, argv[i + 1]);
-
-    if (!source_bin) {
-      g_printerr ("Failed to create source bin. Exiting.\n");
+  /* nvstreammux batches the streams of one GPU for its nvinfer */
+  branches = g_new0 (InferBranch, num_gpus);
+  streammuxes = g_new0 (GstElement *, num_gpus);
+  for (i = 0; i < num_gpus; i++) {
+    if (!create_infer_branch (&branches[i], pipeline, i, streams_per_gpu,
+            live))
       return -1;
-    }
-
-    gst_bin_add (GST_BIN (pipeline), source_bin);
+    streammuxes[i] = branches[i].streammux;
+  }
 
-    g_snprintf (pad_name, 15, "sink_%u", i);
-    sinkpad = gst_element_get_request_pad (streammux, pad_name);
-    if (!sinkpad) {
-      g_printerr ("Streammux request sink pad failed. Exiting.\n");
+  if (benchmark_streams > 0) {
+    bench = benchmark_new (pipeline, streammuxes[0], argc > 1 ? argv[1] : NULL,
+        benchmark_streams, benchmark_duration, loop);
+    if (!bench) {
+      g_printerr ("Failed to set up the benchmark source. Exiting.\n");
       return -1;
     }
+  } else {
+    /* Every slot up to num_sources can be filled at runtime, the batch and
+     * the engine profile are sized for all of them up front */
+    sources = source_manager_new (pipeline, streammuxes, num_gpus,
+        streams_per_gpu * num_gpus);
+  }
 
-    srcpad = gst_element_get_static_pad (source_bin, "src");
-    if (!srcpad) {
-      g_printerr ("Failed to get src pad of source bin. Exiting.\n");
-      return -1;
+  if (headless) {
+    /* Analytics only: nothing is composited or displayed, the sink just
+     * releases the batches as fast as they come */
+    sink = gst_element_factory_make ("fakesink", "nvvideo-renderer");
+  } else {
+    /* Use nvtiler to composite the batched frames into a 2D tiled array based
+     * on the source of the frames. */
+    tiler = gst_element_factory_make ("nvmultistreamtiler", "nvtiler");
+
+    /* Use convertor to convert from NV12 to RGBA as required by nvosd */
+    nvvidconv = gst_element_factory_make ("nvvideoconvert", "nvvideo-converter");
+
+    /* Create OSD to draw on the converted RGBA buffer */
+    nvosd = gst_element_factory_make ("nvdsosd", "nv-onscreendisplay");
+
+    queue5 = gst_element_factory_make ("queue", "queue5");
+    queue6 = gst_element_factory_make ("queue", "queue6");
+    queue7 = gst_element_factory_make ("queue", "queue7");
+    if (queue5 && queue6 && queue7) {
+      pipeline_config_apply_queue (&pipeline_settings, 5, queue5);
+      pipeline_config_apply_queue (&pipeline_settings, 6, queue6);
+      pipeline_config_apply_queue (&pipeline_settings, 7, queue7);
     }
 
-    if (gst_pad_link (srcpad, sinkpad) != GST_PAD_LINK_OK) {
-      g_printerr ("Failed to link source bin to stream muxer. Exiting.\n");
-      return -1;
+    /* Finally render the osd output, the encoded outputs bring their own
+     * sink */
+    if (output_type == STREAM_OUTPUT_DISPLAY) {
+      if(prop.integrated) {
+        transform = gst_element_factory_make ("nvegltransform", "nvegl-transform");
+      }
+      sink = gst_element_factory_make ("nveglglessink", "nvvideo-renderer");
     }
-
-    gst_object_unref (srcpad);
-    gst_object_unref (sinkpad);
   }
 
-  /* Use nvinfer to infer on batched frame. */
-  pgie = gst_element_factory_make ("nvinfer", "primary-nvinference-engine");
-
-  /* Use nvtracker to track detections on batched frame. */
-  nvtracker = gst_element_factory_make ("nvtracker", "nvtracker");
-
-  /* Use nvdsanalytics to perform analytics on object */
-  nvdsanalytics = gst_element_factory_make ("nvdsanalytics", "nvdsanalytics");
-
-  /* Use nvtiler to composite the batched frames into a 2D tiled array based
-   * on the source of the frames. */
-  tiler = gst_element_factory_make ("nvmultistreamtiler", "nvtiler");
-
-  /* Use convertor to convert from NV12 to RGBA as required by nvosd */
-  nvvidconv = gst_element_factory_make ("nvvideoconvert", "nvvideo-converter");
-
-  /* Create OSD to draw on the converted RGBA buffer */
-  nvosd = gst_element_factory_make ("nvdsosd", "nv-onscreendisplay");
+  if (!sink && output_type == STREAM_OUTPUT_DISPLAY) {
+    g_printerr ("One element could not be created. Exiting.\n");
+    return -1;
+  }
 
-  /* Add queue elements between every two elements */
-  queue1 = gst_element_factory_make ("queue", "queue1");
-  queue2 = gst_element_factory_make ("queue", "queue2");
-  queue3 = gst_element_factory_make ("queue", "queue3");
-  queue4 = gst_element_factory_make ("queue", "queue4");
-  queue5 = gst_element_factory_make ("queue", "queue5");
-  queue6 = gst_element_factory_make ("queue", "queue6");
-  queue7 = gst_element_factory_make ("queue", "queue7");
-
-  /* Finally render the osd output */
-  if(prop.integrated) {
-    transform = gst_element_factory_make ("nvegltransform", "nvegl-transform");
-  }
-  sink = gst_element_factory_make ("nveglglessink", "nvvideo-renderer");
-
-  if (!pgie || !nvtracker || !nvdsanalytics || !tiler || !nvvidconv ||
-      !nvosd || !sink || !queue1 || !queue2 || !queue3 || !queue4 || !queue5 ||
-      !queue6 || !queue7
-      ) {
+  if (!headless && (!tiler || !nvvidconv || !nvosd || !queue5 || !queue6 ||
+          !queue7)) {
     g_printerr ("One element could not be created. Exiting.\n");
     return -1;
   }
 
-  if(!transform && prop.integrated) {
+  if(!headless && sink && !transform && prop.integrated) {
     g_printerr ("One tegra element could not be created. Exiting.\n");
     return -1;
   }
 
-  g_object_set (G_OBJECT (streammux), "width", MUXER_OUTPUT_WIDTH, "height",
-      MUXER_OUTPUT_HEIGHT, "batch-size", num_sources,
-      "batched-push-timeout", MUXER_BATCH_TIMEOUT_USEC, NULL);
-
-  /* Configure the nvinfer element using the nvinfer config file. */
-  g_object_set (G_OBJECT (pgie),
-      "config-file-path", "nvdsanalytics_pgie_config.txt", NULL);
-
-  /* Configure the nvtracker element for using the particular tracker algorithm. */
-  g_object_set (G_OBJECT (nvtracker),
-      "ll-lib-file", "/opt/nvidia/deepstream/deepstream/lib/libnvds_nvmultiobjecttracker.so",
-      "ll-config-file", "../../../../samples/configs/deepstream-app/config_tracker_NvDCF_perf.yml",
-      "tracker-width", 640, "tracker-height", 480,
-       NULL);
-
-  /* Configure the nvdsanalytics element for using the particular analytics config file*/
-  g_object_set (G_OBJECT (nvdsanalytics),
-      "config-file", "config_nvdsanalytics.txt",
-       NULL);
-
-  /* Override the batch-size set in the config file with the number of sources. */
-  g_object_get (G_OBJECT (pgie), "batch-size", &pgie_batch_size, NULL);
-  if (pgie_batch_size != num_sources) {
-    g_printerr
-        ("WARNING: Overriding infer-config batch-size (%d) with number of sources (%d)\n",
-        pgie_batch_size, num_sources);
-    g_object_set (G_OBJECT (pgie), "batch-size", num_sources, NULL);
+  if (headless) {
+    g_object_set (G_OBJECT (sink), "sync", FALSE, NULL);
+  } else {
+    tiler_rows = (guint) sqrt (num_sources);
+    tiler_columns = (guint) ceil (1.0 * num_sources / tiler_rows);
+    /* we set the tiler properties here */
+    g_object_set (G_OBJECT (tiler), "rows", tiler_rows, "columns", tiler_columns,
+        "width", TILED_OUTPUT_WIDTH, "height", TILED_OUTPUT_HEIGHT, NULL);
+
+    if (sink)
+      g_object_set (G_OBJECT (sink), "qos", 0, NULL);
   }
 
-  tiler_rows = (guint) sqrt (num_sources);
-  tiler_columns = (guint) ceil (1.0 * num_sources / tiler_rows);
-  /* we set the tiler properties here */
-  g_object_set (G_OBJECT (tiler), "rows", tiler_rows, "columns", tiler_columns,
-      "width", TILED_OUTPUT_WIDTH, "height", TILED_OUTPUT_HEIGHT, NULL);
-
-  g_object_set (G_OBJECT (sink), "qos", 0, NULL);
-
   /* we add a message handler */
   bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
   bus_watch_id = gst_bus_add_watch (bus, bus_call, loop);
   gst_object_unref (bus);
 
+  /* Alerts tap the batches after nvdsanalytics through a tee, a slow
+   * encoder only drops snapshot frames */
+  if (snapshot_dir) {
+    snapshots = snapshot_writer_new (snapshot_dir,
+        snapshot_roi ? snapshot_roi : "RF", SNAPSHOT_POOL_SIZE,
+        snapshot_quality);
+    if (!snapshots)
+      return -1;
+    for (i = 0; i < num_gpus; i++) {
+      branches[i].output = snapshot_writer_add_branch (snapshots, pipeline,
+          branches[i].queue4, i, num_gpus,
+          num_gpus > 1 ? i : (guint) MAX (current_device, 0));
+      if (!branches[i].output)
+        return -1;
+    }
+  }
+
   /* Set up the pipeline */
   /* we add all elements into the pipeline */
-  if(prop.integrated) {
-    gst_bin_add_many (GST_BIN (pipeline), queue1,  pgie, queue2, nvtracker, queue3,
-            nvdsanalytics , queue4, tiler, queue5,
+  if (headless) {
+    gst_bin_add (GST_BIN (pipeline), sink);
+    /* we link the elements together
+    * nvstreammux -> nvinfer -> nvtracker -> nvdsanalytics -> fakesink
+    */
+    if (!gst_element_link (branches[0].output, sink)) {
+      g_printerr ("Elements could not be linked. Exiting.\n");
+      return -1;
+    }
+    /* The other GPUs end in their own fakesink */
+    for (i = 1; i < num_gpus; i++) {
+      GstElement *gpu_sink = make_branch_element ("fakesink",
+          "nvvideo-renderer", i);
+      if (!gpu_sink) {
+        g_printerr ("One element could not be created. Exiting.\n");
+        return -1;
+      }
+      g_object_set (G_OBJECT (gpu_sink), "sync", FALSE, NULL);
+      gst_bin_add (GST_BIN (pipeline), gpu_sink);
+      if (!gst_element_link (branches[i].output, gpu_sink)) {
+        g_printerr ("Elements could not be linked. Exiting.\n");
+        return -1;
+      }
+    }
+  }
+  else if (output_type != STREAM_OUTPUT_DISPLAY) {
+    StreamOutputConfig config;
+
+    gst_bin_add_many (GST_BIN (pipeline), tiler, queue5,
+                  nvvidconv, queue6, nvosd, queue7, NULL);
+    /* nvstreammux -> nvinfer -> nvtracker -> nvdsanalytics -> nvtiler ->
+    * nvvideoconvert -> nvosd -> tee -> fakesink
+    *                                \-> leaky queue -> NVENC -> RTSP / MP4
+    */
+    if (!gst_element_link_many (branches[0].output, tiler, queue5, nvvidconv,
+        queue6, nvosd, queue7, NULL)) {
+      g_printerr ("Elements could not be linked. Exiting.\n");
+      return -1;
+    }
+
+    config.type = output_type;
+    config.h265 = !g_strcmp0 (output_codec, "h265");
+    config.bitrate = output_bitrate;
+    config.gop = output_gop;
+    config.gpu_id = MAX (current_device, 0);
+    config.rtsp_port = rtsp_port;
+    config.location = output_location ? output_location : "out-%05d.mp4";
+    config.segment_sec = MAX (output_segment_sec, 1);
+    output = stream_output_new (pipeline, queue7, &config);
+    if (!output)
+      return -1;
+  }
+  else if(prop.integrated) {
+    gst_bin_add_many (GST_BIN (pipeline), tiler, queue5,
             nvvidconv, queue6, nvosd, queue7, transform, sink,
         NULL);
 
@@ -451,48 +840,102 @@ main (int argc, char *argv[])
     * nvstreammux -> nvinfer -> nvtracker -> nvdsanalytics -> nvtiler ->
     * nvvideoconvert -> nvosd -> transform -> sink
     */
-    if (!gst_element_link_many (streammux,queue1, pgie , queue2, nvtracker,
-          queue3, nvdsanalytics, queue4, tiler, queue5,
+    if (!gst_element_link_many (branches[0].output, tiler, queue5,
           nvvidconv, queue6, nvosd, queue7, transform, sink, NULL)) {
       g_printerr ("Elements could not be linked. Exiting.\n");
       return -1;
     }
   }
   else {
-    gst_bin_add_many (GST_BIN (pipeline), queue1, pgie, queue2,
-                  nvtracker, queue3, nvdsanalytics, queue4, tiler, queue5,
+    gst_bin_add_many (GST_BIN (pipeline), tiler, queue5,
                   nvvidconv, queue6, nvosd, queue7, sink, NULL);
     /* we link the elements together
     * nvstreammux -> nvinfer -> nvtracker -> nvdsanalytics -> nvtiler ->
     * nvvideoconvert -> nvosd -> sink
     */
-    if (!gst_element_link_many (streammux, queue1, pgie, queue2, nvtracker,
-        queue3, nvdsanalytics, queue4, tiler, queue5, nvvidconv, queue6,
-        nvosd, queue7, sink, NULL)) {
+    if (!gst_element_link_many (branches[0].output, tiler, queue5, nvvidconv,
+        queue6, nvosd, queue7, sink, NULL)) {
       g_printerr ("Elements could not be linked. Exiting.\n");
       return -1;
     }
   }
 
-  /* Lets add probe to get informed of the meta data generated, we add probe to
-   * the sink pad of the nvdsanalytics element, since by that time, the buffer
-   * would have had got all the metadata.
-   */
-  nvdsanalytics_src_pad = gst_element_get_static_pad (nvdsanalytics, "src");
-  if (!nvdsanalytics_src_pad)
-    g_print ("Unable to get src pad\n");
-  else
-    gst_pad_add_probe (nvdsanalytics_src_pad, GST_PAD_PROBE_TYPE_BUFFER,
-        nvdsanalytics_src_pad_buffer_probe, NULL, NULL);
-  gst_object_unref (nvdsanalytics_src_pad);
+  if (perf_interval > 0 || perf_port > 0) {
+    gchar *yolo_lib_path =
+        perf_stats_get_custom_lib_path (pgie_config);
+    GstElement *timed[] = { tiler, queue5, nvvidconv, queue6, nvosd, queue7 };
+    GstElement *queues[] = { queue5, queue6, queue7 };
+
+    perf = perf_stats_new (perf_interval, perf_port, yolo_lib_path);
+    g_free (yolo_lib_path);
+    perf_stats_add_startup (perf, startup);
+    /* Headless pipelines stop at queue4 */
+    for (i = 0; i < G_N_ELEMENTS (timed); i++)
+      if (timed[i])
+        perf_stats_add_element (perf, timed[i]);
+    for (i = 0; i < G_N_ELEMENTS (queues); i++)
+      if (queues[i])
+        perf_stats_add_queue (perf, queues[i]);
+  }
+
+  /* One ring per GPU, the streaming threads of the branches never share
+   * one */
+  if (metrics_format != METRICS_FORMAT_NONE) {
+    metrics = metrics_sink_new (metrics_format, metrics_file,
+        METRICS_RING_CAPACITY, num_gpus);
+    if (!metrics)
+      return -1;
+  }
+  analytics = analytics_meta_new (metrics, PGIE_CLASS_ID_PERSON, FALSE);
+
+  if (roi_summary_interval > 0) {
+    aggregator = roi_aggregator_new (roi_summary_interval, roi_summary_window,
+        roi_summary_file);
+    if (!aggregator)
+      return -1;
+  }
+
+  for (i = 0; i < num_gpus; i++)
+    attach_branch_probes (&branches[i], i, analytics, perf, aggregator,
+        startup);
+
+  /* Frames are counted where they leave the pipeline */
+  if (bench) {
+    GstPad *sink_pad = gst_element_get_static_pad (sink, "sink");
+    benchmark_attach (bench, sink_pad);
+    gst_object_unref (sink_pad);
+  }
+
+  /* Engines load and run their first inferences before any camera is
+   * connected, so the first seconds of every stream are not spent on it */
+  if (!startup_preroll (startup, pipeline))
+    return -1;
+  if (warmup_iterations > 0) {
+    gchar *yolo_lib_path = perf_stats_get_custom_lib_path (pgie_config);
+    for (i = 0; i < num_gpus; i++)
+      startup_warmup (startup, yolo_lib_path, branches[i].pgie,
+          warmup_iterations);
+    g_free (yolo_lib_path);
+  }
+
+  if (sources) {
+    for (i = 1; i < (guint) argc; i++) {
+      if (source_manager_add (sources, argv[i]) < 0) {
+        g_printerr ("Failed to add source %s. Exiting.\n", argv[i]);
+        return -1;
+      }
+    }
+    source_manager_watch_stdin (sources);
+  }
 
   /* Set the pipeline to "playing" state */
   g_print ("Now playing:");
-  for (i = 0; i < num_sources; i++) {
-    g_print (" %s,", argv[i + 1]);
+  for (i = 1; i < (guint) argc; i++) {
+    g_print (" %s,", argv[i]);
   }
   g_print ("\n");
   gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  startup_playing (startup);
 
   /* Wait till pipeline encounters an error or EOS */
   g_print ("Running...\n");
@@ -500,10 +943,30 @@ main (int argc, char *argv[])
 
   /* Out of the main loop, clean up nicely */
   g_print ("Returned, stopping playback\n");
+  if (bench)
+    benchmark_report (bench, pgie_config);
   gst_element_set_state (pipeline, GST_STATE_NULL);
+  /* No more buffers flow once in NULL, the sink can drain and stop */
+  analytics_meta_free (analytics);
+  metrics_sink_free (metrics);
+  perf_stats_free (perf);
+  timed_out = startup_timed_out (startup);
+  startup_free (startup);
+  roi_aggregator_free (aggregator);
+  snapshot_writer_free (snapshots);
+  stream_output_free (output);
+  benchmark_free (bench);
+  source_manager_free (sources);
+  sources = NULL;
+  for (i = 0; i < num_gpus; i++)
+    free_infer_branch (&branches[i]);
+  g_free (branches);
+  g_free (streammuxes);
+  g_free (pgie_config);
+  pipeline_config_clear (&pipeline_settings);
   g_print ("Deleting pipeline\n");
   gst_object_unref (GST_OBJECT (pipeline));
   g_source_remove (bus_watch_id);
   g_main_loop_unref (loop);
-  return 0;
+  return timed_out ? -1 : 0;
 }